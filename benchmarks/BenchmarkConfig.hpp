@@ -0,0 +1,269 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _BENCHMARK_CONFIG_H_
+#define _BENCHMARK_CONFIG_H_
+
+#include <cctype>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "LatencyHistogram.hpp"
+#include "MemorySampler.hpp"
+
+/**
+ * <h1> Benchmark Configuration </h1>
+ *
+ * The workload of a benchmark driver, from the command line or from a JSON file,
+ * instead of the constants of each main() in graphs/:
+ *
+ *   --sets cx-tree,psim-tree    Names of the sets to run (the driver lists them with --list)
+ *   --threads 1,2,4,8           Numbers of threads
+ *   --ratios 1000,100,0         Permil of updates: 100%, 10%, 0%
+ *   --elements 1000             Number of keys in the set
+ *   --duration 20               Seconds of each run
+ *   --runs 1                    Runs of each configuration (the median is reported)
+ *   --shards 8                  Number of shards of the Sharded sets, 0 for their default
+ *   --dist zipf:0.99            Key distribution: uniform, zipf[:theta], hotspot[:hotKeys[:hotOps]] or sequential
+ *   --pin compact               Thread placement: none, compact, scatter, smt-first or cpus:0,2,4-7 (CX_PIN_THREADS if not given)
+ *   --perf 1                    Prints hardware counters per op (cycles, LLC misses, ...) after each set
+ *   --output results.csv        File with the results, CSV or JSON from its extension (stdout if empty)
+ *   --config workload.json      Reads the options from a JSON object with the same names, e.g.
+ *                               { "sets": ["cx-tree"], "threads": [1,2,4], "elements": 1000000 }
+ *
+ * The options are applied in order, so the ones after --config override the file.
+ */
+struct BenchmarkConfig {
+    static const int MAX_THREADS = 128;     // Size of the per-thread arrays of the Universal Constructs
+
+    std::vector<std::string> sets;
+    std::vector<int>         threads {1, 2, 4, 8};
+    std::vector<int>         ratios {1000, 100, 10, 0};
+    int                      elements {1000};
+    int                      duration {20};
+    int                      runs {1};
+    int                      shards {0};
+    std::string              dist {"uniform"};
+    int                      perf {0};
+    std::string              pin;
+    std::string              output;
+    bool                     list {false};
+
+    // Returns false and prints the reason if an option is unknown or malformed
+    bool parse(int argc, char* argv[]) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--list") { list = true; continue; }
+            if (arg.rfind("--", 0) != 0 || i+1 == argc) return error("expected '--option value' at '" + arg + "'");
+            std::string value = argv[++i];
+            bool ok = (arg == "--config") ? loadJSON(value) : set(arg.substr(2), splitList(value));
+            if (!ok) return false;
+        }
+        return true;
+    }
+
+    bool loadJSON(const std::string& filename) {
+        std::ifstream file(filename);
+        if (!file) return error("can't open " + filename);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        JSONReader reader {buffer.str()};
+        if (!reader.expect('{')) return error(filename + ": expected a JSON object");
+        if (reader.peek() == '}') return true;
+        do {
+            std::string name;
+            std::vector<std::string> values;
+            if (!reader.readString(name) || !reader.expect(':') || !reader.readValues(values)) {
+                return error(filename + ": malformed JSON at offset " + std::to_string(reader.pos));
+            }
+            if (!set(name, values)) return false;
+        } while (reader.expect(','));
+        if (!reader.expect('}')) return error(filename + ": expected '}' at offset " + std::to_string(reader.pos));
+        return true;
+    }
+
+    static bool error(const std::string& msg) {
+        std::cerr << "ERROR: " << msg << "\n";
+        return false;
+    }
+
+private:
+    // Just enough JSON for an object of strings, numbers and flat arrays of those
+    struct JSONReader {
+        const std::string text;
+        size_t pos {0};
+
+        char peek() {
+            while (pos < text.size() && std::isspace((unsigned char)text[pos])) pos++;
+            return pos < text.size() ? text[pos] : '\0';
+        }
+        bool expect(char c) {
+            if (peek() != c) return false;
+            pos++;
+            return true;
+        }
+        bool readString(std::string& str) {
+            if (!expect('"')) return false;
+            size_t end = text.find('"', pos);
+            if (end == std::string::npos) return false;
+            str = text.substr(pos, end - pos);
+            pos = end + 1;
+            return true;
+        }
+        bool readScalar(std::string& str) {
+            if (peek() == '"') return readString(str);
+            size_t start = pos;
+            while (pos < text.size() && (std::isalnum((unsigned char)text[pos]) || text[pos] == '-' || text[pos] == '.')) pos++;
+            str = text.substr(start, pos - start);
+            return !str.empty();
+        }
+        bool readValues(std::vector<std::string>& values) {
+            std::string str;
+            if (!expect('[')) {
+                if (!readScalar(str)) return false;
+                values.push_back(str);
+                return true;
+            }
+            if (expect(']')) return true;
+            do {
+                if (!readScalar(str)) return false;
+                values.push_back(str);
+            } while (expect(','));
+            return expect(']');
+        }
+    };
+
+    static std::vector<std::string> splitList(const std::string& value) {
+        std::vector<std::string> values;
+        std::stringstream ss(value);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (!item.empty()) values.push_back(item);
+        }
+        return values;
+    }
+
+    // Puts back the commas of a cpus: list that splitList() took apart
+    static std::string joinList(const std::vector<std::string>& values) {
+        std::string str;
+        for (auto& value : values) str += (str.empty() ? "" : ",") + value;
+        return str;
+    }
+
+    static bool toInt(const std::string& name, const std::string& str, int& value, const long minValue=INT_MIN, const long maxValue=INT_MAX) {
+        char* end;
+        long lvalue = std::strtol(str.c_str(), &end, 10);
+        if (str.empty() || *end != '\0') return error("'" + str + "' is not a number for " + name);
+        if (lvalue < minValue || lvalue > maxValue) {
+            const std::string range = (maxValue == INT_MAX) ? "at least " + std::to_string(minValue) : "between " + std::to_string(minValue) + " and " + std::to_string(maxValue);
+            return error(name + " must be " + range + ", not " + str);
+        }
+        value = (int)lvalue;
+        return true;
+    }
+
+    static bool toInts(const std::string& name, const std::vector<std::string>& strs, std::vector<int>& values, const long minValue=INT_MIN, const long maxValue=INT_MAX) {
+        values.clear();
+        for (auto& str : strs) {
+            int value;
+            if (!toInt(name, str, value, minValue, maxValue)) return false;
+            values.push_back(value);
+        }
+        return !values.empty() || error(name + " is empty");
+    }
+
+    static bool toScalar(const std::string& name, const std::vector<std::string>& strs, std::string& value) {
+        if (strs.size() != 1) return error(name + " takes a single value");
+        value = strs[0];
+        return true;
+    }
+
+    bool set(const std::string& name, const std::vector<std::string>& values) {
+        std::string str;
+        if (name == "sets")     { sets = values; return !sets.empty() || error("sets is empty"); }
+        if (name == "threads")  return toInts(name, values, threads, 1, MAX_THREADS);
+        if (name == "ratios")   return toInts(name, values, ratios);
+        if (name == "elements") return toScalar(name, values, str) && toInt(name, str, elements, 1);
+        if (name == "duration") return toScalar(name, values, str) && toInt(name, str, duration, 1);
+        if (name == "runs")     return toScalar(name, values, str) && toInt(name, str, runs, 1);
+        if (name == "shards")   return toScalar(name, values, str) && toInt(name, str, shards);
+        if (name == "dist")     return toScalar(name, values, dist);
+        if (name == "pin")      { pin = joinList(values); return !pin.empty() || error("pin is empty"); }
+        if (name == "perf")     return toScalar(name, values, str) && toInt(name, str, perf);
+        if (name == "output")   return toScalar(name, values, output);
+        return error("unknown option '" + name + "'");
+    }
+};
+
+
+// One line of results: a set, with a number of threads and a ratio of updates
+struct BenchmarkRecord {
+    std::string name;
+    int         threads;
+    int         ratio;
+    int         elements;
+    std::string dist;
+    std::string pinning;
+    long long   opsPerSec;
+    uint64_t    p50, p90, p99, p999, p9999, max;
+    uint64_t    avgRSSMB, maxRSSMB;
+    long long   copiesPerSec;
+    uint64_t    avgCopyNs;
+
+    BenchmarkRecord(const std::string& name, int threads, int ratio, int elements, const std::string& dist, const std::string& pinning, long long opsPerSec, const LatencyHistogram& latency, const MemoryReport& memory)
+        : name{name}, threads{threads}, ratio{ratio}, elements{elements}, dist{dist}, pinning{pinning}, opsPerSec{opsPerSec},
+          p50{latency.percentile(50.)}, p90{latency.percentile(90.)}, p99{latency.percentile(99.)},
+          p999{latency.percentile(99.9)}, p9999{latency.percentile(99.99)}, max{latency.max()},
+          avgRSSMB{memory.avgRSS/(1024*1024)}, maxRSSMB{memory.maxRSS/(1024*1024)}, copiesPerSec{memory.copiesPerSec()}, avgCopyNs{memory.avgCopyNs()} { }
+};
+
+
+// Writes the records as CSV, or as a JSON array if the file name ends in .json
+inline void writeBenchmarkRecords(std::ostream& os, const std::vector<BenchmarkRecord>& records, const bool json) {
+    if (json) {
+        os << "[\n";
+        for (size_t i = 0; i < records.size(); i++) {
+            const BenchmarkRecord& r = records[i];
+            os << "  {\"name\": \"" << r.name << "\", \"threads\": " << r.threads << ", \"ratio\": " << r.ratio/10.
+               << ", \"elements\": " << r.elements << ", \"dist\": \"" << r.dist << "\", \"pinning\": \"" << r.pinning << "\", \"opsPerSec\": " << r.opsPerSec
+               << ", \"p50ns\": " << r.p50 << ", \"p90ns\": " << r.p90 << ", \"p99ns\": " << r.p99
+               << ", \"p999ns\": " << r.p999 << ", \"p9999ns\": " << r.p9999 << ", \"maxns\": " << r.max
+               << ", \"avgRSSMB\": " << r.avgRSSMB << ", \"maxRSSMB\": " << r.maxRSSMB << ", \"copiesPerSec\": " << r.copiesPerSec
+               << ", \"avgCopyNs\": " << r.avgCopyNs << "}"
+               << (i+1 < records.size() ? ",\n" : "\n");
+        }
+        os << "]\n";
+    } else {
+        os << "name,threads,ratio,elements,dist,pinning,opsPerSec,p50ns,p90ns,p99ns,p999ns,p9999ns,maxns,avgRSSMB,maxRSSMB,copiesPerSec,avgCopyNs\n";
+        for (const BenchmarkRecord& r : records) {
+            os << r.name << "," << r.threads << "," << r.ratio/10. << "," << r.elements << "," << r.dist << "," << r.pinning << "," << r.opsPerSec << ","
+               << r.p50 << "," << r.p90 << "," << r.p99 << "," << r.p999 << "," << r.p9999 << "," << r.max << ","
+               << r.avgRSSMB << "," << r.maxRSSMB << "," << r.copiesPerSec << "," << r.avgCopyNs << "\n";
+        }
+    }
+}
+
+inline bool writeBenchmarkRecords(const std::string& filename, const std::vector<BenchmarkRecord>& records) {
+    const bool json = filename.size() >= 5 && filename.compare(filename.size()-5, 5, ".json") == 0;
+    if (filename.empty()) {
+        writeBenchmarkRecords(std::cout, records, false);
+        return true;
+    }
+    std::ofstream file(filename);
+    if (!file) return BenchmarkConfig::error("can't write " + filename);
+    writeBenchmarkRecords(file, records, json);
+    return true;
+}
+
+#endif /* _BENCHMARK_CONFIG_H_ */
@@ -35,6 +35,10 @@
 #include <vector>
 #include <algorithm>
 
+#include "LatencyHistogram.hpp"
+#include "PerfCounters.hpp"
+#include "ThreadPinning.hpp"
+
 
 // Regular UserData
 struct UserData  {
@@ -48,7 +52,7 @@ struct UserData  {
         this->seq = -2;
         this->tid = -2;
     }
-    UserData(const UserData &other) : seq(other.seq), tid(other.tid) { }
+    UserData(const UserData &other) = default;    // Keeps it trivially copyable
 
     bool operator < (const UserData& other) const {
         return seq < other.seq;
@@ -79,7 +83,7 @@ private:
             this->seq = -2;
             this->tid = -2;
         }
-        UserData(const UserData &other) : seq(other.seq), tid(other.tid) { }
+        UserData(const UserData &other) = default;    // Keeps it trivially copyable
 
         bool operator < (const UserData& other) const {
             return seq < other.seq;
@@ -114,12 +118,24 @@ private:
     static const long long NSEC_IN_SEC = 1000000000LL;
 
     int numThreads;
+    bool perfEnabled {PerfCounters::envEnabled()};
+    PerfCounters::Values lastPerf;
+    ThreadPinning pinning;
 
 public:
     BenchmarkLatencySets(int numThreads) {
         this->numThreads = numThreads;
     }
 
+    // Turns on the hardware counters of the measured iterations (off unless CX_PERF_COUNTERS is set)
+    void setPerfCounters(const bool enabled) { perfEnabled = enabled; }
+
+    // Counters of the last call to latency(), for all the threads
+    const PerfCounters::Values& perf() const { return lastPerf; }
+
+    // Placement of the threads, CX_PIN_THREADS or not pinned by default
+    void setPinning(const ThreadPinning& pin) { pinning = pin; }
+
 
 
 
@@ -133,6 +149,8 @@ public:
      * We only do one run for this benchmark
      *
      * The scenario is 100% write operations (half add, half remove)
+     * Each thread records its delays in its own LatencyHistogram, so the memory doesn't grow with kLatencyMeasures
+     * The perf counters, when enabled, include the timing of each operation itself
      */
     template<typename S>
     int latency(std::string& className, const int numElements) {
@@ -143,78 +161,67 @@ public:
         K** udarray = new K*[numElements];
         for (int i = 0; i < numElements; i++) udarray[i] = new K(i);
 
-        auto latency_lambda = [this,&start,&set,&udarray,numElements](nanoseconds* delays, const int tid) {
-            long long delayIndex = 0;
+        auto latency_lambda = [this,&start,&set,&udarray,numElements](LatencyHistogram* hist, PerfCounters::Values* perf, const int tid) {
+            pinning.pin(tid);
+            PerfCounters counters(perfEnabled);
             while (!start.load()) ; // spin
             uint64_t seed = tid+1234567890123456781ULL;
             // Warmup + Measurements
             for (int iter=0; iter < kLatencyMeasures/numThreads+kLatencyWarmupIterations; iter++) {
+                if (iter == kLatencyWarmupIterations) counters.start();
                 seed = randomLong(seed);
                 auto ix = (unsigned int)(seed%numElements);
                 auto startBeats = steady_clock::now();
                 if (set->remove(*udarray[ix], tid)) set->add(*udarray[ix], tid);
                 auto stopBeats = steady_clock::now();
-                if (iter >= kLatencyWarmupIterations) delays[delayIndex++] = (stopBeats-startBeats);
+                if (iter >= kLatencyWarmupIterations) hist->record(stopBeats-startBeats);
             }
+            counters.stop();
+            *perf = counters.read();
         };
 
-        nanoseconds* delays[numThreads];
-        for (int it = 0; it < numThreads; it++) {
-            delays[it] = new nanoseconds[kLatencyMeasures/numThreads];
-            for (int imeas=0; imeas < kLatencyMeasures/numThreads; imeas++) delays[it][imeas] = 0ns;
-        }
+        std::vector<LatencyHistogram> hists(numThreads);
+        std::vector<PerfCounters::Values> perfs(numThreads);
 
         className = S::className();
         std::cout << "##### " << S::className() << " #####  \n";
+        if (pinning.enabled()) std::cout << "Pinning: " << pinning.describe(numThreads) << "\n";
         // Add all the items to the list
         set->addAll(udarray, numElements, 0);
         thread latencyThreads[numThreads];
-        for (int tid = 0; tid < numThreads; tid++) latencyThreads[tid] = thread(latency_lambda, delays[tid], tid);
+        for (int tid = 0; tid < numThreads; tid++) latencyThreads[tid] = thread(latency_lambda, &hists[tid], &perfs[tid], tid);
         this_thread::sleep_for(100ms);
         start.store(true);
         for (int tid = 0; tid < numThreads; tid++) latencyThreads[tid].join();
         delete set;
 
-        // Aggregate all the delays for enqueues and dequeues and compute the maxs
-        cout << "Aggregating delays for " << kLatencyMeasures/1000000 << " million measurements...\n";
-        vector<nanoseconds> aggDelay(kLatencyMeasures);
-        long long idx = 0;
-        for (int it = 0; it < numThreads; it++) {
-            for (int i = 0; i < kLatencyMeasures/numThreads; i++) {
-                aggDelay[idx] = delays[it][i];
-                idx++;
-            }
-        }
-
-        // Sort the aggregated delays
-        cout << "Sorting delays...\n";
-        sort(aggDelay.begin(), aggDelay.end());
+        // Aggregate the delays of all the threads
+        LatencyHistogram agg;
+        for (int it = 0; it < numThreads; it++) agg.merge(hists[it]);
+        lastPerf = PerfCounters::Values{};
+        for (int it = 0; it < numThreads; it++) lastPerf.merge(perfs[it]);
+        const long long per50000 = agg.percentile(50.);
+        const long long per90000 = agg.percentile(90.);
+        const long long per99000 = agg.percentile(99.);
+        const long long per99900 = agg.percentile(99.9);
+        const long long per99990 = agg.percentile(99.99);
+        const long long per99999 = agg.percentile(99.999);
 
         // Show the 50% (median), 90%, 99%, 99.9%, 99.99%, 99.999% and maximum in microsecond/nanoseconds units
-        long per50000 = (long)(kLatencyMeasures*50000LL/100000LL);
-        long per90000 = (long)(kLatencyMeasures*90000LL/100000LL);
-        long per99000 = (long)(kLatencyMeasures*99000LL/100000LL);
-        long per99900 = (long)(kLatencyMeasures*99900LL/100000LL);
-        long per99990 = (long)(kLatencyMeasures*99990LL/100000LL);
-        long per99999 = (long)(kLatencyMeasures*99999LL/100000LL);
-        long imax = kLatencyMeasures-1;
-
-        cout << "Delay (us): 50%=" << aggDelay[per50000].count()/1000
-             << "  90%=" <<     aggDelay[per90000].count()/1000 << "  99%="    << aggDelay[per99000].count()/1000
-             << "  99.9%=" <<   aggDelay[per99900].count()/1000 << "  99.99%=" << aggDelay[per99990].count()/1000
-             << "  99.999%=" << aggDelay[per99999].count()/1000 << "  max="    << aggDelay[imax].count()/1000 << "\n";
+        cout << "Delay (us): 50%=" << per50000/1000
+             << "  90%=" <<     per90000/1000 << "  99%="    << per99000/1000
+             << "  99.9%=" <<   per99900/1000 << "  99.99%=" << per99990/1000
+             << "  99.999%=" << per99999/1000 << "  max="    << agg.max()/1000 << "\n";
+        if (perfEnabled) lastPerf.print(cout, (long long)agg.count());
 
         // Show in csv format
         cout << "Enqueue delay (us):\n";
-        cout << "50, " << aggDelay[per50000].count()/1000 << "\n";
-        cout << "90, " << aggDelay[per90000].count()/1000 << "\n";
-        cout << "99, " << aggDelay[per99000].count()/1000 << "\n";
-        cout << "99.9, " << aggDelay[per99900].count()/1000 << "\n";
-        cout << "99.99, " << aggDelay[per99990].count()/1000 << "\n";
-        cout << "99.999, " << aggDelay[per99999].count()/1000 << "\n";
-
-        // Cleanup
-        for (int it = 0; it < numThreads; it++) delete[] delays[it];
+        cout << "50, " << per50000/1000 << "\n";
+        cout << "90, " << per90000/1000 << "\n";
+        cout << "99, " << per99000/1000 << "\n";
+        cout << "99.9, " << per99900/1000 << "\n";
+        cout << "99.99, " << per99990/1000 << "\n";
+        cout << "99.999, " << per99999/1000 << "\n";
         return 0;
     }
 
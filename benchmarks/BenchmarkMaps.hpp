@@ -9,6 +9,10 @@
 #include <algorithm>
 #include <iostream>
 
+#include "KeyGenerator.hpp"
+#include "LatencyHistogram.hpp"
+#include "MemorySampler.hpp"
+
 using namespace std;
 using namespace chrono;
 
@@ -24,7 +28,7 @@ struct UserData  {
         this->seq = -2;
         this->tid = -2;
     }
-    UserData(const UserData &other) : seq(other.seq), tid(other.tid) { }
+    UserData(const UserData &other) = default;    // Keeps it trivially copyable
 
     bool operator < (const UserData& other) const {
         return seq < other.seq;
@@ -79,19 +83,43 @@ private:
     };
 
     static const long long NSEC_IN_SEC = 1000000000LL;
+    static const uint64_t kLatencySampling = 64;    // One in every kLatencySampling iterations is timed
 
     int numThreads;
+    KeyDistribution keyDist;
+    int rmwRatio {0};
+    LatencyHistogram lastLatency;
+    MemoryReport lastMemory;
+
+    // stats() of the map, for the Universal Constructs that have it
+    template<typename S> static auto setStats(S* set, int) -> decltype(set->stats()) { return set->stats(); }
+    template<typename S> static UCStatsSnapshot setStats(S* set, long) { return {}; }
 
 public:
     BenchmarkMaps(int numThreads) {
         this->numThreads = numThreads;
     }
 
+    // Latencies of the last call to benchmark(), for all the threads and runs
+    const LatencyHistogram& latency() const { return lastLatency; }
+
+    // RSS and copies of the last call to benchmark(), for all the runs
+    const MemoryReport& memory() const { return lastMemory; }
+
+    // Distribution of the keys of the next calls to benchmark(), uniform by default
+    void setKeyDistribution(const KeyDistribution& dist) { keyDist = dist; }
+
+    // Permil of the updates that are a read-modify-write (a get() and a put() of another value on the same key), 0 by default
+    void setRMWRatio(const int ratio) { rmwRatio = ratio; }
+
 
     /**
      * When doing "updates" we execute a random removal and if the removal is successful we do an add() of the
      * same item immediately after. This keeps the size of the data structure equal to the original size (minus
      * MAX_THREADS items at most) which gives more deterministic results.
+     * With setRMWRatio(), that permil of the updates are a get() followed by a put() of a different value, like
+     * the read-modify-write of YCSB's workload F, which on a skewed distribution puts the hot keys under contention.
+     * The latency is of a whole iteration (a remove() and put(), two get(), or a get() and put()), on a sample of the iterations.
      */
     template<template<typename,typename> class S, typename K, typename V>
     long long benchmark(const int updateRatio, const seconds testLengthSeconds, const int numRuns, const int numElements, const bool dedicated=false) {
@@ -100,6 +128,9 @@ public:
         atomic<bool> quit = { false };
         atomic<bool> startFlag = { false };
         S<K,V>* set = nullptr;
+        std::vector<LatencyHistogram> hists(numThreads);
+        MemorySampler sampler;
+        lastMemory = MemoryReport{};
 #ifdef TINY_STM
         stm_init_thread();
         //const int tid = 0;
@@ -113,37 +144,43 @@ public:
         for (int i = 0; i < numElements; i++) keyarray[i] = new K(i);
         V** valarray = new V*[numElements];
         for (int i = 0; i < numElements; i++) valarray[i] = new V(i);
+        const KeyGenerator keyGen(keyDist, numElements, numThreads);
 
         // Can either be a Reader or a Writer
         auto rw_lambda = [&](const int updateRatio, long long *ops, const int tid) {
         	uint64_t accum = 0;
             long long numOps = 0;
+            uint64_t iter = 0;
 #ifdef TINY_STM
             stm_init_thread();
 #endif
+            KeyGenerator::State keyState = keyGen.initState(tid);
             while (!startFlag.load()) ; // spin
-            uint64_t seed = tid+1234567890123456781ULL;
             while (!quit.load()) {
-                seed = randomLong(seed);
-                int update = seed%1000;
-                seed = randomLong(seed);
-                auto ix = (unsigned int)(seed%numElements);
-                if (update < updateRatio) {
+                const bool timed = (++iter % kLatencySampling) == 0;
+                const auto startBeats = timed ? steady_clock::now() : steady_clock::time_point{};
+                int update = keyState.random()%1000;
+                auto ix = keyGen.next(keyState);
+                if (update < updateRatio && (int)(keyState.random()%1000) < rmwRatio) {
+                    // Read-modify-write
+                    set->get(*keyarray[ix], tid);
+                    set->put(*keyarray[ix], *valarray[(ix+1)%numElements], tid);
+                    numOps+=2;
+                } else if (update < updateRatio) {
                     // I'm a Writer
-                    if (set->remove(*keyarray[ix])) {
+                    if (set->remove(*keyarray[ix], tid)) {
                     	numOps++;
-                    	set->put(*keyarray[ix], *valarray[ix]);
+                    	set->put(*keyarray[ix], *valarray[ix], tid);
                     }
                     numOps++;
                 } else {
                 	// I'm a Reader
-                    set->get(*keyarray[ix]);
-                    seed = randomLong(seed);
-                    ix = (unsigned int)(seed%numElements);
-                    set->get(*keyarray[ix]);
+                    set->get(*keyarray[ix], tid);
+                    ix = keyGen.next(keyState);
+                    set->get(*keyarray[ix], tid);
                     numOps+=2;
                 }
-
+                if (timed) hists[tid].record(steady_clock::now() - startBeats);
             }
             *ops = numOps;
 #ifdef TINY_STM
@@ -152,10 +189,10 @@ public:
         };
 
         for (int irun = 0; irun < numRuns; irun++) {
-            set = new S<K,V>();
+            set = new S<K,V>(numThreads);
             // Add all the items to the list
-            set->addAll(keyarray, valarray, numElements);
-            if (irun == 0) std::cout << "##### " << set->className() << " #####  \n";
+            set->addAll(keyarray, valarray, numElements, 0);
+            if (irun == 0) std::cout << "##### " << set->className() << " #####  " << (keyDist.type != KeyDistribution::UNIFORM ? "keys=" + keyDist.name() : "") << (rmwRatio > 0 ? "  rmw=" + std::to_string(rmwRatio) + "/1000" : "") << "\n";
             thread rwThreads[numThreads];
             if (dedicated) {
                 rwThreads[0] = thread(rw_lambda, 1000, &ops[0][irun], 0);
@@ -165,6 +202,8 @@ public:
                 for (int tid = 0; tid < numThreads; tid++) rwThreads[tid] = thread(rw_lambda, updateRatio, &ops[tid][irun], tid);
             }
             this_thread::sleep_for(100ms);
+            const UCStatsSnapshot statsBefore = setStats(set, 0);
+            sampler.start();
             auto startBeats = steady_clock::now();
             startFlag.store(true);
             // Sleep for testLengthSeconds seconds
@@ -172,7 +211,9 @@ public:
             quit.store(true);
             auto stopBeats = steady_clock::now();
             for (int tid = 0; tid < numThreads; tid++) rwThreads[tid].join();
+            sampler.stop();
             lengthSec[irun] = (stopBeats-startBeats).count();
+            lastMemory.addRun(sampler, statsBefore, setStats(set, 0), lengthSec[irun]);
             if (dedicated) {
                 // We don't account for the write-only operations but we aggregate the values from the two threads and display them
                 std::cout << "Mutative transactions per second = " << (ops[0][irun] + ops[1][irun])*1000000000LL/lengthSec[irun] << "\n";
@@ -191,8 +232,8 @@ public:
             delete set;
 
             auto stopDel = steady_clock::now();
-            if ((startDel-stopDel).count() > NSEC_IN_SEC) {
-                std::cout << "Destructor took " << (startDel-stopDel).count()/NSEC_IN_SEC << " seconds\n";
+            if ((stopDel-startDel).count() > NSEC_IN_SEC) {
+                std::cout << "Destructor took " << (stopDel-startDel).count()/NSEC_IN_SEC << " seconds\n";
             }
             // Compute ops at the end of each run
             long long agg = 0;
@@ -203,6 +244,10 @@ public:
 
         for (int i = 0; i < numElements; i++) delete keyarray[i];
         delete[] keyarray;
+        for (int i = 0; i < numElements; i++) delete valarray[i];
+        delete[] valarray;
+        lastLatency.reset();
+        for (int tid = 0; tid < numThreads; tid++) lastLatency.merge(hists[tid]);
 
         // Accounting
         vector<long long> agg(numRuns);
@@ -220,6 +265,8 @@ public:
         auto delta = (long)(100.*(maxops-minops) / ((double)medianops));
         // Printed value is the median of the number of ops per second that all threads were able to accomplish (on average)
         std::cout << "Ops/sec = " << medianops << "      delta = " << delta << "%   min = " << minops << "   max = " << maxops << "\n";
+        lastLatency.print(std::cout);
+        lastMemory.print(std::cout);
 #ifdef TINY_STM
         stm_exit_thread();
 #endif
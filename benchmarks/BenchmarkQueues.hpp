@@ -36,6 +36,10 @@
 #include <algorithm>
 #include <cassert>
 
+#include "LatencyHistogram.hpp"
+#include "PerfCounters.hpp"
+#include "ThreadPinning.hpp"
+
 
 using namespace std;
 using namespace chrono;
@@ -96,8 +100,13 @@ private:
 
 
     static const long long NSEC_IN_SEC = 1000000000LL;
+    static const long long kLatencySampling = 64;   // One in every kLatencySampling pairs is timed
 
     int numThreads;
+    LatencyHistogram lastLatency;
+    bool perfEnabled {PerfCounters::envEnabled()};
+    PerfCounters::Values lastPerf;
+    ThreadPinning pinning;
 
 public:
 
@@ -105,32 +114,71 @@ public:
         this->numThreads = numThreads;
     }
 
+    // Latencies of the enqueue-dequeue pairs of the last call to enqDeq(), for all the threads and runs
+    const LatencyHistogram& latency() const { return lastLatency; }
+
+    // Turns on the hardware counters of the measurement phase of enqDeq() (off unless CX_PERF_COUNTERS is set)
+    void setPerfCounters(const bool enabled) { perfEnabled = enabled; }
+
+    // Counters of the last call to enqDeq(), for all the threads and runs
+    const PerfCounters::Values& perf() const { return lastPerf; }
+
+    // Placement of the threads of all the benchmarks, CX_PIN_THREADS or not pinned by default
+    void setPinning(const ThreadPinning& pin) { pinning = pin; }
+
 
     /**
      * enqueue-dequeue pairs: in each iteration a thread executes an enqueue followed by a dequeue;
      * the benchmark executes 10^8 pairs partitioned evenly among all threads;
+     * one in every kLatencySampling pairs is timed on its own, for the latency histogram;
      */
     template<typename Q>
     uint64_t enqDeq(std::string& className, const long numPairs, const int numRuns) {
+        return pairs<Q>(className, numPairs, numRuns, [] (Q* q, UserData* ud, const int tid) { q->enqueue(ud, tid); },
+                                                      [] (Q* q, const int tid) { return q->dequeue(tid); });
+    }
+
+    /**
+     * push-pop pairs on a stack (e.g. UCStack), same as enqDeq()
+     */
+    template<typename S>
+    uint64_t pushPop(std::string& className, const long numPairs, const int numRuns) {
+        return pairs<S>(className, numPairs, numRuns, [] (S* s, UserData* ud, const int tid) { s->push(ud, tid); },
+                                                      [] (S* s, const int tid) { return s->pop(tid); });
+    }
+
+    // Pairs of an insertion (addFunc) followed by a removal (removeFunc) that must not return nullptr
+    template<typename Q, typename FA, typename FR>
+    uint64_t pairs(std::string& className, const long numPairs, const int numRuns, FA&& addFunc, FR&& removeFunc) {
         nanoseconds deltas[numThreads][numRuns];
         atomic<bool> startFlag = { false };
         Q* queue = nullptr;
+        std::vector<LatencyHistogram> hists(numThreads);
+        std::vector<PerfCounters::Values> perfs(numThreads);
 
-        auto enqdeq_lambda = [this,&startFlag,&numPairs,&queue](nanoseconds *delta, const int tid) {
+        auto enqdeq_lambda = [this,&startFlag,&numPairs,&queue,&hists,&perfs,&addFunc,&removeFunc](nanoseconds *delta, const int tid) {
             UserData ud(0,0);
+            pinning.pin(tid);
+            PerfCounters counters(perfEnabled);
             while (!startFlag.load()) {} // Spin until the startFlag is set
             // Warmup phase
             for (long long iter = 0; iter < kNumPairsWarmup/numThreads; iter++) {
-                queue->enqueue(&ud, tid);
-                if (queue->dequeue(tid) == nullptr) cout << "Error at warmup dequeueing iter=" << iter << "\n";
+                addFunc(queue, &ud, tid);
+                if (removeFunc(queue, tid) == nullptr) cout << "Error at warmup dequeueing iter=" << iter << "\n";
             }
             // Measurement phase
+            counters.start();
             auto startBeats = steady_clock::now();
             for (long long iter = 0; iter < numPairs/numThreads; iter++) {
-                queue->enqueue(&ud, tid);
-                if (queue->dequeue(tid) == nullptr) cout << "Error at measurement dequeueing iter=" << iter << "\n";
+                const bool timed = (iter % kLatencySampling) == 0;
+                const auto pairBeats = timed ? steady_clock::now() : steady_clock::time_point{};
+                addFunc(queue, &ud, tid);
+                if (removeFunc(queue, tid) == nullptr) cout << "Error at measurement dequeueing iter=" << iter << "\n";
+                if (timed) hists[tid].record(steady_clock::now() - pairBeats);
             }
             auto stopBeats = steady_clock::now();
+            counters.stop();
+            perfs[tid].merge(counters.read());
             *delta = stopBeats - startBeats;
         };
 
@@ -139,6 +187,7 @@ public:
             if (irun == 0) {
                 className = queue->className();
                 cout << "##### " << queue->className() << " #####  \n";
+                if (pinning.enabled()) cout << "Pinning: " << pinning.describe(numThreads) << "\n";
             }
             thread enqdeqThreads[numThreads];
             for (int tid = 0; tid < numThreads; tid++) enqdeqThreads[tid] = thread(enqdeq_lambda, &deltas[tid][irun], tid);
@@ -164,15 +213,54 @@ public:
         auto median = agg[numRuns/2].count()/numThreads; // Normalize back to per-thread time (mean of time for this run)
 
         cout << "Total Ops/sec = " << numPairs*2*NSEC_IN_SEC/median << "\n";
+        lastLatency.reset();
+        for (int tid = 0; tid < numThreads; tid++) lastLatency.merge(hists[tid]);
+        lastLatency.print(cout, "Enq-Deq pair latency");
+        lastPerf = PerfCounters::Values{};
+        for (int tid = 0; tid < numThreads; tid++) lastPerf.merge(perfs[tid]);
+        if (perfEnabled) lastPerf.print(cout, (numPairs/numThreads)*numThreads*2LL*numRuns);
         return (numPairs*2*NSEC_IN_SEC/median);
     }
 
 
 
+    // Enqueues numItems items, with enqueueBatch() in groups of BATCH items if BATCH > 1
+    template<typename Q, int BATCH>
+    static inline void enqueueItems(Q* queue, UserData* ud, const long long numItems, const int tid) {
+        if constexpr (BATCH > 1) {
+            UserData* items[BATCH];
+            for (int i = 0; i < BATCH; i++) items[i] = ud;
+            for (long long i = 0; i < numItems; i += BATCH) {
+                queue->enqueueBatch(items, (numItems - i < BATCH) ? (int)(numItems - i) : BATCH, tid);
+            }
+        } else {
+            for (long long i = 0; i < numItems; i++) queue->enqueue(ud, tid);
+        }
+    }
+
+    // Dequeues numItems items, with dequeueBatch() in groups of BATCH items if BATCH > 1. Returns false if it dequeues a nullptr
+    template<typename Q, int BATCH>
+    static inline bool dequeueItems(Q* queue, const long long numItems, const int tid) {
+        if constexpr (BATCH > 1) {
+            UserData* items[BATCH];
+            for (long long i = 0; i < numItems; i += BATCH) {
+                const int num = (numItems - i < BATCH) ? (int)(numItems - i) : BATCH;
+                if (queue->dequeueBatch(items, num, tid) != num) return false;
+            }
+        } else {
+            for (long long i = 0; i < numItems; i++) {
+                if (queue->dequeue(tid) == nullptr) return false;
+            }
+        }
+        return true;
+    }
+
+
     /**
      * Start with only enqueues 100K/numThreads, wait for them to finish, then do only dequeues but only 100K/numThreads
+     * With BATCH > 1 the queue must have enqueueBatch() and dequeueBatch(), which are called with BATCH items at a time.
      */
-    template<typename Q>
+    template<typename Q, int BATCH=1>
     void burst(std::string& className, uint64_t& resultsEnq, uint64_t& resultsDeq,
                const long long burstSize, const int numIters, const int numRuns, const bool isSC=false) {
         Result results[numThreads][numRuns];
@@ -183,6 +271,7 @@ public:
 
         auto burst_lambda = [this,&startEnq,&startDeq,&burstSize,&barrier,&numIters,&isSC,&queue](Result *res, const int tid) {
             UserData ud(0,0);
+            pinning.pin(tid);
             // Warmup only if it is not Single-Consumer
             if (!isSC) {
                 const long long warmupIters = 100000LL;  // Do 100K for each thread as a warmup
@@ -196,9 +285,7 @@ public:
                 // Start with enqueues
                 while (!startEnq.load()) {} // spin is better than yield here
                 auto startBeats = steady_clock::now();
-                for (long long i = 0; i < burstSize/numThreads; i++) {
-                    queue->enqueue(&ud, tid);
-                }
+                enqueueItems<Q,BATCH>(queue, &ud, burstSize/numThreads, tid);
                 auto stopBeats = steady_clock::now();
                 res->nsEnq += (stopBeats-startBeats);
                 res->numEnq += burstSize/numThreads;
@@ -209,11 +296,9 @@ public:
                     if (tid == 0) {
                         startBeats = steady_clock::now();
                         // We need to deal with rounding errors in the single-consumer case
-                        for (long long i = 0; i < ((long long)(burstSize/numThreads))*numThreads; i++) {
-                            if (queue->dequeue(tid) == nullptr) {
-                                cout << "ERROR: dequeued nullptr in iter=" << i << "\n";
-                                assert(false);
-                            }
+                        if (!dequeueItems<Q,BATCH>(queue, ((long long)(burstSize/numThreads))*numThreads, tid)) {
+                            cout << "ERROR: dequeued nullptr in iter=" << iter << "\n";
+                            assert(false);
                         }
                         stopBeats = steady_clock::now();
                         if (queue->dequeue(tid) != nullptr) cout << "ERROR: dequeued non-null, there must be duplicate items!\n";
@@ -222,11 +307,9 @@ public:
                     }
                 } else {
                     startBeats = steady_clock::now();
-                    for (long long i = 0; i < burstSize/numThreads; i++) {
-                        if (queue->dequeue(tid) == nullptr) {
-                            cout << "ERROR: dequeued nullptr in iter=" << i << "\n";
-                            assert(false);
-                        }
+                    if (!dequeueItems<Q,BATCH>(queue, burstSize/numThreads, tid)) {
+                        cout << "ERROR: dequeued nullptr in iter=" << iter << "\n";
+                        assert(false);
                     }
                     stopBeats = steady_clock::now();
                     res->nsDeq += (stopBeats-startBeats);
@@ -240,7 +323,9 @@ public:
             queue = new Q(numThreads);
             if (irun == 0) {
                 className = queue->className();
-                cout << "##### " << queue->className() << " #####  \n";
+                if (BATCH > 1) className += "-Batch" + std::to_string(BATCH);
+                cout << "##### " << className << " #####  \n";
+                if (pinning.enabled()) cout << "Pinning: " << pinning.describe(numThreads) << "\n";
             }
             thread burstThreads[numThreads];
             for (int tid = 0; tid < numThreads; tid++) burstThreads[tid] = thread(burst_lambda, &results[tid][irun], tid);
@@ -299,8 +384,9 @@ public:
         atomic<bool> startFlag = { false };
         Q* queue = nullptr;
 
-        auto pingpong_lambda = [&quit,&startFlag,&queue](Result *res, const int tid) {
+        auto pingpong_lambda = [this,&quit,&startFlag,&queue](Result *res, const int tid) {
             UserData ud(0,0);
+            pinning.pin(tid);
             nanoseconds nsEnq = 0ns;
             nanoseconds nsDeq = 0ns;
             long long numEnq = 0;
@@ -330,7 +416,10 @@ public:
 
         for (int irun = 0; irun < numRuns; irun++) {
             queue = new Q(numThreads);
-            if (irun == 0) cout << "##### " << queue->className() << " #####  \n";
+            if (irun == 0) {
+                cout << "##### " << queue->className() << " #####  \n";
+                if (pinning.enabled()) cout << "Pinning: " << pinning.describe(numThreads) << "\n";
+            }
             thread pingpongThreads[numThreads];
             for (int tid = 0; tid < numThreads; tid++) pingpongThreads[tid] = thread(pingpong_lambda, &results[tid][irun], tid);
             startFlag.store(true);
@@ -372,8 +461,9 @@ public:
         long long numDeqs[numThreads][numRuns];
         long long numEnqs[numThreads][numRuns];
 
-        auto dedicated_producer = [&quit,&startFlag,&queue](long long* numEnqueues, const int tid) {
+        auto dedicated_producer = [this,&quit,&startFlag,&queue](long long* numEnqueues, const int tid) {
             UserData ud(0,0);
+            pinning.pin(tid);
             long long numEnq = 0;
             while (!startFlag.load()) {} // spin
             while (!quit.load()) {
@@ -383,8 +473,9 @@ public:
             *numEnqueues = numEnq;
         };
 
-        auto dedicated_consumer = [&quit,&startFlag,&queue](long long* numDequeues, const int tid) {
+        auto dedicated_consumer = [this,&quit,&startFlag,&queue](long long* numDequeues, const int tid) {
             UserData ud(0,0);
+            pinning.pin(tid);
             long long numDeq = 0;
             while (!startFlag.load()) {} // spin
             while (!quit.load()) {
@@ -395,7 +486,10 @@ public:
 
         for (int irun = 0; irun < numRuns; irun++) {
             queue = new Q(numThreads+1);
-            if (irun == 0) cout << "##### " << queue->className() << " #####  \n";
+            if (irun == 0) {
+                cout << "##### " << queue->className() << " #####  \n";
+                if (pinning.enabled()) cout << "Pinning: " << pinning.describe(numThreads+1) << "\n";
+            }
             thread consumerThreads[numThreads];
             thread producerThreads[numThreads];
             if (isSP) {
@@ -9,6 +9,13 @@
 #include <algorithm>
 #include <iostream>
 #include <random>
+#include <type_traits>
+
+#include "KeyGenerator.hpp"
+#include "LatencyHistogram.hpp"
+#include "MemorySampler.hpp"
+#include "PerfCounters.hpp"
+#include "ThreadPinning.hpp"
 
 using namespace std;
 using namespace chrono;
@@ -25,7 +32,7 @@ struct UserData  {
         this->seq = -2;
         this->tid = -2;
     }
-    UserData(const UserData &other) : seq(other.seq), tid(other.tid) { }
+    UserData(const UserData &other) = default;    // Keeps it trivially copyable
 
     bool operator < (const UserData& other) const {
         return seq < other.seq;
@@ -80,19 +87,62 @@ private:
     };
 
     static const long long NSEC_IN_SEC = 1000000000LL;
+    static const uint64_t kLatencySampling = 64;    // One in every kLatencySampling iterations is timed
 
     int numThreads;
+    KeyDistribution keyDist;
+    LatencyHistogram lastLatency;
+    bool perfEnabled {PerfCounters::envEnabled()};
+    PerfCounters::Values lastPerf;
+    ThreadPinning pinning;
+    MemoryReport lastMemory;
+
+    // stats() and getPeakReplicas() of the set, for the Universal Constructs that have them
+    template<typename S> static auto setStats(S* set, int) -> decltype(set->stats()) { return set->stats(); }
+    template<typename S> static UCStatsSnapshot setStats(S* set, long) { return {}; }
+    template<typename S> static auto setPeakReplicas(S* set, int) -> decltype((int)set->getPeakReplicas()) { return set->getPeakReplicas(); }
+    template<typename S> static int setPeakReplicas(S* set, long) { return -1; }
 
 public:
     BenchmarkSets(int numThreads) {
         this->numThreads = numThreads;
     }
 
+    // Turns on the hardware counters of the measured region (off unless CX_PERF_COUNTERS is set)
+    void setPerfCounters(const bool enabled) { perfEnabled = enabled; }
+
+    // Counters of the last call to benchmark(), for all the threads and runs
+    const PerfCounters::Values& perf() const { return lastPerf; }
+
+    // RSS and copies of the last call to benchmark(), for all the runs
+    const MemoryReport& memory() const { return lastMemory; }
+
+    // Placement of the threads of the next calls to benchmark(), CX_PIN_THREADS or not pinned by default
+    void setPinning(const ThreadPinning& pin) { pinning = pin; }
+    const ThreadPinning& getPinning() const { return pinning; }
+
+    // Latencies of the last call to benchmark(), for all the threads and runs
+    const LatencyHistogram& latency() const { return lastLatency; }
+
+    // Distribution of the keys of the next calls to benchmark(), uniform by default
+    void setKeyDistribution(const KeyDistribution& dist) { keyDist = dist; }
+
+    // Sets that take a second constructor argument (like the number of shards of ShardedUC) get numObjs, when it's given
+    template<typename S> S* createSet(const int numObjs) {
+        if constexpr (std::is_constructible<S,int,int>::value) {
+            if (numObjs > 0) return new S(numThreads, numObjs);
+        }
+        return new S(numThreads);
+    }
+
 
     /**
      * When doing "updates" we execute a random removal and if the removal is successful we do an add() of the
      * same item immediately after. This keeps the size of the data structure equal to the original size (minus
      * MAX_THREADS items at most) which gives more deterministic results.
+     * numObjs is the number of objects of the blocking UCs, or the number of shards of ShardedUC.
+     * The latency is of a whole iteration (a remove() and add(), or two contains()), on a sample of the iterations.
+     * The keys are picked with the distribution of setKeyDistribution().
      */
     template<typename S, typename K>
     long long benchmark(std::string& className, const int updateRatio, const seconds testLengthSeconds, const int numRuns, const int numElements, const bool dedicated=false, const int numObjs=0) {
@@ -102,30 +152,41 @@ public:
         atomic<bool> startFlag = { false };
 
         S* set = nullptr;
+        std::vector<LatencyHistogram> hists(numThreads);
+        std::vector<PerfCounters::Values> perfs(numThreads);
+        MemorySampler sampler;
+        lastMemory = MemoryReport{};
 
-        // Create all the keys in the concurrent set
+        // Create all the keys in the concurrent set, in the order of the KeyGenerator
         K** udarray = new K*[numElements];
         for (int i = 0; i < numElements; i++) {
 			udarray[i] = new K(i);
 		}
+        const KeyGenerator keyGen(keyDist, numElements, numThreads);
 
         // in order to insert randomly to have a balanced tree
+        K** shuffled = new K*[numElements];
+        std::copy(udarray, udarray + numElements, shuffled);
 		std::random_device rd;
         auto seed = rd();
         std::mt19937 g(seed);
-        std::shuffle(udarray, udarray + numElements, g);
+        std::shuffle(shuffled, shuffled + numElements, g);
 
         // Can either be a Reader or a Writer
-        auto rw_lambda = [this,&quit,&startFlag,&set,&udarray,&numElements](const int updateRatio, long long *ops, const int tid) {
+        auto rw_lambda = [this,&quit,&startFlag,&set,&udarray,&keyGen,&hists,&perfs,dedicated](const int updateRatio, long long *ops, const int tid) {
         	uint64_t accum = 0;
             long long numOps = 0;
+            uint64_t iter = 0;
+            pinning.pin(tid);
+            KeyGenerator::State keyState = keyGen.initState(tid);
+            PerfCounters counters(perfEnabled);
             while (!startFlag.load()) ; // spin
-            uint64_t seed = tid+1234567890123456781ULL;
+            counters.start();
             while (!quit.load()) {
-                seed = randomLong(seed);
-                int update = seed%1000;
-                seed = randomLong(seed);
-                auto ix = (unsigned int)(seed%numElements);
+                const bool timed = (++iter % kLatencySampling) == 0;
+                const auto startBeats = timed ? steady_clock::now() : steady_clock::time_point{};
+                int update = keyState.random()%1000;
+                auto ix = keyGen.next(keyState);
                 if (update < updateRatio) {
                     // I'm a Writer
                     if (set->remove(*udarray[ix], tid)) {
@@ -136,12 +197,14 @@ public:
                 } else {
                 	// I'm a Reader
                     set->contains(*udarray[ix], tid);
-                    seed = randomLong(seed);
-                    ix = (unsigned int)(seed%numElements);
+                    ix = keyGen.next(keyState);
                     set->contains(*udarray[ix], tid);
                     numOps += 2;
                 }
+                if (timed) hists[tid].record(steady_clock::now() - startBeats);
             }
+            counters.stop();
+            if (!dedicated || tid >= 2) perfs[tid].merge(counters.read());  // Same threads as the ops/sec
             *ops = numOps;
         };
 
@@ -149,10 +212,10 @@ public:
 #ifdef TREEBLOCKING
         	set = new S(numThreads, numObjs); //blocking benchmark
 #else
-        	set = new S(numThreads);
+        	set = createSet<S>(numObjs);
 #endif
             // Add all the items to the list
-            set->addAll(udarray, numElements, 0);
+            set->addAll(shuffled, numElements, 0);
 
             if (irun == 0) {
 #ifdef TREEBLOCKING
@@ -160,7 +223,8 @@ public:
 #else
                 className = set->className();
 #endif
-                std::cout << "##### " << className << " #####  \n";
+                std::cout << "##### " << className << " #####  " << (keyDist.type != KeyDistribution::UNIFORM ? "keys=" + keyDist.name() : "") << "\n";
+                if (pinning.enabled()) std::cout << "Pinning: " << pinning.describe(numThreads) << "\n";
             }
             thread rwThreads[numThreads];
             if (dedicated) {
@@ -171,6 +235,8 @@ public:
                 for (int tid = 0; tid < numThreads; tid++) rwThreads[tid] = thread(rw_lambda, updateRatio, &ops[tid][irun], tid);
             }
             this_thread::sleep_for(100ms);
+            const UCStatsSnapshot statsBefore = setStats(set, 0);
+            sampler.start();
             auto startBeats = steady_clock::now();
             startFlag.store(true);
             // Sleep for testLengthSeconds seconds
@@ -178,7 +244,10 @@ public:
             quit.store(true);
             auto stopBeats = steady_clock::now();
             for (int tid = 0; tid < numThreads; tid++) rwThreads[tid].join();
+            sampler.stop();
             lengthSec[irun] = (stopBeats-startBeats).count();
+            lastMemory.addRun(sampler, statsBefore, setStats(set, 0), lengthSec[irun]);
+            lastMemory.peakReplicas = std::max(lastMemory.peakReplicas, setPeakReplicas(set, 0));
             if (dedicated) {
                 // We don't account for the write-only operations but we aggregate the values from the two threads and display them
                 std::cout << "Mutative transactions per second = " << (ops[0][irun] + ops[1][irun])*1000000000LL/lengthSec[irun] << "\n";
@@ -191,8 +260,8 @@ public:
             auto startDel = steady_clock::now();
             delete set;
             auto stopDel = steady_clock::now();
-            if ((startDel-stopDel).count() > NSEC_IN_SEC) {
-                std::cout << "Destructor took " << (startDel-stopDel).count()/NSEC_IN_SEC << " seconds\n";
+            if ((stopDel-startDel).count() > NSEC_IN_SEC) {
+                std::cout << "Destructor took " << (stopDel-startDel).count()/NSEC_IN_SEC << " seconds\n";
             }
             // Compute ops at the end of each run
             long long agg = 0;
@@ -203,12 +272,19 @@ public:
 
         for (int i = 0; i < numElements; i++) delete udarray[i];
         delete[] udarray;
+        delete[] shuffled;
+        lastLatency.reset();
+        for (int tid = 0; tid < numThreads; tid++) lastLatency.merge(hists[tid]);
+        lastPerf = PerfCounters::Values{};
+        for (int tid = 0; tid < numThreads; tid++) lastPerf.merge(perfs[tid]);
 
         // Accounting
         vector<long long> agg(numRuns);
+        long long totalOps = 0;
         for (int irun = 0; irun < numRuns; irun++) {
             for (int tid = 0; tid < numThreads; tid++) {
                 agg[irun] += ops[tid][irun]*1000000000LL/lengthSec[irun];
+                totalOps += ops[tid][irun];
             }
         }
 
@@ -220,6 +296,9 @@ public:
         auto delta = (long)(100.*(maxops-minops) / ((double)medianops));
         // Printed value is the median of the number of ops per second that all threads were able to accomplish (on average)
         std::cout << "Ops/sec = " << medianops << "      delta = " << delta << "%   min = " << minops << "   max = " << maxops << "\n";
+        lastLatency.print(std::cout);
+        lastMemory.print(std::cout);
+        if (perfEnabled) lastPerf.print(std::cout, totalOps);
         return medianops;
     }
 
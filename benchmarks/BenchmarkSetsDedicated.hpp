@@ -9,6 +9,8 @@
 #include <algorithm>
 #include <iostream>
 
+#include "ThreadPinning.hpp"
+
 using namespace std;
 using namespace chrono;
 
@@ -24,7 +26,7 @@ struct UserData  {
         this->seq = -2;
         this->tid = -2;
     }
-    UserData(const UserData &other) : seq(other.seq), tid(other.tid) { }
+    UserData(const UserData &other) = default;    // Keeps it trivially copyable
 
     bool operator < (const UserData& other) const {
         return seq < other.seq;
@@ -89,12 +91,16 @@ private:
     static const long long NSEC_IN_SEC = 1000000000LL;
 
     int numThreads;
+    ThreadPinning pinning;
 
 public:
     BenchmarkSetsDedicated(int numThreads) {
         this->numThreads = numThreads;
     }
 
+    // Placement of the threads, CX_PIN_THREADS or not pinned by default
+    void setPinning(const ThreadPinning& pin) { pinning = pin; }
+
 
     /**
      * When doing "updates" we execute a random removal and if the removal is successful we do an add() of the
@@ -118,6 +124,7 @@ public:
         auto rw_lambda = [this,&quit,&startFlag,&set,&udarray,&numElements,&itersize](TwoResults *ops, const int tid) {
             const bool isReader = (tid%2 == 0); // Threads with even tids are readers. Odd tids are updaters
             TwoResults numOps {};
+            pinning.pin(tid);
             while (!startFlag.load()) ; // spin
             uint64_t seed = tid+1234567890123456781ULL;
             while (!quit.load()) {
@@ -143,6 +150,7 @@ public:
             if (irun == 0) {
                 className = set->className();
                 std::cout << "##### " << set->className() << " #####  \n";
+                if (pinning.enabled()) std::cout << "Pinning: " << pinning.describe(numThreads) << "\n";
             }
             thread rwThreads[numThreads];
             for (int tid = 0; tid < numThreads; tid++) rwThreads[tid] = thread(rw_lambda, &ops[tid][irun], tid);
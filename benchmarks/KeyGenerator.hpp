@@ -0,0 +1,185 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _KEY_GENERATOR_H_
+#define _KEY_GENERATOR_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <string>
+
+// Which keys the benchmark threads pick, see KeyGenerator
+struct KeyDistribution {
+    enum Type { UNIFORM, ZIPFIAN, HOTSPOT, SEQUENTIAL };
+
+    Type   type {UNIFORM};
+    double theta {0.99};     // Skew of ZIPFIAN, in ]0,1[
+    double hotKeys {0.01};   // Fraction of the keys that are hot in HOTSPOT
+    double hotOps {0.9};     // Fraction of the operations that go to the hot keys in HOTSPOT
+
+    static KeyDistribution uniform() { return KeyDistribution{}; }
+    static KeyDistribution zipfian(double theta=0.99) { KeyDistribution d; d.type = ZIPFIAN; d.theta = theta; return d; }
+    static KeyDistribution hotspot(double hotKeys=0.01, double hotOps=0.9) { KeyDistribution d; d.type = HOTSPOT; d.hotKeys = hotKeys; d.hotOps = hotOps; return d; }
+    static KeyDistribution sequential() { KeyDistribution d; d.type = SEQUENTIAL; return d; }
+
+    std::string name() const {
+        switch (type) {
+        case ZIPFIAN:    return "zipf:" + shortString(theta);
+        case HOTSPOT:    return "hotspot:" + shortString(hotKeys) + ":" + shortString(hotOps);
+        case SEQUENTIAL: return "sequential";
+        default:         return "uniform";
+        }
+    }
+
+    // The inverse of name(): "uniform", "zipf[:theta]", "hotspot[:hotKeys[:hotOps]]" or "sequential"
+    static bool parse(const std::string& str, KeyDistribution& dist) {
+        size_t colon = str.find(':');
+        const std::string kind = str.substr(0, colon);
+        double params[2];
+        int numParams = 0;
+        while (colon != std::string::npos) {
+            if (numParams == 2) return false;
+            const size_t start = colon + 1;
+            colon = str.find(':', start);
+            const std::string param = str.substr(start, colon == std::string::npos ? std::string::npos : colon - start);
+            char* end;
+            params[numParams++] = std::strtod(param.c_str(), &end);
+            if (param.empty() || *end != '\0') return false;
+        }
+        if (kind == "uniform" && numParams == 0) dist = uniform();
+        else if (kind == "sequential" && numParams == 0) dist = sequential();
+        else if (kind == "zipf" && numParams <= 1) dist = zipfian(numParams > 0 ? params[0] : 0.99);
+        else if (kind == "hotspot") dist = hotspot(numParams > 0 ? params[0] : 0.01, numParams > 1 ? params[1] : 0.9);
+        else return false;
+        if (dist.type == ZIPFIAN && !(dist.theta > 0 && dist.theta < 1)) return false;
+        if (dist.type == HOTSPOT && !(dist.hotKeys > 0 && dist.hotKeys <= 1 && dist.hotOps >= 0 && dist.hotOps <= 1)) return false;
+        return true;
+    }
+
+private:
+    static std::string shortString(double value) {
+        std::string str = std::to_string(value);
+        str.erase(str.find_last_not_of('0') + 1);
+        if (str.back() == '.') str.pop_back();
+        return str;
+    }
+};
+
+
+/**
+ * <h1> Key Generator </h1>
+ *
+ * Picks the indexes of the keys for the benchmarks, from 0 to numKeys-1 in the order of the
+ * keys, with one of the distributions of KeyDistribution:
+ * - UNIFORM: all the keys are equally likely;
+ * - ZIPFIAN: the key of rank i is picked with a probability of 1/i^theta, with the method of
+ *   Gray et al. "Quickly Generating Billion-Record Synthetic Databases" (like YCSB). The ranks
+ *   are scattered over the key space, so that the hot keys aren't all in the same subtree;
+ * - HOTSPOT: hotOps of the operations go to hotKeys of the keys, uniformly within each part,
+ *   and the hot keys are scattered like for ZIPFIAN;
+ * - SEQUENTIAL: each thread goes through the keys in increasing order, starting at its tid
+ *   and in steps of numThreads, wrapping around at the end.
+ *
+ * The generator is immutable after the constructor, which is where the O(numKeys) zeta of
+ * ZIPFIAN is computed, so all the threads share it. Each thread keeps its own State, with a
+ * xorshift64* generator that is also used for the other random decisions of the benchmark.
+ */
+class KeyGenerator {
+
+public:
+    struct State {
+        uint64_t seed;
+        uint64_t counter {0};
+
+        // xorshift64*, which keeps the state before the multiplication
+        inline uint64_t random() {
+            seed ^= seed >> 12;
+            seed ^= seed << 25;
+            seed ^= seed >> 27;
+            return seed * 2685821657736338717ULL;
+        }
+
+        // Uniform in [0,1[
+        inline double randomDouble() { return (random() >> 11) * (1.0 / 9007199254740992.0); }
+    };
+
+private:
+    const KeyDistribution dist;
+    const uint64_t numKeys;
+    const int numThreads;
+    uint64_t scatterMul {1};
+    uint64_t numHot {1};
+    double zetan {0}, alpha {0}, eta {0}, halfPowTheta {0};
+
+    static double zeta(uint64_t n, double theta) {
+        double sum = 0;
+        for (uint64_t i = 1; i <= n; i++) sum += 1.0 / std::pow((double)i, theta);
+        return sum;
+    }
+
+    // A bijection of [0,numKeys[, so that consecutive ranks are far apart in the key space
+    inline uint64_t scatter(uint64_t rank) const {
+        return (uint64_t)(((unsigned __int128)rank * scatterMul + numKeys/2) % numKeys);
+    }
+
+public:
+    KeyGenerator(const KeyDistribution& dist, uint64_t numKeys, int numThreads)
+            : dist{dist}, numKeys{numKeys > 0 ? numKeys : 1}, numThreads{numThreads} {
+        scatterMul = 0x9E3779B97F4A7C15ULL % this->numKeys;
+        if (scatterMul == 0) scatterMul = 1;
+        while (std::gcd(scatterMul, this->numKeys) != 1) scatterMul++;
+        if (dist.type == KeyDistribution::ZIPFIAN) {
+            zetan = zeta(this->numKeys, dist.theta);
+            const double zeta2 = zeta(2, dist.theta);
+            alpha = 1.0 / (1.0 - dist.theta);
+            eta = (1.0 - std::pow(2.0 / this->numKeys, 1.0 - dist.theta)) / (1.0 - zeta2 / zetan);
+            halfPowTheta = std::pow(0.5, dist.theta);
+        } else if (dist.type == KeyDistribution::HOTSPOT) {
+            numHot = (uint64_t)(dist.hotKeys * this->numKeys);
+            if (numHot == 0) numHot = 1;
+        }
+    }
+
+    const KeyDistribution& distribution() const { return dist; }
+
+    State initState(const int tid) const {
+        State state;
+        state.seed = tid + 1234567890123456781ULL;
+        state.counter = tid;
+        return state;
+    }
+
+    inline uint64_t next(State& state) const {
+        switch (dist.type) {
+        case KeyDistribution::ZIPFIAN: {
+            const double uz = state.randomDouble() * zetan;
+            uint64_t rank;
+            if (uz < 1.0) rank = 0;
+            else if (uz < 1.0 + halfPowTheta) rank = 1;
+            else rank = (uint64_t)(numKeys * std::pow(eta * (uz / zetan) - eta + 1.0, alpha));
+            if (rank >= numKeys) rank = numKeys - 1;
+            return scatter(rank);
+        }
+        case KeyDistribution::HOTSPOT: {
+            if (numHot == numKeys || state.randomDouble() < dist.hotOps) return scatter(state.random() % numHot);
+            return scatter(numHot + state.random() % (numKeys - numHot));
+        }
+        case KeyDistribution::SEQUENTIAL: {
+            const uint64_t idx = state.counter % numKeys;
+            state.counter += numThreads;
+            return idx;
+        }
+        default:
+            return state.random() % numKeys;
+        }
+    }
+};
+
+#endif /* _KEY_GENERATOR_H_ */
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _LATENCY_HISTOGRAM_H_
+#define _LATENCY_HISTOGRAM_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/**
+ * <h1> Latency Histogram </h1>
+ *
+ * A log-linear histogram of latencies in nanoseconds, like HdrHistogram: each power
+ * of two is split in SUB_BUCKETS buckets, so a value is known within 1/SUB_BUCKETS
+ * (about 3%) of itself, from 1 ns up to 2^64 ns, in a fixed 15 kB of counters.
+ *
+ * Each thread records into its own histogram, without atomics, and the histograms
+ * are merged after the threads are joined. The percentiles are the largest value of
+ * the bucket where they fall, capped at the largest value that was recorded, which
+ * is kept exactly.
+ */
+class alignas(128) LatencyHistogram {
+
+public:
+    static const int      SUB_BITS = 5;
+    static const uint64_t SUB_BUCKETS = 1ULL << SUB_BITS;
+    static const int      NUM_BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+private:
+    uint64_t counts[NUM_BUCKETS];
+    uint64_t total {0};
+    uint64_t maxValue {0};
+
+    // The values below SUB_BUCKETS have a bucket each, then every power of two has SUB_BUCKETS buckets
+    static inline int indexOf(uint64_t value) {
+        if (value < SUB_BUCKETS) return (int)value;
+        const int shift = 63 - __builtin_clzll(value) - SUB_BITS;
+        return (int)((shift + 1)*SUB_BUCKETS + (value >> shift) - SUB_BUCKETS);
+    }
+
+    // Largest value of the bucket idx
+    static inline uint64_t valueOf(int idx) {
+        if (idx < (int)SUB_BUCKETS) return idx;
+        const int shift = idx/SUB_BUCKETS - 1;
+        const uint64_t mantissa = idx%SUB_BUCKETS + SUB_BUCKETS;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+public:
+    LatencyHistogram() { reset(); }
+
+    void reset() {
+        std::memset(counts, 0, sizeof(counts));
+        total = 0;
+        maxValue = 0;
+    }
+
+    inline void record(uint64_t ns) {
+        counts[indexOf(ns)]++;
+        total++;
+        if (ns > maxValue) maxValue = ns;
+    }
+
+    inline void record(std::chrono::nanoseconds delay) { record((uint64_t)delay.count()); }
+
+    void merge(const LatencyHistogram& other) {
+        for (int i = 0; i < NUM_BUCKETS; i++) counts[i] += other.counts[i];
+        total += other.total;
+        if (other.maxValue > maxValue) maxValue = other.maxValue;
+    }
+
+    uint64_t count() const { return total; }
+
+    uint64_t max() const { return maxValue; }
+
+    // Latency in nanoseconds below which are 'percent' percent of the recorded values
+    uint64_t percentile(double percent) const {
+        if (total == 0) return 0;
+        uint64_t target = (uint64_t)(percent*total/100.);
+        if (target == 0) target = 1;
+        uint64_t accum = 0;
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            accum += counts[i];
+            if (accum >= target) return valueOf(i) < maxValue ? valueOf(i) : maxValue;
+        }
+        return maxValue;
+    }
+
+    // One line with the 50%, 90%, 99%, 99.9%, 99.99% and the maximum, in nanoseconds
+    void print(std::ostream& os, const std::string& label = "Latency") const {
+        os << label << " (ns): 50%=" << percentile(50.) << "  90%=" << percentile(90.)
+           << "  99%=" << percentile(99.) << "  99.9%=" << percentile(99.9)
+           << "  99.99%=" << percentile(99.99) << "  max=" << maxValue
+           << "   (" << total << " samples)\n";
+    }
+};
+
+#endif /* _LATENCY_HISTOGRAM_H_ */
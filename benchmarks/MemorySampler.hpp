@@ -0,0 +1,153 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _MEMORY_SAMPLER_H_
+#define _MEMORY_SAMPLER_H_
+
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#include "../common/UCStats.hpp"
+
+/**
+ * <h1> Memory Sampler </h1>
+ *
+ * Samples the resident set size of the process from a background thread, every
+ * kSamplePeriod, between start() and stop(), and keeps the average and the
+ * maximum of the samples. The peak RSS is the kernel's VmHWM, which start()
+ * resets (through /proc/self/clear_refs) when the kernel allows it, so that it
+ * covers only the run and catches the spikes between two samples.
+ *
+ * MemoryReport puts these together with the copies made by the Universal
+ * Construct during the run, from its stats() (with the UCStats policy) and its
+ * getPeakReplicas(), when it has them.
+ */
+class MemorySampler {
+
+private:
+    static constexpr std::chrono::milliseconds kSamplePeriod {10};
+
+    std::atomic<bool> quit {false};
+    std::thread       sampler;
+    uint64_t          sumRSS {0};
+    uint64_t          numSamples {0};
+    uint64_t          maxRSS {0};
+
+public:
+    ~MemorySampler() { if (sampler.joinable()) stop(); }
+
+    // Current resident set size of the process, in bytes
+    static uint64_t currentRSS() {
+        FILE* f = fopen("/proc/self/statm", "r");
+        if (f == nullptr) return 0;
+        unsigned long size, resident = 0;
+        if (fscanf(f, "%lu %lu", &size, &resident) != 2) resident = 0;
+        fclose(f);
+        return (uint64_t)resident*sysconf(_SC_PAGESIZE);
+    }
+
+    // Highest resident set size of the process (VmHWM), in bytes
+    static uint64_t peakRSS() {
+        FILE* f = fopen("/proc/self/status", "r");
+        if (f == nullptr) return 0;
+        char line[256];
+        unsigned long kb = 0;
+        while (fgets(line, sizeof(line), f) != nullptr) {
+            if (std::strncmp(line, "VmHWM:", 6) == 0) {
+                sscanf(line+6, "%lu", &kb);
+                break;
+            }
+        }
+        fclose(f);
+        return (uint64_t)kb*1024;
+    }
+
+    // Resets VmHWM to the current RSS. Returns false if the kernel doesn't allow it
+    static bool resetPeakRSS() {
+        FILE* f = fopen("/proc/self/clear_refs", "w");
+        if (f == nullptr) return false;
+        const bool ok = fputs("5", f) >= 0;
+        return (fclose(f) == 0) && ok;
+    }
+
+    void start() {
+        resetPeakRSS();
+        sumRSS = numSamples = maxRSS = 0;
+        quit.store(false);
+        sampler = std::thread([this] () {
+            while (!quit.load()) {
+                const uint64_t rss = currentRSS();
+                sumRSS += rss;
+                numSamples++;
+                if (rss > maxRSS) maxRSS = rss;
+                std::this_thread::sleep_for(kSamplePeriod);
+            }
+        });
+    }
+
+    void stop() {
+        quit.store(true);
+        sampler.join();
+    }
+
+    uint64_t getAvgRSS() const { return numSamples == 0 ? 0 : sumRSS/numSamples; }
+    uint64_t getMaxRSS() const { return maxRSS; }
+};
+
+
+// Memory and copies of one or more runs of a benchmark
+struct MemoryReport {
+    uint64_t avgRSS {0};        // Average of the runs, in bytes
+    uint64_t maxRSS {0};        // Largest sample of all the runs
+    uint64_t peakRSS {0};       // Largest VmHWM of all the runs
+    uint64_t copies {0};
+    uint64_t copyBytes {0};
+    uint64_t copyTimeNs {0};
+    uint64_t parks {0};         // Updaters that parked on a futex (CXMutationBlocking)
+    uint64_t lengthNs {0};      // Duration of the runs
+    int      peakReplicas {-1}; // Largest getPeakReplicas(), -1 if the set doesn't have it
+    int      numRuns {0};
+
+    // Adds a run of lengthNs, with the stats of the set at the start and at the end of the run
+    void addRun(const MemorySampler& sampler, const UCStatsSnapshot& before, const UCStatsSnapshot& after, const uint64_t runNs) {
+        avgRSS = (avgRSS*numRuns + sampler.getAvgRSS())/(numRuns+1);
+        numRuns++;
+        if (sampler.getMaxRSS() > maxRSS) maxRSS = sampler.getMaxRSS();
+        const uint64_t peak = MemorySampler::peakRSS();
+        if (peak > peakRSS) peakRSS = peak;
+        copies += after.copies - before.copies;
+        copyBytes += after.copyBytes - before.copyBytes;
+        copyTimeNs += after.copyTimeNs - before.copyTimeNs;
+        parks += after.parks - before.parks;
+        lengthNs += runNs;
+    }
+
+    long long copiesPerSec() const { return lengthNs == 0 ? 0 : (long long)(copies*1e9/lengthNs); }
+
+    uint64_t avgCopyNs() const { return copies == 0 ? 0 : copyTimeNs/copies; }
+
+    // One line with the RSS, one with the copies if the set counts them (UCStats), and one with the parks if there were any
+    void print(std::ostream& os) const {
+        os << "Memory (MB): avgRSS=" << avgRSS/(1024*1024) << "  maxRSS=" << maxRSS/(1024*1024) << "  peakRSS=" << peakRSS/(1024*1024);
+        if (peakReplicas >= 0) os << "   peak replicas=" << peakReplicas;
+        os << "\n";
+        if (copies > 0) {
+            os << "Copies/sec = " << copiesPerSec() << "   avg copy = " << avgCopyNs()/1000. << " us   copied MB/sec = "
+               << (lengthNs == 0 ? 0 : (long long)(copyBytes*1e9/lengthNs/(1024*1024))) << "\n";
+        }
+        if (parks > 0) os << "Parks/sec = " << (lengthNs == 0 ? 0 : (long long)(parks*1e9/lengthNs)) << "\n";
+    }
+};
+
+#endif /* _MEMORY_SAMPLER_H_ */
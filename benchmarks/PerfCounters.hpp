@@ -0,0 +1,150 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _PERF_COUNTERS_H_
+#define _PERF_COUNTERS_H_
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/**
+ * <h1> Performance Counters </h1>
+ *
+ * Hardware and software counters of the calling thread, with perf_event_open(),
+ * to explain a throughput number: cycles, instructions, last-level cache misses,
+ * branch misses and context switches.
+ *
+ * Each measuring thread creates its own PerfCounters, calls start() when the
+ * measured region begins and stop() when it ends, and the values of all the
+ * threads are merged and printed per operation next to the ops/sec.
+ *
+ * The counters are off unless they are enabled, either with the CX_PERF_COUNTERS
+ * environment variable or with setPerfCounters() on the benchmark. Events that
+ * the kernel won't open (no PMU in a VM, perf_event_paranoid too high) are
+ * shown as n/a. Kernel events are counted when allowed, otherwise only user space.
+ * When the PMU is multiplexed, the counts are scaled by the time they were running.
+ */
+class PerfCounters {
+
+public:
+    enum Event { CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, CONTEXT_SWITCHES, NUM_EVENTS };
+
+    // The counts of one or more threads, and whether each event could be opened
+    struct Values {
+        uint64_t count[NUM_EVENTS] {};
+        bool     valid[NUM_EVENTS] {};
+
+        void merge(const Values& other) {
+            for (int i = 0; i < NUM_EVENTS; i++) {
+                count[i] += other.count[i];
+                valid[i] = valid[i] || other.valid[i];
+            }
+        }
+
+        bool any() const {
+            for (int i = 0; i < NUM_EVENTS; i++) if (valid[i]) return true;
+            return false;
+        }
+
+        // One line with each counter divided by numOps, plus the IPC
+        void print(std::ostream& os, const long long numOps) const {
+            static const char* names[NUM_EVENTS] = { "cycles", "instructions", "LLC-misses", "branch-misses", "ctx-switches" };
+            if (!any()) {
+                os << "Perf counters: not available\n";
+                return;
+            }
+            os << "Perf counters per op:";
+            for (int i = 0; i < NUM_EVENTS; i++) {
+                os << "  " << names[i] << "=";
+                if (valid[i] && numOps > 0) os << (double)count[i]/numOps;
+                else os << "n/a";
+            }
+            if (valid[CYCLES] && valid[INSTRUCTIONS] && count[CYCLES] > 0) {
+                os << "  IPC=" << (double)count[INSTRUCTIONS]/count[CYCLES];
+            }
+            os << "   (" << numOps << " ops)\n";
+        }
+    };
+
+private:
+    int fds[NUM_EVENTS];
+
+    static int openEvent(uint32_t type, uint64_t config) {
+        struct perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0) {
+            attr.exclude_kernel = 1;    // Try again with user space only
+            fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+        return fd;
+    }
+
+public:
+    // Opens the counters of the calling thread, stopped, if enabled is true
+    PerfCounters(const bool enabled) {
+        for (int i = 0; i < NUM_EVENTS; i++) fds[i] = -1;
+        if (!enabled) return;
+        fds[CYCLES]           = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds[INSTRUCTIONS]     = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[LLC_MISSES]       = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        fds[BRANCH_MISSES]    = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        fds[CONTEXT_SWITCHES] = openEvent(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES);
+    }
+
+    ~PerfCounters() {
+        for (int i = 0; i < NUM_EVENTS; i++) if (fds[i] >= 0) close(fds[i]);
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // Default of the benchmarks: on if CX_PERF_COUNTERS is set to anything but 0
+    static bool envEnabled() {
+        const char* env = std::getenv("CX_PERF_COUNTERS");
+        return env != nullptr && std::strcmp(env, "0") != 0 && env[0] != '\0';
+    }
+
+    void start() {
+        for (int i = 0; i < NUM_EVENTS; i++) {
+            if (fds[i] < 0) continue;
+            ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    void stop() {
+        for (int i = 0; i < NUM_EVENTS; i++) if (fds[i] >= 0) ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    Values read() const {
+        Values values;
+        for (int i = 0; i < NUM_EVENTS; i++) {
+            uint64_t buf[3];   // value, time enabled, time running
+            if (fds[i] < 0 || ::read(fds[i], buf, sizeof(buf)) != sizeof(buf)) continue;
+            values.valid[i] = true;
+            values.count[i] = (buf[2] == 0 || buf[2] >= buf[1]) ? buf[0] : (uint64_t)((double)buf[0]*buf[1]/buf[2]);
+        }
+        return values;
+    }
+};
+
+#endif /* _PERF_COUNTERS_H_ */
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _THREAD_PINNING_H_
+#define _THREAD_PINNING_H_
+
+#include <pthread.h>
+#include <sched.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/**
+ * <h1> Thread Pinning </h1>
+ *
+ * Places the thread with a given tid of a benchmark on a CPU, so that a scaling curve
+ * doesn't depend on where the scheduler happens to put the threads:
+ *
+ *   none          The threads are not pinned (the default)
+ *   compact       Fills the physical cores of a socket, then their SMT siblings, then the next socket
+ *   scatter       Round-robin over the sockets, one thread per physical core before any SMT sibling
+ *   smt-first     Fills both SMT siblings of a core before the next core, socket by socket
+ *   cpus:0,2,8-11 Thread i goes to the i-th CPU of the list
+ *
+ * The topology comes from /sys/devices/system/cpu/cpu*\/topology, restricted to the CPUs
+ * in the affinity mask of the process. When there are more threads than CPUs the order
+ * wraps around. The policy is taken from the CX_PIN_THREADS environment variable, unless
+ * the benchmark is given another one with setPinning().
+ * Each thread calls pin() with its tid when it starts, and describe() gives the placement
+ * that is printed with the results.
+ */
+class ThreadPinning {
+
+public:
+    enum Policy { NONE, COMPACT, SCATTER, SMT_FIRST, LIST };
+
+private:
+    struct CPU {
+        int id;
+        int package;
+        int core;
+        int smt;    // Index of this CPU among the siblings of its core
+    };
+
+    Policy policy {NONE};
+    std::vector<int> order;     // CPU of each tid, modulo its size
+
+    static int readInt(const std::string& path, const int defValue) {
+        FILE* f = fopen(path.c_str(), "r");
+        if (f == nullptr) return defValue;
+        int value;
+        if (fscanf(f, "%d", &value) != 1) value = defValue;
+        fclose(f);
+        return value;
+    }
+
+    // Parses a cpulist like "0-7,16-23"
+    static bool parseCpuList(const std::string& str, std::vector<int>& cpus) {
+        size_t pos = 0;
+        while (pos < str.size()) {
+            char* end;
+            long first = std::strtol(str.c_str()+pos, &end, 10);
+            if (end == str.c_str()+pos || first < 0) return false;
+            long last = first;
+            if (*end == '-') {
+                const char* start = end+1;
+                last = std::strtol(start, &end, 10);
+                if (end == start || last < first) return false;
+            }
+            for (long cpu = first; cpu <= last; cpu++) cpus.push_back((int)cpu);
+            pos = end - str.c_str();
+            if (pos < str.size() && str[pos++] != ',') return false;
+        }
+        return !cpus.empty();
+    }
+
+    static std::vector<CPU> allowedCPUs() {
+        std::vector<CPU> cpus;
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        if (sched_getaffinity(0, sizeof(mask), &mask) != 0) return cpus;
+        for (int id = 0; id < CPU_SETSIZE; id++) {
+            if (!CPU_ISSET(id, &mask)) continue;
+            const std::string topo = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+            cpus.push_back({id, readInt(topo + "physical_package_id", 0), readInt(topo + "core_id", id), 0});
+        }
+        // The SMT index is the rank of the CPU among those with the same package and core
+        for (auto& cpu : cpus) {
+            for (auto& other : cpus) {
+                if (other.package == cpu.package && other.core == cpu.core && other.id < cpu.id) cpu.smt++;
+            }
+        }
+        return cpus;
+    }
+
+    void buildOrder(std::vector<CPU> cpus) {
+        auto key = [this] (const CPU& c) {
+            if (policy == SMT_FIRST) return std::make_tuple(c.package, c.core, c.smt, c.id);
+            return std::make_tuple(c.package, c.smt, c.core, c.id);
+        };
+        std::sort(cpus.begin(), cpus.end(), [&key] (const CPU& a, const CPU& b) { return key(a) < key(b); });
+        if (policy == SCATTER) {
+            // Take the next CPU of each package in turn, in the compact order of each package
+            std::vector<std::vector<int>> packages;
+            std::vector<int> packageIds;
+            for (auto& cpu : cpus) {
+                auto it = std::find(packageIds.begin(), packageIds.end(), cpu.package);
+                if (it == packageIds.end()) {
+                    packageIds.push_back(cpu.package);
+                    packages.emplace_back();
+                    it = packageIds.end()-1;
+                }
+                packages[it - packageIds.begin()].push_back(cpu.id);
+            }
+            for (size_t i = 0; order.size() < cpus.size(); i++) {
+                for (auto& pkg : packages) if (i < pkg.size()) order.push_back(pkg[i]);
+            }
+        } else {
+            for (auto& cpu : cpus) order.push_back(cpu.id);
+        }
+    }
+
+public:
+    ThreadPinning() {
+        const char* env = std::getenv("CX_PIN_THREADS");
+        if (env != nullptr && !parse(env, *this)) {
+            fprintf(stderr, "WARNING: unknown CX_PIN_THREADS '%s', threads are not pinned\n", env);
+            *this = ThreadPinning(NONE);
+        }
+    }
+
+    explicit ThreadPinning(Policy policy) : policy{policy} {
+        if (policy != NONE && policy != LIST) buildOrder(allowedCPUs());
+    }
+
+    // Parses none, compact, scatter, smt-first or cpus:<cpulist>. Returns false if the name is unknown
+    static bool parse(const std::string& str, ThreadPinning& pinning) {
+        if (str == "" || str == "none") pinning = ThreadPinning(NONE);
+        else if (str == "compact")      pinning = ThreadPinning(COMPACT);
+        else if (str == "scatter")      pinning = ThreadPinning(SCATTER);
+        else if (str == "smt-first")    pinning = ThreadPinning(SMT_FIRST);
+        else if (str.rfind("cpus:", 0) == 0) {
+            ThreadPinning list(LIST);
+            if (!parseCpuList(str.substr(5), list.order)) return false;
+            pinning = list;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    bool enabled() const { return policy != NONE && !order.empty(); }
+
+    // CPU of the thread tid, or -1 if it is not pinned
+    int cpuOf(const int tid) const { return enabled() ? order[tid % order.size()] : -1; }
+
+    // Pins the calling thread to the CPU of tid. Returns false if it couldn't
+    bool pin(const int tid) const {
+        if (!enabled()) return true;
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpuOf(tid), &mask);
+        return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+    }
+
+    std::string name() const {
+        static const char* names[] = { "none", "compact", "scatter", "smt-first", "list" };
+        return names[policy];
+    }
+
+    // The policy and the CPUs of the first numThreads tids, like "compact cpus=0 1 2 3"
+    std::string describe(const int numThreads) const {
+        if (!enabled()) return name();
+        std::string str = name() + " cpus=";
+        for (int tid = 0; tid < numThreads; tid++) str += (tid == 0 ? "" : " ") + std::to_string(cpuOf(tid));
+        return str;
+    }
+};
+
+#endif /* _THREAD_PINNING_H_ */
@@ -0,0 +1,331 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+/**
+ * <h1> Arenas for the replicas of the Universal Constructs </h1>
+ *
+ * The Universal Constructs take the policy that allocates and frees the replicas as a
+ * template parameter:
+ * - HeapReplicas (the default) does new C(other) and delete, like the original CX;
+ * - ArenaReplicas places each replica in its own Arena. The copy constructor and
+ *   the mutations applied on the replica run with that arena as the current arena
+ *   of the thread, so the nodes that the container allocates with ArenaAllocator
+ *   come from it. Freeing a replica frees the chunks of its arena without calling
+ *   the destructor of C, and refreshing a replica with a new copy resets the arena
+ *   and reuses its chunks, so there are no calls to the global allocator (and no
+ *   contention on it) in the steady state.
+ *
+ * To use ArenaReplicas, all the memory of C must come from ArenaAllocator, for
+ * example TreeSet<K,ArenaAllocator<K>> or LinkedListSet<K,ArenaAllocator<K>>, and
+ * C must not own any other resource, because its destructor isn't called.
+ * ArenaAllocator uses the global allocator when there is no current arena, so the
+ * same container type can still be used outside of a Universal Construct.
+ *
+ * An Arena is a list of chunks where the allocations are bumped, with free lists
+ * for the small sizes so that the nodes freed by the mutations are reused. The Arena
+ * itself is at the start of its first chunk, followed by the replica, which is how
+ * the Arena of a replica is found from its address.
+ *
+ * Refreshing a replica:
+ * When the Universal Construct refreshes a stale replica with a copy of curComb, it
+ * calls refresh(from, fromTicket, old, oldTicket). If C has a method
+ *   void assignFrom(const C& from, uint64_t fromTicket, uint64_t myTicket)
+ * HeapReplicas calls it on the old replica instead of delete + new C(from), so the
+ * container can reuse its capacity (and its nodes) and, if it keeps track of the
+ * tickets of its changes, copy only what changed since myTicket. myTicket is
+ * UINT64_MAX when the replica has no head, i.e. its state is unknown.
+ * If C has no assignFrom() and opts in to the optimistic reads of CXMutationWF (it's
+ * then trivially copyable), HeapReplicas copies it in place, so the replica of a
+ * Combined is never freed while an optimistic reader may be reading it.
+ * ArenaReplicas always resets the arena and makes a new copy, which already reuses
+ * the chunks of the arena.
+ *
+ * The policy also gives the allocator of the Combined instances of CXMutationWF and of the
+ * read indicators of their rwLocks, which is std::allocator except for SharedReplicas, see
+ * SharedMemory.hpp.
+ */
+class Arena {
+
+private:
+    static const size_t ALIGN = 64;
+    static const size_t FIRST_CHUNK_BYTES = 64*1024;
+    static const size_t MAX_CHUNK_BYTES = 4*1024*1024;
+    static const size_t SMALL_STEP = 16;
+    static const size_t NUM_SMALL = 32;             // Free lists for sizes up to SMALL_STEP*NUM_SMALL bytes
+
+    struct Chunk {
+        Chunk* next;
+        size_t bytes;
+    };
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    Chunk*     firstChunk;
+    Chunk*     curChunk;
+    char*      cur;
+    char*      end;
+    FreeBlock* freeLists[NUM_SMALL];
+
+    static const size_t CHUNK_HEADER = (sizeof(Chunk) + ALIGN - 1) & ~(ALIGN - 1);
+
+    static Chunk* newChunk(size_t bytes) {
+        Chunk* chunk = (Chunk*)::operator new(bytes, std::align_val_t(ALIGN));
+        chunk->next = nullptr;
+        chunk->bytes = bytes;
+        return chunk;
+    }
+
+    void setChunk(Chunk* chunk, size_t offset) {
+        curChunk = chunk;
+        cur = (char*)chunk + offset;
+        end = (char*)chunk + chunk->bytes;
+    }
+
+    // Moves on to the next chunk that fits 'bytes', reusing the chunks of before a reset()
+    void nextChunk(size_t bytes) {
+        while (curChunk->next != nullptr) {
+            setChunk(curChunk->next, CHUNK_HEADER);
+            if (cur + bytes <= end) return;
+        }
+        size_t chunkBytes = curChunk->bytes*2 > MAX_CHUNK_BYTES ? MAX_CHUNK_BYTES : curChunk->bytes*2;
+        if (chunkBytes < bytes + CHUNK_HEADER + ALIGN) chunkBytes = bytes + CHUNK_HEADER + ALIGN;
+        Chunk* chunk = newChunk(chunkBytes);
+        curChunk->next = chunk;
+        setChunk(chunk, CHUNK_HEADER);
+    }
+
+    static inline Arena*& currentRef() {
+        static thread_local Arena* tlCurrent = nullptr;
+        return tlCurrent;
+    }
+
+    Arena(Chunk* chunk) : firstChunk{chunk} {
+        setChunk(chunk, HEADER_BYTES);
+        for (size_t i = 0; i < NUM_SMALL; i++) freeLists[i] = nullptr;
+    }
+
+public:
+    // The Arena is at the start of its first chunk, and the first allocation (the replica) right after it
+    static const size_t HEADER_BYTES;
+
+    static Arena* create() {
+        Chunk* chunk = newChunk(FIRST_CHUNK_BYTES);
+        return new ((char*)chunk + CHUNK_HEADER) Arena(chunk);
+    }
+
+    // Frees all the chunks, including the one with this Arena
+    static void destroy(Arena* arena) {
+        Chunk* chunk = arena->firstChunk;
+        while (chunk != nullptr) {
+            Chunk* lnext = chunk->next;
+            ::operator delete(chunk, std::align_val_t(ALIGN));
+            chunk = lnext;
+        }
+    }
+
+    // Arena of an object that was the first allocation after create() or reset()
+    static inline Arena* of(const void* firstObj) {
+        return (Arena*)((char*)firstObj - HEADER_BYTES + CHUNK_HEADER);
+    }
+
+    static inline Arena* current() { return currentRef(); }
+
+    // Forgets all the allocations, but keeps the chunks for the next ones
+    void reset() {
+        setChunk(firstChunk, HEADER_BYTES);
+        for (size_t i = 0; i < NUM_SMALL; i++) freeLists[i] = nullptr;
+    }
+
+    void* allocate(size_t bytes, size_t align) {
+        if (bytes == 0) bytes = 1;
+        const size_t iclass = (bytes + SMALL_STEP - 1) / SMALL_STEP - 1;
+        if (iclass < NUM_SMALL) {
+            bytes = (iclass + 1) * SMALL_STEP;      // The size of the block in the free list
+            if (align <= SMALL_STEP && freeLists[iclass] != nullptr) {
+                FreeBlock* block = freeLists[iclass];
+                freeLists[iclass] = block->next;
+                return block;
+            }
+        }
+        if (align < SMALL_STEP) align = SMALL_STEP;
+        char* ptr = (char*)(((uintptr_t)cur + align - 1) & ~(uintptr_t)(align - 1));
+        if (ptr + bytes > end) {
+            nextChunk(bytes + align);
+            ptr = (char*)(((uintptr_t)cur + align - 1) & ~(uintptr_t)(align - 1));
+        }
+        cur = ptr + bytes;
+        return ptr;
+    }
+
+    // The small blocks go to a free list, the others are only reclaimed by reset()
+    void deallocate(void* ptr, size_t bytes) {
+        if (bytes == 0) bytes = 1;
+        const size_t iclass = (bytes + SMALL_STEP - 1) / SMALL_STEP - 1;
+        if (iclass >= NUM_SMALL) return;
+        FreeBlock* block = (FreeBlock*)ptr;
+        block->next = freeLists[iclass];
+        freeLists[iclass] = block;
+    }
+
+    // Bytes in the chunks of this arena
+    size_t capacity() const {
+        size_t total = 0;
+        for (Chunk* chunk = firstChunk; chunk != nullptr; chunk = chunk->next) total += chunk->bytes;
+        return total;
+    }
+
+    friend class ArenaScope;
+};
+
+inline const size_t Arena::HEADER_BYTES = (Arena::CHUNK_HEADER + sizeof(Arena) + Arena::ALIGN - 1) & ~(Arena::ALIGN - 1);
+
+
+// Makes 'arena' the current arena of this thread until the end of the scope
+class ArenaScope {
+    Arena* previous;
+public:
+    ArenaScope(Arena* arena) : previous{Arena::currentRef()} { Arena::currentRef() = arena; }
+    ~ArenaScope() { Arena::currentRef() = previous; }
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+
+// Allocator for the sequential containers, from the current arena if there is one
+template<typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator() noexcept { }
+    template<typename U> ArenaAllocator(const ArenaAllocator<U>&) noexcept { }
+
+    T* allocate(size_t n) {
+        Arena* arena = Arena::current();
+        if (arena == nullptr) return std::allocator<T>().allocate(n);
+        return (T*)arena->allocate(n*sizeof(T), alignof(T));
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        Arena* arena = Arena::current();
+        if (arena == nullptr) return std::allocator<T>().deallocate(ptr, n);
+        arena->deallocate(ptr, n*sizeof(T));
+    }
+
+    template<typename U> bool operator==(const ArenaAllocator<U>&) const noexcept { return true; }
+    template<typename U> bool operator!=(const ArenaAllocator<U>&) const noexcept { return false; }
+};
+
+
+/*
+ * A replica type opts in to the optimistic reads of CXMutationWF with:
+ *   template<> struct OptimisticReads<MyType> { static const bool value = true; };
+ */
+template<typename C> struct OptimisticReads {
+    static const bool value = false;
+};
+
+
+class HeapReplicas {
+public:
+    static const bool enabled = false;
+
+    template<typename T> using Allocator = std::allocator<T>;
+
+    // Takes ownership of the instance given to the Universal Construct
+    template<typename C> static inline C* adopt(C* inst) { return inst; }
+
+    // Returns a copy of 'from', replacing 'old' (which may be nullptr)
+    template<typename C> static inline C* copy(const C& from, C* old) {
+        delete old;
+        return new C(from);
+    }
+
+    // Same as copy(), but 'old' is updated in place if C has assignFrom()
+    template<typename C> static inline C* refresh(const C& from, const uint64_t fromTicket, C* old, const uint64_t oldTicket) {
+        if (old == nullptr) return new C(from);
+        return assign(from, fromTicket, old, oldTicket, 0);
+    }
+
+private:
+    template<typename C> static inline auto assign(const C& from, const uint64_t fromTicket, C* old, const uint64_t oldTicket, int)
+            -> decltype(old->assignFrom(from, fromTicket, oldTicket), (C*)nullptr) {
+        old->assignFrom(from, fromTicket, oldTicket);
+        return old;
+    }
+
+    template<typename C> static inline C* assign(const C& from, const uint64_t fromTicket, C* old, const uint64_t oldTicket, long) {
+        if constexpr (OptimisticReads<C>::value && std::is_trivially_copyable<C>::value) {
+            std::memcpy((void*)old, (const void*)&from, sizeof(C));
+            return old;
+        } else {
+            return copy(from, old);
+        }
+    }
+
+public:
+
+    template<typename C> static inline void destroy(C* obj) { delete obj; }
+
+    template<typename C, typename F> static inline auto apply(C* obj, F& func) { return func(obj); }
+};
+
+
+class ArenaReplicas {
+public:
+    static const bool enabled = true;
+
+    template<typename T> using Allocator = std::allocator<T>;
+
+    template<typename C> static C* adopt(C* inst) {
+        C* obj = copy(*inst, (C*)nullptr);
+        delete inst;
+        return obj;
+    }
+
+    template<typename C> static C* copy(const C& from, C* old) {
+        static_assert(alignof(C) <= 64, "The replica must fit the alignment of the arena");
+        Arena* arena;
+        if (old == nullptr) {
+            arena = Arena::create();
+        } else {
+            arena = Arena::of(old);
+            arena->reset();
+        }
+        ArenaScope scope(arena);
+        void* ptr = arena->allocate(sizeof(C), alignof(C));
+        return new (ptr) C(from);
+    }
+
+    template<typename C> static C* refresh(const C& from, const uint64_t fromTicket, C* old, const uint64_t oldTicket) {
+        return copy(from, old);
+    }
+
+    template<typename C> static void destroy(C* obj) {
+        if (obj != nullptr) Arena::destroy(Arena::of(obj));
+    }
+
+    template<typename C, typename F> static inline auto apply(C* obj, F& func) {
+        ArenaScope scope(Arena::of(obj));
+        return func(obj);
+    }
+};
+
+#endif /* _ARENA_H_ */
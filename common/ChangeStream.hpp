@@ -0,0 +1,111 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _CHANGE_STREAM_H_
+#define _CHANGE_STREAM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+/**
+ * <h1> Change Stream </h1>
+ *
+ * An in-memory ring with the (ticket, entry) pairs of the mutations published by a
+ * Universal Construct, for followers that keep their own copy of the object up to
+ * date, in another thread or, by forwarding the entries, in another process.
+ * The entry of a CX node is its LOG::Entry, i.e. the descriptor of applyUpdateLogged().
+ *
+ * Like MutationLog, the entry with ticket t goes in slot t % capacity and is written
+ * by the thread that publishes it, which claims the slot with a CAS on its ticket.
+ * Readers don't hold anything: a Cursor is the last ticket that was consumed, and
+ * poll() reads the next slots, validating each copy with the ticket of the slot, like
+ * a seqlock. Nodes are never pinned by a follower, so the retirement of nodes goes on
+ * no matter how slow the followers are. A follower that fell more than capacity tickets
+ * behind finds a newer ticket in its slot and gets SNAPSHOT_NEEDED: it has to start
+ * again from a snapshot of the object, with the ticket of that snapshot as its cursor.
+ */
+template<typename E>
+class ChangeStream {
+    static_assert(std::is_trivially_copyable<E>::value, "The entries of the change stream must be trivially copyable");
+
+    static const uint64_t BUSY = UINT64_MAX;
+
+    struct Slot {
+        std::atomic<uint64_t> ticket {0};
+        E                     entry;
+    };
+
+    const uint64_t capacity;
+    Slot*          slots;
+
+public:
+    enum Status {
+        UP_TO_DATE,       // All the published entries were consumed
+        MORE,             // maxEntries were consumed and there may be more
+        SNAPSHOT_NEEDED,  // The cursor is too far behind, the entries it needs were overwritten
+    };
+
+    // The last ticket consumed by a follower
+    struct Cursor {
+        uint64_t ticket {0};
+    };
+
+    ChangeStream(const uint64_t capacity) : capacity{capacity}, slots{new Slot[capacity]} { }
+
+    ~ChangeStream() { delete[] slots; }
+
+    ChangeStream(const ChangeStream&) = delete;
+    ChangeStream& operator=(const ChangeStream&) = delete;
+
+    uint64_t getCapacity() const { return capacity; }
+
+    // Called by the publisher of the mutation with ticket. A slow publisher never overwrites a newer ticket.
+    void publish(const uint64_t ticket, const E& entry) {
+        Slot& slot = slots[ticket % capacity];
+        while (true) {
+            uint64_t old = slot.ticket.load();
+            if (old == BUSY) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (old >= ticket) return;
+            if (slot.ticket.compare_exchange_strong(old, BUSY)) break;
+        }
+        std::memcpy(&slot.entry, &entry, sizeof(E));
+        slot.ticket.store(ticket, std::memory_order_release);
+    }
+
+    /*
+     * Calls func(ticket, entry) for the entries after the cursor, in ticket order, up to
+     * maxEntries of them, and advances the cursor. Stops at the first entry that is not
+     * published yet.
+     *
+     * Progress Condition: wait-free (bounded by maxEntries)
+     */
+    template<typename F> Status poll(Cursor& cursor, F&& func, const uint64_t maxEntries) {
+        E entry;
+        for (uint64_t i = 0; i < maxEntries; i++) {
+            const uint64_t next = cursor.ticket + 1;
+            Slot& slot = slots[next % capacity];
+            const uint64_t lticket = slot.ticket.load(std::memory_order_acquire);
+            if (lticket == BUSY || lticket < next) return UP_TO_DATE;
+            if (lticket > next) return SNAPSHOT_NEEDED;
+            std::memcpy(&entry, &slot.entry, sizeof(E));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.ticket.load(std::memory_order_relaxed) != next) return SNAPSHOT_NEEDED;
+            func(next, (const E&)entry);
+            cursor.ticket = next;
+        }
+        return MORE;
+    }
+};
+
+#endif /* _CHANGE_STREAM_H_ */
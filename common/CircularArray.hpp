@@ -30,6 +30,9 @@
 #ifndef _CIRCULARARRAY_H_
 #define _CIRCULARARRAY_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <iostream>
 
@@ -39,42 +42,70 @@
 
 /**
  * This is storing the pointers to the T instances, not the actual T instances.
+ *
+ * Nodes are kept until they are at least min_size tickets behind the newest
+ * node, so that Combined instances that are behind can still re-apply them
+ * instead of doing a copy. The array starts small and grows up to max_size.
+ *
+ * In the default mode, the nodes are retired in one burst when the array is
+ * full. In incremental mode, add() receives the ticket of the oldest head of
+ * a Combined instance and retires at most RETIRE_PER_ADD nodes per call that
+ * are behind it or more than min_size tickets behind the newest node. This
+ * avoids latency spikes on the thread that fills up the array, and the array
+ * only grows as much as needed for the actual lag of the Combined instances.
  */
 template<typename TNode, class HP = HazardPointersCX<TNode>>
 class CircularArray {
 
+public:
+    static const int MAX_SIZE = 2000;
+    static const int MIN_SIZE = 1000;
+
 private:
-    static const int max_size = 2000;
-    int min_size = 1000;
+    static const int INITIAL_CAPACITY = 64;
+    static const int RETIRE_PER_ADD = 2;
+    const int max_size;
+    const int min_size;
+    const bool incremental;
+    int capacity;
     TNode** preRetiredMutNodes;
     int begin = 0;
     int size = 0;
     HP& hp;
     int tid;
 
+    // Self-links the oldest node and retires the one after it
+    void retireFront() {
+        TNode* mNode = preRetiredMutNodes[begin];
+        TNode* lnext = mNode->next.load();
+        mNode->next.store(mNode, std::memory_order_release);
+        hp.retire(lnext,tid);
+        begin = (begin+1 == capacity) ? 0 : begin+1;
+        size--;
+    }
+
+    // Retires all nodes that are at least min_size tickets behind 'node'
     void clean(TNode* node) {
-        int pos = begin;
-        int initialSize = size;
-        TNode* lnext = nullptr;
-        for(int i = 0;i<initialSize;i++){
-            if(pos==max_size)pos=0;
-            TNode* mNode = preRetiredMutNodes[pos];
-            if(mNode->ticket.load() > node->ticket.load()-min_size) {
-                begin = pos;
-                return;
-            }
-            lnext = mNode->next.load();
-            mNode->next.store(mNode, std::memory_order_release);
-            hp.retire(lnext,tid);
-            pos++;
-            size--;
+        while (size > 0) {
+            if (preRetiredMutNodes[begin]->ticket.load() + min_size > node->ticket.load()) return;
+            retireFront();
         }
     }
 
+    void grow() {
+        const int newCapacity = std::min(2*capacity, max_size);
+        TNode** newArray = new TNode*[newCapacity];
+        for (int i = 0; i < size; i++) newArray[i] = preRetiredMutNodes[(begin+i) % capacity];
+        delete[] preRetiredMutNodes;
+        preRetiredMutNodes = newArray;
+        capacity = newCapacity;
+        begin = 0;
+    }
 
 public:
-    CircularArray(HP& hp, int tid):hp{hp},tid{tid} {
-        preRetiredMutNodes = new TNode*[max_size];
+    CircularArray(HP& hp, int tid, bool incremental=false, int maxSize=MAX_SIZE, int minSize=MIN_SIZE) :
+            max_size{maxSize}, min_size{minSize}, incremental{incremental}, capacity{std::min(INITIAL_CAPACITY, maxSize)}, hp{hp}, tid{tid} {
+        preRetiredMutNodes = new TNode*[capacity];
         static_assert(std::is_same<decltype(TNode::ticket), std::atomic<uint64_t>>::value, "TNode::ticket must exist");
         static_assert(std::is_same<decltype(TNode::next), std::atomic<TNode*>>::value, "TNode::next must exist");
     }
@@ -82,7 +113,7 @@ public:
     ~CircularArray() {
         int pos = begin;
         for(int i = 0;i<size;i++){
-            if (pos == max_size) pos = 0;
+            if (pos == capacity) pos = 0;
             hp.retire(preRetiredMutNodes[pos]->next.load(),tid);
             pos++;
         }
@@ -90,11 +121,24 @@ public:
     }
 
 
-    bool add(TNode* node) {
-        if (size == max_size) clean(node);
-        int pos = (begin+size)%max_size;
+    /*
+     * oldestTicket is used only in incremental mode, it is the ticket of the oldest head of
+     * the Combined instances, which don't need the nodes before it anymore.
+     */
+    bool add(TNode* node, uint64_t oldestTicket=0) {
+        if (size == capacity && !incremental) clean(node);
+        if (size == capacity && capacity < max_size) grow();
+        if (size == capacity) retireFront();    // Window is full, the oldest node must go
+        int pos = (begin+size)%capacity;
         preRetiredMutNodes[pos] = node;
         size++;
+        if (!incremental) return true;
+        const uint64_t ticket = node->ticket.load();
+        const uint64_t minTicket = std::max(oldestTicket, (ticket > (uint64_t)min_size) ? ticket - min_size : 0);
+        for (int i = 0; i < RETIRE_PER_ADD && size > 0; i++) {
+            if (preRetiredMutNodes[begin]->ticket.load() >= minTicket) break;
+            retireFront();
+        }
         return true;
     }
 };
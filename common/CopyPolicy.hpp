@@ -0,0 +1,110 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _COPY_POLICY_H_
+#define _COPY_POLICY_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * <h1> Copy Policies for the Universal Constructs </h1>
+ *
+ * An updater that locks a Combined which is behind curComb can either replay the
+ * mutations in the queue, copy curComb, or wait for another updater to apply its
+ * mutation. The Universal Constructs take the policy that makes this decision as
+ * a template parameter:
+ * - CopyAlways (the default) never waits and replays only in the cases that the
+ *   Universal Construct already did, i.e. the original CX behaviour;
+ * - CopyCostModel keeps an EWMA of the duration of a copy and of the application
+ *   of a mutation, shared by all threads:
+ *   - replayLimit() is the number of mutations that take as long as one copy, so
+ *     a Combined that is fewer mutations behind is caught up instead of copied;
+ *   - waitNs() is how long it is worth waiting for another updater before doing
+ *     a copy, which is the duration of a copy, or zero when a copy is so cheap
+ *     (small objects) that it is faster than any wait.
+ *
+ * The samples are written without synchronization, a lost update only means
+ * that the EWMA takes one more sample to converge.
+ */
+
+class CopyAlways {
+public:
+    static const bool enabled = false;
+
+    inline uint64_t now() const { return 0; }
+
+    // Returns the duration of the copy that started at startNs
+    inline uint64_t onCopy(const uint64_t startNs) { return 0; }
+
+    inline void onApply(const uint64_t numMutations, const uint64_t durationNs) { }
+
+    // Zero means don't replay (unless the Universal Construct is in replay mode)
+    inline uint64_t replayLimit() const { return 0; }
+
+    // Zero means don't wait, copy now
+    inline uint64_t waitNs() const { return 0; }
+};
+
+
+class CopyCostModel {
+
+private:
+    static const int      EWMA_SHIFT = 3;           // Weight of a new sample is 1/8
+    static const uint64_t MIN_WAIT_NS = 20000;      // Below this, a copy is faster than a couple of yields
+    static const uint64_t MAX_REPLAY = 1 << 20;
+    static const uint64_t PS_PER_NS = 1000;
+
+    alignas(128) std::atomic<uint64_t> copyNs {0};    // EWMA of the duration of a copy
+    alignas(128) std::atomic<uint64_t> applyPs {0};   // EWMA of the duration of one mutation, in picoseconds
+
+    static inline void addSample(std::atomic<uint64_t>& ewma, const uint64_t sample) {
+        const uint64_t old = ewma.load(std::memory_order_relaxed);
+        const uint64_t next = (old == 0) ? sample : old - (old >> EWMA_SHIFT) + (sample >> EWMA_SHIFT);
+        ewma.store(std::max<uint64_t>(next, 1), std::memory_order_relaxed);
+    }
+
+public:
+    static const bool enabled = true;
+
+    inline uint64_t now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    inline uint64_t onCopy(const uint64_t startNs) {
+        const uint64_t durationNs = now() - startNs;
+        addSample(copyNs, durationNs);
+        return durationNs;
+    }
+
+    inline void onApply(const uint64_t numMutations, const uint64_t durationNs) {
+        if (numMutations == 0) return;
+        addSample(applyPs, durationNs*PS_PER_NS/numMutations);
+    }
+
+    // Zero until there is at least one sample of each
+    inline uint64_t replayLimit() const {
+        const uint64_t lcopy = copyNs.load(std::memory_order_relaxed);
+        const uint64_t lapply = applyPs.load(std::memory_order_relaxed);
+        if (lcopy == 0 || lapply == 0) return 0;
+        return std::min(MAX_REPLAY, lcopy*PS_PER_NS/lapply);
+    }
+
+    inline uint64_t waitNs() const {
+        const uint64_t lcopy = copyNs.load(std::memory_order_relaxed);
+        return lcopy < MIN_WAIT_NS ? 0 : lcopy;
+    }
+
+    uint64_t getCopyNs() const { return copyNs.load(); }
+
+    uint64_t getApplyNs() const { return applyPs.load()/PS_PER_NS; }
+};
+
+#endif /* _COPY_POLICY_H_ */
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _EPOCH_BASED_H_
+#define _EPOCH_BASED_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * <h1> Epoch Based Reclamation </h1>
+ *
+ * For the lock-free data structures whose operations hold more pointers than it's
+ * practical to protect with hazard pointers or hazard eras, like the predecessors at
+ * every level of a skip list. beginOp() publishes the global epoch of the thread,
+ * and every object reached until endOp() is protected.
+ *
+ * An object must be retired after it is unreachable. retire() stamps it with the
+ * global epoch, and it is deleted in a later scan when every thread that is inside
+ * an operation has announced a higher epoch, i.e. it started the operation after
+ * the object was retired. Each thread scans its list every thresholdR retires, and
+ * the global epoch is incremented at the end of each scan.
+ *
+ * A thread that stalls between beginOp() and endOp() prevents all other threads from
+ * reclaiming, therefore memory usage is unbounded (the operations of the data structure
+ * are still lock-free). Operations must not be nested.
+ *
+ * See also EpochBasedCX, the variant for the nodes of the Universal Constructs.
+ */
+template<typename T>
+class EpochBased {
+
+private:
+    static const int      EBR_MAX_THREADS = 128;
+    static const int      CLPAD = 128/sizeof(std::atomic<uint64_t>);
+    static const int      EBR_THRESHOLD_R = 64;
+    static const uint64_t NOT_READING = 0;     // Announced by a thread that is not inside an operation
+
+    struct Retired {
+        T*       obj;
+        uint64_t epoch;
+    };
+
+    const int             maxThreads;
+    const int             thresholdR;
+
+    alignas(128) std::atomic<uint64_t>  globalEpoch {1};
+    alignas(128) std::atomic<uint64_t>* announce;
+    alignas(128) std::vector<Retired>*  retiredList;
+    alignas(128) int*                   retireCount;  // Number of retire() calls since the last scan
+
+    // Lowest epoch announced by the threads that are inside an operation
+    inline uint64_t getMinEpoch() {
+        uint64_t minEpoch = UINT64_MAX;
+        for (int it = 0; it < maxThreads; it++) {
+            const uint64_t epoch = announce[it*CLPAD].load();
+            if (epoch != NOT_READING) minEpoch = std::min(minEpoch, epoch);
+        }
+        return minEpoch;
+    }
+
+public:
+    EpochBased(int maxThreads=EBR_MAX_THREADS, int thresholdR=EBR_THRESHOLD_R) : maxThreads{maxThreads}, thresholdR{thresholdR} {
+        announce = new std::atomic<uint64_t>[maxThreads*CLPAD];
+        retiredList = new std::vector<Retired>[maxThreads*CLPAD];
+        retireCount = new int[maxThreads*CLPAD];
+        for (int it = 0; it < maxThreads; it++) {
+            announce[it*CLPAD].store(NOT_READING, std::memory_order_relaxed);
+            retireCount[it*CLPAD] = 0;
+        }
+    }
+
+    ~EpochBased() {
+        for (int it = 0; it < maxThreads; it++) {
+            for (auto& r : retiredList[it*CLPAD]) delete r.obj;
+        }
+        delete[] announce;
+        delete[] retiredList;
+        delete[] retireCount;
+    }
+
+
+    /**
+     * Must be called before accessing any object, and endOp() after the last access.
+     * Progress Condition: wait-free population oblivious
+     */
+    inline void beginOp(const int tid) {
+        announce[tid*CLPAD].store(globalEpoch.load());
+    }
+
+
+    /**
+     * Progress Condition: wait-free population oblivious
+     */
+    inline void endOp(const int tid) {
+        announce[tid*CLPAD].store(NOT_READING, std::memory_order_release);
+    }
+
+
+    /**
+     * Retire an object that is no longer reachable by threads that call beginOp() from now on.
+     * Progress Condition: wait-free bounded (by the number of threads plus the number of retired objects)
+     */
+    void retire(T* ptr, const int tid) {
+        std::vector<Retired>& rlist = retiredList[tid*CLPAD];
+        rlist.push_back({ptr, globalEpoch.load()});
+        if (++retireCount[tid*CLPAD] < thresholdR) return;
+        retireCount[tid*CLPAD] = 0;
+        const uint64_t minEpoch = getMinEpoch();
+        unsigned keep = 0;
+        for (unsigned iret = 0; iret < rlist.size(); iret++) {
+            if (rlist[iret].epoch < minEpoch) {
+                delete rlist[iret].obj;
+                continue;
+            }
+            rlist[keep++] = rlist[iret];
+        }
+        rlist.resize(keep);
+        globalEpoch.fetch_add(1);
+    }
+};
+
+#endif /* _EPOCH_BASED_H_ */
@@ -0,0 +1,210 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _EPOCH_BASED_CX_H_
+#define _EPOCH_BASED_CX_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "ThreadCount.hpp"
+
+/**
+ * <h1> Epoch Based Reclamation for CX </h1>
+ *
+ * Same interface as HazardPointersCX, but the objects are protected for the
+ * whole duration of an operation instead of one pointer at a time:
+ * beginOp() publishes the current epoch of the thread with a single store, and
+ * protectPtr()/protectPtrRelease() don't do any store at all, which makes the
+ * traversals of the queue of mutations cheaper.
+ *
+ * As in HazardPointersCX, a retired object can only be reclaimed after it is
+ * self-linked (obj->next == obj) and its ORC (obj->refcnt) is zero. The first
+ * scan that sees both conditions stamps the object with the global epoch, and
+ * the object is reclaimed in a later scan if every thread that is inside an
+ * operation has started it in a higher epoch. The global epoch is incremented
+ * at the end of each scan.
+ *
+ * The price is the progress of reclamation: a thread that stalls between
+ * beginOp() and endOp() prevents all other threads from reclaiming, therefore
+ * memory usage is unbounded and the progress of the whole construct is at best
+ * blocking. Operations (beginOp()/endOp() pairs) must not be nested.
+ *
+ * When maxRecycled is non-zero, each thread keeps up to maxRecycled reclaimed
+ * objects in a (thread-local) pool instead of deleting them, like in HazardPointersCX.
+ */
+template<typename T, int MAX_T = 0>   // MAX_T fixes the number of threads at compile time, see ThreadCount.hpp
+class EpochBasedCX {
+
+private:
+    static const int      EBR_MAX_THREADS = 128;
+    static const int      CLPAD = 128/sizeof(std::atomic<uint64_t>);
+    static const int      EBR_THRESHOLD_R = 0;
+    static const uint64_t NOT_READING = 0;     // Announced by a thread that is not inside an operation
+    static const uint64_t NOT_STAMPED = 0;     // Epoch of a retired object that may still be reachable
+
+    struct Retired {
+        T*       obj;
+        uint64_t epoch;
+    };
+
+    const ThreadCount<MAX_T> maxThreads;
+    const unsigned        maxRecycled;
+    const int             thresholdR;
+
+    alignas(128) std::atomic<uint64_t>  globalEpoch {1};
+    // All the per-thread arrays have maxThreads entries
+    alignas(128) std::atomic<uint64_t>* announce;
+    alignas(128) std::vector<Retired>*  retiredList;
+    alignas(128) std::vector<void*>*    recycledList;
+    alignas(128) int*                   retireCount;  // Number of retire() calls since the last scan
+    alignas(128) std::atomic<uint64_t>* numScans;
+
+    inline void reclaim(T* obj, const int tid) {
+        if (recycledList[tid*CLPAD].size() >= maxRecycled) {
+            delete obj;
+            return;
+        }
+        obj->~T();
+        recycledList[tid*CLPAD].push_back(obj);
+    }
+
+    // Lowest epoch announced by the threads that are inside an operation
+    inline uint64_t getMinEpoch() {
+        uint64_t minEpoch = UINT64_MAX;
+        for (int it = 0; it < maxThreads; it++) {
+            const uint64_t epoch = announce[it*CLPAD].load();
+            if (epoch != NOT_READING) minEpoch = std::min(minEpoch, epoch);
+        }
+        return minEpoch;
+    }
+
+    inline bool isUnreachable(T* obj) {
+        return obj->next.load() == obj && obj->refcnt.load() == 0;
+    }
+
+public:
+    // maxHPs is not used, it's here to have the same constructor as HazardPointersCX
+    EpochBasedCX(int maxHPs=0, int numThreads=(MAX_T != 0 ? MAX_T : EBR_MAX_THREADS), unsigned maxRecycled=0, int thresholdR=EBR_THRESHOLD_R) :
+            maxThreads{numThreads}, maxRecycled{maxRecycled}, thresholdR{thresholdR} {
+        announce = new std::atomic<uint64_t>[maxThreads*CLPAD];
+        retiredList = new std::vector<Retired>[maxThreads*CLPAD];
+        recycledList = new std::vector<void*>[maxThreads*CLPAD];
+        retireCount = new int[maxThreads*CLPAD];
+        numScans = new std::atomic<uint64_t>[maxThreads*CLPAD];
+        for (int it = 0; it < maxThreads; it++) {
+            announce[it*CLPAD].store(NOT_READING, std::memory_order_relaxed);
+            recycledList[it*CLPAD].reserve(maxRecycled);
+            retireCount[it*CLPAD] = 0;
+            numScans[it*CLPAD].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~EpochBasedCX() {
+        for (int it = 0; it < maxThreads; it++) {
+            for (auto& r : retiredList[it*CLPAD]) delete r.obj;
+            for (void* mem : recycledList[it*CLPAD]) {
+                if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) ::operator delete(mem, std::align_val_t{alignof(T)});
+                else ::operator delete(mem);
+            }
+        }
+        delete[] announce;
+        delete[] retiredList;
+        delete[] recycledList;
+        delete[] retireCount;
+        delete[] numScans;
+    }
+
+
+    /**
+     * Must be called before accessing any object, and endOp() after the last access.
+     * Progress Condition: wait-free population oblivious
+     */
+    inline void beginOp(const int tid) {
+        announce[tid*CLPAD].store(globalEpoch.load());
+    }
+
+
+    /**
+     * Progress Condition: wait-free population oblivious
+     */
+    inline void endOp(const int tid) {
+        announce[tid*CLPAD].store(NOT_READING, std::memory_order_release);
+    }
+
+
+    // Nothing to do for new objects, the epochs are only needed for retired objects
+    inline void onNew(T* obj) { }
+
+
+    /**
+     * Returns the memory of an object previously reclaimed by this thread, or nullptr if the pool is empty.
+     * The object has already been destroyed, use placement new to construct a new one.
+     * Progress Condition: wait-free population oblivious
+     */
+    inline void* getRecycled(const int tid) {
+        if (recycledList[tid*CLPAD].empty()) return nullptr;
+        void* mem = recycledList[tid*CLPAD].back();
+        recycledList[tid*CLPAD].pop_back();
+        return mem;
+    }
+
+
+    inline void clear(const int tid) { }
+
+    // Number of scans done by all threads (approximate while there are threads calling retire())
+    uint64_t getNumScans() const {
+        uint64_t sum = 0;
+        for (int it = 0; it < maxThreads; it++) sum += numScans[it*CLPAD].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+
+    // The object is already protected by the epoch announced in beginOp()
+    inline T* protectPtr(int index, T* ptr, const int tid) {
+        return ptr;
+    }
+
+
+    inline T* protectPtrRelease(int index, T* ptr, const int tid) {
+        return ptr;
+    }
+
+
+    /**
+     * Progress Condition: wait-free bounded (by the number of threads plus the number of retired objects)
+     */
+    void retire(T* ptr, const int tid) {
+        std::vector<Retired>& rlist = retiredList[tid*CLPAD];
+        rlist.push_back({ptr, NOT_STAMPED});
+        if (++retireCount[tid*CLPAD] < thresholdR) return;
+        retireCount[tid*CLPAD] = 0;
+        numScans[tid*CLPAD].store(numScans[tid*CLPAD].load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+        const uint64_t minEpoch = getMinEpoch();
+        unsigned keep = 0;
+        for (unsigned iret = 0; iret < rlist.size(); iret++) {
+            Retired r = rlist[iret];
+            if (!isUnreachable(r.obj)) {
+                r.epoch = NOT_STAMPED;
+            } else if (r.epoch == NOT_STAMPED) {
+                r.epoch = globalEpoch.load();
+            } else if (r.epoch < minEpoch) {
+                reclaim(r.obj, tid);
+                continue;
+            }
+            rlist[keep++] = r;
+        }
+        rlist.resize(keep);
+        globalEpoch.fetch_add(1);
+    }
+};
+
+#endif /* _EPOCH_BASED_CX_H_ */
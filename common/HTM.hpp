@@ -0,0 +1,83 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _HTM_H_
+#define _HTM_H_
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+/**
+ * <h1> Hardware Transactional Memory </h1>
+ *
+ * A thin wrapper of Intel RTM (xbegin/xend/xabort). The instructions are emitted
+ * with inline assembly, so the code doesn't need to be compiled with -mrtm, and
+ * isSupported() checks with cpuid that the processor has RTM and that it's not
+ * disabled by the microcode (RTM_ALWAYS_ABORT). begin() must not be called when
+ * isSupported() is false, the instruction would fault.
+ *
+ * On other architectures isSupported() is false and begin() always reports an
+ * abort, which means that the callers always take their fallback path.
+ *
+ * Usage:
+ *   if (HTM::begin() == HTM::STARTED) {
+ *       ...                 // if (something) HTM::abort();
+ *       HTM::end();
+ *   } else {
+ *       ...                 // Fallback, nothing of the transaction is visible
+ *   }
+ */
+class HTM {
+public:
+    static const unsigned STARTED        = ~0u;
+    // Bits of the status returned by begin() after an abort
+    static const unsigned ABORT_EXPLICIT = 1 << 0;   // abort() was called
+    static const unsigned ABORT_RETRY    = 1 << 1;   // The transaction may succeed on a retry
+    static const unsigned ABORT_CONFLICT = 1 << 2;   // Another thread accessed the read or write set
+    static const unsigned ABORT_CAPACITY = 1 << 3;   // The read or write set doesn't fit in the cache
+
+#if defined(__x86_64__) || defined(__i386__)
+    static bool isSupported() {
+        static const bool supported = [] () {
+            unsigned eax, ebx, ecx, edx;
+            if (__get_cpuid_max(0, nullptr) < 7) return false;
+            __cpuid_count(7, 0, eax, ebx, ecx, edx);
+            return (ebx & (1 << 11)) != 0 && (edx & (1 << 11)) == 0;
+        }();
+        return supported;
+    }
+
+    // On an abort, the processor jumps to the label with the status in eax
+    static inline unsigned begin() {
+        unsigned status = STARTED;
+        asm volatile("xbegin 1f\n1:" : "+a"(status) :: "memory");
+        return status;
+    }
+
+    static inline void end() {
+        asm volatile("xend" ::: "memory");
+    }
+
+    static inline void abort() {
+        asm volatile("xabort $0xff" ::: "memory");
+    }
+#else
+    static bool isSupported() { return false; }
+    static inline unsigned begin() { return 0; }
+    static inline void end() { }
+    static inline void abort() { }
+#endif
+
+    // A transaction that aborted on a conflict may succeed if it's tried again, one that aborted on capacity won't
+    static inline bool mayRetry(const unsigned status) {
+        return (status & (ABORT_RETRY | ABORT_CONFLICT)) != 0 && (status & ABORT_CAPACITY) == 0;
+    }
+};
+
+#endif /* _HTM_H_ */
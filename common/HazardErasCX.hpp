@@ -32,9 +32,12 @@
 
 #include <atomic>
 #include <iostream>
+#include <new>
 #include <vector>
 #include <algorithm>
 
+#include "ThreadCount.hpp"
+
 /*
  * <h1> Hazard Eras </h1>
  * The only differences between HE and HECX is the check on obj->refcnt and obj->next being self-linked in retired()
@@ -49,13 +52,17 @@
  * The type T is for the objects/nodes and it's expected to have the following members:
  * newEra, delEra, delNext.
  *
- * R is zero.
+ * R is zero by default, otherwise a scan is done once every thresholdR calls to retire().
+ *
+ * It has the same interface as HazardPointersCX, including the pool of reclaimed
+ * objects (maxRecycled), so that it can be used as the reclamation policy of CX.
+ * onNew() must be called on each new object to set its newEra.
  *
  * <p>
  * @author Pedro Ramalhete
  * @author Andreia Correia
  */
-template<typename T>
+template<typename T, int MAX_T = 0>   // MAX_T fixes the number of threads at compile time, see ThreadCount.hpp
 class HazardErasCX {
 
 private:
@@ -66,17 +73,41 @@ private:
     static const int      HE_THRESHOLD_R = 0; // This is named 'R' in the HP paper
 
     const int             maxHEs;
-    const int             maxThreads;
+    const ThreadCount<MAX_T> maxThreads;
+    const unsigned        maxRecycled;
+    const int             thresholdR;
 
     alignas(128) std::atomic<uint64_t>  eraClock {1};
-    alignas(128) std::atomic<uint64_t>* he[HE_MAX_THREADS];
-    alignas(128) std::vector<T*>        retiredList[HE_MAX_THREADS*CLPAD];  // It's not nice that we have a lot of empty vectors
+    // All the per-thread arrays have maxThreads entries
+    alignas(128) std::atomic<uint64_t>** he;
+    alignas(128) std::vector<T*>*        retiredList;  // It's not nice that we have a lot of empty vectors
+    alignas(128) std::vector<void*>*     recycledList;
+    alignas(128) int*                    retireCount;  // Number of retire() calls since the last scan
+    alignas(128) std::atomic<uint64_t>*  numScans;
+
+    inline void reclaim(T* obj, const int tid) {
+        if (recycledList[tid*CLPAD].size() >= maxRecycled) {
+            delete obj;
+            return;
+        }
+        obj->~T();
+        recycledList[tid*CLPAD].push_back(obj);
+    }
 
 public:
-    HazardErasCX(int maxHEs=MAX_HES, int maxThreads=HE_MAX_THREADS) : maxHEs{maxHEs}, maxThreads{maxThreads} {
-        for (int it = 0; it < HE_MAX_THREADS; it++) {
+    HazardErasCX(int maxHEs=MAX_HES, int numThreads=(MAX_T != 0 ? MAX_T : HE_MAX_THREADS), unsigned maxRecycled=0, int thresholdR=HE_THRESHOLD_R) :
+            maxHEs{maxHEs}, maxThreads{numThreads}, maxRecycled{maxRecycled}, thresholdR{thresholdR} {
+        he = new std::atomic<uint64_t>*[maxThreads];
+        retiredList = new std::vector<T*>[maxThreads*CLPAD];
+        recycledList = new std::vector<void*>[maxThreads*CLPAD];
+        retireCount = new int[maxThreads*CLPAD];
+        numScans = new std::atomic<uint64_t>[maxThreads*CLPAD];
+        for (int it = 0; it < maxThreads; it++) {
             he[it] = new std::atomic<uint64_t>[CLPAD*2]; // We allocate four cache lines to allow for many hps and without false sharing
             retiredList[it*CLPAD].reserve(maxThreads*maxHEs);
+            recycledList[it*CLPAD].reserve(maxRecycled);
+            retireCount[it*CLPAD] = 0;
+            numScans[it*CLPAD].store(0, std::memory_order_relaxed);
             for (int ihe = 0; ihe < MAX_HES; ihe++) {
                 he[it][ihe].store(NONE, std::memory_order_relaxed);
             }
@@ -86,13 +117,22 @@ public:
     }
 
     ~HazardErasCX() {
-        for (int it = 0; it < HE_MAX_THREADS; it++) {
+        for (int it = 0; it < maxThreads; it++) {
             delete[] he[it];
             // Clear the current retired nodes
             for (unsigned iret = 0; iret < retiredList[it*CLPAD].size(); iret++) {
                 delete retiredList[it*CLPAD][iret];
             }
+            for (void* mem : recycledList[it*CLPAD]) {
+                if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) ::operator delete(mem, std::align_val_t{alignof(T)});
+                else ::operator delete(mem);
+            }
         }
+        delete[] he;
+        delete[] retiredList;
+        delete[] recycledList;
+        delete[] retireCount;
+        delete[] numScans;
     }
 
 
@@ -101,6 +141,38 @@ public:
     }
 
 
+    // Nothing to do in hazard eras, each object is protected when it's accessed
+    inline void beginOp(const int tid) { }
+    inline void endOp(const int tid) { }
+
+
+    // Must be called on each new object before it is made visible to other threads
+    inline void onNew(T* obj) {
+        obj->newEra = eraClock.load(std::memory_order_relaxed);
+    }
+
+
+    /**
+     * Returns the memory of an object previously reclaimed by this thread, or nullptr if the pool is empty.
+     * The object has already been destroyed, use placement new to construct a new one.
+     * Progress Condition: wait-free population oblivious
+     */
+    inline void* getRecycled(const int tid) {
+        if (recycledList[tid*CLPAD].empty()) return nullptr;
+        void* mem = recycledList[tid*CLPAD].back();
+        recycledList[tid*CLPAD].pop_back();
+        return mem;
+    }
+
+
+    // Number of scans done by all threads (approximate while there are threads calling retire())
+    uint64_t getNumScans() const {
+        uint64_t sum = 0;
+        for (int it = 0; it < maxThreads; it++) sum += numScans[it*CLPAD].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+
     /**
      * Progress Condition: wait-free bounded (by maxHEs)
      */
@@ -175,6 +247,32 @@ public:
     }
 
 
+    /*
+     * Same usage as in HazardPointersCX: ptr has already been read by the caller, who
+     * must check afterwards that it was not retired before the era was published.
+     *
+     * Progress Condition: wait-free population oblivious
+     */
+    inline T* protectPtr(int index, T* ptr, const int tid) {
+        const auto era = eraClock.load();
+        if (he[tid][index].load(std::memory_order_relaxed) != era) he[tid][index].store(era);
+        return ptr;
+    }
+
+
+    /*
+     * ptr must already be protected (by another index or because it's a new object).
+     * Its newEra is inside its lifetime, so there is no need to check anything afterwards.
+     *
+     * Progress Condition: wait-free population oblivious
+     */
+    inline T* protectPtrRelease(int index, T* ptr, const int tid) {
+        const auto era = ptr->newEra;
+        if (he[tid][index].load(std::memory_order_relaxed) != era) he[tid][index].store(era, std::memory_order_release);
+        return ptr;
+    }
+
+
     /**
      * Retire an object (node)
      * Progress Condition: wait-free bounded
@@ -185,15 +283,19 @@ public:
         auto& rlist = retiredList[mytid*CLPAD];
         rlist.push_back(ptr);
         if (eraClock == currEra) eraClock.fetch_add(1);
-        for (unsigned iret = 0; iret < rlist.size();) {
+        if (++retireCount[mytid*CLPAD] < thresholdR) return;
+        retireCount[mytid*CLPAD] = 0;
+        numScans[mytid*CLPAD].store(numScans[mytid*CLPAD].load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+        unsigned keep = 0;
+        for (unsigned iret = 0; iret < rlist.size(); iret++) {
             auto obj = rlist[iret];
             if (canDelete(obj, mytid)) {
-                rlist.erase(rlist.begin() + iret);
-                delete obj;
+                reclaim(obj, mytid);
                 continue;
             }
-            iret++;
+            rlist[keep++] = obj;
         }
+        rlist.resize(keep);
     }
 
 private:
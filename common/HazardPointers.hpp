@@ -32,7 +32,7 @@
 
 #include <atomic>
 #include <iostream>
-
+#include "common/NodePool.hpp"
 
 
 /**
@@ -55,6 +55,8 @@ private:
     alignas(128) long                  numRetiredObjects[MAX_THREADS*CLPAD];       // Number of nodes in the retired list
     // Used specifically for CXMutation
     alignas(128) std::atomic<T*>       heads[2*MAX_THREADS*CLPAD];
+    // If set, the objects that pass the scan go back to this pool instead of being deleted
+    NodePool<T>*                       pool {nullptr};
 
 public:
     HazardPointers(int maxHPs=MAX_HPS, int maxThreads=MAX_THREADS) : maxHPs{maxHPs}, maxThreads{maxThreads} {
@@ -169,6 +171,12 @@ public:
     }
 
 
+    // The pool must outlive this instance
+    void setPool(NodePool<T>* nodePool) {
+        pool = nodePool;
+    }
+
+
     void copyPtr(int index, int other, const int tid) {
         auto ptr = hp[tid*CLPAD][other].load(std::memory_order_relaxed);
         hp[tid*CLPAD][index].store(ptr, std::memory_order_release);
@@ -193,7 +201,11 @@ private:
             if (ptrInUse) { iret++; continue;  }
             for (int i = iret; i < numRetiredObjects[tid*CLPAD]-1; i++) retiredObjects[tid*CLPAD][i] = retiredObjects[tid*CLPAD][i+1];
             numRetiredObjects[tid*CLPAD]--;
-            delete ptr;
+            if (pool != nullptr) {
+                pool->release(ptr, tid);
+            } else {
+                delete ptr;
+            }
 
         }
     }
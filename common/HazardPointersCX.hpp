@@ -30,36 +30,74 @@
 #ifndef _HAZARD_POINTERS_CX_H_
 #define _HAZARD_POINTERS_CX_H_
 
+#include <algorithm>
 #include <atomic>
 #include <iostream>
+#include <new>
+#include <vector>
+
+#include "ThreadCount.hpp"
 
 
 /**
  * The only differences between HP and HP CX is the check on obj->refcnt and obj->next being self-linked in retired()
  *
+ * When maxRecycled is non-zero, each thread keeps up to maxRecycled reclaimed
+ * objects in a (thread-local) pool instead of deleting them. The destructor of
+ * the object is called before it goes into the pool, and the memory can be
+ * reused with placement new after getRecycled().
+ *
+ * MAX_T fixes the number of threads at compile time (see ThreadCount.hpp), which
+ * makes the scans loop over a constant number of threads.
  */
-template<typename T>
+template<typename T, int MAX_T = 0>
 class HazardPointersCX {
 
 private:
     static const int      HP_MAX_THREADS = 128;
     static const int      HP_MAX_HPS = 5;     // This is named 'K' in the HP paper
     static const int      CLPAD = 128/sizeof(std::atomic<T*>);
-    static const int      HP_THRESHOLD_R = 0; // This is named 'R' in the HP paper
-    static const int      MAX_RETIRED = HP_MAX_THREADS*HP_MAX_HPS; // Maximum number of retired objects per thread
+    static const int      HP_THRESHOLD_R = 0; // This is named 'R' in the HP paper (default value)
 
     const int             maxHPs;
-    const int             maxThreads;
+    const ThreadCount<MAX_T> maxThreads;
+    const unsigned        maxRecycled;
+    const int             thresholdR;
 
-    alignas(128) std::atomic<T*>*      hp[HP_MAX_THREADS];
+    // All the per-thread arrays have maxThreads entries.
     // It's not nice that we have a lot of empty vectors, but we need padding to avoid false sharing
-    alignas(128) std::vector<T*>       retiredList[HP_MAX_THREADS*CLPAD];
+    alignas(128) std::atomic<T*>**     hp;
+    alignas(128) std::vector<T*>*      retiredList;
+    alignas(128) std::vector<void*>*   recycledList;
+    alignas(128) std::vector<T*>*      scanList;     // Snapshot of the hazard pointers
+    alignas(128) int*                  retireCount;  // Number of retire() calls since the last scan
+    alignas(128) std::atomic<uint64_t>* numScans;
+
+    inline void reclaim(T* obj, const int tid) {
+        if (recycledList[tid*CLPAD].size() >= maxRecycled) {
+            delete obj;
+            return;
+        }
+        obj->~T();
+        recycledList[tid*CLPAD].push_back(obj);
+    }
 
 public:
-    HazardPointersCX(int maxHPs=HP_MAX_HPS, int maxThreads=HP_MAX_THREADS) : maxHPs{maxHPs}, maxThreads{maxThreads} {
-        for (int it = 0; it < HP_MAX_THREADS; it++) {
+    HazardPointersCX(int maxHPs=HP_MAX_HPS, int numThreads=(MAX_T != 0 ? MAX_T : HP_MAX_THREADS), unsigned maxRecycled=0, int thresholdR=HP_THRESHOLD_R) :
+            maxHPs{maxHPs}, maxThreads{numThreads}, maxRecycled{maxRecycled}, thresholdR{thresholdR} {
+        hp = new std::atomic<T*>*[maxThreads];
+        retiredList = new std::vector<T*>[maxThreads*CLPAD];
+        recycledList = new std::vector<void*>[maxThreads*CLPAD];
+        scanList = new std::vector<T*>[maxThreads*CLPAD];
+        retireCount = new int[maxThreads*CLPAD];
+        numScans = new std::atomic<uint64_t>[maxThreads*CLPAD];
+        for (int it = 0; it < maxThreads; it++) {
             hp[it] = new std::atomic<T*>[CLPAD*2]; // We allocate four cache lines to allow for many hps and without false sharing
-            retiredList[it*CLPAD].reserve(MAX_RETIRED);
+            retiredList[it*CLPAD].reserve(maxThreads*maxHPs);
+            recycledList[it*CLPAD].reserve(maxRecycled);
+            scanList[it*CLPAD].reserve(maxHPs*maxThreads);
+            retireCount[it*CLPAD] = 0;
+            numScans[it*CLPAD].store(0, std::memory_order_relaxed);
             for (int ihp = 0; ihp < HP_MAX_HPS; ihp++) {
                 hp[it][ihp].store(nullptr, std::memory_order_relaxed);
             }
@@ -67,13 +105,50 @@ public:
     }
 
     ~HazardPointersCX() {
-        for (int it = 0; it < HP_MAX_THREADS; it++) {
+        for (int it = 0; it < maxThreads; it++) {
             delete[] hp[it];
             // Clear the current retired nodes
             for (unsigned iret = 0; iret < retiredList[it*CLPAD].size(); iret++) {
                 delete retiredList[it*CLPAD][iret];
             }
+            for (void* mem : recycledList[it*CLPAD]) {
+                if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) ::operator delete(mem, std::align_val_t{alignof(T)});
+                else ::operator delete(mem);
+            }
         }
+        delete[] hp;
+        delete[] retiredList;
+        delete[] recycledList;
+        delete[] scanList;
+        delete[] retireCount;
+        delete[] numScans;
+    }
+
+
+    // Nothing to do in hazard pointers, each object is protected when it's accessed
+    inline void beginOp(const int tid) { }
+    inline void endOp(const int tid) { }
+    inline void onNew(T* obj) { }
+
+
+    /**
+     * Returns the memory of an object previously reclaimed by this thread, or nullptr if the pool is empty.
+     * The object has already been destroyed, use placement new to construct a new one.
+     * Progress Condition: wait-free population oblivious
+     */
+    inline void* getRecycled(const int tid) {
+        if (recycledList[tid*CLPAD].empty()) return nullptr;
+        void* mem = recycledList[tid*CLPAD].back();
+        recycledList[tid*CLPAD].pop_back();
+        return mem;
+    }
+
+
+    // Number of scans done by all threads (approximate while there are threads calling retire())
+    uint64_t getNumScans() const {
+        uint64_t sum = 0;
+        for (int it = 0; it < maxThreads; it++) sum += numScans[it*CLPAD].load(std::memory_order_relaxed);
+        return sum;
     }
 
 
@@ -131,32 +206,45 @@ public:
 
 
     /**
-     * Progress Condition: wait-free bounded (by the number of threads squared)
+     * Progress Condition: wait-free bounded (by the number of threads times the number of retired objects)
      *
      * The only differences between HP and HP CX is the check on obj->refcnt and obj->next being self-linked
+     *
+     * A scan is done once every thresholdR calls. The hazard pointers of all threads are
+     * read once into a sorted snapshot and the retired objects are looked up in it, which
+     * makes a scan O(R log H) instead of O(R * H).
      */
     void retire(T* ptr, const int tid) {
-        retiredList[tid*CLPAD].push_back(ptr);
-        if (retiredList[tid*CLPAD].size() < HP_THRESHOLD_R) return;
-        for (unsigned iret = 0; iret < retiredList[tid*CLPAD].size(); iret++) {
-            auto obj = retiredList[tid*CLPAD][iret];
-            if (obj->next.load() != obj) continue; // Delete only if node.next == node
-            bool canDelete = true;
-            for (int it = 0; it < maxThreads && canDelete; it++) {
-                for (int ihp = 0; ihp < maxHPs; ihp++) {
-                    if (hp[it][ihp].load() == obj) {
-                        canDelete = false;
-                        break;
-                    }
-                }
+        std::vector<T*>& rlist = retiredList[tid*CLPAD];
+        rlist.push_back(ptr);
+        if (++retireCount[tid*CLPAD] < thresholdR) return;
+        retireCount[tid*CLPAD] = 0;
+        numScans[tid*CLPAD].store(numScans[tid*CLPAD].load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+        // Move the self-linked objects to the front, they're the only ones that can be deleted
+        unsigned numCandidates = 0;
+        for (unsigned iret = 0; iret < rlist.size(); iret++) {
+            if (rlist[iret]->next.load() == rlist[iret]) std::swap(rlist[iret], rlist[numCandidates++]);
+        }
+        if (numCandidates == 0) return;
+        std::vector<T*>& snapshot = scanList[tid*CLPAD];
+        snapshot.clear();
+        for (int it = 0; it < maxThreads; it++) {
+            for (int ihp = 0; ihp < maxHPs; ihp++) {
+                T* obj = hp[it][ihp].load();
+                if (obj != nullptr) snapshot.push_back(obj);
             }
-            if (canDelete && obj->refcnt.load() == 0) { // Delete only if ORC is zero
-                retiredList[tid*CLPAD].erase(retiredList[tid*CLPAD].begin() + iret);
-                delete obj;
-                iret--;
+        }
+        std::sort(snapshot.begin(), snapshot.end());
+        unsigned keep = 0;
+        for (unsigned iret = 0; iret < rlist.size(); iret++) {
+            T* obj = rlist[iret];
+            if (iret < numCandidates && !std::binary_search(snapshot.begin(), snapshot.end(), obj) && obj->refcnt.load() == 0) {
+                reclaim(obj, tid); // Delete only if ORC is zero
                 continue;
             }
+            rlist[keep++] = obj;
         }
+        rlist.resize(keep);
     }
 };
 
@@ -34,6 +34,7 @@
 #include <iostream>
 #include <functional>
 #include <vector>
+#include "common/NodePool.hpp"
 
 
 // TODO: use std::vector instead of arrays for the retired objects (keep the padding)
@@ -55,6 +56,8 @@ private:
     std::vector<T*>       retiredList[HP_MAX_THREADS*CLPAD];
 
     std::function<bool(T*)> findPtr;
+    // If set, the objects that pass the scan go back to this pool instead of being deleted
+    NodePool<T>*          pool {nullptr};
 
 public:
     HazardPointersSimQueue(std::function<bool(T*)>& find, int maxHPs=HP_MAX_HPS, int maxThreads=HP_MAX_THREADS) : maxHPs{maxHPs}, maxThreads{maxThreads} {
@@ -127,6 +130,12 @@ public:
     }
 
 
+    // The pool must outlive this instance
+    void setPool(NodePool<T>* nodePool) {
+        pool = nodePool;
+    }
+
+
     /**
      * This returns the same value that is passed as ptr, which is sometimes useful
      * Progress Condition: wait-free bounded (by the number of threads squared)
@@ -150,7 +159,11 @@ public:
             }
             if (canDelete) {
                 retiredList[tid*CLPAD].erase(retiredList[tid*CLPAD].begin() + iret);
-                delete obj;
+                if (pool != nullptr) {
+                    pool->release(obj, tid);
+                } else {
+                    delete obj;
+                }
                 continue;
             }
             iret++;
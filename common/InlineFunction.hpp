@@ -0,0 +1,74 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _INLINE_FUNCTION_H_
+#define _INLINE_FUNCTION_H_
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * <h1> Inline Function </h1>
+ *
+ * A type-erased callable, similar to std::function, but where the callable is
+ * always stored inside the object, in a buffer of Size bytes.
+ * It never allocates memory: a callable that doesn't fit in the buffer is a
+ * compilation error instead of a silent heap allocation.
+ * Callables bigger than Size can still be used by wrapping them in a
+ * std::function (which fits in the buffer) or by capturing a pointer.
+ *
+ * It is not copyable nor movable, it is meant to be constructed in-place
+ * inside the nodes of the Universal Constructs.
+ */
+template<typename Sig, std::size_t Size = 64>
+class InlineFunction;
+
+template<typename R, typename... Args, std::size_t Size>
+class InlineFunction<R(Args...), Size> {
+
+private:
+    alignas(std::max_align_t) unsigned char buffer[Size];
+    R    (*invokeFunc)(void*, Args...) {nullptr};
+    void (*destroyFunc)(void*) {nullptr};
+
+    template<typename Fn> static R invokeImpl(void* buf, Args... args) {
+        return (*static_cast<Fn*>(buf))(std::forward<Args>(args)...);
+    }
+
+    template<typename Fn> static void destroyImpl(void* buf) {
+        static_cast<Fn*>(buf)->~Fn();
+    }
+
+public:
+    static const std::size_t capacity = Size;
+
+    template<typename F, typename Fn = typename std::decay<F>::type,
+             typename = typename std::enable_if<!std::is_same<Fn, InlineFunction>::value>::type>
+    InlineFunction(F&& func) {
+        static_assert(sizeof(Fn) <= Size, "Callable is too large for InlineFunction: capture by pointer or wrap it in a std::function");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "Callable is over-aligned for InlineFunction");
+        new (buffer) Fn(std::forward<F>(func));
+        invokeFunc = &invokeImpl<Fn>;
+        destroyFunc = &destroyImpl<Fn>;
+    }
+
+    InlineFunction(const InlineFunction&) = delete;
+    InlineFunction& operator=(const InlineFunction&) = delete;
+
+    ~InlineFunction() {
+        destroyFunc(buffer);
+    }
+
+    inline R operator()(Args... args) {
+        return invokeFunc(buffer, std::forward<Args>(args)...);
+    }
+};
+
+#endif /* _INLINE_FUNCTION_H_ */
@@ -0,0 +1,355 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _MUTATION_LOG_H_
+#define _MUTATION_LOG_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+/**
+ * <h1> Mutation Logs for the Universal Constructs </h1>
+ *
+ * The queue of mutations of CX is totally ordered by the ticket of its nodes, which
+ * is the order of a redo log. The Universal Constructs take the log policy as a
+ * template parameter:
+ * - NoLog (the default), where nothing is written;
+ * - MutationLog<D>, a write-ahead log of descriptors of type D, which must be
+ *   trivially copyable, for example { op, key }.
+ *
+ * The log is a memory-mapped file of 'capacity' slots, and the mutation with ticket
+ * t goes in slot t % capacity, so concurrent writers never compete for a position
+ * and the file is in ticket order no matter the order of the writes. A slot is
+ * written by the thread that publishes the mutation in curComb, with a checksum,
+ * and its ticket is stored last. A writer claims the slot with a CAS on the ticket,
+ * so that a slow writer doesn't overwrite a newer mutation that wrapped around. Mutations without a descriptor are logged as
+ * no-ops (reads that fell back to the queue are harmless, but a plain update is
+ * not durable).
+ *
+ * A checkpoint is a file with a copy of the object, made by the Universal Construct
+ * from a quiescent (pinned) replica, with the ticket of that replica. After a
+ * checkpoint at ticket T the slots up to T can be reused, so a writer waits if its
+ * slot still holds a ticket after the last checkpoint. The checkpoint is written
+ * to a temporary file, synced and renamed, so there is always a complete one.
+ *
+ * Each open() starts a new epoch, stored in the checkpoint and in the slots, so
+ * the slots of an older run are never replayed on a newer checkpoint.
+ *
+ * Recovery loads the checkpoint and replays the slots after its ticket, while they
+ * are in the same epoch, have consecutive tickets and a valid checksum. The result
+ * is the object after a prefix of the mutations.
+ *
+ * Durability:
+ * The slots are in the page cache as soon as they're written, which survives a crash
+ * of the process. With syncCommit, waitDurable() also msync()s the slots, as a group
+ * commit: one thread at a time syncs all the consecutive slots that are written, and
+ * the others wait for it. This makes the updates blocking, on the disk.
+ */
+
+class NoLog {
+public:
+    static const bool enabled = false;
+
+    struct Entry { };
+
+    bool isOpen() const { return false; }
+    bool needsCheckpoint(const uint64_t ticket) const { return false; }
+    bool isFull(const uint64_t ticket) const { return false; }
+    bool tryBeginCheckpoint() { return false; }
+    template<typename F> bool writeCheckpoint(const uint64_t ticket, F&& save) { return false; }
+    void endCheckpoint() { }
+    void write(const uint64_t ticket, const Entry& entry) { }
+    void waitDurable(const uint64_t ticket) { }
+};
+
+
+template<typename D>
+class MutationLog {
+    static_assert(std::is_trivially_copyable<D>::value, "The descriptors of the log must be trivially copyable");
+
+public:
+    static const bool enabled = true;
+
+    typedef D Descriptor;
+
+    // Stored in each node of the queue
+    struct Entry {
+        D        desc;
+        bool     hasDesc {false};
+    };
+
+private:
+    static const uint64_t MAGIC = 0x43584d55544c4f47ULL;   // "CXMUTLOG"
+    static const uint64_t HEADER_SIZE = 4096;
+    static const uint64_t BUSY = UINT64_MAX;              // Ticket of a slot that is being written
+
+    struct Header {
+        uint64_t magic;
+        uint64_t capacity;
+        uint64_t slotSize;
+        uint64_t epoch;
+    };
+
+    struct Slot {
+        uint64_t ticket;        // Stored last, with release
+        uint64_t epoch;
+        uint64_t check;
+        uint64_t hasDesc;
+        D        desc;
+    };
+
+    std::string           path;
+    uint64_t              capacity {0};
+    uint64_t              epoch {0};
+    bool                  syncCommit {false};
+    int                   fd {-1};
+    uint8_t*              base {nullptr};
+    size_t                mapSize {0};
+    alignas(128) std::atomic<uint64_t> ckptTicket {0};     // Ticket of the last complete checkpoint
+    alignas(128) std::atomic<uint64_t> durableTicket {0};  // All tickets up to this one are synced
+    alignas(128) std::atomic<bool>     isFlushing {false};
+    alignas(128) std::atomic<bool>     isCheckpointing {false};
+
+    inline Slot* slotOf(const uint64_t ticket) const {
+        return reinterpret_cast<Slot*>(base + HEADER_SIZE) + (ticket % capacity);
+    }
+
+    static uint64_t checksum(const Slot* slot, const uint64_t ticket) {
+        uint64_t h = 14695981039346656037ULL;    // FNV-1a
+        auto mix = [&h] (const void* p, size_t n) {
+            const uint8_t* b = (const uint8_t*)p;
+            for (size_t i = 0; i < n; i++) h = (h ^ b[i]) * 1099511628211ULL;
+        };
+        mix(&ticket, sizeof(ticket));
+        mix(&slot->epoch, sizeof(slot->epoch));
+        mix(&slot->hasDesc, sizeof(slot->hasDesc));
+        mix(&slot->desc, sizeof(D));
+        return h;
+    }
+
+    static bool isValid(const Slot* slot, const uint64_t ticket, const uint64_t epoch) {
+        return __atomic_load_n(&slot->ticket, __ATOMIC_ACQUIRE) == ticket && slot->epoch == epoch && slot->check == checksum(slot, ticket);
+    }
+
+    // msync() of the pages of the slots in [first, last], which may wrap around the ring
+    void syncSlots(const uint64_t first, const uint64_t last) {
+        const uint64_t page = sysconf(_SC_PAGESIZE);
+        auto syncRange = [&] (const uint8_t* start, const uint8_t* end) {
+            uint8_t* pstart = base + ((start - base)/page)*page;
+            msync(pstart, end - pstart, MS_SYNC);
+        };
+        if (last - first + 1 >= capacity || first % capacity <= last % capacity) {
+            const uint64_t nfirst = (last - first + 1 >= capacity) ? 0 : first % capacity;
+            const uint64_t nlast = (last - first + 1 >= capacity) ? capacity-1 : last % capacity;
+            syncRange((uint8_t*)slotOf(nfirst), (uint8_t*)(slotOf(nlast)+1));
+        } else {
+            syncRange((uint8_t*)slotOf(first), (uint8_t*)(slotOf(capacity-1)+1));
+            syncRange((uint8_t*)slotOf(0), (uint8_t*)(slotOf(last)+1));
+        }
+    }
+
+    static std::string ckptPath(const std::string& path) { return path + ".ckpt"; }
+    static std::string logPath(const std::string& path) { return path + ".log"; }
+
+    static void syncDir(const std::string& file) {
+        const size_t slash = file.rfind('/');
+        const std::string dir = (slash == std::string::npos) ? "." : file.substr(0, slash+1);
+        int dfd = ::open(dir.c_str(), O_RDONLY);
+        if (dfd < 0) return;
+        fsync(dfd);
+        ::close(dfd);
+    }
+
+public:
+    MutationLog() { }
+
+    ~MutationLog() { close(); }
+
+    MutationLog(const MutationLog&) = delete;
+    MutationLog& operator=(const MutationLog&) = delete;
+
+    bool isOpen() const { return base != nullptr; }
+
+    /*
+     * Opens (or creates) path.log with capacity slots and starts a new epoch.
+     * The Universal Construct must write a checkpoint of the initial object right after.
+     */
+    bool open(const std::string& lpath, const uint64_t lcapacity, const bool lsyncCommit) {
+        close();
+        path = lpath;
+        capacity = lcapacity;
+        syncCommit = lsyncCommit;
+        fd = ::open(logPath(path).c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) return false;
+        mapSize = HEADER_SIZE + capacity*sizeof(Slot);
+        if (ftruncate(fd, mapSize) != 0) return false;
+        void* addr = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            fd = -1;
+            return false;
+        }
+        base = (uint8_t*)addr;
+        Header* header = (Header*)base;
+        const bool sameLayout = header->magic == MAGIC && header->capacity == capacity && header->slotSize == sizeof(Slot);
+        epoch = sameLayout ? header->epoch + 1 : 1;
+        if (!sameLayout) std::memset(base + HEADER_SIZE, 0, capacity*sizeof(Slot));
+        *header = Header{MAGIC, capacity, sizeof(Slot), epoch};
+        msync(base, HEADER_SIZE, MS_SYNC);
+        ckptTicket.store(0);
+        durableTicket.store(0);
+        return true;
+    }
+
+    void close() {
+        if (base != nullptr) {
+            msync(base, mapSize, MS_SYNC);
+            munmap(base, mapSize);
+            base = nullptr;
+        }
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    uint64_t getCheckpointTicket() const { return ckptTicket.load(); }
+
+    // True once the log is half full since the last checkpoint
+    inline bool needsCheckpoint(const uint64_t ticket) const { return ticket > ckptTicket.load() + capacity/2; }
+
+    // True if the slot of ticket holds a mutation that is not in a checkpoint yet
+    inline bool isFull(const uint64_t ticket) const { return ticket > ckptTicket.load() + capacity; }
+
+    // Only one checkpoint at a time, returns false if there is one in progress
+    bool tryBeginCheckpoint() { return !isCheckpointing.load() && !isCheckpointing.exchange(true); }
+
+    /*
+     * Writes the checkpoint of an object at ticket, where save(std::ostream&) writes the object.
+     * Must be called between tryBeginCheckpoint() and endCheckpoint().
+     */
+    template<typename F> bool writeCheckpoint(const uint64_t ticket, F&& save) {
+        const std::string tmpPath = ckptPath(path) + ".tmp";
+        {
+            std::ofstream os(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!os) return false;
+            const Header header {MAGIC, ticket, sizeof(Slot), epoch};   // capacity holds the ticket
+            os.write((const char*)&header, sizeof(header));
+            save(os);
+            os.flush();
+            if (!os) return false;
+        }
+        int tfd = ::open(tmpPath.c_str(), O_RDONLY);
+        if (tfd >= 0) {
+            fsync(tfd);
+            ::close(tfd);
+        }
+        if (std::rename(tmpPath.c_str(), ckptPath(path).c_str()) != 0) return false;
+        syncDir(path);
+        uint64_t lticket = ckptTicket.load();
+        while (lticket < ticket && !ckptTicket.compare_exchange_weak(lticket, ticket));
+        lticket = durableTicket.load();
+        while (lticket < ticket && !durableTicket.compare_exchange_weak(lticket, ticket));
+        return true;
+    }
+
+    void endCheckpoint() { isCheckpointing.store(false, std::memory_order_release); }
+
+    // Writes the slot of the mutation with ticket. Waits if the slot is not yet covered by a checkpoint.
+    void write(const uint64_t ticket, const Entry& entry) {
+        while (isFull(ticket)) std::this_thread::yield();
+        Slot* slot = slotOf(ticket);
+        // A slow writer must not overwrite a newer ticket in the same slot, so the slot is claimed first
+        while (true) {
+            if (ticket <= ckptTicket.load()) return;
+            uint64_t old = __atomic_load_n(&slot->ticket, __ATOMIC_ACQUIRE);
+            if (old == BUSY) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (old >= ticket && slot->epoch == epoch) return;   // Slots of older epochs are free
+            if (__atomic_compare_exchange_n(&slot->ticket, &old, BUSY, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) break;
+        }
+        slot->epoch = epoch;
+        slot->hasDesc = entry.hasDesc ? 1 : 0;
+        std::memcpy(&slot->desc, &entry.desc, sizeof(D));
+        slot->check = checksum(slot, ticket);
+        __atomic_store_n(&slot->ticket, ticket, __ATOMIC_RELEASE);
+    }
+
+    // With syncCommit, waits until the mutation with ticket is synced to the file. Does nothing otherwise.
+    void waitDurable(const uint64_t ticket) {
+        if (!syncCommit) return;
+        while (durableTicket.load() < ticket) {
+            if (isFlushing.load() || isFlushing.exchange(true)) {
+                std::this_thread::yield();
+                continue;
+            }
+            const uint64_t first = durableTicket.load() + 1;
+            uint64_t last = first - 1;
+            while (last + 1 < first + capacity && isValid(slotOf(last+1), last+1, epoch)) last++;
+            if (last >= first) {
+                syncSlots(first, last);
+                uint64_t lticket = durableTicket.load();
+                while (lticket < last && !durableTicket.compare_exchange_weak(lticket, last));
+            }
+            isFlushing.store(false, std::memory_order_release);
+            if (last < ticket) std::this_thread::yield();
+        }
+    }
+
+    /*
+     * Loads the checkpoint at path.ckpt with load(std::istream&), which returns a new C,
+     * and applies replay(C*, const D&) for each mutation of the log after it.
+     * Returns nullptr if there is no valid checkpoint. lastTicket is the ticket of the last
+     * mutation applied, and numReplayed the number of slots after the checkpoint.
+     */
+    template<typename C, typename L, typename F>
+    static C* recover(const std::string& path, L&& load, F&& replay, uint64_t* lastTicket=nullptr, uint64_t* numReplayed=nullptr) {
+        std::ifstream is(ckptPath(path), std::ios::binary);
+        if (!is) return nullptr;
+        Header ckpt;
+        if (!is.read((char*)&ckpt, sizeof(ckpt)) || ckpt.magic != MAGIC || ckpt.slotSize != sizeof(Slot)) return nullptr;
+        C* obj = load(is);
+        if (obj == nullptr) return nullptr;
+        uint64_t ticket = ckpt.capacity;
+        const uint64_t ckptTicket = ticket;
+        int lfd = ::open(logPath(path).c_str(), O_RDONLY);
+        struct stat st;
+        if (lfd >= 0 && fstat(lfd, &st) == 0 && (size_t)st.st_size >= HEADER_SIZE) {
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, lfd, 0);
+            if (addr != MAP_FAILED) {
+                const Header* header = (const Header*)addr;
+                if (header->magic == MAGIC && header->slotSize == sizeof(Slot) && HEADER_SIZE + header->capacity*sizeof(Slot) <= (size_t)st.st_size) {
+                    const Slot* slots = (const Slot*)((const uint8_t*)addr + HEADER_SIZE);
+                    for (uint64_t n = 0; n < header->capacity; n++) {
+                        const Slot* slot = &slots[(ticket+1) % header->capacity];
+                        if (!isValid(slot, ticket+1, ckpt.epoch)) break;
+                        if (slot->hasDesc) replay(obj, slot->desc);
+                        ticket++;
+                    }
+                }
+                munmap(addr, st.st_size);
+            }
+        }
+        if (lfd >= 0) ::close(lfd);
+        if (lastTicket != nullptr) *lastTicket = ticket;
+        if (numReplayed != nullptr) *numReplayed = ticket - ckptTicket;
+        return obj;
+    }
+};
+
+#endif /* _MUTATION_LOG_H_ */
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _NODE_POOL_H_
+#define _NODE_POOL_H_
+
+#include <atomic>
+#include <new>
+#include <utility>
+
+/**
+ * <h1> Node Pool </h1>
+ *
+ * Per-thread free lists of nodes for the concurrent queues. The Hazard Pointers
+ * give the nodes that pass the scan to release() instead of deleting them, and
+ * the queue gets its new nodes from create(), so that in the steady state an
+ * enqueue-dequeue pair does no allocations.
+ *
+ * Each thread keeps at most MAX_LOCAL nodes. When it goes over, it moves BATCH
+ * nodes to the depot, and when it has no nodes it takes a batch from the depot,
+ * which is what keeps the nodes of a consumer flowing back to a producer. The
+ * depot is an array of slots with one batch each, which are filled with a CAS
+ * and emptied with an exchange, so there is no ABA and both operations are
+ * wait-free bounded by the number of slots. When the depot is full, the batch is
+ * freed.
+ *
+ * The nodes come from ::operator new(), the same as new T(), which means that a
+ * node from the pool can still be freed with delete, e.g. in the destructor of
+ * the queue.
+ */
+template<typename T>
+class NodePool {
+
+private:
+    static const int MAX_THREADS = 128;
+    static const int BATCH = 64;
+    static const int MAX_LOCAL = 2*BATCH;
+    static const int DEPOT_SLOTS = 2*MAX_THREADS;
+
+    struct FreeNode {
+        FreeNode* next;
+    };
+
+    struct alignas(128) LocalPool {
+        FreeNode* head {nullptr};
+        int       size {0};
+    };
+
+    LocalPool local[MAX_THREADS];
+    alignas(128) std::atomic<FreeNode*> depot[DEPOT_SLOTS];
+
+    static void freeList(FreeNode* node) {
+        while (node != nullptr) {
+            FreeNode* lnext = node->next;
+            ::operator delete(node);
+            node = lnext;
+        }
+    }
+
+    // Moves BATCH nodes from the local pool to an empty slot of the depot
+    void spill(const int tid) {
+        LocalPool& lpool = local[tid];
+        FreeNode* first = lpool.head;
+        FreeNode* last = first;
+        for (int i = 1; i < BATCH; i++) last = last->next;
+        lpool.head = last->next;
+        lpool.size -= BATCH;
+        last->next = nullptr;
+        for (int i = 0; i < DEPOT_SLOTS; i++) {
+            const int islot = (tid + i) % DEPOT_SLOTS;
+            if (depot[islot].load(std::memory_order_relaxed) != nullptr) continue;
+            FreeNode* lnull = nullptr;
+            if (depot[islot].compare_exchange_strong(lnull, first)) return;
+        }
+        freeList(first);
+    }
+
+    // Takes a batch from the depot, if there is one
+    void refill(const int tid) {
+        LocalPool& lpool = local[tid];
+        for (int i = 0; i < DEPOT_SLOTS; i++) {
+            const int islot = (tid + i) % DEPOT_SLOTS;
+            if (depot[islot].load(std::memory_order_relaxed) == nullptr) continue;
+            FreeNode* batch = depot[islot].exchange(nullptr);
+            if (batch == nullptr) continue;
+            lpool.head = batch;
+            lpool.size = BATCH;
+            return;
+        }
+    }
+
+public:
+    NodePool() {
+        for (int i = 0; i < DEPOT_SLOTS; i++) depot[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~NodePool() {
+        for (int it = 0; it < MAX_THREADS; it++) freeList(local[it].head);
+        for (int i = 0; i < DEPOT_SLOTS; i++) freeList(depot[i].load());
+    }
+
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+
+    /**
+     * Progress Condition: wait-free bounded (by DEPOT_SLOTS), unless it has to allocate
+     */
+    template<typename... Args> T* create(const int tid, Args&&... args) {
+        static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "Over-aligned nodes are not supported");
+        static_assert(sizeof(T) >= sizeof(FreeNode), "The node must fit a pointer");
+        LocalPool& lpool = local[tid];
+        if (lpool.head == nullptr) refill(tid);
+        if (lpool.head == nullptr) return new T(std::forward<Args>(args)...);
+        FreeNode* node = lpool.head;
+        lpool.head = node->next;
+        lpool.size--;
+        return new (node) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Called by the Hazard Pointers when no thread can access obj anymore
+     * Progress Condition: wait-free bounded (by DEPOT_SLOTS)
+     */
+    void release(T* obj, const int tid) {
+        obj->~T();
+        LocalPool& lpool = local[tid];
+        FreeNode* node = (FreeNode*)obj;
+        node->next = lpool.head;
+        lpool.head = node;
+        if (++lpool.size > MAX_LOCAL) spill(tid);
+    }
+};
+
+#endif /* _NODE_POOL_H_ */
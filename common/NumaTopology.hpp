@@ -0,0 +1,75 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _NUMA_TOPOLOGY_H_
+#define _NUMA_TOPOLOGY_H_
+
+#include <sched.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * <h1> NUMA Topology </h1>
+ *
+ * Maps each CPU to its NUMA node, reading /sys/devices/system/node/node*\/cpulist
+ * so that there is no dependency on libnuma.
+ * If the information is not available (or there is a single node), then all
+ * CPUs are placed in node zero.
+ * getNode() returns the node of the CPU where the calling thread is currently
+ * running, which may change if the thread is not pinned.
+ */
+class NumaTopology {
+
+private:
+    static const int MAX_NODES = 64;
+    int numNodes {1};
+    std::vector<int> cpuToNode;
+
+    // Parses a cpulist like "0-7,16-23"
+    void parseCpuList(const char* path, int node) {
+        FILE* f = fopen(path, "r");
+        if (f == nullptr) return;
+        int first, last;
+        char sep;
+        while (fscanf(f, "%d", &first) == 1) {
+            last = first;
+            sep = fgetc(f);
+            if (sep == '-') {
+                if (fscanf(f, "%d", &last) != 1) break;
+                sep = fgetc(f);
+            }
+            if (last >= (int)cpuToNode.size()) cpuToNode.resize(last+1, 0);
+            for (int cpu = first; cpu <= last; cpu++) cpuToNode[cpu] = node;
+            if (sep != ',') break;
+        }
+        fclose(f);
+    }
+
+public:
+    NumaTopology() {
+        for (int node = 0; node < MAX_NODES; node++) {
+            std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+            FILE* f = fopen(path.c_str(), "r");
+            if (f == nullptr) break;
+            fclose(f);
+            parseCpuList(path.c_str(), node);
+            numNodes = node+1;
+        }
+    }
+
+    int getNumNodes() const { return numNodes; }
+
+    int getNode() const {
+        const int cpu = sched_getcpu();
+        if (cpu < 0 || cpu >= (int)cpuToNode.size()) return 0;
+        return cpuToNode[cpu];
+    }
+};
+
+#endif /* _NUMA_TOPOLOGY_H_ */
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _PARALLEL_COPY_H_
+#define _PARALLEL_COPY_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * <h1> Cooperative copies of replicas </h1>
+ *
+ * With a large object, a copy of a replica takes a long time on one core while the
+ * other updaters spin, waiting for a Combined. If C has a method
+ *   void parallelCopy(const C& from, CopyJob& job)
+ * then CooperativeCopy::copy() makes the copy in work units: parallelCopy() sizes
+ * *this like 'from' and adds to the job the units that fill it (for example, ranges
+ * of a vector, or groups of subtrees), which must be independent of each other.
+ * The job is published, the copier runs units, and the updaters that are waiting
+ * call help() and steal units from it. The copier returns when all the units are
+ * done, so 'from' (which the copier keeps locked) outlives the units.
+ * The copier waits for the units that the helpers claimed, so a helper that is
+ * preempted stalls it: only CXMutationBlocking uses CooperativeCopy, the wait-free
+ * variants keep the serial copy.
+ *
+ * Only one copy at a time is published. A copier that finds another copy in progress
+ * runs all of its own units, which is the same as a copy without helpers.
+ * When C doesn't have parallelCopy(), copy() calls the fallback, i.e. the usual copy.
+ *
+ * CopyJob::addRanges() is a helper to split a contiguous array in chunks of about
+ * UNIT_BYTES bytes.
+ */
+class CopyJob {
+    std::vector<std::function<void()>> units;
+    std::atomic<size_t>                nextUnit {0};
+    std::atomic<size_t>                doneUnits {0};
+
+public:
+    static const size_t UNIT_BYTES = 256*1024;
+
+    // Must be called before the job is published
+    void add(std::function<void()> unit) { units.push_back(std::move(unit)); }
+
+    // Adds the units that copy-assign count elements from src to dst, in chunks of UNIT_BYTES
+    template<typename T> void addRanges(T* dst, const T* src, const size_t count) {
+        const size_t chunk = std::max<size_t>(1, UNIT_BYTES/sizeof(T));
+        for (size_t first = 0; first < count; first += chunk) {
+            const size_t n = std::min(chunk, count - first);
+            add([dst, src, first, n] () { std::copy(src + first, src + first + n, dst + first); });
+        }
+    }
+
+    size_t numUnits() const { return units.size(); }
+
+    // Claims and runs the next unit. Returns false if they were all claimed.
+    bool runOne() {
+        const size_t i = nextUnit.fetch_add(1);
+        if (i >= units.size()) return false;
+        units[i]();
+        doneUnits.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+    bool isDone() const { return doneUnits.load(std::memory_order_acquire) == units.size(); }
+};
+
+
+class CooperativeCopy {
+    std::shared_ptr<CopyJob> active;   // Accessed with std::atomic_load()/std::atomic_store()
+    std::atomic<bool>        hasActive {false};
+
+public:
+    template<typename C> struct IsParallel {
+        template<typename U> static auto test(int) -> decltype(std::declval<U&>().parallelCopy(std::declval<const U&>(), std::declval<CopyJob&>()), std::true_type{});
+        template<typename U> static std::false_type test(long);
+        static const bool value = decltype(test<C>(0))::value;
+    };
+
+    /*
+     * Returns a copy of 'from', reusing 'old' if it's not nullptr, with the units of
+     * C::parallelCopy() shared with the threads that call help(). Calls fallback()
+     * and returns its result if C doesn't have parallelCopy().
+     */
+    template<typename C, typename F> C* copy(const C& from, C* old, F&& fallback) {
+        if constexpr (!IsParallel<C>::value) {
+            return fallback();
+        } else {
+            C* to = (old == nullptr) ? new C() : old;
+            auto job = std::make_shared<CopyJob>();
+            to->parallelCopy(from, *job);
+            bool published = false;
+            if (job->numUnits() > 1 && !hasActive.load() && !hasActive.exchange(true)) {
+                std::atomic_store(&active, job);
+                published = true;
+            }
+            while (job->runOne());
+            while (!job->isDone()) std::this_thread::yield();   // Helpers are finishing their units
+            if (published) {
+                std::atomic_store(&active, std::shared_ptr<CopyJob>());
+                hasActive.store(false, std::memory_order_release);
+            }
+            return to;
+        }
+    }
+
+    // Called by updaters that are waiting: runs units of the copy in progress, if there is one
+    void help() {
+        if (!hasActive.load(std::memory_order_relaxed)) return;
+        std::shared_ptr<CopyJob> job = std::atomic_load(&active);
+        if (job == nullptr) return;
+        while (job->runOne());
+    }
+};
+
+#endif /* _PARALLEL_COPY_H_ */
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _PARKING_SPOT_H_
+#define _PARKING_SPOT_H_
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <ctime>
+#include <thread>
+
+/**
+ * <h1> Parking Spot </h1>
+ *
+ * Spin-then-park waiting for the blocking paths, for when there are more threads
+ * than cores and a spinning waiter takes the CPU away from the thread that holds
+ * the lock. A waiter calls waitUntil(cond): it tries cond() SPIN_TRIES times,
+ * yielding in between, and then parks on a futex until a waker calls wake().
+ * A waker calls wake() after making cond() true (unlocking), which is a single load
+ * when no thread is parked.
+ *
+ * No wakeup is lost: the waiter registers in numParked before it checks cond() one
+ * last time, and the futex word is read before that, so either the waiter sees the
+ * condition, or the waker sees numParked and changes the futex word, which makes
+ * the FUTEX_WAIT return right away. A parked thread also wakes up after PARK_TIMEOUT,
+ * in case the waker's condition was not the one it was waiting for.
+ *
+ * getNumParks() is the number of times a thread parked, and getNumWakes() the number
+ * of wake() that had to go to the kernel.
+ *
+ * The futex is process-private unless the ParkingSpot is built with shared=true,
+ * which is needed when it's in shared memory and the waiters can be in other
+ * processes (see SharedMemory.hpp).
+ */
+class ParkingSpot {
+
+public:
+    static const int SPIN_TRIES = 64;
+    static constexpr std::chrono::microseconds PARK_TIMEOUT {1000};
+
+private:
+    alignas(128) std::atomic<uint32_t> futexWord {0};
+    alignas(128) std::atomic<uint32_t> numParked {0};
+    std::atomic<uint64_t>              numParks {0};
+    std::atomic<uint64_t>              numWakes {0};
+    const int                          waitOp;
+    const int                          wakeOp;
+
+    static inline long futex(std::atomic<uint32_t>* addr, int op, uint32_t val, const struct timespec* timeout) {
+        return syscall(SYS_futex, (uint32_t*)addr, op, val, timeout, nullptr, 0);
+    }
+
+public:
+    ParkingSpot(const bool shared=false) :
+            waitOp{shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE}, wakeOp{shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE} { }
+
+    uint64_t getNumParks() const { return numParks.load(std::memory_order_relaxed); }
+    uint64_t getNumWakes() const { return numWakes.load(std::memory_order_relaxed); }
+
+    // Returns when cond() is true. Spins first, then parks.
+    template<typename F> void waitUntil(F&& cond) {
+        for (int i = 0; i < SPIN_TRIES; i++) {
+            if (cond()) return;
+            std::this_thread::yield();
+        }
+        while (true) {
+            const uint32_t word = futexWord.load();
+            numParked.fetch_add(1);
+            if (cond()) {
+                numParked.fetch_add(-1);
+                return;
+            }
+            parkOnce(word);
+            numParked.fetch_add(-1);
+            if (cond()) return;
+        }
+    }
+
+    /*
+     * For waiters that check a condition in their own loop: park() blocks until the next
+     * wake() (or the timeout) unless there was a wake() since prepare() returned word.
+     * The caller must have called registerParked() before the last check of its condition.
+     */
+    uint32_t prepare() const { return futexWord.load(); }
+    void registerParked() { numParked.fetch_add(1); }
+    void unregisterParked() { numParked.fetch_add(-1); }
+
+    void parkOnce(const uint32_t word) {
+        numParks.fetch_add(1, std::memory_order_relaxed);
+        const struct timespec timeout {0, (long)std::chrono::nanoseconds(PARK_TIMEOUT).count()};
+        futex(&futexWord, waitOp, word, &timeout);
+    }
+
+    // Wakes up all the parked threads, called after the condition they wait for may have changed
+    inline void wake() {
+        if (numParked.load() == 0) return;
+        futexWord.fetch_add(1);
+        numWakes.fetch_add(1, std::memory_order_relaxed);
+        futex(&futexWord, wakeOp, INT_MAX, nullptr);
+    }
+};
+
+#endif /* _PARKING_SPOT_H_ */
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _READ_ONCE_H_
+#define _READ_ONCE_H_
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+/**
+ * <h1> Read Once </h1>
+ *
+ * For the read-only functions that write their results in the memory of the caller
+ * instead of returning them, like the lookups of UCSet::containsMany(). When a reader
+ * can't get the shared lock, applyRead() enqueues the function as if it was a mutation
+ * (CXMutationWF does this after MAX_READ_TRIES), and then it runs on every replica
+ * that applies the node, possibly after the caller has returned.
+ *
+ * The function passed to applyRead() calls run(), which runs the lookups only the
+ * first time, and the caller calls wait() after applyRead() returns, which waits for
+ * that first run to finish. All the replicas give the same results for the ticket of
+ * the node, and so does the replica where the caller itself runs it. The state is
+ * shared with the copies of the function, which may outlive the caller.
+ * wait() doesn't wait at all unless applyRead() fell back to a mutation, and then
+ * only for the duration of the lookups on another thread.
+ */
+class ReadOnce {
+    static const int FREE = 0;
+    static const int RUNNING = 1;
+    static const int DONE = 2;
+
+    std::shared_ptr<std::atomic<int>> state {std::make_shared<std::atomic<int>>(FREE)};
+
+public:
+    template<typename F> inline void run(F&& func) const {
+        int expected = FREE;
+        if (state->load(std::memory_order_relaxed) != FREE || !state->compare_exchange_strong(expected, RUNNING)) return;
+        func();
+        state->store(DONE, std::memory_order_release);
+    }
+
+    inline void wait() const {
+        while (state->load(std::memory_order_acquire) != DONE) std::this_thread::yield();
+    }
+};
+
+#endif /* _READ_ONCE_H_ */
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _RESULT_SLOT_H_
+#define _RESULT_SLOT_H_
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+/**
+ * <h1> Result Slot </h1>
+ *
+ * Holds the result of a mutation in the nodes of the Universal Constructs.
+ * The same mutation can be applied by several threads, each on its own copy of
+ * the object, and all of them will try to store the same result in the slot.
+ *
+ * When R is trivially copyable and fits in 8 bytes, the slot is a plain
+ * (relaxed) std::atomic<R> and the write-races are harmless.
+ *
+ * Otherwise, the result is stored in a cache-aligned buffer which is written
+ * only once: the first thread to store() claims the slot with a CAS, copies the
+ * value and then publishes it by setting the state to READY. Other writers
+ * return immediately. A load() waits until the value is READY, which takes a
+ * bounded number of steps unless the thread that claimed the slot is preempted
+ * in the middle of copying the value.
+ */
+template<typename R, bool Inline = std::is_trivially_copyable<R>::value && sizeof(R) <= sizeof(uint64_t)>
+struct ResultSlot;
+
+template<typename R>
+struct ResultSlot<R, true> {
+    std::atomic<R> result;
+
+    inline void store(R value) {
+        result.store(value, std::memory_order_relaxed);
+    }
+
+    inline R load() const {
+        return result.load();
+    }
+};
+
+template<typename R>
+struct alignas(64) ResultSlot<R, false> {
+    static const int EMPTY   = 0;
+    static const int WRITING = 1;
+    static const int READY   = 2;
+
+    std::atomic<int> state {EMPTY};
+    alignas(R) unsigned char buffer[sizeof(R)];
+
+    ResultSlot() { }
+    ResultSlot(const ResultSlot&) = delete;
+
+    ~ResultSlot() {
+        if (state.load(std::memory_order_relaxed) == READY) reinterpret_cast<R*>(buffer)->~R();
+    }
+
+    inline void store(const R& value) { emplace(value); }
+
+    inline void store(R&& value) { emplace(std::move(value)); }
+
+    inline R load() const {
+        while (state.load(std::memory_order_acquire) != READY) std::this_thread::yield();
+        return *reinterpret_cast<const R*>(buffer);
+    }
+
+private:
+    template<typename T> inline void emplace(T&& value) {
+        if (state.load(std::memory_order_relaxed) != EMPTY) return;
+        int tmp = EMPTY;
+        if (!state.compare_exchange_strong(tmp, WRITING)) return;
+        new (buffer) R(std::forward<T>(value));
+        state.store(READY, std::memory_order_release);
+    }
+};
+
+#endif /* _RESULT_SLOT_H_ */
@@ -0,0 +1,188 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _SHARDED_UNIVERSAL_CONSTRUCT_H_
+#define _SHARDED_UNIVERSAL_CONSTRUCT_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../common/ThreadRegistry.hpp"
+
+// Shard of a key, from the high bits of std::hash<K> times the golden ratio
+template<typename K>
+struct HashPartition {
+    inline int operator()(const K& key, const int numShards) const {
+        const uint64_t h = (uint64_t)std::hash<K>{}(key) * 0x9E3779B97F4A7C15ULL;
+        return (int)((h >> 32) % numShards);
+    }
+};
+
+
+/**
+ * <h1> Sharded Universal Construct (Sets) </h1>
+ *
+ * Same interface as UCSet, but the keys are partitioned across numShards
+ * independent instances of UC, each with its own SET, queue of mutations and
+ * replicas. A mutation copies only the replica of its shard, which is about
+ * 1/numShards of the set, and the mutations on different shards don't wait for
+ * each other.
+ *
+ * PARTITION maps a key to its shard. The default, HashPartition, mixes the bits of
+ * std::hash<K> so that the keys of a shard don't all fall in the same buckets when
+ * SET is itself a hash set. A range partition does the same with a functor that
+ * returns the index of the range of the key.
+ *
+ * Each operation on a single key is linearizable, like in UCSet. The operations on
+ * multiple shards (addAll(), iterateAll() and iterate()) are done shard by shard, so
+ * each shard is seen at a single point in time, but not all the shards at the same
+ * point. iterateAllSnapshot() and iterateSnapshot() take the snapshots of all the
+ * shards before visiting any key, which keeps that window short.
+ */
+template<typename UC, typename SET, typename K, typename PARTITION = HashPartition<K>>
+class ShardedUC {
+private:
+    static const int MAX_THREADS = 128;
+    static const int DEFAULT_SHARDS = 8;
+    const int maxThreads;
+    const int numShards;
+    PARTITION partition {};
+    UC** shards;
+
+    inline UC* shardOf(const K& key) const { return shards[partition(key, numShards)]; }
+
+    // Orders the keys of iterate(): first the ones from beginkey upwards, then the ones that wrapped around
+    static void sortFrom(std::vector<K>& keys, const K& beginkey) {
+        std::sort(keys.begin(), keys.end(), [&beginkey] (const K& a, const K& b) {
+            const bool awrap = a < beginkey;
+            const bool bwrap = b < beginkey;
+            if (awrap != bwrap) return bwrap;
+            return a < b;
+        });
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    }
+
+    static bool visit(std::function<bool(K*)>& itfun, std::vector<K>& keys, uint64_t itersize) {
+        for (uint64_t i = 0; i < keys.size() && i < itersize; i++) {
+            if (!itfun(&keys[i])) return false;
+        }
+        return true;
+    }
+
+public:
+    ShardedUC(const int maxThreads=MAX_THREADS, const int numShards=DEFAULT_SHARDS) : maxThreads{maxThreads}, numShards{numShards} {
+        shards = new UC*[numShards];
+        for (int i = 0; i < numShards; i++) shards[i] = new UC(new SET(), maxThreads);
+    }
+
+    ~ShardedUC() {
+        for (int i = 0; i < numShards; i++) delete shards[i];
+        delete[] shards;
+    }
+
+    std::string className() { return "Sharded" + std::to_string(numShards) + "-" + UC::className() + SET::className(); }
+
+    // Sum of the statistics of all the shards, for the UCs that have stats()
+    template<typename U = UC> auto stats() const -> decltype(std::declval<const U&>().stats()) {
+        decltype(std::declval<const U&>().stats()) snap {};
+        for (int i = 0; i < numShards; i++) snap += shards[i]->stats();
+        return snap;
+    }
+
+    bool add(K key, const int tid) {
+        return shardOf(key)->applyUpdate([key] (SET* set) { return set->add(key); }, tid);
+    }
+
+    bool remove(K key, const int tid) {
+        return shardOf(key)->applyUpdate([key] (SET* set) { return set->remove(key); }, tid);
+    }
+
+    bool contains(K key, const int tid) {
+        return shardOf(key)->applyRead([key] (SET* set) { return set->contains(key); }, tid);
+    }
+
+    // Visits the keys shard by shard, so they're ordered only within each shard
+    bool iterateAll(std::function<bool(K*)> itfun, const int tid) {
+        for (int i = 0; i < numShards; i++) {
+            if (!shards[i]->applyRead([&itfun] (SET* set) { return set->iterateAll(itfun); }, tid)) return false;
+        }
+        return true;
+    }
+
+    /*
+     * The keys are spread over all the shards, so this takes up to itersize keys from
+     * beginkey on each shard and merges them, which gives the same keys in the same
+     * order as SET::iterate() on the whole set, unless the set has less than itersize keys.
+     */
+    bool iterate(std::function<bool(K*)> itfun, const int tid, uint64_t itersize, K beginkey) {
+        std::vector<K> keys;
+        for (int i = 0; i < numShards; i++) {
+            // A read that falls back to a mutation may be applied again on other replicas after it returns
+            std::shared_ptr<std::vector<K>> lkeys = std::make_shared<std::vector<K>>();
+            shards[i]->applyRead([lkeys,itersize,beginkey] (SET* set) {
+                lkeys->clear();
+                return set->iterate([&lkeys] (K* key) { lkeys->push_back(*key); return true; }, itersize, beginkey);
+            }, tid);
+            keys.insert(keys.end(), lkeys->begin(), lkeys->end());
+        }
+        sortFrom(keys, beginkey);
+        return visit(itfun, keys, itersize);
+    }
+
+    // Same as iterateAll() and iterate(), on snapshots of all the shards (only for UCs with snapshot(), like CXMutationWF)
+    bool iterateAllSnapshot(std::function<bool(K*)> itfun, const int tid) {
+        std::vector<decltype(shards[0]->snapshot(tid))> snaps;
+        snaps.reserve(numShards);
+        for (int i = 0; i < numShards; i++) snaps.push_back(shards[i]->snapshot(tid));
+        for (auto& snap : snaps) {
+            if (!snap->iterateAll(itfun)) return false;
+        }
+        return true;
+    }
+
+    bool iterateSnapshot(std::function<bool(K*)> itfun, const int tid, uint64_t itersize, K beginkey) {
+        std::vector<decltype(shards[0]->snapshot(tid))> snaps;
+        snaps.reserve(numShards);
+        for (int i = 0; i < numShards; i++) snaps.push_back(shards[i]->snapshot(tid));
+        std::vector<K> keys;
+        for (auto& snap : snaps) {
+            snap->iterate([&keys] (K* key) { keys.push_back(*key); return true; }, itersize, beginkey);
+        }
+        sortFrom(keys, beginkey);
+        return visit(itfun, keys, itersize);
+    }
+
+    // One mutation per shard, with the keys of that shard
+    void addAll(K** keys, const int size, const int tid) {
+        std::vector<std::vector<K*>> shardKeys(numShards);
+        for (int i = 0; i < size; i++) shardKeys[partition(*keys[i], numShards)].push_back(keys[i]);
+        for (int ishard = 0; ishard < numShards; ishard++) {
+            std::vector<K*>& lkeys = shardKeys[ishard];
+            if (lkeys.empty()) continue;
+            // The mutation is applied again on the other replicas, so it must own its keys
+            shards[ishard]->applyUpdate([lkeys = std::move(lkeys)] (SET* set) {
+                for (K* key : lkeys) set->add(*key);
+                return true;
+            }, tid);
+        }
+    }
+
+    int getNumShards() const { return numShards; }
+
+    // Same as above, with the tid that the ThreadRegistry assigned to the calling thread
+    bool add(K key)      { return add(key, ThreadRegistry::getTID()); }
+    bool remove(K key)   { return remove(key, ThreadRegistry::getTID()); }
+    bool contains(K key) { return contains(key, ThreadRegistry::getTID()); }
+};
+
+#endif /* _SHARDED_UNIVERSAL_CONSTRUCT_H_ */
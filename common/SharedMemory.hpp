@@ -0,0 +1,307 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _SHARED_MEMORY_H_
+#define _SHARED_MEMORY_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * <h1> Shared memory segment for the Universal Constructs </h1>
+ *
+ * Lets several processes use the same instance of CXMutationWF, instead of each process
+ * keeping its own copy of the data. The process that creates the segment constructs the
+ * Universal Construct in it and does the updates, and the processes that attach the
+ * segment (or that were forked after it was created) call applyReadAttached(), which
+ * reads the replica of curComb in place, with no copy and no serialization.
+ *
+ * The segment is a POSIX shared memory object that is mapped at the same address in all
+ * the processes, so the pointers of the Universal Construct and of the replicas are valid
+ * in all of them and the sequential data structures don't need offset-based pointers.
+ * create() and attach() fail if that address is already in use in the process.
+ *
+ * With SharedReplicas as the ALLOC policy of CXMutationWF, the segment has:
+ * - the instance of the Universal Construct, made with construct() and published with setRoot();
+ * - the Combined instances and the read indicators of their rwLocks;
+ * - the replicas, all the memory of C must come from SharedAllocator, for example
+ *   TreeSet<K,SharedAllocator<K>>, and the keys must not point to the memory of a process.
+ * The nodes of the Turn queue, the hazard pointers and the rest of the state of the updaters
+ * are in the heap of the process that created the segment. A mutation is a callable of that
+ * process, it can't run in another one, which is why only that process calls applyUpdate()
+ * and applyRead(), and why applyReadAttached() never enqueues the read as a mutation.
+ *
+ * The read indicators are indexed by tid: the tids of all the processes must be distinct
+ * and lower than the maxThreads of the Universal Construct.
+ *
+ * The allocator bumps a pointer, with free lists for the small sizes (like Arena) and a
+ * list of the larger blocks, which are reused by the allocations that fit in them without
+ * being split nor coalesced. It's protected by a spin lock in the segment, taken only by
+ * the updaters when the mutations and the copies allocate or free memory.
+ * A process has at most one segment, the current one, where SharedAllocator allocates.
+ * The process that creates the segment makes it current, attach() doesn't because the
+ * readers don't allocate. SharedAllocator uses the global allocator when there is no
+ * current segment and frees to the global allocator the memory that isn't in the segment,
+ * so the same container type can also be used outside of it.
+ */
+class SharedSegment {
+
+private:
+    static const uint64_t MAGIC = 0x43585348414D454DULL;
+    static const size_t ALIGN = 64;
+    static const size_t SMALL_STEP = 16;
+    static const size_t NUM_SMALL = 32;             // Free lists for sizes up to SMALL_STEP*NUM_SMALL bytes
+
+    struct FreeBlock {
+        FreeBlock* next;
+        size_t     bytes;
+    };
+
+    // At the start of the segment
+    struct Header {
+        std::atomic<uint64_t> magic {0};            // Set last by create()
+        char*                 base;
+        size_t                bytes;
+        std::atomic<bool>     locked {false};
+        char*                 cur;
+        FreeBlock*            freeLists[NUM_SMALL];
+        FreeBlock*            largeBlocks {nullptr};
+        std::atomic<void*>    root {nullptr};
+
+        Header(char* base, size_t bytes) : base{base}, bytes{bytes} {
+            cur = base + ((sizeof(Header) + ALIGN - 1) & ~(ALIGN - 1));
+            for (size_t i = 0; i < NUM_SMALL; i++) freeLists[i] = nullptr;
+        }
+    };
+
+    Header*     header;
+
+    static inline SharedSegment*& currentRef() {
+        static SharedSegment* current = nullptr;
+        return current;
+    }
+
+    SharedSegment(Header* header) : header{header} { }
+
+    // Maps the object of fd at addr, or returns nullptr
+    static char* map(int fd, size_t bytes, void* addr) {
+#ifdef MAP_FIXED_NOREPLACE
+        const int flags = MAP_SHARED | MAP_FIXED_NOREPLACE;
+#else
+        const int flags = MAP_SHARED;
+#endif
+        void* ptr = mmap(addr, bytes, PROT_READ | PROT_WRITE, flags, fd, 0);
+        if (ptr == MAP_FAILED) return nullptr;
+        if (ptr != addr) {       // Without MAP_FIXED_NOREPLACE addr is only a hint
+            munmap(ptr, bytes);
+            return nullptr;
+        }
+        return (char*)ptr;
+    }
+
+    void lock() {
+        while (header->locked.load(std::memory_order_relaxed) || header->locked.exchange(true, std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+
+    void unlock() { header->locked.store(false, std::memory_order_release); }
+
+public:
+    static void* defaultAddr() { return (void*)0x500000000000ULL; }
+
+    // Creates and maps the segment 'name' (e.g. "/cx-set") and makes it the current segment, or returns nullptr
+    static SharedSegment* create(const std::string& name, const size_t bytes, void* addr=defaultAddr()) {
+        if (currentRef() != nullptr) return nullptr;
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) return nullptr;
+        char* base = (ftruncate(fd, bytes) == 0) ? map(fd, bytes, addr) : nullptr;
+        close(fd);
+        if (base == nullptr) {
+            shm_unlink(name.c_str());
+            return nullptr;
+        }
+        Header* header = new (base) Header(base, bytes);
+        header->magic.store(MAGIC, std::memory_order_release);
+        currentRef() = new SharedSegment(header);
+        return currentRef();
+    }
+
+    // Maps the segment 'name' that another process created with the same addr, or returns nullptr
+    static SharedSegment* attach(const std::string& name, void* addr=defaultAddr()) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) return nullptr;
+        struct stat st;
+        char* base = (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Header)) ? map(fd, st.st_size, addr) : nullptr;
+        close(fd);
+        if (base == nullptr) return nullptr;
+        Header* header = (Header*)base;
+        if (header->magic.load(std::memory_order_acquire) != MAGIC || header->base != base) {
+            munmap(base, st.st_size);
+            return nullptr;
+        }
+        return new SharedSegment(header);
+    }
+
+    // Removes the name of the segment, the memory is freed when all the processes have unmapped it
+    static bool unlink(const std::string& name) { return shm_unlink(name.c_str()) == 0; }
+
+    static inline SharedSegment* current() { return currentRef(); }
+
+    // Unmaps the segment, the objects in it must not be used anymore by this process
+    ~SharedSegment() {
+        if (currentRef() == this) currentRef() = nullptr;
+        munmap(header->base, header->bytes);
+    }
+
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+
+    inline bool contains(const void* ptr) const {
+        return (const char*)ptr >= header->base && (const char*)ptr < header->base + header->bytes;
+    }
+
+    // Returns nullptr if the segment is full
+    void* allocate(size_t bytes, size_t align) {
+        if (bytes == 0) bytes = 1;
+        if (align < SMALL_STEP) align = SMALL_STEP;
+        const size_t iclass = (bytes + SMALL_STEP - 1) / SMALL_STEP - 1;
+        if (iclass < NUM_SMALL) bytes = (iclass + 1) * SMALL_STEP;
+        lock();
+        void* ptr = nullptr;
+        if (iclass < NUM_SMALL && align == SMALL_STEP && header->freeLists[iclass] != nullptr) {
+            FreeBlock* block = header->freeLists[iclass];
+            header->freeLists[iclass] = block->next;
+            ptr = block;
+        } else if (iclass >= NUM_SMALL) {
+            for (FreeBlock** prev = &header->largeBlocks; *prev != nullptr; prev = &(*prev)->next) {
+                FreeBlock* block = *prev;
+                if (block->bytes < bytes || ((uintptr_t)block & (align - 1)) != 0) continue;
+                *prev = block->next;
+                ptr = block;
+                break;
+            }
+        }
+        if (ptr == nullptr) {
+            char* lcur = (char*)(((uintptr_t)header->cur + align - 1) & ~(uintptr_t)(align - 1));
+            if (lcur + bytes <= header->base + header->bytes) {
+                header->cur = lcur + bytes;
+                ptr = lcur;
+            }
+        }
+        unlock();
+        return ptr;
+    }
+
+    void deallocate(void* ptr, size_t bytes) {
+        if (bytes == 0) bytes = 1;
+        const size_t iclass = (bytes + SMALL_STEP - 1) / SMALL_STEP - 1;
+        FreeBlock* block = (FreeBlock*)ptr;
+        block->bytes = bytes;
+        lock();
+        FreeBlock** list = (iclass < NUM_SMALL) ? &header->freeLists[iclass] : &header->largeBlocks;
+        block->next = *list;
+        *list = block;
+        unlock();
+    }
+
+    template<typename T, typename... Args> T* construct(Args&&... args) {
+        void* ptr = allocate(sizeof(T), alignof(T));
+        if (ptr == nullptr) throw std::bad_alloc();
+        return new (ptr) T(std::forward<Args>(args)...);
+    }
+
+    template<typename T> void destroy(T* obj) {
+        if (obj == nullptr) return;
+        obj->~T();
+        deallocate(obj, sizeof(T));
+    }
+
+    // The object that the other processes look up after attach(), usually the Universal Construct
+    void setRoot(void* obj) { header->root.store(obj, std::memory_order_release); }
+
+    template<typename T> T* getRoot() const { return (T*)header->root.load(std::memory_order_acquire); }
+
+    // Bytes used by the bump allocator, including the free blocks
+    size_t used() const { return header->cur - header->base; }
+
+    size_t capacity() const { return header->bytes; }
+};
+
+
+// Allocator for the sequential containers and the Universal Construct, from the current segment if there is one
+template<typename T>
+class SharedAllocator {
+public:
+    using value_type = T;
+
+    SharedAllocator() noexcept { }
+    template<typename U> SharedAllocator(const SharedAllocator<U>&) noexcept { }
+
+    T* allocate(size_t n) {
+        SharedSegment* segment = SharedSegment::current();
+        if (segment == nullptr) return std::allocator<T>().allocate(n);
+        T* ptr = (T*)segment->allocate(n*sizeof(T), alignof(T));
+        if (ptr == nullptr) throw std::bad_alloc();
+        return ptr;
+    }
+
+    void deallocate(T* ptr, size_t n) {
+        SharedSegment* segment = SharedSegment::current();
+        if (segment == nullptr || !segment->contains(ptr)) return std::allocator<T>().deallocate(ptr, n);
+        segment->deallocate(ptr, n*sizeof(T));
+    }
+
+    template<typename U> bool operator==(const SharedAllocator<U>&) const noexcept { return true; }
+    template<typename U> bool operator!=(const SharedAllocator<U>&) const noexcept { return false; }
+};
+
+
+// ALLOC policy of CXMutationWF that places the replicas, the Combined instances and their read indicators in the current segment
+class SharedReplicas {
+public:
+    static const bool enabled = false;      // The replicas are not in an Arena
+
+    template<typename T> using Allocator = SharedAllocator<T>;
+
+    template<typename C> static C* adopt(C* inst) {
+        C* obj = copy(*inst, (C*)nullptr);
+        delete inst;
+        return obj;
+    }
+
+    template<typename C> static C* copy(const C& from, C* old) {
+        destroy(old);
+        C* obj = SharedAllocator<C>().allocate(1);
+        return new (obj) C(from);
+    }
+
+    template<typename C> static C* refresh(const C& from, const uint64_t fromTicket, C* old, const uint64_t oldTicket) {
+        return copy(from, old);
+    }
+
+    template<typename C> static void destroy(C* obj) {
+        if (obj == nullptr) return;
+        obj->~C();
+        SharedAllocator<C>().deallocate(obj, 1);
+    }
+
+    template<typename C, typename F> static inline auto apply(C* obj, F& func) { return func(obj); }
+};
+
+#endif /* _SHARED_MEMORY_H_ */
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _STRONG_TRY_COUNTER_RW_LOCK_H_
+#define _STRONG_TRY_COUNTER_RW_LOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * <h1> Strong Try Reader-Writer Lock with a single word </h1>
+ *
+ * The same interface and the same states as StrongTryRIRWLock (without HLOCK), but the
+ * read indicator is a counter in the same 64 bit word as the state, which makes the lock
+ * 8 bytes instead of one cache line per thread. It's meant for objects that exist in
+ * large numbers (see CXMutationWFLite), where the readers of one object are few and
+ * the contention on the counter doesn't matter.
+ *
+ * The low 56 bits are the number of readers and the high bits are the state:
+ * - NOLOCK: readers and writers may acquire the lock;
+ * - RLOCK:  only readers may acquire the lock (downgraded, or the curComb of a CX);
+ * - WLOCK:  a writer holds the lock in exclusive mode;
+ *
+ * The try-locks are strong: sharedTryLock() fails only when there is a writer holding
+ * the lock, and exclusiveTryLock() fails only when another thread holds the lock, or is
+ * in the middle of a sharedTryLock(). A reader that finds WLOCK rolls back its increment.
+ * Like the RI lock, it's reader-preference.
+ *
+ * Progress Condition of all methods: wait-free population oblivious
+ */
+class StrongTryCounterRWLock {
+
+private:
+    static const uint64_t RLOCK = 1ULL << 56;
+    static const uint64_t WLOCK = 2ULL << 56;
+
+    std::atomic<uint64_t> word {0};
+
+public:
+    static std::string className() { return "StrongTryCounterRWLock"; }
+
+    inline bool sharedTryLock(const int tid) noexcept {
+        if (word.fetch_add(1) & WLOCK) {
+            word.fetch_add(-1);
+            return false;
+        }
+        return true;
+    }
+
+    inline void sharedUnlock(const int tid) noexcept {
+        word.fetch_add(-1);
+    }
+
+    inline bool exclusiveTryLock(const int tid) noexcept {
+        uint64_t w = word.load();
+        if (w != 0) return false;
+        return word.compare_exchange_strong(w, WLOCK);
+    }
+
+    inline void exclusiveUnlock() noexcept {
+        word.fetch_add(-WLOCK);
+    }
+
+    inline void setReadLock() noexcept {
+        word.fetch_add(RLOCK);
+    }
+
+    inline void setReadUnlock() noexcept {
+        word.fetch_add(-RLOCK);
+    }
+
+    // WLOCK -> RLOCK, the readers that are rolling back their increment are not affected
+    inline void downgrade() noexcept {
+        word.fetch_add(RLOCK - WLOCK);
+    }
+};
+
+#endif /* _STRONG_TRY_COUNTER_RW_LOCK_H_ */
@@ -30,9 +30,14 @@
 #ifndef _STRONG_TRY_READ_INDICATOR_READER_WRITER_LOCK_H_
 #define _STRONG_TRY_READ_INDICATOR_READER_WRITER_LOCK_H_
 
+#include <algorithm>
 #include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
 #include <string>
 #include <thread>
+#include "ThreadCount.hpp"
 
 /**
  * <h1> Try-Lock Reader-Preference with Intermediate states - TryRWLockFRThreeState</h1>
@@ -57,10 +62,26 @@
  * - seq || WLOCK -> seq || RLOCK:      A writer is unlocking but only allowing readers to enter;
  * - seq || RLOCK -> seq || NOLOCK:     A writer has unlocked and now allows both readers and writers to acquire the lock
  *
+ * Writer-preference mode:
+ * By default the lock is reader-preference, a reader that finds HLOCK will cancel
+ * it and a writer may fail an unbounded number of times under constant reader
+ * pressure. When maxCancels is non-zero, readers stop cancelling HLOCK after
+ * maxCancels consecutive cancellations (the count is reset each time a writer
+ * gets WLOCK) and instead give up on their sharedTryLock(), letting the writer
+ * in. The try-locks stay strong: a sharedTryLock() fails only when there is a
+ * writer holding or attempting to hold the lock.
+ * getNumCancels() returns the total number of times that a reader cancelled a writer.
+ *
+ * MAX_T fixes the number of threads at compile time (see ThreadCount.hpp), which
+ * gives the scans of the read indicator a constant bound.
+ *
+ * The arrays of the read indicator are allocated with ALLOC, e.g. SharedAllocator
+ * to place them in shared memory with the lock (see SharedMemory.hpp).
  *
  * @author Andreia Correia
  * @author Pedro Ramalhete
  */
+template<int MAX_T = 0, template<typename> class ALLOC = std::allocator>
 class StrongTryRIRWLock {
 
 private:
@@ -81,34 +102,63 @@ private:
 
 
     // Customized ReadIndicator
+    // When threadsPerGroup is non-zero, each group of threadsPerGroup threads (by tid) also has a
+    // counter of the threads in the group that are not NOT_READING. isEmpty() only has to scan the
+    // counters and abortRollback() only has to scan the states in the groups that are not empty,
+    // at the cost of one more atomic increment/decrement for the readers.
     class RIStaticPerThread {
 
     private:
-        const int maxThreads;
+        const ThreadCount<MAX_T> maxThreads;
+        const int threadsPerGroup;
+        const int numGroups;
         alignas(128) std::atomic<uint64_t>* states;
+        std::atomic<int64_t>*               groups {nullptr};
 
         static const uint64_t NOT_READING = 0;
         static const uint64_t READING = 1;
         static const int CLPAD = 128/sizeof(uint64_t);
 
-    public:
-        RIStaticPerThread(int maxThreads) : maxThreads{maxThreads} {
-            states = new std::atomic<uint64_t>[maxThreads*CLPAD];
-            for (int tid = 0; tid < maxThreads; tid++) {
-                states[tid*CLPAD].store(NOT_READING, std::memory_order_relaxed);
+        inline void groupArrive(const int tid) noexcept {
+            if (numGroups != 0) groups[(tid/threadsPerGroup)*CLPAD].fetch_add(1);
+        }
+
+        inline void groupDepart(const int tid) noexcept {
+            if (numGroups != 0) groups[(tid/threadsPerGroup)*CLPAD].fetch_add(-1);
+        }
+
+        inline void abortRollback(int firstTid, int lastTid) noexcept {
+            for (int tid = firstTid; tid < lastTid; tid++) {
+                if (states[tid*CLPAD].load() != READING) continue;
+                uint64_t read = READING;
+                states[tid*CLPAD].compare_exchange_strong(read, READING+1);
             }
         }
 
+    public:
+        RIStaticPerThread(int numThreads, int threadsPerGroup=0) : maxThreads{numThreads}, threadsPerGroup{threadsPerGroup},
+                numGroups{threadsPerGroup == 0 ? 0 : (maxThreads+threadsPerGroup-1)/threadsPerGroup} {
+            states = ALLOC<std::atomic<uint64_t>>().allocate(maxThreads*CLPAD);
+            for (int i = 0; i < maxThreads*CLPAD; i++) new (&states[i]) std::atomic<uint64_t>(NOT_READING);
+            if (numGroups == 0) return;
+            groups = ALLOC<std::atomic<int64_t>>().allocate(numGroups*CLPAD);
+            for (int i = 0; i < numGroups*CLPAD; i++) new (&groups[i]) std::atomic<int64_t>(0);
+        }
+
         ~RIStaticPerThread() {
-            delete[] states;
+            ALLOC<std::atomic<uint64_t>>().deallocate(states, maxThreads*CLPAD);
+            if (groups != nullptr) ALLOC<std::atomic<int64_t>>().deallocate(groups, numGroups*CLPAD);
         }
 
         // Will attempt to pass all current READING states to
         inline void abortRollback() noexcept {
-            for (int tid = 0; tid < maxThreads; tid++) {
-                if (states[tid*CLPAD].load() != READING) continue;
-                uint64_t read = READING;
-                states[tid*CLPAD].compare_exchange_strong(read, READING+1);
+            if (numGroups == 0) {
+                abortRollback(0, maxThreads);
+                return;
+            }
+            for (int ig = 0; ig < numGroups; ig++) {
+                if (groups[ig*CLPAD].load() == 0) continue;
+                abortRollback(ig*threadsPerGroup, std::min((int)maxThreads, (ig+1)*threadsPerGroup));
             }
         }
 
@@ -116,18 +166,30 @@ private:
         // If there was a writer changing the state to READING+1 then it will
         // return false, meaning that the arrive() is still valid and visible.
         inline bool rollbackArrive(const int tid) noexcept {
-            return (states[tid*CLPAD].fetch_add(-1) == READING);
+            if (states[tid*CLPAD].fetch_add(-1) != READING) return false;
+            groupDepart(tid);
+            return true;
         }
 
+        // The group counter must be incremented before the state, otherwise a
+        // writer could miss this state in abortRollback()
         inline void arrive(const int tid) noexcept {
+            groupArrive(tid);
             states[tid*CLPAD].store(READING);
         }
 
         inline void depart(const int tid) noexcept {
             states[tid*CLPAD].store(NOT_READING); // Making this "memory_order_release" will cause overflows!
+            groupDepart(tid);
         }
 
         inline bool isEmpty() noexcept {
+            if (numGroups != 0) {
+                for (int ig = 0; ig < numGroups; ig++) {
+                    if (groups[ig*CLPAD].load() != 0) return false;
+                }
+                return true;
+            }
             for (int tid = 0; tid < maxThreads; tid++) {
                 if (states[tid*CLPAD].load() != NOT_READING) return false;
             }
@@ -136,17 +198,42 @@ private:
     };
 
 
-    const int maxThreads;
+    const ThreadCount<MAX_T> maxThreads;
+    const uint64_t maxCancels;  // Zero means reader-preference
 
     // ReadIndicator
-    RIStaticPerThread ri {maxThreads};
+    RIStaticPerThread ri;
 
     alignas(128) std::atomic<StructData> wstate {{0,NOLOCK}};
+    alignas(128) std::atomic<uint64_t>   consecutiveCancels {0};  // Since the last time a writer got WLOCK
+    std::atomic<uint64_t>                numCancels {0};
+
+    // A reader has found HLOCK
+    inline bool mayCancel() noexcept {
+        return maxCancels == 0 || consecutiveCancels.load(std::memory_order_relaxed) < maxCancels;
+    }
+
+    inline void onCancel() noexcept {
+        numCancels.fetch_add(1, std::memory_order_relaxed);
+        if (maxCancels != 0) consecutiveCancels.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    inline bool onWLock() noexcept {
+        if (maxCancels != 0 && consecutiveCancels.load(std::memory_order_relaxed) != 0) consecutiveCancels.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
 public:
     /**
      * Default constructor
+     * numThreads is the number of threads (tids) that may use this lock.
+     * With threadsPerGroup non-zero, the read indicator is split in groups of
+     * threadsPerGroup threads (see RIStaticPerThread) which makes the scans done
+     * by writers O(maxThreads/threadsPerGroup) instead of O(maxThreads).
+     * With maxCancels non-zero, the lock is in writer-preference mode.
      */
-    StrongTryRIRWLock(int maxThreads) : maxThreads{maxThreads} {
+    StrongTryRIRWLock(int numThreads, int threadsPerGroup=0, uint64_t maxCancels=0) :
+            maxThreads{numThreads}, maxCancels{maxCancels}, ri{maxThreads, threadsPerGroup} {
     }
 
     ~StrongTryRIRWLock() {
@@ -154,17 +241,55 @@ public:
 
     static std::string className() { return "StrongTryRWLock"; }
 
+    // Total number of times a reader has cancelled a writer in HLOCK
+    uint64_t getNumCancels() const { return numCancels.load(std::memory_order_relaxed); }
+
     inline bool sharedTryLock(const int tid) noexcept {
-        if (wstate.load().state == WLOCK) return false; // There is a writer
+        const uint64_t state = wstate.load().state;
+        if (state == WLOCK) return false; // There is a writer
+        if (state == HLOCK && !mayCancel()) return false;
         ri.arrive(tid);
         StructData ws = wstate.load();
         if (ws.state == HLOCK) {
-            if (wstate.compare_exchange_strong(ws, {ws.seq,NOLOCK})) return true;
+            if (!mayCancel()) return !ri.rollbackArrive(tid); // Writer-preference: let the writer in
+            if (wstate.compare_exchange_strong(ws, {ws.seq,NOLOCK})) {
+                onCancel();
+                return true;
+            }
             ws = wstate.load();
         }
         return (ws.state != WLOCK || !ri.rollbackArrive(tid));
     }
 
+    /*
+     * Optimistic reads (seqlock-style), for readers that don't arrive on the read indicator:
+     *   uint64_t seq = lock.optimisticBegin();
+     *   if (seq != NO_SEQ) { ...reads...; if (lock.optimisticValidate(seq)) the reads were consistent }
+     * Every exclusive lock goes through HLOCK with seq+1, so the reads were consistent if there was
+     * no writer at the start and seq is the same at the end. Writers don't wait for optimistic
+     * readers: the reads may see data that a writer is modifying, they must be safe on it, and
+     * their result is thrown away when the validation fails. There are no stores on this path.
+     */
+    static constexpr uint64_t NO_SEQ = UINT64_MAX;
+
+    inline uint64_t optimisticBegin() const noexcept {
+        const StructData ws = wstate.load();
+        if (ws.state == WLOCK || ws.state == HLOCK) return NO_SEQ;
+        return ws.seq;
+    }
+
+    inline bool optimisticValidate(const uint64_t seq) const noexcept {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const StructData ws = wstate.load(std::memory_order_relaxed);
+        return ws.seq == seq && ws.state != WLOCK && ws.state != HLOCK;
+    }
+
+    // True if some thread holds (or is trying to get) the shared lock. Used inside hardware transactions,
+    // where a reader that arrives later aborts the transaction.
+    inline bool hasReaders() noexcept {
+        return !ri.isEmpty();
+    }
+
     inline void sharedLock(const int tid) noexcept {
         while (!sharedTryLock(tid)) std::this_thread::yield();
     }
@@ -177,16 +302,18 @@ public:
     inline bool exclusiveTryLock(const int tid) noexcept {
         StructData ws = wstate.load();
         if (ws.state == WLOCK || ws.state == RLOCK) return false;
-        if (!ri.isEmpty()) return false;
+        // In writer-preference mode we go to HLOCK even if there are readers, so that the next readers back off
+        if (maxCancels == 0 && !ri.isEmpty()) return false;
         if (ws.state == HLOCK) {
+            if (maxCancels != 0 && !ri.isEmpty()) return false;
             if(ws!=wstate.load()) return false; // possible opt
-            return wstate.compare_exchange_strong(ws, {ws.seq, WLOCK}); // A writer jumped ahead of me
+            return wstate.compare_exchange_strong(ws, {ws.seq, WLOCK}) && onWLock(); // A writer jumped ahead of me
         }
         StructData next = {ws.seq+1,HLOCK};
         wstate.compare_exchange_strong(ws, next);
         if (!ri.isEmpty()) return false;
         if (wstate.load()!=next) return false;
-        return wstate.compare_exchange_strong(next, {next.seq,WLOCK});
+        return wstate.compare_exchange_strong(next, {next.seq,WLOCK}) && onWLock();
     }
 
 
@@ -0,0 +1,40 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _THREAD_COUNT_H_
+#define _THREAD_COUNT_H_
+
+#include <cassert>
+
+/**
+ * <h1> Thread Count </h1>
+ *
+ * The maxThreads of a data structure, given at runtime (N == 0, the default) or fixed
+ * at compile time (N != 0). A ThreadCount converts to int, so the classes that have a
+ * member 'const ThreadCount<N> maxThreads' use it like an int. With a fixed N the
+ * conversion is a constant: the loops over the threads (the scans of the hazard pointers
+ * and of the read indicators, the helping in enqueue()) have a constant bound that the
+ * compiler can unroll, and there's no load of maxThreads. The per-thread arrays are then
+ * allocated with N entries, and the value given at runtime must not be larger than N.
+ */
+template<int N>
+class ThreadCount {
+public:
+    ThreadCount(const int numThreads) { assert(numThreads <= N); }
+    constexpr operator int() const { return N; }
+};
+
+template<>
+class ThreadCount<0> {
+    const int value;
+public:
+    ThreadCount(const int numThreads) : value{numThreads} { }
+    operator int() const { return value; }
+};
+
+#endif /* _THREAD_COUNT_H_ */
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _THREAD_REGISTRY_H_
+#define _THREAD_REGISTRY_H_
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+
+/**
+ * <h1> Thread Registry </h1>
+ *
+ * Assigns to each thread a unique and dense tid, the lowest one that is not in
+ * use, the first time that the thread calls ThreadRegistry::getTID(). After
+ * that, getTID() is just a load of a thread_local variable. The tid is given
+ * back when the thread exits, and can then be re-used by a new thread, which
+ * means that thread pools that grow and shrink will keep the tids dense.
+ *
+ * The tids are global (one registry per process), therefore the maxThreads of
+ * each Universal Construct must be higher than the number of threads that are
+ * alive at the same time, not just the ones that use that instance.
+ *
+ * Threads that manage their own tids can keep passing them explicitly, but
+ * mixing the two in the same process is not safe.
+ */
+class ThreadRegistry;
+
+// A helper class to do the check-in and check-out of the thread registry
+struct ThreadCheckInCheckOut {
+    static const int NOT_ASSIGNED = -1;
+    int tid { NOT_ASSIGNED };
+    ~ThreadCheckInCheckOut();
+};
+
+inline thread_local ThreadCheckInCheckOut tl_tcico {};
+
+class ThreadRegistry {
+
+public:
+    static const int REGISTRY_MAX_THREADS = 1024;
+
+private:
+    alignas(128) std::atomic<bool>  usedTID[REGISTRY_MAX_THREADS];
+    alignas(128) std::atomic<int>   maxTid {0};   // One more than the highest tid that was ever assigned
+
+public:
+    ThreadRegistry() {
+        for (int it = 0; it < REGISTRY_MAX_THREADS; it++) usedTID[it].store(false, std::memory_order_relaxed);
+    }
+
+    // Progress Condition: lock-free
+    int registerThreadNew() {
+        for (int tid = 0; tid < REGISTRY_MAX_THREADS; tid++) {
+            if (usedTID[tid].load(std::memory_order_acquire)) continue;
+            bool unused = false;
+            if (!usedTID[tid].compare_exchange_strong(unused, true)) continue;
+            // Increase the current maximum to cover our thread id
+            int curMax = maxTid.load();
+            while (curMax <= tid && !maxTid.compare_exchange_weak(curMax, tid+1));
+            tl_tcico.tid = tid;
+            return tid;
+        }
+        std::cout << "ERROR: Too many threads, registry can only hold " << REGISTRY_MAX_THREADS << " threads\n";
+        assert(false);
+        return ThreadCheckInCheckOut::NOT_ASSIGNED;
+    }
+
+    // Progress Condition: wait-free population oblivious
+    inline void deregisterThread(const int tid) {
+        usedTID[tid].store(false, std::memory_order_release);
+    }
+
+    // Number of tids that have ever been assigned (the highest tid plus one)
+    static inline int getMaxThreads();
+
+    // Returns the tid of the calling thread, registering it if needed
+    static inline int getTID();
+};
+
+inline ThreadRegistry gThreadRegistry {};
+
+inline int ThreadRegistry::getTID() {
+    const int tid = tl_tcico.tid;
+    if (tid != ThreadCheckInCheckOut::NOT_ASSIGNED) return tid;
+    return gThreadRegistry.registerThreadNew();
+}
+
+inline int ThreadRegistry::getMaxThreads() { return gThreadRegistry.maxTid.load(std::memory_order_acquire); }
+
+inline ThreadCheckInCheckOut::~ThreadCheckInCheckOut() {
+    if (tid == NOT_ASSIGNED) return;
+    gThreadRegistry.deregisterThread(tid);
+}
+
+#endif /* _THREAD_REGISTRY_H_ */
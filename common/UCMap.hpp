@@ -0,0 +1,148 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _UNIVERSAL_CONSTRUCT_MAP_H_
+#define _UNIVERSAL_CONSTRUCT_MAP_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "../common/ReadOnce.hpp"
+#include "../common/ThreadRegistry.hpp"
+
+/**
+ * <h1> Interface for Universal Constructs (Maps) </h1>
+ *
+ * UC is the Universal Construct, and its result type (R) must be std::optional<V>
+ * MAP is the map class
+ * K is the type of the key of the map
+ * V is the type of the value of the map
+ *
+ * MAP must have the methods:
+ *   std::optional<V> put(const K& key, const V& value);   // Returns the previous value, if any
+ *   std::optional<V> remove(const K& key);                // Returns the removed value, if any
+ *   std::optional<V> get(const K& key);
+ *   static std::string className();
+ *
+ * For example:
+ *   UCMap<CXMutationWF<TreeMap<K,V>,std::optional<V>>,TreeMap<K,V>,K,V> map;
+ *   if (auto val = map.get(key, tid)) use(*val);
+ */
+template<typename UC, typename MAP, typename K, typename V>
+class UCMap {
+private:
+    static const int MAX_THREADS = 128;
+    const int maxThreads;
+    UC uc {new MAP(), maxThreads};
+
+    using OptV = std::optional<V>;
+
+public:
+    UCMap(const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} { }
+
+    static std::string className() { return UC::className() + MAP::className(); }
+
+    OptV put(K key, V value, const int tid) {
+        return uc.applyUpdate([key,value] (MAP* map) -> OptV { return map->put(key, value); }, tid);
+    }
+
+    OptV remove(K key, const int tid) {
+        return uc.applyUpdate([key] (MAP* map) -> OptV { return map->remove(key); }, tid);
+    }
+
+    OptV get(K key, const int tid) {
+        auto getFunc = [key] (MAP* map) -> OptV { return map->get(key); };
+        static_assert(std::is_same<decltype(uc.applyRead(getFunc, tid)), OptV>::value, "The Universal Construct must return std::optional<V>");
+        return uc.applyRead(getFunc, tid);
+    }
+
+    template<typename M> struct HasGetBatch {
+        template<typename U> static auto test(int) -> decltype(std::declval<U&>().getBatch((const K*)nullptr, (uint64_t)0, (OptV*)nullptr), std::true_type{});
+        template<typename U> static std::false_type test(long);
+        static const bool value = decltype(test<M>(0))::value;
+    };
+
+    /*
+     * out[i] is get(keys[i]), with the n lookups in a single applyRead(), like UCSet::containsMany().
+     * If MAP has getBatch() the lookups are interleaved with prefetches, otherwise they are done one by one.
+     */
+    void getMany(const K* keys, const uint64_t n, OptV* out, const int tid) {
+        ReadOnce once;
+        uc.applyRead([once,keys,n,out] (MAP* map) -> OptV {
+            once.run([&] () {
+                if constexpr (HasGetBatch<MAP>::value) {
+                    map->getBatch(keys, n, out);
+                } else {
+                    for (uint64_t i = 0; i < n; i++) out[i] = map->get(keys[i]);
+                }
+            });
+            return {};
+        }, tid);
+        once.wait();
+    }
+
+    template<typename M> struct HasBulkLoad {
+        template<typename U> static auto test(int) -> decltype(std::declval<U&>().bulkLoad((const K*)nullptr, (const V*)nullptr, (uint64_t)0), std::true_type{});
+        template<typename U> static std::false_type test(long);
+        static const bool value = decltype(test<M>(0))::value;
+    };
+
+    /*
+     * Same as UCSet::addAll(): if MAP has bulkLoad(), the pairs are sorted outside of the mutation
+     * and an empty map is built from them in O(n), otherwise they are put one by one.
+     * With duplicate keys, the last value wins in both cases.
+     */
+    void addAll(K** keys, V** values, const int size, const int tid) {
+        if constexpr (HasBulkLoad<MAP>::value) {
+            std::vector<int> order(size);
+            for (int i = 0; i < size; i++) order[i] = i;
+            std::stable_sort(order.begin(), order.end(), [keys] (int a, int b) { return *keys[a] < *keys[b]; });
+            auto sortedKeys = std::make_shared<std::vector<K>>();
+            auto sortedVals = std::make_shared<std::vector<V>>();
+            for (int i = 0; i < size; i++) {
+                const int ix = order[i];
+                if (!sortedKeys->empty() && !(sortedKeys->back() < *keys[ix])) {
+                    sortedVals->back() = *values[ix];
+                    continue;
+                }
+                sortedKeys->push_back(*keys[ix]);
+                sortedVals->push_back(*values[ix]);
+            }
+            uc.applyUpdate([sortedKeys,sortedVals] (MAP* map) -> OptV {
+                if (!map->bulkLoad(sortedKeys->data(), sortedVals->data(), sortedKeys->size())) {
+                    for (size_t i = 0; i < sortedKeys->size(); i++) map->put((*sortedKeys)[i], (*sortedVals)[i]);
+                }
+                return {};
+            }, tid);
+        } else {
+            uc.applyUpdate([keys,values,size] (MAP* map) -> OptV {
+                for (int i = 0; i < size; i++) map->put(*keys[i], *values[i]);
+                return {};
+            }, tid);
+        }
+    }
+
+    // Statistics and replica count of the Universal Construct, for the UCs that have them
+    template<typename U = UC> auto stats() const -> decltype(std::declval<const U&>().stats()) { return uc.stats(); }
+    template<typename U = UC> auto getPeakReplicas() const -> decltype(std::declval<const U&>().getPeakReplicas()) { return uc.getPeakReplicas(); }
+
+    // Same as above, with the tid that the ThreadRegistry assigned to the calling thread
+    OptV put(K key, V value) { return put(key, value, ThreadRegistry::getTID()); }
+    OptV remove(K key)       { return remove(key, ThreadRegistry::getTID()); }
+    OptV get(K key)          { return get(key, ThreadRegistry::getTID()); }
+    void getMany(const K* keys, const uint64_t n, OptV* out) { getMany(keys, n, out, ThreadRegistry::getTID()); }
+    void addAll(K** keys, V** values, const int size) { addAll(keys, values, size, ThreadRegistry::getTID()); }
+};
+
+#endif /* _UNIVERSAL_CONSTRUCT_MAP_H_ */
@@ -33,6 +33,9 @@
 #include <stdexcept>
 #include <cstdint>
 #include <functional>
+#include <type_traits>
+
+#include "../common/ThreadRegistry.hpp"
 
 /**
  * <h1> Interface for Universal Constructs (Queues) </h1>
@@ -48,7 +51,7 @@
 
 // This class can be used to simplify the usage of queues with Universal Constructs
 // For generic code you don't need it (and can't use it), but it can serve as an example of how to use lambdas.
-// Q must be a queue where the items are of type QItem
+// Q must be a queue where the items are of type QItem, and the result type (R) of UC must be QItem*
 template<typename UC, typename Q, typename QItem>
 class UCQueue {
 private:
@@ -61,15 +64,21 @@ public:
 
     static std::string className() { return UC::className() + Q::className(); }
 
+    // Returns false if the item was not enqueued (e.g. the queue is full)
     bool enqueue(QItem* item, const int tid) {
-        std::function<bool(Q*)> func = [item] (Q* q) { return q->enqueue(item); };
-        return uc.applyUpdate(func, tid);
+        return uc.applyUpdate([item] (Q* q) -> QItem* { return q->enqueue(item) ? item : nullptr; }, tid) != nullptr;
     }
 
+    // Returns nullptr if the queue is empty
     QItem* dequeue(const int tid) {
-        std::function<bool(Q*)> func = [] (Q* q) { return q->dequeue(); };
-        return (QItem*)uc.applyUpdate(func, tid);
+        auto deqFunc = [] (Q* q) -> QItem* { return q->dequeue(); };
+        static_assert(std::is_same<decltype(uc.applyUpdate(deqFunc, tid)), QItem*>::value, "The Universal Construct must return QItem*");
+        return uc.applyUpdate(deqFunc, tid);
     }
+
+    // Same as above, with the tid that the ThreadRegistry assigned to the calling thread
+    bool enqueue(QItem* item) { return enqueue(item, ThreadRegistry::getTID()); }
+    QItem* dequeue()          { return dequeue(ThreadRegistry::getTID()); }
 };
 
 #endif /* _UNIVERSAL_CONSTRUCT_QUEUE_H_ */
@@ -29,7 +29,15 @@
 #ifndef _UNIVERSAL_CONSTRUCT_BLOCKING_SET_H_
 #define _UNIVERSAL_CONSTRUCT_BLOCKING_SET_H_
 
+#include <algorithm>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../common/ReadOnce.hpp"
+#include "../common/ThreadRegistry.hpp"
 
 /**
  * <h1> Interface for Universal Constructs (Sets) </h1>
@@ -59,35 +67,88 @@ public:
 
     static std::string className() { return UC::className() + SET::className(); }
 
+    // The lambdas are passed as they are, the Universal Construct does the type erasure (if any)
     bool add(K key, const int tid) {
-        std::function<bool(SET*)> addFunc = [key] (SET* set) { return set->add(key); };
-        return uc.applyUpdate(addFunc, tid);
+        return uc.applyUpdate([key] (SET* set) { return set->add(key); }, tid);
     }
 
     bool remove(K key, const int tid) {
-        std::function<bool(SET*)> removeFunc = [key] (SET* set) { return set->remove(key); };
-        return uc.applyUpdate(removeFunc, tid);
+        return uc.applyUpdate([key] (SET* set) { return set->remove(key); }, tid);
     }
 
     bool contains(K key, const int tid) {
-        std::function<bool(SET*)> containsFunc = [key] (SET* set) { return set->contains(key); };
-        return uc.applyRead(containsFunc, tid);
+        return uc.applyRead([key] (SET* set) { return set->contains(key); }, tid);
     }
 
     bool iterateAll(std::function<bool(K*)> itfun, const int tid) {
-        std::function<bool(SET*)> func = [&itfun] (SET* set) {
-        	return set->iterateAll(itfun);
-        };
-        return uc.applyRead(func, tid);
+        return uc.applyRead([&itfun] (SET* set) { return set->iterateAll(itfun); }, tid);
     }
 
-    void addAll(K** keys, const int size, const int tid) {
-        std::function<bool(SET*)> addFunc = [keys,size] (SET* set) {
-            for (int i = 0; i < size; i++) set->add(*keys[i]);
+    template<typename S> struct HasContainsBatch {
+        template<typename U> static auto test(int) -> decltype(std::declval<U&>().containsBatch((const K*)nullptr, (uint64_t)0, (bool*)nullptr), std::true_type{});
+        template<typename U> static std::false_type test(long);
+        static const bool value = decltype(test<S>(0))::value;
+    };
+
+    /*
+     * out[i] is contains(keys[i]), with the n lookups in a single applyRead(), i.e. one round-trip on
+     * the lock instead of one per key. If SET has containsBatch() the lookups are interleaved with
+     * prefetches, otherwise they are done one by one. See ReadOnce.hpp for why the results go through it.
+     */
+    void containsMany(const K* keys, const uint64_t n, bool* out, const int tid) {
+        ReadOnce once;
+        uc.applyRead([once,keys,n,out] (SET* set) {
+            once.run([&] () {
+                if constexpr (HasContainsBatch<SET>::value) {
+                    set->containsBatch(keys, n, out);
+                } else {
+                    for (uint64_t i = 0; i < n; i++) out[i] = set->contains(keys[i]);
+                }
+            });
             return true;
-        };
-        uc.applyUpdate(addFunc, tid);
+        }, tid);
+        once.wait();
     }
+
+    template<typename S> struct HasBulkLoad {
+        template<typename U> static auto test(int) -> decltype(std::declval<U&>().bulkLoad((const K*)nullptr, (uint64_t)0), std::true_type{});
+        template<typename U> static std::false_type test(long);
+        static const bool value = decltype(test<S>(0))::value;
+    };
+
+    /*
+     * If SET has bulkLoad(), the keys are sorted (outside of the mutation, which may be applied
+     * more than once) and an empty set is built from them in O(n), otherwise they are added one by one.
+     */
+    void addAll(K** keys, const int size, const int tid) {
+        if constexpr (HasBulkLoad<SET>::value) {
+            auto sorted = std::make_shared<std::vector<K>>();
+            sorted->reserve(size);
+            for (int i = 0; i < size; i++) sorted->push_back(*keys[i]);
+            std::sort(sorted->begin(), sorted->end());
+            sorted->erase(std::unique(sorted->begin(), sorted->end()), sorted->end());
+            uc.applyUpdate([sorted] (SET* set) {
+                if (!set->bulkLoad(sorted->data(), sorted->size())) {
+                    for (const K& key : *sorted) set->add(key);
+                }
+                return true;
+            }, tid);
+        } else {
+            uc.applyUpdate([keys,size] (SET* set) {
+                for (int i = 0; i < size; i++) set->add(*keys[i]);
+                return true;
+            }, tid);
+        }
+    }
+
+    // Statistics of the Universal Construct, for the UCs that have them
+    template<typename U = UC> auto stats() const -> decltype(std::declval<const U&>().stats()) { return uc.stats(); }
+
+    // Same as above, with the tid that the ThreadRegistry assigned to the calling thread
+    bool add(K key)      { return add(key, ThreadRegistry::getTID()); }
+    bool remove(K key)   { return remove(key, ThreadRegistry::getTID()); }
+    bool contains(K key) { return contains(key, ThreadRegistry::getTID()); }
+    void containsMany(const K* keys, const uint64_t n, bool* out) { containsMany(keys, n, out, ThreadRegistry::getTID()); }
 };
 
 #endif /* _UNIVERSAL_CONSTRUCT_BLOCKING_SET_H_ */
@@ -0,0 +1,149 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _UNIVERSAL_CONSTRUCT_STACK_H_
+#define _UNIVERSAL_CONSTRUCT_STACK_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+#include "../common/ThreadRegistry.hpp"
+
+/**
+ * <h1> Interface for Universal Constructs (Stacks), with an elimination array </h1>
+ *
+ * UC is the Universal Construct
+ * S is the stack class, with push(item) and pop(), e.g. LinkedListStack
+ * SItem is the type of the item in the stack
+ * ELIM_SPINS is the maximum number of times that a push() waits in the elimination array for a pop(),
+ * zero disables the elimination array
+ *
+ * A push() and a pop() that meet in the elimination array exchange the item without going
+ * through the Universal Construct: the pair is linearized at the exchange, as if the push was
+ * immediately followed by the pop, which is correct whatever the state of the stack is.
+ * push() parks its item in a random slot of the array and waits for a pop() to take it, and
+ * pop() takes the item of a random slot, if there is one, without waiting. Each thread halves
+ * its wait when no pop() came, and doubles it (up to ELIM_SPINS) when its item was taken, so
+ * that a workload with few matching pairs doesn't pay much for the elimination array.
+ * Only the operations that are not eliminated call applyUpdate(), which means that with
+ * symmetrical push/pop traffic most pairs never enter the Turn queue nor touch a replica.
+ *
+ * Each slot is a single word which is nullptr (empty), an item (a parked push) or TAKEN
+ * (a pop took the item and the push hasn't seen it yet). Only the push that parked the item
+ * moves the slot back to empty, so the same item can be parked again without an ABA issue.
+ * push() and pop() keep the progress condition of the Universal Construct, because the wait
+ * in the elimination array is bounded.
+ */
+template<typename UC, typename S, typename SItem, int ELIM_SPINS = 256>
+class UCStack {
+private:
+    static const int MAX_THREADS = 128;
+    static const int CLPAD = 128/sizeof(uint64_t);
+    const int maxThreads;
+    const int numSlots;
+    UC uc{new S(), maxThreads};
+
+    alignas(128) std::atomic<SItem*>*   slots;        // numSlots entries
+    alignas(128) uint64_t*              seeds;        // Per-thread xorshift state to pick the slots, and the wait of push()
+    alignas(128) std::atomic<uint64_t>* eliminated;   // Per-thread number of eliminated pairs
+
+    static inline SItem* taken() { return reinterpret_cast<SItem*>(uintptr_t(1)); }
+
+    inline std::atomic<SItem*>& randomSlot(const int tid) {
+        uint64_t& x = seeds[tid*CLPAD];
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return slots[(x % numSlots)*CLPAD];
+    }
+
+    // Returns true if a pop() took the item
+    bool tryEliminatePush(SItem* item, const int tid) {
+        std::atomic<SItem*>& slot = randomSlot(tid);
+        SItem* expected = nullptr;
+        if (slot.load() != nullptr || !slot.compare_exchange_strong(expected, item)) return false;
+        uint64_t& spins = seeds[tid*CLPAD+1];
+        for (uint64_t i = 0; i < spins; i++) {
+            if (slot.load() == taken()) break;
+        }
+        expected = item;
+        if (slot.compare_exchange_strong(expected, nullptr)) {
+            spins = std::max<uint64_t>(1, spins/2);
+            return false;
+        }
+        // The slot is TAKEN and only we can change it
+        slot.store(nullptr, std::memory_order_release);
+        spins = std::min<uint64_t>(ELIM_SPINS, spins*2);
+        eliminated[tid*CLPAD].store(eliminated[tid*CLPAD].load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Returns the item of a parked push(), or nullptr
+    SItem* tryEliminatePop(const int tid) {
+        std::atomic<SItem*>& slot = randomSlot(tid);
+        SItem* litem = slot.load();
+        if (litem == nullptr || litem == taken()) return nullptr;
+        return slot.compare_exchange_strong(litem, taken()) ? litem : nullptr;
+    }
+
+public:
+    UCStack(const int maxThreads=MAX_THREADS) : maxThreads{maxThreads}, numSlots{std::max(1, maxThreads/2)} {
+        slots = new std::atomic<SItem*>[numSlots*CLPAD];
+        for (int is = 0; is < numSlots; is++) slots[is*CLPAD].store(nullptr, std::memory_order_relaxed);
+        seeds = new uint64_t[maxThreads*CLPAD];
+        eliminated = new std::atomic<uint64_t>[maxThreads*CLPAD];
+        for (int it = 0; it < maxThreads; it++) {
+            seeds[it*CLPAD] = 0x9E3779B97F4A7C15ULL*(it+1);
+            seeds[it*CLPAD+1] = ELIM_SPINS;
+            eliminated[it*CLPAD].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~UCStack() {
+        delete[] slots;
+        delete[] seeds;
+        delete[] eliminated;
+    }
+
+    static std::string className() { return UC::className() + S::className() + (ELIM_SPINS != 0 ? "-Elim" + std::to_string(ELIM_SPINS) : ""); }
+
+    // Returns false if the item was not pushed (e.g. it's nullptr)
+    bool push(SItem* item, const int tid) {
+        if (item == nullptr) return false;
+        // With a single thread there is no one to meet in the elimination array
+        if (ELIM_SPINS != 0 && maxThreads > 1 && tryEliminatePush(item, tid)) return true;
+        return uc.applyUpdate([item] (S* s) -> SItem* { return s->push(item) ? item : nullptr; }, tid) != nullptr;
+    }
+
+    // Returns nullptr if the stack is empty
+    SItem* pop(const int tid) {
+        if (ELIM_SPINS != 0 && maxThreads > 1) {
+            SItem* litem = tryEliminatePop(tid);
+            if (litem != nullptr) return litem;
+        }
+        auto popFunc = [] (S* s) -> SItem* { return s->pop(); };
+        static_assert(std::is_same<decltype(uc.applyUpdate(popFunc, tid)), SItem*>::value, "The Universal Construct must return SItem*");
+        return uc.applyUpdate(popFunc, tid);
+    }
+
+    // Number of push/pop pairs that were exchanged in the elimination array, for all threads
+    uint64_t getNumEliminated() const {
+        uint64_t sum = 0;
+        for (int it = 0; it < maxThreads; it++) sum += eliminated[it*CLPAD].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // Same as above, with the tid that the ThreadRegistry assigned to the calling thread
+    bool push(SItem* item) { return push(item, ThreadRegistry::getTID()); }
+    SItem* pop()           { return pop(ThreadRegistry::getTID()); }
+};
+
+#endif /* _UNIVERSAL_CONSTRUCT_STACK_H_ */
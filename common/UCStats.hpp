@@ -0,0 +1,174 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _UC_STATS_H_
+#define _UC_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+/**
+ * <h1> Statistics for the Universal Constructs </h1>
+ *
+ * The Universal Constructs take a statistics policy as a template parameter:
+ * - NoStats (the default) where all methods are empty and inlined away;
+ * - UCStats which keeps one set of counters per thread, each set on its own cache
+ *   lines, so that recording is a relaxed load and store on a line that no other
+ *   thread writes to;
+ *
+ * stats() on the Universal Construct returns a UCStatsSnapshot with the sum of the
+ * counters of all threads. The snapshot is not atomic, the counters of each thread
+ * may be read at different times.
+ *
+ * The number of bytes copied is sizeof(C) unless C has a method memoryUsage()
+ * that returns the number of bytes used by the object.
+ */
+
+enum UCStatsCounter {
+    STATS_COPIES,           // Copies of the object
+    STATS_COPY_BYTES,       // Bytes copied, see memoryUsage()
+    STATS_COPY_NS,          // Time spent in copies, in nanoseconds
+    STATS_MUTATIONS,        // Mutations applied, on all replicas
+    STATS_LOCK_HOLDS,       // Number of times a Combined/ObjectState was held to apply mutations
+    STATS_ENQUEUE_HELPS,    // Steps of the enqueue done on behalf of another thread
+    STATS_READ_FALLBACKS,   // Reads that were enqueued as mutations
+    STATS_HTM_COMMITS,      // Mutations applied in place by a hardware transaction
+    STATS_HTM_ABORTS,       // Hardware transactions that aborted
+    STATS_OPTIMISTIC_FAILS, // Optimistic reads that fell back to the shared lock
+    STATS_NUM_COUNTERS
+};
+
+struct UCStatsSnapshot {
+    uint64_t copies {0};
+    uint64_t copyBytes {0};
+    uint64_t copyTimeNs {0};
+    uint64_t mutations {0};
+    uint64_t lockHolds {0};
+    uint64_t enqueueHelps {0};
+    uint64_t readFallbacks {0};
+    uint64_t htmCommits {0};
+    uint64_t htmAborts {0};
+    uint64_t optimisticFails {0};
+    uint64_t hpScans {0};           // Scans of the memory reclamation, filled by the Universal Construct
+    uint64_t parks {0};             // Times an updater parked on a futex (CXMutationBlocking), filled by the Universal Construct
+
+    UCStatsSnapshot& operator+=(const UCStatsSnapshot& other) {
+        copies += other.copies;
+        copyBytes += other.copyBytes;
+        copyTimeNs += other.copyTimeNs;
+        mutations += other.mutations;
+        lockHolds += other.lockHolds;
+        enqueueHelps += other.enqueueHelps;
+        readFallbacks += other.readFallbacks;
+        htmCommits += other.htmCommits;
+        htmAborts += other.htmAborts;
+        optimisticFails += other.optimisticFails;
+        hpScans += other.hpScans;
+        parks += other.parks;
+        return *this;
+    }
+
+    double mutationsPerLockHold() const { return lockHolds == 0 ? 0.0 : (double)mutations/lockHolds; }
+
+    void print(std::ostream& os) const {
+        os << "copies=" << copies << " copyBytes=" << copyBytes << " copyTimeNs=" << copyTimeNs
+           << " mutations=" << mutations << " lockHolds=" << lockHolds << " mutationsPerLockHold=" << mutationsPerLockHold()
+           << " enqueueHelps=" << enqueueHelps << " readFallbacks=" << readFallbacks
+           << " htmCommits=" << htmCommits << " htmAborts=" << htmAborts << " optimisticFails=" << optimisticFails << " hpScans=" << hpScans << " parks=" << parks << "\n";
+    }
+};
+
+
+// Size of the object, which is sizeof(C) unless C has a method memoryUsage()
+template<typename C> auto statsObjectBytes(const C& obj, int) -> decltype((uint64_t)obj.memoryUsage()) { return obj.memoryUsage(); }
+template<typename C> uint64_t statsObjectBytes(const C& obj, long) { return sizeof(C); }
+
+
+class NoStats {
+public:
+    static const bool enabled = false;
+
+    NoStats(const int maxThreads) { }
+
+    inline void add(const UCStatsCounter counter, const int tid, const uint64_t n=1) { }
+
+    // Copy of the object with the copy constructor, or made by makeCopy()
+    template<typename C> inline C* copy(const C& obj, const int tid) { return new C(obj); }
+    template<typename C, typename F> inline C* copy(const C& obj, F&& makeCopy, const int tid) { return makeCopy(); }
+
+    UCStatsSnapshot snapshot() const { return {}; }
+};
+
+
+class UCStats {
+
+private:
+    struct alignas(128) Counters {
+        std::atomic<uint64_t> counters[STATS_NUM_COUNTERS];
+    };
+
+    const int maxThreads;
+    Counters* perThread;
+
+public:
+    static const bool enabled = true;
+
+    UCStats(const int maxThreads) : maxThreads{maxThreads} {
+        perThread = new Counters[maxThreads];
+        for (int it = 0; it < maxThreads; it++) {
+            for (int ic = 0; ic < STATS_NUM_COUNTERS; ic++) perThread[it].counters[ic].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~UCStats() {
+        delete[] perThread;
+    }
+
+    // Only thread tid writes to its counters, there is no need for an atomic increment
+    inline void add(const UCStatsCounter counter, const int tid, const uint64_t n=1) {
+        std::atomic<uint64_t>& c = perThread[tid].counters[counter];
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    template<typename C> inline C* copy(const C& obj, const int tid) {
+        return copy(obj, [&obj] () { return new C(obj); }, tid);
+    }
+
+    template<typename C, typename F> inline C* copy(const C& obj, F&& makeCopy, const int tid) {
+        auto startTime = std::chrono::steady_clock::now();
+        C* newObj = makeCopy();
+        auto stopTime = std::chrono::steady_clock::now();
+        add(STATS_COPIES, tid);
+        add(STATS_COPY_BYTES, tid, statsObjectBytes(obj, 0));
+        add(STATS_COPY_NS, tid, std::chrono::duration_cast<std::chrono::nanoseconds>(stopTime-startTime).count());
+        return newObj;
+    }
+
+    UCStatsSnapshot snapshot() const {
+        uint64_t sum[STATS_NUM_COUNTERS] = {};
+        for (int it = 0; it < maxThreads; it++) {
+            for (int ic = 0; ic < STATS_NUM_COUNTERS; ic++) sum[ic] += perThread[it].counters[ic].load(std::memory_order_relaxed);
+        }
+        UCStatsSnapshot snap;
+        snap.copies = sum[STATS_COPIES];
+        snap.copyBytes = sum[STATS_COPY_BYTES];
+        snap.copyTimeNs = sum[STATS_COPY_NS];
+        snap.mutations = sum[STATS_MUTATIONS];
+        snap.lockHolds = sum[STATS_LOCK_HOLDS];
+        snap.enqueueHelps = sum[STATS_ENQUEUE_HELPS];
+        snap.readFallbacks = sum[STATS_READ_FALLBACKS];
+        snap.htmCommits = sum[STATS_HTM_COMMITS];
+        snap.htmAborts = sum[STATS_HTM_ABORTS];
+        snap.optimisticFails = sum[STATS_OPTIMISTIC_FAILS];
+        return snap;
+    }
+};
+
+#endif /* _UC_STATS_H_ */
@@ -31,33 +31,121 @@
 #define _URCU_GRACE_VERSION_H_
 
 #include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
 
 
 // Our own userspace implementation of RCU that allows for concurrent calls to rcu_synchronize(),
 // in other words, threads calling rcu_synchronize() can "shared the grace period".
+//
+// retire() is the asynchronous alternative to synchronize() followed by a delete (call_rcu).
+// Each thread keeps the objects it retired in its own list. Every batchSize retires it advances
+// the version once for the whole batch and frees the objects of the previous batches whose
+// version all readers have already passed, without waiting for any of them. With startReclaimer(),
+// the full batches are instead handed over to a background thread that does one synchronize()
+// for all the batches it takes at a time. The objects still retired are freed in the destructor.
 class URCUGraceVersion {
 
     static const int CLPAD = (128/sizeof(uint64_t));
     static const uint64_t NOT_READING = 0xFFFFFFFFFFFFFFFE;
     static const uint64_t UNASSIGNED =  0xFFFFFFFFFFFFFFFD;
 
+    struct Retired {
+        void*    obj;
+        void     (*deleter)(void*);
+        uint64_t version;               // Zero until the batch of obj is closed
+    };
+
+    struct alignas(128) RetiredList {
+        std::vector<Retired> list;
+        size_t               numClosed {0};   // The first numClosed entries have a version
+    };
+
+    // A batch handed over to the reclaimer thread
+    struct RetiredBatch {
+        std::vector<Retired> list;
+        RetiredBatch*        next {nullptr};
+    };
+
     const int maxThreads; // Defaults to 32
+    const size_t batchSize;
     std::atomic<uint64_t> reclaimerVersion alignas(128) = { 0 };
     std::atomic<uint64_t>* readersVersion alignas(128);
+    RetiredList* retired;
+    std::atomic<RetiredBatch*> handoff alignas(128) = { nullptr };
+    std::atomic<bool> quitReclaimer = { false };
+    std::thread reclaimer;
+
+    static void freeList(std::vector<Retired>& list, size_t num) {
+        for (size_t i = 0; i < num; i++) list[i].deleter(list[i].obj);
+        list.erase(list.begin(), list.begin()+num);
+    }
+
+    // A version that has more than the readers that are currently inside a read-side critical section
+    uint64_t advanceVersion() noexcept {
+        const uint64_t newVersion = reclaimerVersion.load()+1;
+        auto tmp = newVersion-1;
+        reclaimerVersion.compare_exchange_strong(tmp, newVersion);
+        return newVersion;
+    }
+
+    // Lowest version of the readers that are inside a read-side critical section
+    uint64_t minReaderVersion() const noexcept {
+        uint64_t minVersion = NOT_READING;
+        for (int i=0; i < maxThreads; i++) {
+            const uint64_t rv = readersVersion[i*CLPAD].load();
+            if (rv < minVersion) minVersion = rv;
+        }
+        return minVersion;
+    }
+
+    void reclaimerLoop() {
+        while (!quitReclaimer.load()) {
+            RetiredBatch* batch = handoff.exchange(nullptr);
+            if (batch == nullptr) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                continue;
+            }
+            synchronize();   // One grace period for all the batches we took
+            while (batch != nullptr) {
+                RetiredBatch* lnext = batch->next;
+                freeList(batch->list, batch->list.size());
+                delete batch;
+                batch = lnext;
+            }
+        }
+    }
 
 public:
-    URCUGraceVersion(const int maxThreads = 32) : maxThreads{maxThreads} {
+    URCUGraceVersion(const int maxThreads = 32, const size_t batchSize = 64) : maxThreads{maxThreads}, batchSize{batchSize} {
         readersVersion = new std::atomic<uint64_t>[maxThreads*CLPAD];
         for (int i=0; i < maxThreads; i++) {
             readersVersion[i*CLPAD].store(UNASSIGNED, std::memory_order_relaxed);
         }
+        retired = new RetiredList[maxThreads];
     }
 
+    // There can't be any readers left, so everything that was retired is freed
     ~URCUGraceVersion() {
+        if (reclaimer.joinable()) {
+            quitReclaimer.store(true);
+            reclaimer.join();
+        }
+        RetiredBatch* batch = handoff.load();
+        while (batch != nullptr) {
+            RetiredBatch* lnext = batch->next;
+            freeList(batch->list, batch->list.size());
+            delete batch;
+            batch = lnext;
+        }
+        for (int i=0; i < maxThreads; i++) freeList(retired[i].list, retired[i].list.size());
+        delete[] retired;
         delete[] readersVersion;
     }
 
-    // Returns the index (tid) in the array
+    // Returns the index (tid) in the array, or -1 if there are already maxThreads registered threads
     int register_thread() {
         for (int i=0; i < maxThreads; i++) {
             if (readersVersion[i*CLPAD].load() != UNASSIGNED) continue;
@@ -67,12 +155,13 @@ public:
             }
         }
         std::cout << "Error: too many threads already registered\n";
+        return -1;
     }
 
     // Pass the tid returned by register_thread()
     void unregister_thread(int tid)
     {
-        if (readersVersion[tid*CLPAD].load() == UNASSIGNED) {
+        if (tid < 0 || tid >= maxThreads || readersVersion[tid*CLPAD].load() == UNASSIGNED) {
             std::cout << "Error: calling unregister_thread() with a tid that was never registered\n";
             return;
         }
@@ -94,13 +183,69 @@ public:
 
 
     void synchronize() noexcept {
-        const uint64_t waitForVersion = reclaimerVersion.load()+1;
-        auto tmp = waitForVersion-1;
-        reclaimerVersion.compare_exchange_strong(tmp, waitForVersion);
+        const uint64_t waitForVersion = advanceVersion();
         for (int i=0; i < maxThreads; i++) {
             while (readersVersion[i*CLPAD].load() < waitForVersion) { } // spin
         }
     }
+
+
+    // Returns true if all the readers that were inside a read-side critical section when 'version' was returned by beginGrace() have left it
+    bool isGraceOver(const uint64_t version) const noexcept {
+        return minReaderVersion() >= version;
+    }
+
+    // Starts a grace period without waiting for it, see isGraceOver()
+    uint64_t beginGrace() noexcept {
+        return advanceVersion();
+    }
+
+
+    /*
+     * Calls deleter(obj) once no reader can be accessing obj anymore, i.e. after a grace period.
+     * obj must already be unreachable for new readers. tid is the index of the calling thread
+     * (it doesn't have to be registered), and must not be inside a read-side critical section.
+     * Progress Condition: wait-free bounded (by maxThreads and the number of retired objects), lock-free with startReclaimer()
+     */
+    void retire(void* obj, void (*deleter)(void*), const int tid) {
+        RetiredList& rlist = retired[tid];
+        rlist.list.push_back({obj, deleter, 0});
+        if (rlist.list.size() - rlist.numClosed < batchSize) return;
+        if (reclaimer.joinable()) {
+            RetiredBatch* batch = new RetiredBatch();
+            batch->list.swap(rlist.list);
+            rlist.numClosed = 0;
+            batch->next = handoff.load();
+            while (!handoff.compare_exchange_weak(batch->next, batch)) { }
+            return;
+        }
+        // Close the batch: the readers that are not past this version may still see it
+        const uint64_t version = advanceVersion();
+        for (size_t i = rlist.numClosed; i < rlist.list.size(); i++) rlist.list[i].version = version;
+        rlist.numClosed = rlist.list.size();
+        reclaim(tid);
+    }
+
+    template<typename T> void retire(T* obj, const int tid) {
+        retire(obj, [] (void* ptr) { delete (T*)ptr; }, tid);
+    }
+
+
+    // Frees the closed batches of tid that no reader can be accessing anymore. Doesn't block.
+    void reclaim(const int tid) {
+        RetiredList& rlist = retired[tid];
+        const uint64_t minVersion = minReaderVersion();
+        size_t num = 0;
+        while (num < rlist.numClosed && rlist.list[num].version <= minVersion) num++;
+        freeList(rlist.list, num);
+        rlist.numClosed -= num;
+    }
+
+
+    // Hands over the full batches to a background thread, must be called before the first retire()
+    void startReclaimer() {
+        if (!reclaimer.joinable()) reclaimer = std::thread(&URCUGraceVersion::reclaimerLoop, this);
+    }
 };
 
 #endif
@@ -30,91 +30,51 @@
 #ifndef _COW_SORTED_VECTOR_SET_H_
 #define _COW_SORTED_VECTOR_SET_H_
 
-#include <vector>
-#include <iostream>
-#include <functional>
+#include <string>
 
-#include "../../common/URCUReadersVersion.hpp"
+#include "../../ucs/COW.hpp"
 #include "../sequential/SortedVectorSet.hpp"
 
 // TODO: change T* to T&
 
-template<typename T>
+/**
+ * A sorted vector behind a pointer, where each update makes a new copy of the vector (see COW.hpp).
+ * With COMBINING, the thread that copies the vector also applies the pending add()/remove()
+ * of the other threads before the CAS, instead of each thread copying the vector for itself.
+ */
+template<typename T, bool COMBINING = false>
 class COWSortedVectorSet {
 
 private:
-    URCUGraceVersion urcu{128};
-    alignas(128) std::atomic<SortedVectorSet<T>*> ptr;
+    static const int MAX_THREADS = 128;
+    COW<SortedVectorSet<T>,bool,COMBINING> cow;
 
 public:
-    // Is there a better way of doing this without using constructor/destructor?
-    COWSortedVectorSet(const int maxThreads=0) {
-        ptr.store(new SortedVectorSet<T>());
-    }
-
-    ~COWSortedVectorSet() {
-        delete ptr.load();
-    }
+    COWSortedVectorSet(const int maxThreads=0) : cow{new SortedVectorSet<T>(), maxThreads == 0 ? MAX_THREADS : maxThreads} { }
 
-    std::string className() { return "COW-SortedVectorSet"; }
+    static std::string className() { return COMBINING ? "COWComb-SortedVectorSet" : "COW-SortedVectorSet"; }
 
-    // Progress-condition: blocking
+    // Progress-condition: lock-free, wait-free with COMBINING
     bool add(T* key, const int tid) {
-        while(true) {
-            urcu.read_lock(tid);
-            auto oldptr = ptr.load();
-            auto newptr = new SortedVectorSet<T>(*oldptr);
-            auto ret = newptr->add(key);
-            if (ptr.compare_exchange_weak(oldptr, newptr)) {
-                urcu.read_unlock(tid);
-                urcu.synchronize();
-                delete oldptr;
-                return ret;
-            }
-            delete newptr;
-        }
+        return cow.applyUpdate([key] (SortedVectorSet<T>* set) { return set->add(key); }, tid);
     }
 
-    // Progress-condition: blocking
+    // Progress-condition: lock-free, wait-free with COMBINING
     bool remove(T* key, const int tid) {
-        while(true) {
-            urcu.read_lock(tid);
-            auto oldptr = ptr.load();
-            auto newptr = new SortedVectorSet<T>(*oldptr);
-            auto ret = newptr->remove(key);
-            if (ptr.compare_exchange_weak(oldptr, newptr)) {
-                urcu.read_unlock(tid);
-                urcu.synchronize();
-                delete oldptr;
-                return ret;
-            }
-            delete newptr;
-        }
+        return cow.applyUpdate([key] (SortedVectorSet<T>* set) { return set->remove(key); }, tid);
     }
 
     // Progress-condition: wait-free
     bool contains(T* key, const int tid) {
-        urcu.read_lock(tid);
-        auto ret = ptr.load()->contains(key);
-        urcu.read_unlock(tid);
-        return ret;
+        return cow.applyRead([key] (SortedVectorSet<T>* set) { return set->contains(key); }, tid);
     }
 
-    // Progress-condition: blocking
+    // Progress-condition: lock-free, wait-free with COMBINING
     void addAll(T** keys, const int size, const int tid) {
-        while(true) {
-            urcu.read_lock(tid);
-            auto oldptr = ptr.load();
-            auto newptr = new SortedVectorSet<T>(*oldptr);
-            for (int i = 0; i < size; i++) newptr->add(keys[i]);
-            if (ptr.compare_exchange_weak(oldptr, newptr)) {
-                urcu.read_unlock(tid);
-                urcu.synchronize();
-                delete oldptr;
-                return;
-            }
-            delete newptr;
-        }
+        cow.applyUpdate([keys,size] (SortedVectorSet<T>* set) {
+            for (int i = 0; i < size; i++) set->add(keys[i]);
+            return true;
+        }, tid);
     }
 };
 
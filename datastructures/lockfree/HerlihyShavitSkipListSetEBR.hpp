@@ -0,0 +1,245 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _HERLIHY_SHAVIT_SKIP_LIST_SET_EBR_H_
+#define _HERLIHY_SHAVIT_SKIP_LIST_SET_EBR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <string>
+
+#include "common/EpochBased.hpp"
+
+/**
+ * <h1> Lock-Free Skip List Set </h1>
+ *
+ * The lock-free skip list from "The Art of Multiprocessor Programming" (Herlihy and Shavit,
+ * section 14.4), which is based on the skip list by Keir Fraser. It's the balanced (in expectation,
+ * with O(log n) levels) lock-free ordered set that we compare the Universal Constructs with in
+ * the tree benchmarks, instead of an unbalanced tree like NatarajanTreeHE.
+ *
+ * A node is logically removed when the mark (the low bit) of its next pointer at level 0 is set,
+ * after the marks of the upper levels. find() unlinks the marked nodes it goes through at every
+ * level. Like in Fraser's skip list, the inserter updates the next pointer of the new node before
+ * each CAS on an upper level, and gives up linking the upper levels once the node is marked.
+ *
+ * Memory Reclamation: Epoch Based (see EpochBased.hpp), because find() holds the predecessors at
+ * every level. A node may still be linked at an upper level by its inserter after the remover
+ * has unlinked it, so it is retired by whichever of the two (inserter and remover) finishes last,
+ * each one having called find() for its key after its last link or mark.
+ *
+ * <p>
+ * This set has three operations:
+ * <ul>
+ * <li>add(x)      - Lock-Free
+ * <li>remove(x)   - Lock-Free
+ * <li>contains(x) - Wait-Free bounded (by the number of keys)
+ * </ul><p>
+ */
+template<typename T>
+class HerlihyShavitSkipListSetEBR {
+
+private:
+    static const int MAX_THREADS = 128;
+    static const int MAX_LEVEL = 24;      // Enough for 16M keys
+    static const int CLPAD = 128/sizeof(uint64_t);
+
+    struct Node {
+        T                  key;
+        const int          topLevel;
+        std::atomic<int>   owners {2};    // The inserter and the remover, the last one retires the node
+        std::atomic<Node*> next[1];       // topLevel+1 entries, allocated with the node
+
+        Node(const T& key, const int topLevel) : key{key}, topLevel{topLevel} {
+            for (int level = 0; level <= topLevel; level++) new (&next[level]) std::atomic<Node*>(nullptr);
+        }
+
+        static void* operator new(size_t size, const int topLevel) { return ::operator new(size + topLevel*sizeof(std::atomic<Node*>)); }
+        static void operator delete(void* ptr) { ::operator delete(ptr); }
+        static void operator delete(void* ptr, const int topLevel) { ::operator delete(ptr); }
+    };
+
+    const int          maxThreads;
+    Node*              head;          // Sentinel with MAX_LEVEL levels, the end of each level is nullptr
+    uint64_t*          seeds;         // Per-thread xorshift state for the levels of the new nodes
+    EpochBased<Node>   ebr {maxThreads};
+
+    static inline bool isMarked(Node* ptr) { return ((uintptr_t)ptr & 1); }
+    static inline Node* getMarked(Node* ptr) { return (Node*)((uintptr_t)ptr | 1); }
+    static inline Node* getUnmarked(Node* ptr) { return (Node*)((uintptr_t)ptr & ~(uintptr_t)1); }
+
+    // Level of a new node, the probability of each level is half of the one below
+    inline int randomLevel(const int tid) {
+        uint64_t& x = seeds[tid*CLPAD];
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return std::min(__builtin_ctzll(x | (1ULL << 63)), MAX_LEVEL-1);
+    }
+
+    /*
+     * Fills preds[] and succs[] with the last node smaller than key and the next one, at every level,
+     * and unlinks the marked nodes on the way. Returns true if succs[0] has the key.
+     */
+    bool find(const T& key, Node** preds, Node** succs) {
+    retry:
+        Node* pred = head;
+        Node* curr = nullptr;
+        for (int level = MAX_LEVEL-1; level >= 0; level--) {
+            curr = getUnmarked(pred->next[level].load());
+            while (curr != nullptr) {
+                Node* succ = curr->next[level].load();
+                if (isMarked(succ)) {
+                    Node* expected = curr;
+                    if (!pred->next[level].compare_exchange_strong(expected, getUnmarked(succ))) goto retry;
+                    curr = getUnmarked(succ);
+                    continue;
+                }
+                if (!(curr->key < key)) break;
+                pred = curr;
+                curr = succ;
+            }
+            preds[level] = pred;
+            succs[level] = curr;
+        }
+        return curr != nullptr && curr->key == key;
+    }
+
+    // Called by the inserter and by the remover once they no longer link or mark the node
+    inline void release(Node* node, const int tid) {
+        if (node->owners.fetch_add(-1) == 1) ebr.retire(node, tid);
+    }
+
+public:
+    HerlihyShavitSkipListSetEBR(const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+        head = new (MAX_LEVEL-1) Node(T{}, MAX_LEVEL-1);
+        seeds = new uint64_t[maxThreads*CLPAD];
+        for (int it = 0; it < maxThreads; it++) seeds[it*CLPAD] = 0x9E3779B97F4A7C15ULL*(it+1);
+    }
+
+    // We don't expect the destructor to be called if this instance can still be in use
+    ~HerlihyShavitSkipListSetEBR() {
+        Node* node = head->next[0].load();
+        while (node != nullptr) {
+            Node* lnext = getUnmarked(node->next[0].load());
+            delete node;
+            node = lnext;
+        }
+        delete head;
+        delete[] seeds;
+    }
+
+    static std::string className() { return "HerlihyShavit-SkipListSetEBR"; }
+
+    /**
+     * Progress Condition: Lock-Free
+     */
+    bool add(T key, const int tid) {
+        Node* preds[MAX_LEVEL];
+        Node* succs[MAX_LEVEL];
+        const int topLevel = randomLevel(tid);
+        Node* newNode = nullptr;
+        ebr.beginOp(tid);
+        while (true) {
+            if (find(key, preds, succs)) {
+                ebr.endOp(tid);
+                delete newNode;            // Never linked, nobody else has seen it
+                return false;
+            }
+            if (newNode == nullptr) newNode = new (topLevel) Node(key, topLevel);
+            for (int level = 0; level <= topLevel; level++) newNode->next[level].store(succs[level], std::memory_order_relaxed);
+            Node* expected = succs[0];
+            if (preds[0]->next[0].compare_exchange_strong(expected, newNode)) break;
+        }
+        // The key is in the set, now link the upper levels unless the node is already being removed
+        for (int level = 1; level <= topLevel; level++) {
+            while (true) {
+                Node* lnext = newNode->next[level].load();
+                if (isMarked(lnext)) goto done;
+                if (lnext != succs[level] && !newNode->next[level].compare_exchange_strong(lnext, succs[level])) goto done;
+                Node* expected = succs[level];
+                if (preds[level]->next[level].compare_exchange_strong(expected, newNode)) break;
+                find(key, preds, succs);
+                if (succs[0] != newNode) goto done;
+            }
+        }
+    done:
+        // If it was removed in the meantime, the remover may have missed the levels we linked after its find()
+        if (isMarked(newNode->next[0].load())) find(key, preds, succs);
+        release(newNode, tid);
+        ebr.endOp(tid);
+        return true;
+    }
+
+    /**
+     * Progress Condition: Lock-Free
+     */
+    bool remove(T key, const int tid) {
+        Node* preds[MAX_LEVEL];
+        Node* succs[MAX_LEVEL];
+        ebr.beginOp(tid);
+        if (!find(key, preds, succs)) {
+            ebr.endOp(tid);
+            return false;
+        }
+        Node* node = succs[0];
+        for (int level = node->topLevel; level >= 1; level--) {
+            Node* lnext = node->next[level].load();
+            while (!isMarked(lnext)) {
+                node->next[level].compare_exchange_strong(lnext, getMarked(lnext));
+                lnext = node->next[level].load();
+            }
+        }
+        Node* lnext = node->next[0].load();
+        while (!isMarked(lnext)) {
+            if (node->next[0].compare_exchange_strong(lnext, getMarked(lnext))) {
+                find(key, preds, succs);   // Unlinks it from all levels
+                release(node, tid);
+                ebr.endOp(tid);
+                return true;
+            }
+        }
+        ebr.endOp(tid);
+        return false;                      // Another thread removed it first
+    }
+
+    /**
+     * Doesn't unlink the marked nodes.
+     * Progress Condition: Wait-Free bounded (by the number of keys)
+     */
+    bool contains(T key, const int tid) {
+        ebr.beginOp(tid);
+        Node* pred = head;
+        Node* curr = nullptr;
+        for (int level = MAX_LEVEL-1; level >= 0; level--) {
+            curr = getUnmarked(pred->next[level].load());
+            while (curr != nullptr) {
+                Node* succ = curr->next[level].load();
+                if (isMarked(succ)) {
+                    curr = getUnmarked(succ);
+                    continue;
+                }
+                if (!(curr->key < key)) break;
+                pred = curr;
+                curr = succ;
+            }
+        }
+        const bool found = curr != nullptr && curr->key == key && !isMarked(curr->next[0].load());
+        ebr.endOp(tid);
+        return found;
+    }
+
+    // Used only by our benchmarks, at the start of the test
+    void addAll(T** keys, const int size, const int tid) {
+        for (int i = 0; i < size; i++) add(*keys[i], tid);
+    }
+};
+
+#endif /* _HERLIHY_SHAVIT_SKIP_LIST_SET_EBR_H_ */
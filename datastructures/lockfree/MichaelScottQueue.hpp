@@ -32,6 +32,7 @@
 #include <atomic>
 #include <stdexcept>
 #include "common/HazardPointers.hpp"
+#include "common/NodePool.hpp"
 
 
 /**
@@ -55,9 +56,12 @@
  * The paper on Hazard Pointers is named "Hazard Pointers: Safe Memory
  * Reclamation for Lock-Free objects" and it is available here:
  * http://web.cecs.pdx.edu/~walpole/class/cs510/papers/11.pdf
+ * <p>
+ * With POOLED=true the retired nodes go back to a NodePool once they pass the
+ * Hazard Pointers scan, and enqueue() takes its nodes from there.
  *
  */
-template<typename T>
+template<typename T, bool POOLED=false>
 class MichaelScottQueue {
 
 private:
@@ -88,6 +92,7 @@ private:
     const int maxThreads;
 
     // We need two hazard pointers for dequeue()
+    NodePool<Node> nodePool {};
     HazardPointers<Node> hp {2, maxThreads};
     const int kHpTail = 0;
     const int kHpHead = 0;
@@ -95,6 +100,7 @@ private:
 
 public:
     MichaelScottQueue(int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+        if (POOLED) hp.setPool(&nodePool);
         Node* sentinelNode = new Node(nullptr);
         head.store(sentinelNode, std::memory_order_relaxed);
         tail.store(sentinelNode, std::memory_order_relaxed);
@@ -106,11 +112,11 @@ public:
         delete head.load();            // Delete the last node
     }
 
-    std::string className() { return "MichaelScottQueue"; }
+    std::string className() { return POOLED ? "MichaelScottQueue-Pool" : "MichaelScottQueue"; }
 
     void enqueue(T* item, const int tid) {
         if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
-        Node* newNode = new Node(item);
+        Node* newNode = POOLED ? nodePool.create(tid, item) : new Node(item);
         while (true) {
             Node* ltail = hp.protectPtr(kHpTail, tail, tid);
             if (ltail == tail.load()) {
@@ -27,8 +27,10 @@ Due to the usage of <optional>, this needs C++17 to compile
 #include <iostream>
 #include <atomic>
 #include <algorithm>
+#include <functional>
 #include <map>
 #include <optional>
+#include <vector>
 #include "common/HazardPointers.hpp"
 
 
@@ -111,7 +113,11 @@ private:
     /* private interfaces */
     void seek(K key, int tid);
     bool cleanup(K key, int tid);
-    void doRangeQuery(Node& k1, Node& k2, int tid, Node* root, std::map<K,V>& res);
+    Node* seekLeaf(const K* key, K& next, bool& hasNext, bool& isLive, int tid);
+    template<typename F> bool scanLeaves(const K* key1, const K* key2, F&& func, int tid);
+    Node* buildSubtree(const std::pair<K,V>* kvs, size_t num);
+    void deleteSubtree(Node* node);
+    bool bulkLoad(std::vector<std::pair<K,V>>& kvs, int tid);
 public:
     NatarajanTreeHP(const int maxThreads=0) {
         r = new Node(infK,defltV,nullptr,nullptr,2);
@@ -122,6 +128,11 @@ public:
         s->left = new Node(infK,defltV,nullptr,nullptr,0);
         records = new SeekRecord[MAX_THREADS]{};
     };
+
+    // Bulk-load constructor: builds a balanced tree with the (not necessarily sorted) pairs in O(n log n), without any CAS
+    NatarajanTreeHP(std::vector<std::pair<K,V>> kvs, const int maxThreads=0) : NatarajanTreeHP(maxThreads) {
+        bulkLoad(kvs, 0);
+    }
     ~NatarajanTreeHP(){};
 
     std::string className() { return "NatarajanTreeHP"; }
@@ -137,6 +148,7 @@ public:
     bool remove(K key, int tid);
     bool contains(K key, int tid);
     void addAll(K** keys, const int size, const int tid);
+    bool iterate(std::function<bool(K*)> itfun, const int tid, uint64_t itersize, K beginKey);
 };
 
 //-------Definition----------
@@ -534,44 +546,119 @@ std::optional<V> NatarajanTreeHP<K,V>::replace(K key, V val, int tid){
     return res;
 }
 
+/*
+ * Read-only descent to the leaf where key is (or would be), or to the lowest leaf when key is nullptr.
+ * 'next' is the key of the last internal node where the descent went left, which is the lowest key
+ * that can be after this leaf, and isLive is false if the leaf is flagged for removal.
+ * The leaf stays protected until the next call or until the hazard pointers are cleared.
+ */
 template <class K, class V>
-std::map<K, V> NatarajanTreeHP<K,V>::rangeQuery(K key1, K key2, int& len, int tid){
-    //NOT HP-like GC safe.
-    if(key1>key2) return {};
-    Node k1{key1,defltV,nullptr,nullptr};//node to be compared
-    Node k2{key2,defltV,nullptr,nullptr};//node to be compared
+typename NatarajanTreeHP<K,V>::Node* NatarajanTreeHP<K,V>::seekLeaf(const K* key, K& next, bool& hasNext, bool& isLive, int tid){
+    Node keyNode{key == nullptr ? infK : *key,defltV,nullptr,nullptr};//node to be compared
+    hasNext = false;
+    int ihp = 0;
+    Node* currentField = hp.get_protected(ihp, s->left, tid);
+    Node* current = getPtr(currentField);
+    while(true){
+        const bool goLeft = (key == nullptr) || nodeLess(&keyNode,current);
+        /* hand-over-hand: the child goes in the index that protected the parent */
+        ihp = 1 - ihp;
+        Node* childField = hp.get_protected(ihp, goLeft ? current->left : current->right, tid);
+        if(getPtr(childField)==nullptr) break; // current is a leaf
+        if(goLeft && !isInf(current)){
+            next = current->key;
+            hasNext = true;
+        }
+        currentField = childField;
+        current = getPtr(childField);
+    }
+    isLive = !getFlg(currentField);
+    return current;
+}
 
-    Node* leaf = getPtr(hp.get_protected(0, s->left, tid));
-    Node* current = getPtr(hp.get_protected(1, leaf->left, tid));
+/*
+ * Calls func on each live leaf with a key in [key1,key2], in ascending order, until func returns false.
+ * A nullptr key1 starts at the lowest key and a nullptr key2 goes to the highest key.
+ * Each step is a seekLeaf() to the lowest key that can be after the previous leaf, which means that
+ * only two hazard pointers are needed and that we never go up the tree through nodes that may
+ * have been retired. The keys are visited in strictly ascending order and each key that is in the
+ * range during the whole scan is visited, but the scan is not a snapshot of the tree.
+ */
+template <class K, class V>
+template <typename F>
+bool NatarajanTreeHP<K,V>::scanLeaves(const K* key1, const K* key2, F&& func, int tid){
+    K cur{};
+    bool hasNext = true;
+    bool ret = true;
+    for (const K* from = key1; hasNext; from = &cur) {
+        bool isLive;
+        K next{};
+        Node* leaf = seekLeaf(from, next, hasNext, isLive, tid);
+        if(isLive && !isInf(leaf) && (from == nullptr || !(leaf->key < *from))){
+            if(key2 != nullptr && *key2 < leaf->key) break;
+            if(!func(leaf)){
+                ret = false;
+                break;
+            }
+        }
+        if(!hasNext || (key2 != nullptr && *key2 < next)) break;
+        cur = next;
+    }
+    hp.clear(tid);
+    return ret;
+}
 
+template <class K, class V>
+std::map<K, V> NatarajanTreeHP<K,V>::rangeQuery(K key1, K key2, int& len, int tid){
+    if(key1>key2) return {};
     std::map<K,V> res;
-    if(current!=nullptr)
-        doRangeQuery(k1,k2,tid,current,res);
+    scanLeaves(&key1, &key2, [&res](Node* leaf){
+        res.emplace(leaf->key,leaf->val);
+        return true;
+    }, tid);
     len=res.size();
     return res;
 }
 
+/*
+ * Same shape as the trees that insert() makes: the key of an internal node is the key
+ * of the lowest leaf on its right.
+ */
 template <class K, class V>
-void NatarajanTreeHP<K,V>::doRangeQuery(Node& k1, Node& k2, int tid, Node* root, std::map<K,V>& res){
-    Node* left = getPtr(hp.get_protected(2, root->left, tid));
-    Node* right = getPtr(hp.get_protected(3, root->right, tid));
-    if(left==nullptr&&right==nullptr){
-        if(nodeLessEqual(&k1,root)&&nodeLessEqual(root,&k2)){
-            res.emplace(root->key,root->val);
-        }
-        return;
-    }
-    if(left!=nullptr){
-        if(nodeLess(&k1,root)){
-            doRangeQuery(k1,k2,tid,left,res);
-        }
-    }
-    if(right!=nullptr){
-        if(nodeLessEqual(root,&k2)){
-            doRangeQuery(k1,k2,tid,right,res);
-        }
-    }
-    return;
+typename NatarajanTreeHP<K,V>::Node* NatarajanTreeHP<K,V>::buildSubtree(const std::pair<K,V>* kvs, size_t num){
+    if(num==1) return new Node(kvs[0].first,kvs[0].second,nullptr,nullptr);
+    const size_t half = num/2;
+    return new Node(kvs[half].first,defltV,buildSubtree(kvs,half),buildSubtree(kvs+half,num-half));
+}
+
+template <class K, class V>
+void NatarajanTreeHP<K,V>::deleteSubtree(Node* node){
+    if(node==nullptr) return;
+    deleteSubtree(getPtr(node->left.load()));
+    deleteSubtree(getPtr(node->right.load()));
+    delete node;
+}
+
+/*
+ * If the tree is empty, builds a balanced tree with the pairs and publishes it with a single CAS.
+ * Returns false if the tree is not empty (or stopped being empty), and then nothing is inserted.
+ */
+template <class K, class V>
+bool NatarajanTreeHP<K,V>::bulkLoad(std::vector<std::pair<K,V>>& kvs, int tid){
+    std::sort(kvs.begin(), kvs.end(), [](const std::pair<K,V>& a, const std::pair<K,V>& b){ return a.first < b.first; });
+    kvs.erase(std::unique(kvs.begin(), kvs.end(), [](const std::pair<K,V>& a, const std::pair<K,V>& b){ return a.first == b.first; }), kvs.end());
+    if(kvs.size()==0) return true;
+    /* the tree is empty only when the left child of s is the inf0 leaf, which is never retired */
+    Node* lleaf = hp.get_protected(0, s->left, tid);
+    const bool isEmpty = getPtr(lleaf)->left.load()==nullptr;
+    hp.clear(tid);
+    if(!isEmpty) return false;
+    Node* subtree = buildSubtree(kvs.data(), kvs.size());
+    Node* newInternal = new Node(infK,defltV,subtree,getPtr(lleaf),0);
+    if(s->left.compare_exchange_strong(lleaf,newInternal,std::memory_order_acq_rel)) return true;
+    deleteSubtree(subtree);
+    delete newInternal;
+    return false;
 }
 
 
@@ -591,10 +678,33 @@ bool NatarajanTreeHP<K,V>::contains(K key, int tid) {
     return get(key,tid).has_value();
 }
 
-// Not lock-free
+// Bulk-loads the keys if the tree is empty, otherwise adds them one at a time
 template <class K, class V>
 void NatarajanTreeHP<K,V>::addAll(K** keys, const int size, const int tid) {
+    std::vector<std::pair<K,V>> kvs;
+    kvs.reserve(size);
+    for (int i = 0; i < size; i++) kvs.emplace_back(*keys[i], *keys[i]);
+    if (bulkLoad(kvs, tid)) return;
     for (int i = 0; i < size; i++) add(*keys[i], tid);
 }
 
+// Same as TreeSet::iterate(), when it reaches the end it continues from the lowest key
+template <class K, class V>
+bool NatarajanTreeHP<K,V>::iterate(std::function<bool(K*)> itfun, const int tid, uint64_t itersize, K beginKey) {
+    if (itersize == 0) return true;
+    uint64_t i = 0;
+    bool stopped = false;
+    auto visit = [&itfun,&i,&stopped,&itersize](Node* leaf) {
+        K key = leaf->key;
+        if (!itfun(&key)) {
+            stopped = true;
+            return false;
+        }
+        return ++i < itersize;
+    };
+    scanLeaves(&beginKey, nullptr, visit, tid);
+    if (!stopped && i < itersize) scanLeaves(nullptr, nullptr, visit, tid);
+    return !stopped;
+}
+
 #endif
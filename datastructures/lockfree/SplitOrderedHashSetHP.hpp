@@ -0,0 +1,332 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _SPLIT_ORDERED_HASH_SET_HP_H_
+#define _SPLIT_ORDERED_HASH_SET_HP_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>   // For std::hash
+#include <string>
+#include "common/HazardPointers.hpp"
+
+/**
+ * <h1> Split-Ordered Hash Set with Hazard Pointers </h1>
+ *
+ * Lock-free resizable hash set by Ori Shalev and Nir Shavit: all the keys are in
+ * a single Maged-Harris linked list, sorted by the bit-reversed hash of the key
+ * (the split-order), and each bucket is a pointer to a dummy node in that list.
+ * Doubling the number of buckets doesn't move any node, the new buckets are
+ * initialized lazily, the first time they're used, by inserting their dummy node
+ * after the dummy node of their parent bucket (the bucket index without its
+ * highest bit).
+ *
+ * The buckets are kept in segments of increasing size (the first one has
+ * FIRST_SEGMENT_SIZE buckets and each following segment doubles the table), which
+ * are allocated when the first bucket in them is initialized, so the bucket table
+ * never has to be copied. The table doubles when there are more than MAX_LOAD
+ * keys per bucket on average. The number of keys is counted by each thread and
+ * added to the shared counter once every COUNT_BATCH changes, so that add() and
+ * remove() don't all hit the same cache line. The table never shrinks.
+ *
+ * Dummy nodes are never removed, which means that a traversal can always start
+ * from a dummy node without protecting it. The other nodes are reclaimed with
+ * Hazard Pointers, the same way as in MagedHarrisHashSetHP.
+ *
+ * This set has three operations:
+ * <ul>
+ * <li>add(x)      - Lock-Free
+ * <li>remove(x)   - Lock-Free
+ * <li>contains(x) - Lock-Free
+ * </ul><p>
+ *
+ * Split-Ordered Lists: Lock-Free Extensible Hash Tables:
+ * https://dl.acm.org/citation.cfm?id=1147958
+ */
+template<typename T>
+class SplitOrderedHashSetHP {
+
+private:
+    static const uint64_t FIRST_SEGMENT_SIZE = 1024;
+    static const int      MAX_SEGMENTS = 24;         // Up to FIRST_SEGMENT_SIZE*2^23 buckets
+    static const uint64_t MAX_BUCKETS = FIRST_SEGMENT_SIZE << (MAX_SEGMENTS-1);
+    static const uint64_t MAX_LOAD = 2;
+    static const int64_t  COUNT_BATCH = 64;
+    static const uint64_t HASH_MASK = 0x7FFFFFFFFFFFFFFFULL;   // The highest bit is used to tell apart the dummy nodes
+
+    struct Node {
+        const uint64_t     soKey;    // Split-order key, the lowest bit is 1 for regular nodes and 0 for dummy nodes
+        T                  key;
+        std::atomic<Node*> next {nullptr};
+
+        Node(uint64_t soKey, T key) : soKey{soKey}, key{key} { }
+    };
+
+    struct alignas(128) LocalCount {
+        int64_t count {0};
+    };
+
+    const int maxThreads;
+
+    alignas(128) std::atomic<std::atomic<Node*>*> segments[MAX_SEGMENTS];
+    alignas(128) std::atomic<uint64_t>            numBuckets {FIRST_SEGMENT_SIZE};  // Always a power of two
+    alignas(128) std::atomic<int64_t>             numKeys {0};
+    LocalCount*                                   localCounts;    // maxThreads entries
+
+    // We need 3 hazard pointers
+    HazardPointers<Node> hp {3, maxThreads};
+    const int kHpNext = 0;
+    const int kHpCurr = 1;
+    const int kHpPrev = 2;
+
+    static inline uint64_t reverseBits(uint64_t x) {
+        x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+        x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+        x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+        return __builtin_bswap64(x);
+    }
+
+    static inline uint64_t hashOf(const T& key) { return std::hash<T>{}(key) & HASH_MASK; }
+    static inline uint64_t regularKey(uint64_t hash) { return reverseBits(hash | ~HASH_MASK); }
+    static inline uint64_t dummyKey(uint64_t bucket) { return reverseBits(bucket); }
+    static inline bool     isDummy(uint64_t soKey) { return (soKey & 1) == 0; }
+
+    // Order of the list: by split-order key, and then by key for regular nodes with the same hash
+    static inline bool lessThan(Node* node, uint64_t soKey, const T& key) {
+        if (node->soKey != soKey) return node->soKey < soKey;
+        return !isDummy(soKey) && node->key < key;
+    }
+
+    static inline bool isEqual(Node* node, uint64_t soKey, const T& key) {
+        return node->soKey == soKey && (isDummy(soKey) || node->key == key);
+    }
+
+    // Returns the entry of the bucket table, allocating its segment if needed
+    std::atomic<Node*>& bucketSlot(uint64_t bucket) {
+        int iseg = 0;
+        uint64_t offset = bucket;
+        uint64_t segSize = FIRST_SEGMENT_SIZE;
+        if (bucket >= FIRST_SEGMENT_SIZE) {
+            iseg = 64 - __builtin_clzll(bucket / FIRST_SEGMENT_SIZE);
+            segSize = FIRST_SEGMENT_SIZE << (iseg-1);
+            offset = bucket - segSize;
+        }
+        std::atomic<Node*>* seg = segments[iseg].load();
+        if (seg == nullptr) {
+            std::atomic<Node*>* newSeg = new std::atomic<Node*>[segSize];
+            for (uint64_t i = 0; i < segSize; i++) newSeg[i].store(nullptr, std::memory_order_relaxed);
+            if (segments[iseg].compare_exchange_strong(seg, newSeg)) {
+                seg = newSeg;
+            } else {
+                delete[] newSeg;
+            }
+        }
+        return seg[offset];
+    }
+
+    // Dummy node of the bucket, inserting it in the list if this is the first time the bucket is used
+    Node* getBucket(uint64_t bucket, const int tid) {
+        std::atomic<Node*>& slot = bucketSlot(bucket);
+        Node* dummy = slot.load();
+        if (dummy != nullptr) return dummy;
+        // The parent bucket is the same bucket index without the highest bit
+        Node* parent = getBucket(bucket & ~(1ULL << (63 - __builtin_clzll(bucket))), tid);
+        const uint64_t soKey = dummyKey(bucket);
+        Node* newDummy = new Node(soKey, T{});
+        std::atomic<Node*>* prev;
+        Node *curr, *next;
+        while (true) {
+            if (find(parent, soKey, newDummy->key, &prev, &curr, &next, tid)) {
+                delete newDummy;        // Another thread inserted it, and dummy nodes are never removed
+                newDummy = curr;
+                break;
+            }
+            newDummy->next.store(curr, std::memory_order_relaxed);
+            Node* tmp = curr;
+            if (prev->compare_exchange_strong(tmp, newDummy)) break;
+        }
+        hp.clear(tid);
+        slot.store(newDummy, std::memory_order_release);
+        return newDummy;
+    }
+
+    // Counts the keys in batches, and doubles the number of buckets when the load is too high
+    void updateCount(const int delta, const int tid) {
+        int64_t& lcount = localCounts[tid].count;
+        lcount += delta;
+        if (lcount < COUNT_BATCH && lcount > -COUNT_BATCH) return;
+        const int64_t total = numKeys.fetch_add(lcount) + lcount;
+        lcount = 0;
+        uint64_t lbuckets = numBuckets.load();
+        if (total > 0 && (uint64_t)total > lbuckets*MAX_LOAD && lbuckets < MAX_BUCKETS) {
+            numBuckets.compare_exchange_strong(lbuckets, 2*lbuckets);
+        }
+    }
+
+    /**
+     * Maged Michael's find(), starting from the dummy node 'start'.
+     * Returns true if the key is in the list, in which case it is in *par_curr.
+     * Otherwise, *par_curr is the first node after the key, and *par_prev the link to it.
+     * <p>
+     * Progress Condition: Lock-Free
+     */
+    bool find(Node* start, uint64_t soKey, const T& key, std::atomic<Node*>** par_prev, Node** par_curr, Node** par_next, const int tid) {
+        std::atomic<Node*>* prev;
+        Node *curr, *next;
+     try_again:
+        prev = &start->next;    // Dummy nodes are never marked
+        curr = hp.protectPtr(kHpCurr, prev->load(), tid);
+        if (prev->load() != curr) goto try_again;
+        while (true) {
+            if (curr == nullptr) {
+                next = nullptr;
+                break;
+            }
+            next = curr->next.load();
+            hp.protectPtr(kHpNext, getUnmarked(next), tid);
+            if (curr->next.load() != next) goto try_again;
+            if (prev->load() != curr) goto try_again;
+            if (isMarked(next)) {
+                // Unlink curr and retire it
+                Node* tmp = curr;
+                if (!prev->compare_exchange_strong(tmp, getUnmarked(next))) goto try_again;
+                hp.retire(curr, tid);
+                curr = hp.protectPtr(kHpCurr, getUnmarked(next), tid);
+                continue;
+            }
+            if (!lessThan(curr, soKey, key)) {
+                *par_prev = prev;
+                *par_curr = curr;
+                *par_next = next;
+                return isEqual(curr, soKey, key);
+            }
+            prev = &curr->next;
+            hp.protectPtr(kHpPrev, curr, tid);
+            curr = hp.protectPtr(kHpCurr, next, tid);
+        }
+        *par_prev = prev;
+        *par_curr = curr;
+        *par_next = next;
+        return false;
+    }
+
+    inline bool isMarked(Node* node) {
+        return ((size_t)node & 0x1);
+    }
+
+    inline Node* getMarked(Node* node) {
+        return (Node*)((size_t)node | 0x1);
+    }
+
+    inline Node* getUnmarked(Node* node) {
+        return (Node*)((size_t)node & (~0x1));
+    }
+
+public:
+    SplitOrderedHashSetHP(const int maxThreads) : maxThreads{maxThreads} {
+        for (int i = 0; i < MAX_SEGMENTS; i++) segments[i].store(nullptr, std::memory_order_relaxed);
+        localCounts = new LocalCount[maxThreads];
+        // Bucket zero is the head of the list
+        bucketSlot(0).store(new Node(dummyKey(0), T{}));
+    }
+
+    // We don't expect the destructor to be called if this instance can still be in use
+    ~SplitOrderedHashSetHP() {
+        Node* node = bucketSlot(0).load();
+        while (node != nullptr) {
+            Node* lnext = getUnmarked(node->next.load());
+            delete node;
+            node = lnext;
+        }
+        for (int i = 0; i < MAX_SEGMENTS; i++) delete[] segments[i].load();
+        delete[] localCounts;
+    }
+
+    static std::string className() { return "SplitOrdered-HashSetHP"; }
+
+    /*
+     * This function is single threaded to be called at the start of the test.
+     */
+    void addAll(T** keys, const int size, const int tid) {
+        for (int i = 0; i < size; i++) add(*keys[i], tid);
+    }
+
+    /**
+     * Progress Condition: Lock-Free
+     */
+    bool add(T key, const int tid) {
+        const uint64_t hash = hashOf(key);
+        const uint64_t soKey = regularKey(hash);
+        Node* bucket = getBucket(hash & (numBuckets.load()-1), tid);
+        Node* newNode = new Node(soKey, key);
+        std::atomic<Node*>* prev;
+        Node *curr, *next;
+        while (true) {
+            if (find(bucket, soKey, key, &prev, &curr, &next, tid)) {
+                delete newNode;              // There is already a matching key
+                hp.clear(tid);
+                return false;
+            }
+            newNode->next.store(curr, std::memory_order_relaxed);
+            Node* tmp = curr;
+            if (prev->compare_exchange_strong(tmp, newNode)) {
+                hp.clear(tid);
+                updateCount(1, tid);
+                return true;
+            }
+        }
+    }
+
+    /**
+     * Progress Condition: Lock-Free
+     */
+    bool remove(T key, const int tid) {
+        const uint64_t hash = hashOf(key);
+        const uint64_t soKey = regularKey(hash);
+        Node* bucket = getBucket(hash & (numBuckets.load()-1), tid);
+        std::atomic<Node*>* prev;
+        Node *curr, *next;
+        while (true) {
+            if (!find(bucket, soKey, key, &prev, &curr, &next, tid)) {
+                hp.clear(tid);
+                return false;
+            }
+            // Mark curr->next, which is the logical removal
+            Node* tmp = next;
+            if (!curr->next.compare_exchange_strong(tmp, getMarked(next))) continue;
+            tmp = curr;
+            if (prev->compare_exchange_strong(tmp, next)) {
+                hp.clear(tid);
+                hp.retire(curr, tid);
+            } else {
+                hp.clear(tid);       // A later find() will unlink it
+            }
+            updateCount(-1, tid);
+            return true;
+        }
+    }
+
+    /**
+     * Progress Condition: Lock-Free
+     */
+    bool contains(T key, const int tid) {
+        const uint64_t hash = hashOf(key);
+        const uint64_t soKey = regularKey(hash);
+        Node* bucket = getBucket(hash & (numBuckets.load()-1), tid);
+        std::atomic<Node*>* prev;
+        Node *curr, *next;
+        const bool isContains = find(bucket, soKey, key, &prev, &curr, &next, tid);
+        hp.clear(tid);
+        return isContains;
+    }
+
+    // Current number of buckets (they're initialized lazily)
+    uint64_t getNumBuckets() const { return numBuckets.load(); }
+};
+
+#endif /* _SPLIT_ORDERED_HASH_SET_HP_H_ */
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _SEQUENTIAL_ARRAY_QUEUE_H_
+#define _SEQUENTIAL_ARRAY_QUEUE_H_
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+/**
+ * <h1> A sequential implementation of an Array Queue </h1>
+ *
+ * This is meant to be used by the Universal Constructs, as a drop-in replacement
+ * for LinkedListQueue. The items are in a ring buffer whose capacity is a power of
+ * two, which doubles when it is full, so an enqueue doesn't allocate anything in
+ * the steady state, and dequeue() doesn't free anything.
+ * The copy constructor copies only the occupied slots (at most two memcpy(), when
+ * the items wrap around the end of the buffer) into a buffer that is sized for the
+ * current number of items, not for the capacity of the original, so the copy of a
+ * queue that was once big and is now small is cheap too.
+ * The buffer is allocated with ALLOC, e.g. ArenaAllocator<T> for ArenaReplicas.
+ */
+template<typename T, typename ALLOC = std::allocator<T>>
+class ArrayQueue {
+
+private:
+    static const uint64_t MIN_CAPACITY = 64;
+
+    using ItemAlloc = typename std::allocator_traits<ALLOC>::template rebind_alloc<T*>;
+    using ItemTraits = std::allocator_traits<ItemAlloc>;
+    ItemAlloc itemAlloc;
+
+    T**      items {nullptr};
+    uint64_t capacity {0};
+    uint64_t head {0};           // Index of the next item to dequeue, not wrapped
+    uint64_t tail {0};           // Index of the next free slot, not wrapped
+
+    // Copies the items of 'from' to the start of newItems
+    static void copyItems(T** newItems, T** fromItems, uint64_t fromCapacity, uint64_t fromHead, uint64_t fromTail) {
+        const uint64_t num = fromTail - fromHead;
+        const uint64_t first = fromHead & (fromCapacity-1);
+        const uint64_t firstNum = (first + num <= fromCapacity) ? num : fromCapacity - first;
+        std::memcpy(newItems, fromItems + first, firstNum*sizeof(T*));
+        std::memcpy(newItems + firstNum, fromItems, (num - firstNum)*sizeof(T*));
+    }
+
+    static uint64_t capacityFor(uint64_t num) {
+        uint64_t lcapacity = MIN_CAPACITY;
+        while (lcapacity < 2*num) lcapacity *= 2;
+        return lcapacity;
+    }
+
+    void resize(uint64_t newCapacity) {
+        T** newItems = ItemTraits::allocate(itemAlloc, newCapacity);
+        copyItems(newItems, items, capacity, head, tail);
+        ItemTraits::deallocate(itemAlloc, items, capacity);
+        tail = tail - head;
+        head = 0;
+        items = newItems;
+        capacity = newCapacity;
+    }
+
+public:
+    ArrayQueue(unsigned int maxThreads=0) {
+        capacity = MIN_CAPACITY;
+        items = ItemTraits::allocate(itemAlloc, capacity);
+    }
+
+
+    // Universal Constructs need a copy constructor on the underlying data structure
+    ArrayQueue(const ArrayQueue& other) {
+        capacity = capacityFor(other.tail - other.head);
+        items = ItemTraits::allocate(itemAlloc, capacity);
+        copyItems(items, other.items, other.capacity, other.head, other.tail);
+        head = 0;
+        tail = other.tail - other.head;
+    }
+
+    ArrayQueue& operator=(const ArrayQueue& other) = delete;
+
+
+    ~ArrayQueue() {
+        ItemTraits::deallocate(itemAlloc, items, capacity);
+    }
+
+
+    static std::string className() { return "ArrayQueue"; }
+
+
+    bool enqueue(T* item, const int tid=0) {
+        if (item == nullptr) return false;
+        if (tail - head == capacity) resize(2*capacity);
+        items[tail & (capacity-1)] = item;
+        tail++;
+        return true;
+    }
+
+
+    T* dequeue(const int tid=0) {
+        if (head == tail) return nullptr;
+        T* item = items[head & (capacity-1)];
+        head++;
+        return item;
+    }
+
+
+    uint64_t size() const { return tail - head; }
+};
+
+#endif /* _SEQUENTIAL_ARRAY_QUEUE_H_ */
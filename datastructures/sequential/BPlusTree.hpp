@@ -0,0 +1,649 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _CX_BPLUS_TREE_H_
+#define _CX_BPLUS_TREE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "../../common/ParallelCopy.hpp"
+
+/**
+ * <h1> B+Tree (sequential) </h1>
+ *
+ * A B+tree meant to be used with the Universal Constructs, where the object is
+ * copied as a whole and the lookups dominate:
+ * - All the leaves are in one std::vector and all the inner nodes in another, and
+ *   the nodes point to each other with 32 bit indexes instead of pointers. The copy
+ *   constructor is the default one, i.e. two contiguous copies of the arrays of
+ *   nodes, which is a memcpy() when K and V are trivially copyable;
+ * - Each node takes about NODE_BYTES bytes (a few cache lines) with the keys in a
+ *   contiguous array. When K is small (up to 16 bytes) the search in a node is a
+ *   branchless count of the smaller keys, which the compiler vectorizes when K is
+ *   an arithmetic type, and it is a binary search (std::lower_bound) otherwise;
+ * - The leaves are linked in order for iterations;
+ * - The nodes freed by merges are kept in a free list and reused.
+ *
+ * Nodes are merged or rebalanced with a sibling when they are less than a
+ * quarter full, so there is some slack before nodes are merged back.
+ *
+ * containsBatch() and getBatch() do the lookups of many keys with group
+ * prefetching: a group of keys goes down the tree one level at a time, and the
+ * nodes of the next level are prefetched for the whole group before any of them
+ * is searched, so that the cache misses of the keys overlap.
+ *
+ * BPlusTreeSet<K> has the same interface as TreeSet and BPlusTreeMap<K,V> has the
+ * interface of the maps in UCMap. K must be default constructible, copyable and
+ * have operator<, and so must V.
+ */
+
+// Used as the value of the tree in BPlusTreeSet, it takes no space in the leaves
+struct BPlusTreeNoValue { };
+
+template<typename V, int N> struct BPlusTreeValues {
+    V vals[N];
+    inline V& at(const int i) { return vals[i]; }
+    inline const V& at(const int i) const { return vals[i]; }
+};
+
+template<int N> struct BPlusTreeValues<BPlusTreeNoValue,N> {
+    inline BPlusTreeNoValue at(const int i) const { return {}; }
+};
+
+template<typename V> struct BPlusTreeValueSize { static constexpr int value = sizeof(V); };
+template<> struct BPlusTreeValueSize<BPlusTreeNoValue> { static constexpr int value = 0; };
+
+
+template<typename K, typename V>
+class BPlusTree {
+
+private:
+    static constexpr int      NODE_BYTES = 512;
+    static constexpr int      LEAF_CAP = std::max<int>(8, NODE_BYTES/(sizeof(K)+BPlusTreeValueSize<V>::value));
+    static constexpr int      INNER_CAP = std::max<int>(8, NODE_BYTES/(sizeof(K)+sizeof(uint32_t)));
+    static constexpr int      LEAF_MIN = LEAF_CAP/4;
+    static constexpr int      INNER_MIN = INNER_CAP/4;
+    static constexpr int      BULK_LEAF = LEAF_CAP*3/4;         // Keys per leaf in build()
+    static constexpr int      BULK_INNER = (INNER_CAP+1)*3/4;   // Children per inner node in build()
+    static constexpr int      BATCH_GROUP = 8;                  // Lookups that go down the tree together in findBatch()
+    static constexpr uint32_t NONE = UINT32_MAX;
+    static constexpr bool     HAS_VALUES = !std::is_same<V,BPlusTreeNoValue>::value;
+    static constexpr bool     LINEAR_SEARCH = std::is_arithmetic<K>::value || sizeof(K) <= 16;
+
+    struct Leaf {
+        int                        count {0};
+        uint32_t                   next {NONE};     // Leaf with the next keys
+        K                          keys[LEAF_CAP];
+        BPlusTreeValues<V,LEAF_CAP> vals;
+    };
+
+    struct Inner {
+        int                        count {0};       // Number of keys, there are count+1 children
+        K                          keys[INNER_CAP]; // All keys in children[i+1] are >= keys[i]
+        uint32_t                   children[INNER_CAP+1];
+    };
+
+    std::vector<Leaf>     leaves;
+    std::vector<Inner>    inners;
+    std::vector<uint32_t> freeLeaves;
+    std::vector<uint32_t> freeInners;
+    uint32_t              root;
+    int                   height {0};   // Zero means the root is a leaf
+    uint64_t              numKeys {0};
+
+    // Index of the first key that is not smaller than key, or count if there is none
+    static inline int lowerBound(const K* keys, const int count, const K& key) {
+        if constexpr (LINEAR_SEARCH) {
+            int pos = 0;
+            for (int i = 0; i < count; i++) pos += (keys[i] < key);
+            return pos;
+        }
+        return std::lower_bound(keys, keys+count, key) - keys;
+    }
+
+    // Index of the first key that is larger than key, or count if there is none
+    static inline int upperBound(const K* keys, const int count, const K& key) {
+        if constexpr (LINEAR_SEARCH) {
+            int pos = 0;
+            for (int i = 0; i < count; i++) pos += !(key < keys[i]);
+            return pos;
+        }
+        return std::upper_bound(keys, keys+count, key) - keys;
+    }
+
+    uint32_t newLeaf() {
+        if (!freeLeaves.empty()) {
+            uint32_t idx = freeLeaves.back();
+            freeLeaves.pop_back();
+            leaves[idx].count = 0;
+            leaves[idx].next = NONE;
+            return idx;
+        }
+        leaves.emplace_back();
+        return leaves.size()-1;
+    }
+
+    uint32_t newInner() {
+        if (!freeInners.empty()) {
+            uint32_t idx = freeInners.back();
+            freeInners.pop_back();
+            inners[idx].count = 0;
+            return idx;
+        }
+        inners.emplace_back();
+        return inners.size()-1;
+    }
+
+    uint32_t findLeaf(const K& key) const {
+        uint32_t idx = root;
+        for (int level = height; level > 0; level--) {
+            const Inner& in = inners[idx];
+            idx = in.children[upperBound(in.keys, in.count, key)];
+        }
+        return idx;
+    }
+
+    uint32_t firstLeaf() const {
+        uint32_t idx = root;
+        for (int level = height; level > 0; level--) idx = inners[idx].children[0];
+        return idx;
+    }
+
+    /*
+     * Inserts key in the subtree of nodeIdx, returning true if it is a new key.
+     * If the node had to be split, splitNode is the new node on the right, and splitKey its lowest key.
+     * Nodes are always accessed by index because new nodes may reallocate the vectors.
+     */
+    bool insertRec(uint32_t nodeIdx, int level, const K& key, const V& val, bool overwrite, std::optional<V>* oldVal, uint32_t& splitNode, K& splitKey) {
+        splitNode = NONE;
+        if (level == 0) {
+            int pos = lowerBound(leaves[nodeIdx].keys, leaves[nodeIdx].count, key);
+            if (pos < leaves[nodeIdx].count && !(key < leaves[nodeIdx].keys[pos])) {
+                if constexpr (HAS_VALUES) {
+                    if (oldVal != nullptr) *oldVal = leaves[nodeIdx].vals.at(pos);
+                    if (overwrite) setValue(leaves[nodeIdx], pos, val);
+                }
+                return false;
+            }
+            uint32_t target = nodeIdx;
+            if (leaves[nodeIdx].count == LEAF_CAP) {
+                splitNode = newLeaf();
+                Leaf& left = leaves[nodeIdx];
+                Leaf& right = leaves[splitNode];
+                const int mid = LEAF_CAP/2;
+                right.count = LEAF_CAP - mid;
+                for (int i = 0; i < right.count; i++) {
+                    right.keys[i] = left.keys[mid+i];
+                    setValue(right, i, left.vals.at(mid+i));
+                }
+                left.count = mid;
+                right.next = left.next;
+                left.next = splitNode;
+                if (pos > mid) {
+                    target = splitNode;
+                    pos -= mid;
+                }
+            }
+            Leaf& leaf = leaves[target];
+            for (int i = leaf.count; i > pos; i--) {
+                leaf.keys[i] = leaf.keys[i-1];
+                setValue(leaf, i, leaf.vals.at(i-1));
+            }
+            leaf.keys[pos] = key;
+            setValue(leaf, pos, val);
+            leaf.count++;
+            if (splitNode != NONE) splitKey = leaves[splitNode].keys[0];
+            return true;
+        }
+        int ichild = upperBound(inners[nodeIdx].keys, inners[nodeIdx].count, key);
+        uint32_t childSplit;
+        K childKey;
+        if (!insertRec(inners[nodeIdx].children[ichild], level-1, key, val, overwrite, oldVal, childSplit, childKey)) return false;
+        if (childSplit == NONE) return true;
+        uint32_t target = nodeIdx;
+        if (inners[nodeIdx].count == INNER_CAP) {
+            splitNode = newInner();
+            Inner& left = inners[nodeIdx];
+            Inner& right = inners[splitNode];
+            const int mid = INNER_CAP/2;
+            splitKey = left.keys[mid];
+            right.count = INNER_CAP - mid - 1;
+            for (int i = 0; i < right.count; i++) right.keys[i] = left.keys[mid+1+i];
+            for (int i = 0; i <= right.count; i++) right.children[i] = left.children[mid+1+i];
+            left.count = mid;
+            if (ichild > mid) {
+                target = splitNode;
+                ichild -= mid+1;
+            }
+        }
+        Inner& in = inners[target];
+        for (int i = in.count; i > ichild; i--) {
+            in.keys[i] = in.keys[i-1];
+            in.children[i+1] = in.children[i];
+        }
+        in.keys[ichild] = childKey;
+        in.children[ichild+1] = childSplit;
+        in.count++;
+        return true;
+    }
+
+    inline void setValue(Leaf& leaf, const int i, const V& val) {
+        if constexpr (HAS_VALUES) leaf.vals.at(i) = val;
+    }
+
+    // Removes key from the subtree of nodeIdx, returning true if it was there
+    bool removeRec(uint32_t nodeIdx, int level, const K& key, std::optional<V>* oldVal) {
+        if (level == 0) {
+            Leaf& leaf = leaves[nodeIdx];
+            const int pos = lowerBound(leaf.keys, leaf.count, key);
+            if (pos == leaf.count || key < leaf.keys[pos]) return false;
+            if constexpr (HAS_VALUES) {
+                if (oldVal != nullptr) *oldVal = leaf.vals.at(pos);
+            }
+            for (int i = pos; i < leaf.count-1; i++) {
+                leaf.keys[i] = leaf.keys[i+1];
+                setValue(leaf, i, leaf.vals.at(i+1));
+            }
+            leaf.count--;
+            return true;
+        }
+        const int ichild = upperBound(inners[nodeIdx].keys, inners[nodeIdx].count, key);
+        const uint32_t child = inners[nodeIdx].children[ichild];
+        if (!removeRec(child, level-1, key, oldVal)) return false;
+        const int childCount = (level == 1) ? leaves[child].count : inners[child].count;
+        if (childCount < ((level == 1) ? LEAF_MIN : INNER_MIN)) rebalance(nodeIdx, ichild, level-1);
+        return true;
+    }
+
+    // Merges the child ichild of parentIdx with a sibling, or moves keys from the sibling if they don't fit in one node
+    void rebalance(uint32_t parentIdx, int ichild, int childLevel) {
+        Inner& parent = inners[parentIdx];
+        if (parent.count == 0) return;
+        const int isep = (ichild < parent.count) ? ichild : ichild-1;
+        const uint32_t leftIdx = parent.children[isep];
+        const uint32_t rightIdx = parent.children[isep+1];
+        if (childLevel == 0) {
+            Leaf& left = leaves[leftIdx];
+            Leaf& right = leaves[rightIdx];
+            if (left.count + right.count <= LEAF_CAP) {
+                for (int i = 0; i < right.count; i++) {
+                    left.keys[left.count+i] = right.keys[i];
+                    setValue(left, left.count+i, right.vals.at(i));
+                }
+                left.count += right.count;
+                left.next = right.next;
+                removeFromParent(parent, isep);
+                freeLeaves.push_back(rightIdx);
+                return;
+            }
+            const int total = left.count + right.count;
+            const int newLeft = total/2;
+            if (left.count < newLeft) {
+                const int n = newLeft - left.count;
+                for (int i = 0; i < n; i++) {
+                    left.keys[left.count+i] = right.keys[i];
+                    setValue(left, left.count+i, right.vals.at(i));
+                }
+                for (int i = 0; i < right.count-n; i++) {
+                    right.keys[i] = right.keys[i+n];
+                    setValue(right, i, right.vals.at(i+n));
+                }
+                right.count -= n;
+                left.count = newLeft;
+            } else {
+                const int n = left.count - newLeft;
+                for (int i = right.count-1; i >= 0; i--) {
+                    right.keys[i+n] = right.keys[i];
+                    setValue(right, i+n, right.vals.at(i));
+                }
+                for (int i = 0; i < n; i++) {
+                    right.keys[i] = left.keys[newLeft+i];
+                    setValue(right, i, left.vals.at(newLeft+i));
+                }
+                right.count += n;
+                left.count = newLeft;
+            }
+            parent.keys[isep] = right.keys[0];
+            return;
+        }
+        Inner& left = inners[leftIdx];
+        Inner& right = inners[rightIdx];
+        if (left.count + right.count + 1 <= INNER_CAP) {
+            left.keys[left.count] = parent.keys[isep];
+            for (int i = 0; i < right.count; i++) left.keys[left.count+1+i] = right.keys[i];
+            for (int i = 0; i <= right.count; i++) left.children[left.count+1+i] = right.children[i];
+            left.count += right.count + 1;
+            removeFromParent(parent, isep);
+            freeInners.push_back(rightIdx);
+            return;
+        }
+        // Rotate the keys through the separator in the parent
+        K keys[2*INNER_CAP+1];
+        uint32_t children[2*INNER_CAP+2];
+        int nkeys = 0, nchildren = 0;
+        for (int i = 0; i < left.count; i++) keys[nkeys++] = left.keys[i];
+        keys[nkeys++] = parent.keys[isep];
+        for (int i = 0; i < right.count; i++) keys[nkeys++] = right.keys[i];
+        for (int i = 0; i <= left.count; i++) children[nchildren++] = left.children[i];
+        for (int i = 0; i <= right.count; i++) children[nchildren++] = right.children[i];
+        const int newLeft = nkeys/2;
+        left.count = newLeft;
+        for (int i = 0; i < newLeft; i++) left.keys[i] = keys[i];
+        for (int i = 0; i <= newLeft; i++) left.children[i] = children[i];
+        parent.keys[isep] = keys[newLeft];
+        right.count = nkeys - newLeft - 1;
+        for (int i = 0; i < right.count; i++) right.keys[i] = keys[newLeft+1+i];
+        for (int i = 0; i <= right.count; i++) right.children[i] = children[newLeft+1+i];
+    }
+
+    // Removes keys[isep] and children[isep+1] from parent
+    static inline void removeFromParent(Inner& parent, const int isep) {
+        for (int i = isep; i < parent.count-1; i++) {
+            parent.keys[i] = parent.keys[i+1];
+            parent.children[i+1] = parent.children[i+2];
+        }
+        parent.count--;
+    }
+
+protected:
+    bool insert(const K& key, const V& val, bool overwrite, std::optional<V>* oldVal) {
+        uint32_t splitNode;
+        K splitKey;
+        if (!insertRec(root, height, key, val, overwrite, oldVal, splitNode, splitKey)) return false;
+        numKeys++;
+        if (splitNode != NONE) {
+            const uint32_t newRoot = newInner();
+            Inner& in = inners[newRoot];
+            in.count = 1;
+            in.keys[0] = splitKey;
+            in.children[0] = root;
+            in.children[1] = splitNode;
+            root = newRoot;
+            height++;
+        }
+        return true;
+    }
+
+    bool erase(const K& key, std::optional<V>* oldVal) {
+        if (!removeRec(root, height, key, oldVal)) return false;
+        numKeys--;
+        if (height > 0 && inners[root].count == 0) {
+            freeInners.push_back(root);
+            root = inners[root].children[0];
+            height--;
+        }
+        return true;
+    }
+
+    // Returns the leaf and the position of key, or NONE if it is not in the tree
+    std::pair<uint32_t,int> find(const K& key) const {
+        const uint32_t idx = findLeaf(key);
+        const Leaf& leaf = leaves[idx];
+        const int pos = lowerBound(leaf.keys, leaf.count, key);
+        if (pos == leaf.count || key < leaf.keys[pos]) return {NONE, 0};
+        return {idx, pos};
+    }
+
+    inline V valueAt(const std::pair<uint32_t,int>& lpos) const { return leaves[lpos.first].vals.at(lpos.second); }
+
+    // Prefetches the count and the keys of a node, which is what the search in the node reads
+    template<typename N> static inline void prefetchKeys(const N& node) {
+        const char* end = (const char*)(node.keys + (sizeof(node.keys)/sizeof(K)));
+        for (const char* ptr = (const char*)&node; ptr < end; ptr += 64) __builtin_prefetch(ptr);
+    }
+
+    /*
+     * Calls onKey(i, lpos) for each of the n keys, where lpos is what find(keys[i]) returns.
+     * The keys are looked up in groups of BATCH_GROUP, one level of the tree at a time for the
+     * whole group, and the nodes of the next level are prefetched as soon as they are known.
+     */
+    template<typename F> void findBatch(const K* keys, const uint64_t n, F&& onKey) const {
+        uint32_t idx[BATCH_GROUP];
+        for (uint64_t first = 0; first < n; first += BATCH_GROUP) {
+            const int num = (int)std::min<uint64_t>(BATCH_GROUP, n - first);
+            for (int i = 0; i < num; i++) idx[i] = root;
+            for (int level = height; level > 0; level--) {
+                for (int i = 0; i < num; i++) {
+                    const Inner& in = inners[idx[i]];
+                    idx[i] = in.children[upperBound(in.keys, in.count, keys[first+i])];
+                    if (level > 1) prefetchKeys(inners[idx[i]]);
+                    else prefetchKeys(leaves[idx[i]]);
+                }
+            }
+            for (int i = 0; i < num; i++) {
+                const K& key = keys[first+i];
+                const Leaf& leaf = leaves[idx[i]];
+                const int pos = lowerBound(leaf.keys, leaf.count, key);
+                const bool found = pos < leaf.count && !(key < leaf.keys[pos]);
+                onKey(first+i, std::pair<uint32_t,int>{found ? idx[i] : (uint32_t)NONE, pos});
+            }
+        }
+    }
+
+    static inline bool isFound(const std::pair<uint32_t,int>& lpos) { return lpos.first != NONE; }
+
+    /*
+     * Calls itfunc on up to itersize keys (and values), in order, starting at beginKey.
+     * Like TreeSet::iterate(), when it reaches the end it continues from the lowest key.
+     */
+    template<typename F> bool iterateFrom(F& itfunc, uint64_t itersize, const K& beginKey) {
+        if (numKeys == 0) return true;
+        uint32_t idx = findLeaf(beginKey);
+        int pos = lowerBound(leaves[idx].keys, leaves[idx].count, beginKey);
+        for (uint64_t i = 0; i < itersize; i++) {
+            while (pos == leaves[idx].count) {
+                idx = leaves[idx].next;
+                pos = 0;
+                if (idx == NONE) idx = firstLeaf();
+            }
+            if (!itfunc(leaves[idx], pos)) return false;
+            pos++;
+        }
+        return true;
+    }
+
+    /*
+     * Builds the tree bottom-up from n sorted and unique keys (and values, if HAS_VALUES), in O(n).
+     * The leaves are filled left to right, and then each level of inner nodes, with the keys spread
+     * evenly so that every node is 3/4 full and above LEAF_MIN/INNER_MIN, leaving room for inserts.
+     * Returns false if the tree is not empty.
+     */
+    bool build(const K* keys, const V* vals, const uint64_t n) {
+        if (numKeys != 0) return false;
+        if (n == 0) return true;
+        leaves.clear();
+        inners.clear();
+        freeLeaves.clear();
+        freeInners.clear();
+        std::vector<uint32_t> level;   // Nodes of the level that was just built, in key order
+        std::vector<K>        lowKeys; // Lowest key in the subtree of each node of level
+        const uint64_t numLeaves = (n + BULK_LEAF - 1) / BULK_LEAF;
+        leaves.reserve(numLeaves);
+        uint64_t k = 0;
+        for (uint64_t i = 0; i < numLeaves; i++) {
+            const int count = n/numLeaves + (i < n%numLeaves);
+            const uint32_t idx = newLeaf();
+            Leaf& leaf = leaves[idx];
+            for (int j = 0; j < count; j++, k++) {
+                leaf.keys[j] = keys[k];
+                if constexpr (HAS_VALUES) leaf.vals.at(j) = vals[k];
+            }
+            leaf.count = count;
+            if (i > 0) leaves[idx-1].next = idx;
+            level.push_back(idx);
+            lowKeys.push_back(leaf.keys[0]);
+        }
+        height = 0;
+        while (level.size() > 1) {
+            const uint64_t numNodes = (level.size() + BULK_INNER - 1) / BULK_INNER;
+            std::vector<uint32_t> upLevel;
+            std::vector<K>        upKeys;
+            uint64_t c = 0;
+            for (uint64_t i = 0; i < numNodes; i++) {
+                const int numChildren = level.size()/numNodes + (i < level.size()%numNodes);
+                const uint32_t idx = newInner();
+                Inner& in = inners[idx];
+                upKeys.push_back(lowKeys[c]);
+                for (int j = 0; j < numChildren; j++, c++) {
+                    in.children[j] = level[c];
+                    if (j > 0) in.keys[j-1] = lowKeys[c];
+                }
+                in.count = numChildren-1;
+                upLevel.push_back(idx);
+            }
+            level.swap(upLevel);
+            lowKeys.swap(upKeys);
+            height++;
+        }
+        root = level[0];
+        numKeys = n;
+        return true;
+    }
+
+    template<typename F> bool iterateLeaves(F& itfunc) {
+        for (uint32_t idx = firstLeaf(); idx != NONE; idx = leaves[idx].next) {
+            for (int pos = 0; pos < leaves[idx].count; pos++) {
+                if (!itfunc(leaves[idx], pos)) return false;
+            }
+        }
+        return true;
+    }
+
+public:
+    BPlusTree() {
+        root = newLeaf();
+    }
+
+    // Number of keys in the tree
+    uint64_t size() const { return numKeys; }
+
+    // Copy of 'from' in units of contiguous nodes, for the cooperative copies of the Universal Constructs
+    void parallelCopy(const BPlusTree& from, CopyJob& job) {
+        leaves.resize(from.leaves.size());
+        inners.resize(from.inners.size());
+        freeLeaves = from.freeLeaves;
+        freeInners = from.freeInners;
+        root = from.root;
+        height = from.height;
+        numKeys = from.numKeys;
+        job.addRanges(leaves.data(), from.leaves.data(), leaves.size());
+        job.addRanges(inners.data(), from.inners.data(), inners.size());
+    }
+
+    // Bytes used by the arrays of nodes, which is what the copy constructor copies
+    uint64_t memoryUsage() const { return leaves.size()*sizeof(Leaf) + inners.size()*sizeof(Inner); }
+};
+
+
+template<typename K>
+class BPlusTreeSet : public BPlusTree<K,BPlusTreeNoValue> {
+    using Base = BPlusTree<K,BPlusTreeNoValue>;
+
+public:
+    static std::string className() { return "BPlusTreeSet"; }
+
+    bool add(K key) {
+        return Base::insert(key, BPlusTreeNoValue{}, false, nullptr);
+    }
+
+    bool remove(K key) {
+        return Base::erase(key, nullptr);
+    }
+
+    bool contains(K key) {
+        return Base::isFound(Base::find(key));
+    }
+
+    // out[i] is contains(keys[i]), see findBatch()
+    void containsBatch(const K* keys, const uint64_t n, bool* out) {
+        Base::findBatch(keys, n, [out] (uint64_t i, const std::pair<uint32_t,int>& lpos) { out[i] = Base::isFound(lpos); });
+    }
+
+    // Builds the set from n sorted and unique keys in O(n), returns false if the set is not empty
+    bool bulkLoad(const K* keys, const uint64_t n) {
+        return Base::build(keys, nullptr, n);
+    }
+
+    bool iterateAll(std::function<bool(K*)> itfunc) {
+        auto func = [&itfunc] (auto& leaf, int pos) { K key = leaf.keys[pos]; return itfunc(&key); };
+        return Base::iterateLeaves(func);
+    }
+
+    bool iterate(std::function<bool(K*)> itfunc, uint64_t itersize, K beginKey) {
+        auto func = [&itfunc] (auto& leaf, int pos) { K key = leaf.keys[pos]; return itfunc(&key); };
+        return Base::iterateFrom(func, itersize, beginKey);
+    }
+};
+
+
+template<typename K, typename V>
+class BPlusTreeMap : public BPlusTree<K,V> {
+    using Base = BPlusTree<K,V>;
+
+public:
+    static std::string className() { return "BPlusTreeMap"; }
+
+    // Returns the previous value, if any
+    std::optional<V> put(const K& key, const V& value) {
+        std::optional<V> oldVal;
+        Base::insert(key, value, true, &oldVal);
+        return oldVal;
+    }
+
+    // Inserts only if the key is not in the map, returns true if it was inserted
+    bool add(const K& key, const V& value) {
+        return Base::insert(key, value, false, nullptr);
+    }
+
+    // Returns the removed value, if any
+    std::optional<V> remove(const K& key) {
+        std::optional<V> oldVal;
+        Base::erase(key, &oldVal);
+        return oldVal;
+    }
+
+    std::optional<V> get(const K& key) {
+        auto lpos = Base::find(key);
+        if (!Base::isFound(lpos)) return {};
+        return Base::valueAt(lpos);
+    }
+
+    bool containsKey(const K& key) {
+        return Base::isFound(Base::find(key));
+    }
+
+    // out[i] is get(keys[i]), see findBatch()
+    void getBatch(const K* keys, const uint64_t n, std::optional<V>* out) {
+        Base::findBatch(keys, n, [this,out] (uint64_t i, const std::pair<uint32_t,int>& lpos) {
+            if (Base::isFound(lpos)) out[i] = Base::valueAt(lpos);
+            else out[i].reset();
+        });
+    }
+
+    bool iterateAll(std::function<bool(K*,V*)> itfunc) {
+        auto func = [&itfunc] (auto& leaf, int pos) { K key = leaf.keys[pos]; V val = leaf.vals.at(pos); return itfunc(&key, &val); };
+        return Base::iterateLeaves(func);
+    }
+
+    // Builds the map from n sorted and unique keys and their values in O(n), returns false if the map is not empty
+    bool bulkLoad(const K* keys, const V* values, const uint64_t n) {
+        return Base::build(keys, values, n);
+    }
+
+    void addAll(K** keys, V** values, const int size) {
+        for (int i = 0; i < size; i++) put(*keys[i], *values[i]);
+    }
+};
+
+#endif /* _CX_BPLUS_TREE_H_ */
@@ -0,0 +1,288 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _FLAT_HASH_SET_H_
+#define _FLAT_HASH_SET_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <type_traits>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../../common/ParallelCopy.hpp"
+
+/**
+ * <h1> Flat Hash Set </h1>
+ *
+ * Open addressing hash set in the style of SwissTable: the slots are split in
+ * groups of 16, and each slot has one control byte which is either EMPTY, DELETED,
+ * or the lowest 7 bits of the hash of its key. A lookup compares the 7 bits of
+ * the hash with the 16 control bytes of a group at once (with SSE2 when available)
+ * and only compares the keys of the slots that match. The groups are probed
+ * quadratically, and a lookup stops at the first group that has an EMPTY slot.
+ *
+ * The control bytes and the slots are in a single allocation, which means that
+ * the copy constructor (what CX calls to make a new replica) is one allocation
+ * and a memcpy() when the key is trivially copyable, or a memcpy() of the control
+ * bytes and a copy of each key otherwise. There are no per-key allocations.
+ *
+ * The table doubles when it is 7/8 full, counting the DELETED slots, and is
+ * rehashed to the same size if most of those are DELETED slots.
+ * containsBatch() hashes a group of keys and prefetches the first group of
+ * control bytes and slots of each one before doing any of the lookups.
+ * It has the same interface as HashSet, except iterate().
+ */
+template<typename CKey, typename Hash = std::hash<CKey>>
+class FlatHashSet {
+
+private:
+    static const uint64_t GROUP_SIZE = 16;
+    static const uint64_t MIN_CAPACITY = 2*GROUP_SIZE;
+    static const int8_t   EMPTY = -128;      // 0x80
+    static const int8_t   DELETED = -2;      // 0xFE, the full slots have the highest bit at zero
+    static const int      BATCH_GROUP = 16;  // Lookups whose first group is prefetched together in containsBatch()
+
+    int8_t*  ctrl {nullptr};          // capacity control bytes, followed by the slots
+    CKey*    slots {nullptr};
+    uint64_t capacity {0};            // Always a power of two and a multiple of GROUP_SIZE
+    uint64_t numKeys {0};
+    uint64_t numDeleted {0};
+
+    // std::hash of integers is usually the identity, mix it so that the low bits and the high bits are both usable
+    static inline uint64_t hashOf(const CKey& key) {
+        uint64_t h = (uint64_t)Hash{}(key) * 0x9E3779B97F4A7C15ULL;
+        return h ^ (h >> 32);
+    }
+    static inline uint64_t h1(uint64_t hash) { return hash >> 7; }
+    static inline int8_t   h2(uint64_t hash) { return (int8_t)(hash & 0x7F); }
+
+    // Bitmask of the slots in the group whose control byte is 'value'
+    static inline uint32_t matchByte(const int8_t* group, int8_t value) {
+#if defined(__SSE2__)
+        __m128i g = _mm_load_si128((const __m128i*)group);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(value), g));
+#else
+        uint32_t mask = 0;
+        for (uint64_t i = 0; i < GROUP_SIZE; i++) if (group[i] == value) mask |= (1U << i);
+        return mask;
+#endif
+    }
+
+    // Bitmask of the slots in the group that are EMPTY or DELETED
+    static inline uint32_t matchFree(const int8_t* group) {
+#if defined(__SSE2__)
+        return _mm_movemask_epi8(_mm_load_si128((const __m128i*)group));
+#else
+        uint32_t mask = 0;
+        for (uint64_t i = 0; i < GROUP_SIZE; i++) if (group[i] < 0) mask |= (1U << i);
+        return mask;
+#endif
+    }
+
+    static inline uint64_t slotsOffset(uint64_t lcapacity) {
+        return (lcapacity + alignof(CKey) - 1) & ~(uint64_t)(alignof(CKey) - 1);
+    }
+
+    static inline uint64_t allocSize(uint64_t lcapacity) {
+        return slotsOffset(lcapacity) + lcapacity*sizeof(CKey);
+    }
+
+    void allocate(uint64_t lcapacity) {
+        capacity = lcapacity;
+        ctrl = (int8_t*)::operator new(allocSize(lcapacity), std::align_val_t(GROUP_SIZE));
+        slots = (CKey*)((char*)ctrl + slotsOffset(lcapacity));
+    }
+
+    void deallocate() {
+        if (ctrl == nullptr) return;
+        if (!std::is_trivially_destructible<CKey>::value) {
+            for (uint64_t i = 0; i < capacity; i++) if (ctrl[i] >= 0) slots[i].~CKey();
+        }
+        ::operator delete(ctrl, std::align_val_t(GROUP_SIZE));
+        ctrl = nullptr;
+        slots = nullptr;
+    }
+
+    /*
+     * Returns the index of the slot with the key, or -1 if the key is not in the set,
+     * in which case *freeSlot is the first EMPTY or DELETED slot in the probe sequence.
+     */
+    int64_t find(const CKey& key, const uint64_t hash, int64_t* freeSlot) const {
+        const uint64_t ngroupsMask = capacity/GROUP_SIZE - 1;
+        const int8_t tag = h2(hash);
+        uint64_t igroup = h1(hash) & ngroupsMask;
+        int64_t lfree = -1;
+        for (uint64_t step = 1; ; step++) {
+            const int8_t* group = ctrl + igroup*GROUP_SIZE;
+            for (uint32_t mask = matchByte(group, tag); mask != 0; mask &= mask - 1) {
+                const uint64_t idx = igroup*GROUP_SIZE + __builtin_ctz(mask);
+                if (slots[idx] == key) return (int64_t)idx;
+            }
+            const uint32_t freeMask = matchFree(group);
+            if (lfree == -1 && freeMask != 0) lfree = (int64_t)(igroup*GROUP_SIZE + __builtin_ctz(freeMask));
+            if (matchByte(group, EMPTY) != 0) break;
+            igroup = (igroup + step) & ngroupsMask;   // Triangular numbers visit all the groups
+        }
+        if (freeSlot != nullptr) *freeSlot = lfree;
+        return -1;
+    }
+
+    // Places a key that we know is not in the set, used when rehashing
+    void insertNew(CKey&& key, const uint64_t hash) {
+        const uint64_t ngroupsMask = capacity/GROUP_SIZE - 1;
+        uint64_t igroup = h1(hash) & ngroupsMask;
+        for (uint64_t step = 1; ; step++) {
+            const uint32_t freeMask = matchFree(ctrl + igroup*GROUP_SIZE);
+            if (freeMask != 0) {
+                const uint64_t idx = igroup*GROUP_SIZE + __builtin_ctz(freeMask);
+                ctrl[idx] = h2(hash);
+                new (&slots[idx]) CKey(std::move(key));
+                return;
+            }
+            igroup = (igroup + step) & ngroupsMask;
+        }
+    }
+
+    void rehash(uint64_t newCapacity) {
+        int8_t* oldCtrl = ctrl;
+        CKey* oldSlots = slots;
+        const uint64_t oldCapacity = capacity;
+        allocate(newCapacity);
+        std::memset(ctrl, EMPTY, capacity);
+        numDeleted = 0;
+        for (uint64_t i = 0; i < oldCapacity; i++) {
+            if (oldCtrl[i] < 0) continue;
+            const uint64_t hash = hashOf(oldSlots[i]);
+            insertNew(std::move(oldSlots[i]), hash);
+            oldSlots[i].~CKey();
+        }
+        ::operator delete(oldCtrl, std::align_val_t(GROUP_SIZE));
+    }
+
+public:
+    FlatHashSet() {
+        allocate(MIN_CAPACITY);
+        std::memset(ctrl, EMPTY, capacity);
+    }
+
+    FlatHashSet(const FlatHashSet& other) : numKeys{other.numKeys}, numDeleted{other.numDeleted} {
+        allocate(other.capacity);
+        if (std::is_trivially_copyable<CKey>::value) {
+            std::memcpy(ctrl, other.ctrl, allocSize(capacity));
+        } else {
+            std::memcpy(ctrl, other.ctrl, capacity);
+            for (uint64_t i = 0; i < capacity; i++) {
+                if (ctrl[i] >= 0) new (&slots[i]) CKey(other.slots[i]);
+            }
+        }
+    }
+
+    FlatHashSet& operator=(const FlatHashSet& other) = delete;
+
+    // Copy of 'other' in ranges of the table, for the cooperative copies of the Universal Constructs
+    void parallelCopy(const FlatHashSet& other, CopyJob& job) {
+        if (!std::is_trivially_copyable<CKey>::value) {
+            job.add([this, &other] () { assignFrom(other, 0, 0); });
+            return;
+        }
+        if (capacity != other.capacity) {
+            deallocate();
+            allocate(other.capacity);
+        }
+        numKeys = other.numKeys;
+        numDeleted = other.numDeleted;
+        job.addRanges((char*)ctrl, (const char*)other.ctrl, allocSize(capacity));
+    }
+
+    // Refresh of a replica by the Universal Constructs (see Arena.hpp), the table is reused if it has the same capacity
+    void assignFrom(const FlatHashSet& other, uint64_t fromTicket, uint64_t myTicket) {
+        if (capacity != other.capacity || !std::is_trivially_copyable<CKey>::value) {
+            deallocate();
+            new (this) FlatHashSet(other);
+            return;
+        }
+        std::memcpy(ctrl, other.ctrl, allocSize(capacity));
+        numKeys = other.numKeys;
+        numDeleted = other.numDeleted;
+    }
+
+    ~FlatHashSet() { deallocate(); }
+
+    static std::string className() { return "FlatHashSet"; }
+
+    bool add(CKey key) {
+        const uint64_t hash = hashOf(key);
+        int64_t freeSlot = -1;
+        if (find(key, hash, &freeSlot) != -1) return false;
+        if (ctrl[freeSlot] == EMPTY && (numKeys + numDeleted + 1)*8 > capacity*7) {
+            // Double the table, unless at least half of the used slots are tombstones
+            rehash(numDeleted*2 >= numKeys + numDeleted ? capacity : 2*capacity);
+            insertNew(std::move(key), hash);
+        } else {
+            if (ctrl[freeSlot] == DELETED) numDeleted--;
+            ctrl[freeSlot] = h2(hash);
+            new (&slots[freeSlot]) CKey(std::move(key));
+        }
+        numKeys++;
+        return true;
+    }
+
+    bool remove(CKey key) {
+        const int64_t idx = find(key, hashOf(key), nullptr);
+        if (idx == -1) return false;
+        slots[idx].~CKey();
+        // If the group has an EMPTY slot the lookups already stop here, so there is no need for a tombstone
+        if (matchByte(ctrl + (idx & ~(GROUP_SIZE-1)), EMPTY) != 0) {
+            ctrl[idx] = EMPTY;
+        } else {
+            ctrl[idx] = DELETED;
+            numDeleted++;
+        }
+        numKeys--;
+        return true;
+    }
+
+    bool contains(CKey key) {
+        return find(key, hashOf(key), nullptr) != -1;
+    }
+
+    // out[i] is contains(keys[i])
+    void containsBatch(const CKey* keys, const uint64_t n, bool* out) {
+        const uint64_t ngroupsMask = capacity/GROUP_SIZE - 1;
+        uint64_t hashes[BATCH_GROUP];
+        for (uint64_t first = 0; first < n; first += BATCH_GROUP) {
+            const int num = (int)std::min<uint64_t>(BATCH_GROUP, n - first);
+            for (int i = 0; i < num; i++) {
+                hashes[i] = hashOf(keys[first+i]);
+                const uint64_t igroup = h1(hashes[i]) & ngroupsMask;
+                __builtin_prefetch(ctrl + igroup*GROUP_SIZE);
+                __builtin_prefetch(slots + igroup*GROUP_SIZE);
+            }
+            for (int i = 0; i < num; i++) out[first+i] = find(keys[first+i], hashes[i], nullptr) != -1;
+        }
+    }
+
+    bool iterateAll(std::function<bool(CKey*)> itfun) {
+        for (uint64_t i = 0; i < capacity; i++) {
+            if (ctrl[i] < 0) continue;
+            CKey key = slots[i];
+            if (!itfun(&key)) return false;
+        }
+        return true;
+    }
+
+    uint64_t size() const { return numKeys; }
+};
+
+#endif /* _FLAT_HASH_SET_H_ */
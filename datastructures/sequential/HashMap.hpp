@@ -0,0 +1,84 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _CX_HASH_MAP_H_
+#define _CX_HASH_MAP_H_
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+/**
+ * <h1> Hash Map (sequential) </h1>
+ *
+ * A wrapper to std::unordered_map with the interface that UCMap expects, the map
+ * counterpart of HashSet. K must have a std::hash specialization.
+ */
+template<typename K, typename V>
+class HashMap {
+
+private:
+    std::unordered_map<K,V> map;
+
+public:
+    static std::string className() { return "HashMap"; }
+
+    // Returns the previous value, if any
+    std::optional<V> put(const K& key, const V& value) {
+        auto res = map.try_emplace(key, value);
+        if (res.second) return {};
+        std::optional<V> oldVal {res.first->second};
+        res.first->second = value;
+        return oldVal;
+    }
+
+    // Inserts only if the key is not in the map, returns true if it was inserted
+    bool add(const K& key, const V& value) {
+        return map.try_emplace(key, value).second;
+    }
+
+    // Returns the removed value, if any
+    std::optional<V> remove(const K& key) {
+        auto iter = map.find(key);
+        if (iter == map.end()) return {};
+        std::optional<V> oldVal {iter->second};
+        map.erase(iter);
+        return oldVal;
+    }
+
+    std::optional<V> get(const K& key) {
+        auto iter = map.find(key);
+        if (iter == map.end()) return {};
+        return iter->second;
+    }
+
+    bool containsKey(const K& key) {
+        return map.find(key) != map.end();
+    }
+
+    uint64_t size() const { return map.size(); }
+
+    bool iterateAll(std::function<bool(K*,V*)> itfunc) {
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            K key = it->first;
+            V val = it->second;
+            if (!itfunc(&key, &val)) return false;
+        }
+        return true;
+    }
+
+    // Sizes the table once for all the keys, instead of rehashing as it grows
+    void addAll(K** keys, V** values, const int size) {
+        map.reserve(map.size() + size);
+        for (int i = 0; i < size; i++) put(*keys[i], *values[i]);
+    }
+};
+
+#endif /* _CX_HASH_MAP_H_ */
@@ -49,11 +49,7 @@ public:
 
 
     bool add(CKey key) {
-        if (set.find(key) == set.end()) {
-            set.insert(key); // TODO: can we improve this so we don't have to lookup twice?
-            return true;
-        }
-        return false;
+        return set.insert(key).second;
     }
 
     bool remove(CKey key) {
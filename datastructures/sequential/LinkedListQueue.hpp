@@ -29,6 +29,9 @@
 #ifndef _SEQUENTIAL_LINKED_LIST_QUEUE_H_
 #define _SEQUENTIAL_LINKED_LIST_QUEUE_H_
 
+#include <memory>
+#include <string>
+
 /**
  * <h1> A sequential implementation of Linked List Queue </h1>
  *
@@ -37,7 +40,8 @@
  * @author Pedro Ramalhete
  * @author Andreia Correia
  */
-template<typename T>
+// The nodes are allocated with ALLOC, e.g. ArenaAllocator<T> for ArenaReplicas
+template<typename T, typename ALLOC = std::allocator<T>>
 class LinkedListQueue {
 
 private:
@@ -50,10 +54,25 @@ private:
     Node*  head {nullptr};
     Node*  tail {nullptr};
 
+    using NodeAlloc = typename std::allocator_traits<ALLOC>::template rebind_alloc<Node>;
+    using NodeTraits = std::allocator_traits<NodeAlloc>;
+    NodeAlloc nodeAlloc;
+
+    template<typename... Args> Node* createNode(Args&&... args) {
+        Node* node = NodeTraits::allocate(nodeAlloc, 1);
+        NodeTraits::construct(nodeAlloc, node, std::forward<Args>(args)...);
+        return node;
+    }
+
+    void destroyNode(Node* node) {
+        NodeTraits::destroy(nodeAlloc, node);
+        NodeTraits::deallocate(nodeAlloc, node, 1);
+    }
+
 
 public:
     LinkedListQueue(unsigned int maxThreads=0) {
-        Node* sentinelNode = new Node(nullptr);
+        Node* sentinelNode = createNode(nullptr);
         head = sentinelNode;
         tail = sentinelNode;
     }
@@ -61,11 +80,11 @@ public:
 
     // Universal Constructs need a copy constructor on the underlying data structure
     LinkedListQueue(const LinkedListQueue& other) {
-        head = new Node(nullptr);
+        head = createNode(nullptr);
         Node* node = head;
         Node* onode = other.head->next;
         while (onode != nullptr) {
-            node->next = new Node(onode->item);
+            node->next = createNode(onode->item);
             node = node->next;
             onode = onode->next;
         }
@@ -76,7 +95,7 @@ public:
     ~LinkedListQueue() {
         while (dequeue(0) != nullptr); // Drain the queue
         Node* lhead = head;
-        delete lhead;
+        destroyNode(lhead);
     }
 
 
@@ -85,7 +104,7 @@ public:
 
     bool enqueue(T* item, const int tid=0) {
         if (item == nullptr) return false;
-        Node* newNode = new Node(item);
+        Node* newNode = createNode(item);
         tail->next = newNode;
         tail = newNode;
         return true;
@@ -96,7 +115,7 @@ public:
         Node* lhead = head;
         if (lhead == tail) return nullptr;
         head = lhead->next;
-        delete lhead;
+        destroyNode(lhead);
         return head->item;
     }
 };
@@ -1,15 +1,16 @@
 #ifndef _SEQUENTIAL_LINKED_LIST_SET_H_
 #define _SEQUENTIAL_LINKED_LIST_SET_H_
 
+#include <memory>
 #include <string>
 
 /**
  * <h1> A sequential implementation of La inked List Set </h1>
  *
  * This is meant to be used by the Universal Constructs
- *
+ * The nodes are allocated with ALLOC, e.g. ArenaAllocator<K> for ArenaReplicas.
  */
-template<typename K>
+template<typename K, typename ALLOC = std::allocator<K>>
 class LinkedListSet {
 
 private:
@@ -24,11 +25,26 @@ private:
     Node*  head {nullptr};
     Node*  tail {nullptr};
 
+    using NodeAlloc = typename std::allocator_traits<ALLOC>::template rebind_alloc<Node>;
+    using NodeTraits = std::allocator_traits<NodeAlloc>;
+    NodeAlloc nodeAlloc;
+
+    template<typename... Args> Node* createNode(Args&&... args) {
+        Node* node = NodeTraits::allocate(nodeAlloc, 1);
+        NodeTraits::construct(nodeAlloc, node, std::forward<Args>(args)...);
+        return node;
+    }
+
+    void destroyNode(Node* node) {
+        NodeTraits::destroy(nodeAlloc, node);
+        NodeTraits::deallocate(nodeAlloc, node, 1);
+    }
+
 
 public:
     LinkedListSet() {
-		Node* lhead = new Node();
-		Node* ltail = new Node();
+		Node* lhead = createNode();
+		Node* ltail = createNode();
 		head = lhead;
 		head->next = ltail;
 		tail = ltail;
@@ -38,15 +54,15 @@ public:
 
     // Universal Constructs need a copy constructor on the underlying data structure
     LinkedListSet(const LinkedListSet& other) {
-        head = new Node();
+        head = createNode();
         Node* node = head;
         Node* onode = other.head->next;
         while (onode != other.tail) {
-            node->next = new Node(onode->key);
+            node->next = createNode(onode->key);
             node = node->next;
             onode = onode->next;
         }
-        tail = new Node();
+        tail = createNode();
         node->next = tail;
     }
 
@@ -56,12 +72,12 @@ public:
 		Node* prev = head;
 		Node* node = prev->next;
 		while (node != tail) {
-			delete prev;
+			destroyNode(prev);
 			prev = node;
 			node = node->next;
 		}
-		delete prev;
-		delete tail;
+		destroyNode(prev);
+		destroyNode(tail);
     }
 
 
@@ -76,7 +92,7 @@ public:
         find(key, prev, node);
         bool retval = !(node != tail && key == node->key);
         if (!retval) return retval;
-        Node* newNode = new Node(key);
+        Node* newNode = createNode(key);
         prev->next = newNode;
         newNode->next = node;
         return retval;
@@ -92,7 +108,7 @@ public:
         bool retval = (node != tail && key == node->key);
         if (!retval) return retval;
         prev->next = node->next;
-        delete node;
+        destroyNode(node);
         return retval;
     }
 
@@ -112,6 +128,18 @@ public:
         }
     }
 
+    // Builds the list from n sorted and unique keys in O(n), returns false if the set is not empty
+    bool bulkLoad(const K* keys, const uint64_t n) {
+        if (head->next != tail) return false;
+        Node* prev = head;
+        for (uint64_t i = 0; i < n; i++) {
+            prev->next = createNode(keys[i]);
+            prev = prev->next;
+        }
+        prev->next = tail;
+        return true;
+    }
+
     // Used only for benchmarks
     bool addAll(K** keys, const int size) {
         bool retval = false;
@@ -120,7 +148,7 @@ public:
             find(*keys[i], prev, node);
             retval = !(node != tail && *keys[i] == node->key);
             if (retval) {
-                Node* newNode = new Node(*keys[i]);
+                Node* newNode = createNode(*keys[i]);
                 prev->next = newNode;
                 newNode->next = node;
             }
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _SEQUENTIAL_LINKED_LIST_STACK_H_
+#define _SEQUENTIAL_LINKED_LIST_STACK_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * <h1> A sequential implementation of Linked List Stack </h1>
+ *
+ * This is meant to be used by the Universal Constructs, see UCStack.hpp.
+ * The top of the stack is the first node of the list, and the copy constructor
+ * keeps the order of the items.
+ * The nodes are allocated with ALLOC, e.g. ArenaAllocator<T> for ArenaReplicas.
+ */
+template<typename T, typename ALLOC = std::allocator<T>>
+class LinkedListStack {
+
+private:
+    struct Node {
+        T* item;
+        Node* next;
+        Node(T* userItem, Node* next) : item{userItem}, next{next} { }
+    };
+
+    Node*    top {nullptr};
+    uint64_t numItems {0};
+
+    using NodeAlloc = typename std::allocator_traits<ALLOC>::template rebind_alloc<Node>;
+    using NodeTraits = std::allocator_traits<NodeAlloc>;
+    NodeAlloc nodeAlloc;
+
+    template<typename... Args> Node* createNode(Args&&... args) {
+        Node* node = NodeTraits::allocate(nodeAlloc, 1);
+        NodeTraits::construct(nodeAlloc, node, std::forward<Args>(args)...);
+        return node;
+    }
+
+    void destroyNode(Node* node) {
+        NodeTraits::destroy(nodeAlloc, node);
+        NodeTraits::deallocate(nodeAlloc, node, 1);
+    }
+
+
+public:
+    LinkedListStack(unsigned int maxThreads=0) { }
+
+
+    // Universal Constructs need a copy constructor on the underlying data structure
+    LinkedListStack(const LinkedListStack& other) : numItems{other.numItems} {
+        Node** prev = &top;
+        for (Node* onode = other.top; onode != nullptr; onode = onode->next) {
+            *prev = createNode(onode->item, nullptr);
+            prev = &(*prev)->next;
+        }
+    }
+
+    LinkedListStack& operator=(const LinkedListStack& other) = delete;
+
+
+    ~LinkedListStack() {
+        while (pop(0) != nullptr); // Drain the stack
+    }
+
+
+    static std::string className() { return "LinkedListStack"; }
+
+
+    bool push(T* item, const int tid=0) {
+        if (item == nullptr) return false;
+        top = createNode(item, top);
+        numItems++;
+        return true;
+    }
+
+
+    // Returns nullptr if the stack is empty
+    T* pop(const int tid=0) {
+        Node* ltop = top;
+        if (ltop == nullptr) return nullptr;
+        T* item = ltop->item;
+        top = ltop->next;
+        destroyNode(ltop);
+        numItems--;
+        return item;
+    }
+
+
+    uint64_t size() const { return numItems; }
+};
+
+#endif /* _SEQUENTIAL_LINKED_LIST_STACK_H_ */
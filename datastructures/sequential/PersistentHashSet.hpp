@@ -0,0 +1,239 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _PERSISTENT_HASH_SET_H_
+#define _PERSISTENT_HASH_SET_H_
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+/**
+ * <h1> Persistent Hash Set </h1>
+ *
+ * A Hash Array Mapped Trie (HAMT) with the CHAMP layout, where each node has a
+ * bitmap for the keys stored inline and a bitmap for the sub-nodes, each of
+ * them indexed by 5 bits of the hash of the key.
+ * Nodes are reference counted and shared between copies of the set, just like
+ * in PersistentTreeSet: the copy constructor is O(1) and add()/remove() do
+ * path-copying of at most O(log32 n) nodes.
+ * After the 64 bits of the hash are used up, keys with a full hash collision
+ * are kept in a collision node, which is a plain list of keys.
+ *
+ * http://lampwww.epfl.ch/papers/idealhashtrees.pdf
+ * https://michael.steindorfer.name/publications/oopsla15.pdf
+ */
+template<typename K>
+class PersistentHashSet {
+
+private:
+    static const int BITS = 5;
+    static const int MAX_SHIFT = 64; // At this shift level all nodes are collision nodes
+
+    struct Node {
+        uint32_t             datamap {0};   // Which of the 32 slots have a key
+        uint32_t             nodemap {0};   // Which of the 32 slots have a sub-node
+        std::vector<K>       keys;
+        std::vector<Node*>   children;
+        std::atomic<int>     refcnt {1};
+        Node() { }
+        Node(const Node* other) : datamap{other->datamap}, nodemap{other->nodemap}, keys{other->keys}, children{other->children} { }
+    };
+
+    Node* root {nullptr};
+
+    // Spread the bits of std::hash, which for integers is usually the identity
+    static inline uint64_t hashOf(const K& key) {
+        uint64_t h = std::hash<K>()(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    static inline uint32_t bitpos(uint64_t hash, int shift) {
+        return 1u << ((hash >> shift) & 31);
+    }
+
+    static inline int index(uint32_t bitmap, uint32_t bit) {
+        return __builtin_popcount(bitmap & (bit-1));
+    }
+
+    static inline void acquire(Node* x) {
+        if (x != nullptr) x->refcnt.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static void release(Node* x) {
+        if (x == nullptr) return;
+        if (x->refcnt.fetch_add(-1, std::memory_order_acq_rel) != 1) return;
+        for (Node* child : x->children) release(child);
+        delete x;
+    }
+
+    // Consumes the reference held by the caller's link and returns a node that is owned only by that link
+    static Node* unique(Node* x) {
+        if (x->refcnt.load(std::memory_order_acquire) == 1) return x;
+        Node* n = new Node(x);
+        for (Node* child : n->children) acquire(child);
+        release(x);
+        return n;
+    }
+
+    static inline bool keyEquals(const K& k1, const K& k2) {
+        return !(k1 < k2) && !(k2 < k1);
+    }
+
+    // Creates a sub-tree with two keys whose hashes are equal up to 'shift'
+    static Node* makeNode(const K& k1, uint64_t h1, const K& k2, uint64_t h2, int shift) {
+        Node* n = new Node();
+        if (shift >= MAX_SHIFT) {
+            n->keys.push_back(k1);
+            n->keys.push_back(k2);
+            return n;
+        }
+        const uint32_t b1 = bitpos(h1, shift);
+        const uint32_t b2 = bitpos(h2, shift);
+        if (b1 == b2) {
+            n->nodemap = b1;
+            n->children.push_back(makeNode(k1, h1, k2, h2, shift+BITS));
+        } else {
+            n->datamap = b1 | b2;
+            if (b1 < b2) { n->keys.push_back(k1); n->keys.push_back(k2); }
+            else         { n->keys.push_back(k2); n->keys.push_back(k1); }
+        }
+        return n;
+    }
+
+    bool find(Node* x, const K& key, uint64_t hash) const {
+        for (int shift = 0; x != nullptr; shift += BITS) {
+            if (shift >= MAX_SHIFT) {
+                for (const K& k : x->keys) if (keyEquals(k, key)) return true;
+                return false;
+            }
+            const uint32_t bit = bitpos(hash, shift);
+            if (x->datamap & bit) return keyEquals(x->keys[index(x->datamap, bit)], key);
+            if (!(x->nodemap & bit)) return false;
+            x = x->children[index(x->nodemap, bit)];
+        }
+        return false;
+    }
+
+    // Inserts a key that is not in the set. 'x' must be uniquely owned.
+    void insert(Node* x, const K& key, uint64_t hash, int shift) {
+        if (shift >= MAX_SHIFT) {
+            x->keys.push_back(key);
+            return;
+        }
+        const uint32_t bit = bitpos(hash, shift);
+        if (x->nodemap & bit) {
+            const int idx = index(x->nodemap, bit);
+            x->children[idx] = unique(x->children[idx]);
+            insert(x->children[idx], key, hash, shift+BITS);
+        } else if (x->datamap & bit) {
+            // Replace the existing key with a sub-node containing both keys
+            const int didx = index(x->datamap, bit);
+            K other = x->keys[didx];
+            x->keys.erase(x->keys.begin()+didx);
+            x->datamap ^= bit;
+            Node* child = makeNode(other, hashOf(other), key, hash, shift+BITS);
+            x->children.insert(x->children.begin()+index(x->nodemap, bit), child);
+            x->nodemap |= bit;
+        } else {
+            x->keys.insert(x->keys.begin()+index(x->datamap, bit), key);
+            x->datamap |= bit;
+        }
+    }
+
+    // Erases a key that is in the set. 'x' must be uniquely owned.
+    void erase(Node* x, const K& key, uint64_t hash, int shift) {
+        if (shift >= MAX_SHIFT) {
+            for (unsigned i = 0; i < x->keys.size(); i++) {
+                if (!keyEquals(x->keys[i], key)) continue;
+                x->keys.erase(x->keys.begin()+i);
+                return;
+            }
+            return;
+        }
+        const uint32_t bit = bitpos(hash, shift);
+        if (x->datamap & bit) {
+            x->keys.erase(x->keys.begin()+index(x->datamap, bit));
+            x->datamap ^= bit;
+            return;
+        }
+        const int idx = index(x->nodemap, bit);
+        Node* child = unique(x->children[idx]);
+        x->children[idx] = child;
+        erase(child, key, hash, shift+BITS);
+        if (!child->children.empty() || child->keys.size() > 1) return;
+        // The sub-node has at most one key left, so we pull it into this node
+        x->children.erase(x->children.begin()+idx);
+        x->nodemap ^= bit;
+        if (child->keys.size() == 1) {
+            x->keys.insert(x->keys.begin()+index(x->datamap, bit), child->keys[0]);
+            x->datamap |= bit;
+        }
+        release(child);
+    }
+
+    bool iterateAll(Node* x, std::function<bool(K*)>& itfunc) const {
+        if (x == nullptr) return true;
+        for (const K& k : x->keys) {
+            K key = k;
+            if (!itfunc(&key)) return false;
+        }
+        for (Node* child : x->children) {
+            if (!iterateAll(child, itfunc)) return false;
+        }
+        return true;
+    }
+
+public:
+    PersistentHashSet() { }
+
+    // Universal Constructs need a copy constructor on the underlying data structure. This one is O(1).
+    PersistentHashSet(const PersistentHashSet& other) {
+        root = other.root;
+        acquire(root);
+    }
+
+    ~PersistentHashSet() {
+        release(root);
+    }
+
+    static std::string className() { return "PersistentHashSet"; }
+
+    bool add(K key) {
+        const uint64_t hash = hashOf(key);
+        if (find(root, key, hash)) return false;
+        root = (root == nullptr) ? new Node() : unique(root);
+        insert(root, key, hash, 0);
+        return true;
+    }
+
+    bool remove(K key) {
+        const uint64_t hash = hashOf(key);
+        if (!find(root, key, hash)) return false;
+        root = unique(root);
+        erase(root, key, hash, 0);
+        return true;
+    }
+
+    bool contains(K key) {
+        return find(root, key, hashOf(key));
+    }
+
+    bool iterateAll(std::function<bool(K*)> itfun) {
+        return iterateAll(root, itfun);
+    }
+};
+
+#endif /* _PERSISTENT_HASH_SET_H_ */
@@ -0,0 +1,280 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _PERSISTENT_TREE_SET_H_
+#define _PERSISTENT_TREE_SET_H_
+
+#include <atomic>
+#include <string>
+#include <functional>
+
+/**
+ * <h1> Persistent Tree Set </h1>
+ *
+ * A left-leaning Red-Black tree (same algorithm as RedBlackBST.hpp) where the
+ * nodes are reference counted and shared between copies of the set.
+ * The copy constructor is O(1), it only increments the refcount of the root.
+ * A mutation does path-copying: any node that is about to be modified and is
+ * shared with another copy is first cloned, therefore each add()/remove()
+ * copies at most O(log n) nodes.
+ *
+ * This is meant to be used by the Universal Constructs, where the cost of the
+ * copy constructor of the object dominates. Different copies may be accessed
+ * by different threads at the same time (one updater per copy, many readers)
+ * which is why the refcount is atomic. A node with refcnt == 1 that is reached
+ * through uniquely owned ancestors belongs only to this copy and can be
+ * modified in place.
+ *
+ * In the nodes, refcnt counts the number of links (parent nodes or roots) that
+ * point to the node.
+ */
+template<typename K>
+class PersistentTreeSet {
+
+private:
+    static const bool RED   = true;
+    static const bool BLACK = false;
+
+    struct Node {
+        K                 key;
+        Node*             left {nullptr};
+        Node*             right {nullptr};
+        bool              color;    // color of parent link
+        std::atomic<int>  refcnt {1};
+        Node(const K& key, bool color) : key{key}, color{color} { }
+        Node(const Node* other) : key{other->key}, left{other->left}, right{other->right}, color{other->color} { }
+    };
+
+    Node* root {nullptr};
+
+    static inline void acquire(Node* x) {
+        if (x != nullptr) x->refcnt.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Drops one reference to x, deleting x (and its children's references) if it was the last one
+    static void release(Node* x) {
+        while (x != nullptr) {
+            if (x->refcnt.fetch_add(-1, std::memory_order_acq_rel) != 1) return;
+            Node* lright = x->right;
+            release(x->left);
+            delete x;
+            x = lright;
+        }
+    }
+
+    // Consumes the reference held by the caller's link and returns a node that is owned only by that link
+    static Node* unique(Node* x) {
+        if (x->refcnt.load(std::memory_order_acquire) == 1) return x;
+        Node* n = new Node(x);
+        acquire(n->left);
+        acquire(n->right);
+        release(x);
+        return n;
+    }
+
+    static inline bool isRed(Node* x) {
+        if (x == nullptr) return false;
+        return x->color == RED;
+    }
+
+    // All the helpers below assume that 'h' is uniquely owned
+
+    // make a left-leaning link lean to the right
+    Node* rotateRight(Node* h) {
+        Node* x = unique(h->left);
+        h->left = x->right;
+        x->right = h;
+        x->color = h->color;
+        h->color = RED;
+        return x;
+    }
+
+    // make a right-leaning link lean to the left
+    Node* rotateLeft(Node* h) {
+        Node* x = unique(h->right);
+        h->right = x->left;
+        x->left = h;
+        x->color = h->color;
+        h->color = RED;
+        return x;
+    }
+
+    // flip the colors of a node and its two children
+    void flipColors(Node* h) {
+        h->left = unique(h->left);
+        h->right = unique(h->right);
+        h->color = !h->color;
+        h->left->color = !h->left->color;
+        h->right->color = !h->right->color;
+    }
+
+    // Assuming that h is red and both h->left and h->left.left
+    // are black, make h->left or one of its children red.
+    Node* moveRedLeft(Node* h) {
+        flipColors(h);
+        if (isRed(h->right->left)) {
+            h->right = rotateRight(h->right);
+            h = rotateLeft(h);
+            flipColors(h);
+        }
+        return h;
+    }
+
+    // Assuming that h is red and both h->right and h->right.left
+    // are black, make h->right or one of its children red.
+    Node* moveRedRight(Node* h) {
+        flipColors(h);
+        if (isRed(h->left->left)) {
+            h = rotateRight(h);
+            flipColors(h);
+        }
+        return h;
+    }
+
+    // restore red-black tree invariant
+    Node* balance(Node* h) {
+        if (isRed(h->right))                        h = rotateLeft(h);
+        if (isRed(h->left) && isRed(h->left->left)) h = rotateRight(h);
+        if (isRed(h->left) && isRed(h->right))      flipColors(h);
+        return h;
+    }
+
+    // insert the key in the subtree rooted at h. The key must not be in the set.
+    Node* put(Node* h, const K& key) {
+        if (h == nullptr) return new Node(key, RED);
+        h = unique(h);
+        if (key < h->key) h->left  = put(h->left,  key);
+        else              h->right = put(h->right, key);
+        // fix-up any right-leaning links
+        if (isRed(h->right) && !isRed(h->left))      h = rotateLeft(h);
+        if (isRed(h->left)  &&  isRed(h->left->left)) h = rotateRight(h);
+        if (isRed(h->left)  &&  isRed(h->right))     flipColors(h);
+        return h;
+    }
+
+    // delete the minimum key rooted at h
+    Node* deleteMin(Node* h) {
+        h = unique(h);
+        if (h->left == nullptr) {
+            release(h);
+            return nullptr;
+        }
+        if (!isRed(h->left) && !isRed(h->left->left)) h = moveRedLeft(h);
+        h->left = deleteMin(h->left);
+        return balance(h);
+    }
+
+    // delete the given key rooted at h. The key must be in the set.
+    Node* deleteKey(Node* h, const K& key) {
+        h = unique(h);
+        if (key < h->key)  {
+            if (!isRed(h->left) && !isRed(h->left->left)) h = moveRedLeft(h);
+            h->left = deleteKey(h->left, key);
+        } else {
+            if (isRed(h->left)) h = rotateRight(h);
+            if (!(h->key < key) && (h->right == nullptr)) {
+                release(h);
+                return nullptr;
+            }
+            if (!isRed(h->right) && !isRed(h->right->left)) h = moveRedRight(h);
+            if (!(h->key < key)) {
+                Node* x = h->right;
+                while (x->left != nullptr) x = x->left;
+                h->key = x->key;
+                h->right = deleteMin(h->right);
+            }
+            else h->right = deleteKey(h->right, key);
+        }
+        return balance(h);
+    }
+
+    Node* find(const K& key) const {
+        Node* x = root;
+        while (x != nullptr) {
+            if      (key < x->key) x = x->left;
+            else if (x->key < key) x = x->right;
+            else                   return x;
+        }
+        return nullptr;
+    }
+
+    bool iterateAll(Node* x, std::function<bool(K*)>& itfunc) const {
+        while (x != nullptr) {
+            if (!iterateAll(x->left, itfunc)) return false;
+            K key = x->key;
+            if (!itfunc(&key)) return false;
+            x = x->right;
+        }
+        return true;
+    }
+
+    // In-order traversal of (at most itersize) keys that are not smaller than beginKey, or all keys if beginKey is nullptr
+    bool iterateFrom(Node* x, std::function<bool(K*)>& itfunc, uint64_t& count, uint64_t itersize, const K* beginKey) const {
+        while (x != nullptr && count < itersize) {
+            if (beginKey == nullptr || !(x->key < *beginKey)) {
+                if (!iterateFrom(x->left, itfunc, count, itersize, beginKey)) return false;
+                if (count == itersize) return true;
+                K key = x->key;
+                count++;
+                if (!itfunc(&key)) return false;
+            }
+            x = x->right;
+        }
+        return true;
+    }
+
+public:
+    PersistentTreeSet() { }
+
+    // Universal Constructs need a copy constructor on the underlying data structure. This one is O(1).
+    PersistentTreeSet(const PersistentTreeSet& other) {
+        root = other.root;
+        acquire(root);
+    }
+
+    ~PersistentTreeSet() {
+        release(root);
+    }
+
+    static std::string className() { return "PersistentTreeSet"; }
+
+    bool add(K key) {
+        if (find(key) != nullptr) return false;
+        root = put(root, key);
+        root->color = BLACK;
+        return true;
+    }
+
+    bool remove(K key) {
+        if (find(key) == nullptr) return false;
+        root = unique(root);
+        // if both children of root are black, set root to red
+        if (!isRed(root->left) && !isRed(root->right)) root->color = RED;
+        root = deleteKey(root, key);
+        if (root != nullptr) root->color = BLACK;
+        return true;
+    }
+
+    bool contains(K key) {
+        return find(key) != nullptr;
+    }
+
+    bool iterateAll(std::function<bool(K*)> itfunc) {
+        return iterateAll(root, itfunc);
+    }
+
+    // Same semantics as TreeSet::iterate(): wraps around to the smallest key if it reaches the end of the set
+    bool iterate(std::function<bool(K*)> itfunc, uint64_t itersize, K beginKey) {
+        uint64_t count = 0;
+        if (!iterateFrom(root, itfunc, count, itersize, &beginKey)) return false;
+        if (count < itersize) return iterateFrom(root, itfunc, count, itersize, nullptr);
+        return true;
+    }
+};
+
+#endif /* _PERSISTENT_TREE_SET_H_ */
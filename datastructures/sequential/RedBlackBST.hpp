@@ -4,10 +4,12 @@
 #include <cassert>
 #include <stdexcept>
 #include <algorithm>
+#include <memory>
 
 // Single-threaded implementation of a Red-Black Tree Map
 //http://algs4.cs.princeton.edu/code/edu/princeton/cs/algs4/RedBlackBST.java
-template<typename K, typename V>
+// The nodes are allocated with ALLOC, e.g. ArenaAllocator<K> for ArenaReplicas
+template<typename K, typename V, typename ALLOC = std::allocator<K>>
 class RedBlackBST {
 
 
@@ -23,9 +25,19 @@ class RedBlackBST {
 
     Node *root {nullptr};   // root of the BST
 
+    using NodeAlloc = typename std::allocator_traits<ALLOC>::template rebind_alloc<Node>;
+    using NodeTraits = std::allocator_traits<NodeAlloc>;
+    NodeAlloc nodeAlloc;
 
-    static const bool RED   = true;
-    static const bool BLACK = false;
+    template<typename... Args> Node* createNode(Args&&... args) {
+        Node* node = NodeTraits::allocate(nodeAlloc, 1);
+        NodeTraits::construct(nodeAlloc, node, std::forward<Args>(args)...);
+        return node;
+    }
+
+
+    static constexpr bool RED   = true;
+    static constexpr bool BLACK = false;
 
 public:
     /**
@@ -131,7 +143,7 @@ public:
 
     // insert the key-value pair in the subtree rooted at h
     Node* put(Node* h, K* key, V* val) {
-        if (h == nullptr) return new Node(key, val, RED, 1);
+        if (h == nullptr) return createNode(key, val, RED, 1);
         if      (*key < *h->key) h->left  = put(h->left,  key, val);
         else if (*h->key < *key) h->right = put(h->right, key, val);
         else              h->val   = val;
@@ -30,6 +30,8 @@
 #ifndef _SORTEDARRAYSET_H_
 #define _SORTEDARRAYSET_H_
 
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 
 // TODO: Test this for correctness
@@ -95,6 +97,17 @@ public:
         }
     }
 
+    // Refresh of a replica by the Universal Constructs (see Arena.hpp), the array is reused if it's large enough
+    void assignFrom(const SortedArraySet<T>& fromssv, uint64_t fromTicket, uint64_t myTicket) {
+        if (max_size < fromssv.max_size) {
+            delete[] vec;
+            vec = new T*[fromssv.max_size];
+            max_size = fromssv.max_size;
+        }
+        size = fromssv.size;
+        std::memcpy(vec, fromssv.vec, size*sizeof(T*));
+    }
+
     static std::string className() { return "SortedArraySet"; }
 
     void erase(int index){
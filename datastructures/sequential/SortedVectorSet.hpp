@@ -31,6 +31,7 @@
 #define _SORTED_VECTOR_SET_H_
 
 #include <vector>
+#include <cstdint>
 #include <iostream>
 
 // TODO: Test this for correctness
@@ -80,6 +81,9 @@ public:
         vec = from.vec; // Do a copy of the vector
     }
 
+    // Refresh of a replica by the Universal Constructs (see Arena.hpp), keeps the capacity of vec
+    void assignFrom(const SortedVectorSet<T>& from, uint64_t fromTicket, uint64_t myTicket) { vec = from.vec; }
+
     static std::string className() { return "SortedVectorSet"; }
 
     /**
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _SORTED_VECTOR_VALUE_SET_H_
+#define _SORTED_VECTOR_VALUE_SET_H_
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../../common/ParallelCopy.hpp"
+
+/**
+ * <h1> Sorted Vector Set (by value) </h1>
+ *
+ * Same as SortedVectorSet and SortedArraySet, but the keys are stored in the
+ * vector instead of pointers to the keys, so a lookup doesn't touch any memory
+ * other than the vector itself, and it has the same interface as TreeSet.
+ * When T is trivially copyable, std::vector copies it with a single memcpy(),
+ * and inserts and removes shift the keys with a memmove().
+ *
+ * The lookup is a branchless lower bound: the range is halved with a conditional
+ * move instead of a branch, which the CPU can't mispredict, and the two possible
+ * positions of the next probe are prefetched. This set is for small sets, where
+ * copying the whole object is cheap, i.e. the best case for CX.
+ */
+template<typename T>
+class SortedVectorValueSet {
+
+private:
+    std::vector<T> vec;
+
+    // Index of the first key that is not smaller than 'key'
+    size_t lowerBound(const T& key) const {
+        size_t n = vec.size();
+        if (n == 0) return 0;
+        const T* base = vec.data();
+        while (n > 1) {
+            const size_t half = n / 2;
+            __builtin_prefetch(base + half/2);
+            __builtin_prefetch(base + half + half/2);
+            base = (base[half] < key) ? base + half : base;
+            n -= half;
+        }
+        return (base - vec.data()) + (*base < key);
+    }
+
+public:
+    SortedVectorValueSet() { }
+
+    SortedVectorValueSet(const SortedVectorValueSet<T>& from) : vec{from.vec} { }
+
+    // Refresh of a replica by the Universal Constructs (see Arena.hpp), keeps the capacity of vec
+    void assignFrom(const SortedVectorValueSet<T>& from, uint64_t fromTicket, uint64_t myTicket) { vec = from.vec; }
+
+    // Copy of 'from' in ranges of the vector, for the cooperative copies of the Universal Constructs
+    void parallelCopy(const SortedVectorValueSet<T>& from, CopyJob& job) {
+        vec.resize(from.vec.size());
+        job.addRanges(vec.data(), from.vec.data(), vec.size());
+    }
+
+    static std::string className() { return "SortedVectorValueSet"; }
+
+    bool add(T key) {
+        const size_t index = lowerBound(key);
+        if (index != vec.size() && vec[index] == key) return false;
+        vec.insert(vec.begin()+index, key);
+        return true;
+    }
+
+    bool remove(T key) {
+        const size_t index = lowerBound(key);
+        if (index == vec.size() || !(vec[index] == key)) return false;
+        vec.erase(vec.begin()+index);
+        return true;
+    }
+
+    bool contains(T key) {
+        const size_t index = lowerBound(key);
+        return index != vec.size() && vec[index] == key;
+    }
+
+    // Builds the set from n sorted and unique keys, returns false if the set is not empty
+    bool bulkLoad(const T* keys, const uint64_t n) {
+        if (!vec.empty()) return false;
+        vec.assign(keys, keys+n);
+        return true;
+    }
+
+    bool iterateAll(std::function<bool(T*)> itfunc) {
+        for (size_t i = 0; i < vec.size(); i++) {
+            T key = vec[i];
+            if (!itfunc(&key)) return false;
+        }
+        return true;
+    }
+
+    // Same as TreeSet::iterate(), when it reaches the end it continues from the lowest key
+    bool iterate(std::function<bool(T*)> itfunc, uint64_t itersize, T beginKey) {
+        if (vec.size() == 0) return true;
+        size_t index = lowerBound(beginKey);
+        for (uint64_t i = 0; i < itersize; i++, index++) {
+            if (index == vec.size()) index = 0;
+            T key = vec[index];
+            if (!itfunc(&key)) return false;
+        }
+        return true;
+    }
+
+    size_t size() const { return vec.size(); }
+
+    bool print() { // For debug purposes
+        for (const T& key : vec) std::cout << key << ",";
+        std::cout << "\n";
+        return true;
+    }
+};
+
+#endif /* _SORTED_VECTOR_VALUE_SET_H_ */
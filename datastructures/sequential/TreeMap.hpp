@@ -0,0 +1,96 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _CX_TREE_MAP_H_
+#define _CX_TREE_MAP_H_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+
+/**
+ * <h1> Tree Map (sequential) </h1>
+ *
+ * A wrapper to std::map, which should be a Red-Black tree, with the interface that
+ * UCMap expects. It's the map counterpart of TreeSet, meant to be wrapped in a
+ * Universal Construct, for example:
+ *   UCMap<CXMutationWF<TreeMap<K,V>,std::optional<V>>,TreeMap<K,V>,K,V> map;
+ * The nodes are allocated with ALLOC, e.g. ArenaAllocator for ArenaReplicas.
+ */
+template<typename K, typename V, typename ALLOC = std::allocator<std::pair<const K,V>>>
+class TreeMap {
+
+private:
+    std::map<K,V,std::less<K>,ALLOC> map;
+
+public:
+    static std::string className() { return "TreeMap"; }
+
+    // Returns the previous value, if any
+    std::optional<V> put(const K& key, const V& value) {
+        auto res = map.try_emplace(key, value);
+        if (res.second) return {};
+        std::optional<V> oldVal {res.first->second};
+        res.first->second = value;
+        return oldVal;
+    }
+
+    // Inserts only if the key is not in the map, returns true if it was inserted
+    bool add(const K& key, const V& value) {
+        return map.try_emplace(key, value).second;
+    }
+
+    // Returns the removed value, if any
+    std::optional<V> remove(const K& key) {
+        auto iter = map.find(key);
+        if (iter == map.end()) return {};
+        std::optional<V> oldVal {iter->second};
+        map.erase(iter);
+        return oldVal;
+    }
+
+    std::optional<V> get(const K& key) {
+        auto iter = map.find(key);
+        if (iter == map.end()) return {};
+        return iter->second;
+    }
+
+    bool containsKey(const K& key) {
+        return map.find(key) != map.end();
+    }
+
+    uint64_t size() const { return map.size(); }
+
+    bool iterateAll(std::function<bool(K*,V*)> itfunc) {
+        for (auto it = map.begin(); it != map.end(); ++it) {
+            K key = it->first;
+            V val = it->second;
+            if (!itfunc(&key, &val)) return false;
+        }
+        return true;
+    }
+
+    /*
+     * Builds the map from n sorted and unique keys and their values in O(n), each insert is
+     * hinted at the end. Returns false without doing anything if the map is not empty.
+     */
+    bool bulkLoad(const K* keys, const V* values, const uint64_t n) {
+        if (!map.empty()) return false;
+        for (uint64_t i = 0; i < n; i++) map.emplace_hint(map.end(), keys[i], values[i]);
+        return true;
+    }
+
+    void addAll(K** keys, V** values, const int size) {
+        for (int i = 0; i < size; i++) put(*keys[i], *values[i]);
+    }
+};
+
+#endif /* _CX_TREE_MAP_H_ */
@@ -32,18 +32,20 @@
 
 #include <iostream>
 #include <functional>
+#include <memory>
 #include <set>
 
 //#include "../datastructures/sequential/RedBlackBST.hpp"
 
 // TODO: change CKey* to CKey&
 
-// This is a wrapper to std::set, which should be a Red-Black tree
-template<typename CKey>
+// This is a wrapper to std::set, which should be a Red-Black tree.
+// The nodes are allocated with ALLOC, e.g. ArenaAllocator<CKey> for ArenaReplicas
+template<typename CKey, typename ALLOC = std::allocator<CKey>>
 class TreeSet {
 
 private:
-    std::set<CKey> set;
+    std::set<CKey,std::less<CKey>,ALLOC> set;
     // Use this instead if we want to have control over the Red-Black tree
     //RedBlackBST<CKey,CKey> set;
 
@@ -72,6 +74,16 @@ public:
         return true;  // TODO: optimize this
     }
 
+    /*
+     * Builds the set from n sorted and unique keys in O(n), each insert is hinted at the end.
+     * Returns false without doing anything if the set is not empty (see UCSet::addAll()).
+     */
+    bool bulkLoad(const CKey* keys, const uint64_t n) {
+        if (!set.empty()) return false;
+        for (uint64_t i = 0; i < n; i++) set.insert(set.end(), keys[i]);
+        return true;
+    }
+
     bool iterateAll(std::function<bool(CKey*)> itfunc) {
         for (auto it = set.begin(); it != set.end(); ++it) {
             CKey key = *it;
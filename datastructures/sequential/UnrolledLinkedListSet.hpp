@@ -0,0 +1,183 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _SEQUENTIAL_UNROLLED_LINKED_LIST_SET_H_
+#define _SEQUENTIAL_UNROLLED_LINKED_LIST_SET_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * <h1> A sequential implementation of an Unrolled Linked List Set </h1>
+ *
+ * This is meant to be used by the Universal Constructs, as a drop-in replacement
+ * for LinkedListSet. Each node holds up to NODE_KEYS sorted keys (about
+ * NODE_BYTES bytes per node), so a traversal touches one cache miss per node
+ * instead of one per key.
+ * All the nodes are in a single std::vector (the arena) and are linked with 32 bit
+ * indexes, which means the copy constructor is the default one: one contiguous
+ * copy of the arena, a memcpy() when K is trivially copyable.
+ *
+ * A full node is split in two halves, and a node is merged with the next one when
+ * together they fit in half a node. The nodes that are unlinked go to a free list.
+ */
+template<typename K>
+class UnrolledLinkedListSet {
+
+private:
+    static const int      NODE_BYTES = 256;
+    static const int      NODE_KEYS = (NODE_BYTES - 8) / sizeof(K) < 4 ? 4 : (NODE_BYTES - 8) / sizeof(K);
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+    struct Node {
+        int      count {0};
+        uint32_t next {NONE};
+        K        keys[NODE_KEYS];
+    };
+
+    std::vector<Node> nodes;            // The first node is always the head, even if empty
+    uint32_t          freeList {NONE};  // Linked through Node::next
+
+    uint32_t allocNode() {
+        if (freeList == NONE) {
+            nodes.emplace_back();
+            return (uint32_t)(nodes.size() - 1);
+        }
+        const uint32_t inode = freeList;
+        freeList = nodes[inode].next;
+        nodes[inode].count = 0;
+        nodes[inode].next = NONE;
+        return inode;
+    }
+
+    void freeNode(uint32_t inode) {
+        nodes[inode].count = 0;
+        nodes[inode].next = freeList;
+        freeList = inode;
+    }
+
+    /*
+     * Finds the node where the key is or should be inserted, which is the first node
+     * whose last key is not smaller than 'key', or the last node.
+     */
+    uint32_t findNode(const K& key, uint32_t& prev) const {
+        prev = NONE;
+        uint32_t inode = 0;
+        while (true) {
+            const Node& node = nodes[inode];
+            if (node.next == NONE) return inode;
+            if (node.count > 0 && !(node.keys[node.count-1] < key)) return inode;
+            prev = inode;
+            inode = node.next;
+        }
+    }
+
+    // Position of the first key in the node that is not smaller than 'key'
+    static inline int findPos(const Node& node, const K& key) {
+        int pos = 0;
+        while (pos < node.count && node.keys[pos] < key) pos++;
+        return pos;
+    }
+
+    bool insert(const K& key) {
+        uint32_t prev;
+        uint32_t inode = findNode(key, prev);
+        int pos = findPos(nodes[inode], key);
+        if (pos < nodes[inode].count && key == nodes[inode].keys[pos]) return false;
+        if (nodes[inode].count == NODE_KEYS) {
+            // Split the node, the upper half goes to a new node after this one
+            const uint32_t inew = allocNode();   // May reallocate the arena
+            Node& node = nodes[inode];
+            Node& newNode = nodes[inew];
+            const int half = NODE_KEYS / 2;
+            for (int i = half; i < NODE_KEYS; i++) newNode.keys[i-half] = node.keys[i];
+            newNode.count = NODE_KEYS - half;
+            node.count = half;
+            newNode.next = node.next;
+            node.next = inew;
+            if (pos > half) {
+                inode = inew;
+                pos -= half;
+            }
+        }
+        Node& node = nodes[inode];
+        for (int i = node.count; i > pos; i--) node.keys[i] = node.keys[i-1];
+        node.keys[pos] = key;
+        node.count++;
+        return true;
+    }
+
+public:
+    UnrolledLinkedListSet() {
+        nodes.reserve(16);
+        allocNode();
+    }
+
+    // Universal Constructs need a copy constructor on the underlying data structure
+    UnrolledLinkedListSet(const UnrolledLinkedListSet& other) = default;
+
+
+    static std::string className() { return "UnrolledLinkedListSet"; }
+
+
+    /*
+     * Adds a key, returns false if the key is already in the set
+     */
+    bool add(const K& key) {
+        return insert(key);
+    }
+
+
+    /*
+     * Removes a key, returns false if the key is not in the set
+     */
+    bool remove(const K& key) {
+        uint32_t prev;
+        const uint32_t inode = findNode(key, prev);
+        Node& node = nodes[inode];
+        const int pos = findPos(node, key);
+        if (pos == node.count || !(key == node.keys[pos])) return false;
+        for (int i = pos; i < node.count-1; i++) node.keys[i] = node.keys[i+1];
+        node.count--;
+        if (node.count == 0 && prev != NONE) {
+            nodes[prev].next = node.next;
+            freeNode(inode);
+            return true;
+        }
+        const uint32_t inext = node.next;
+        if (inext != NONE && node.count + nodes[inext].count <= NODE_KEYS/2) {
+            Node& next = nodes[inext];
+            for (int i = 0; i < next.count; i++) node.keys[node.count+i] = next.keys[i];
+            node.count += next.count;
+            node.next = next.next;
+            freeNode(inext);
+        }
+        return true;
+    }
+
+
+    /*
+     * Returns true if it finds a matching key
+     */
+    bool contains(const K& key) {
+        uint32_t prev;
+        const Node& node = nodes[findNode(key, prev)];
+        const int pos = findPos(node, key);
+        return pos < node.count && key == node.keys[pos];
+    }
+
+
+    // Used only for benchmarks
+    bool addAll(K** keys, const int size) {
+        for (int i = 0; i < size; i++) insert(*keys[i]);
+        return true;
+    }
+};
+
+#endif /* _SEQUENTIAL_UNROLLED_LINKED_LIST_SET_H_ */
@@ -33,6 +33,7 @@
 #include <stdexcept>
 
 #include "common/HazardPointersSimQueue.hpp"
+#include "common/NodePool.hpp"
 
 
 /**
@@ -53,9 +54,12 @@
  * The paper on Hazard Pointers is named "Hazard Pointers: Safe Memory
  * Reclamation for Lock-Free objects" and it is available here:
  * http://web.cecs.pdx.edu/~walpole/class/cs510/papers/11.pdf
+ * <p>
+ * With POOLED=true the retired nodes go back to a NodePool once they pass the
+ * Hazard Pointers scan, and the per-thread pool[] is refilled from there.
  *
  */
-template<typename T>
+template<typename T, bool POOLED=false>
 class SimQueue {
 
 private:
@@ -132,6 +136,7 @@ private:
         return false;
     };
 
+    NodePool<Node>                nodePool {};
     HazardPointersSimQueue<Node>  hp {find, 1, maxThreads};
     const int kHpTail = 0;
     const int kHpNode = 0;
@@ -140,6 +145,7 @@ private:
 
 public:
     SimQueue(int maxThreads=MAX_THREADS) : maxThreads(maxThreads) {
+        if (POOLED) hp.setPool(&nodePool);
         for (int i = 0; i < maxThreads; i++) {
             enqueuers[i].store(false, std::memory_order_relaxed);
             dequeuers[i].store(false, std::memory_order_relaxed);
@@ -169,7 +175,7 @@ public:
     }
 
 
-    std::string className() { return "SimQueue"; }
+    std::string className() { return POOLED ? "SimQueue-Pool" : "SimQueue"; }
 
 
     /**
@@ -230,7 +236,7 @@ public:
             myPointer.u.index = myIndex;
             if (enqPointer.compare_exchange_strong(lpointer, myPointer)) {
                 for (int k = 0; k < numNodes; k++) {   // Refill pool
-                    pool[tid][k] = new Node(nullptr);
+                    pool[tid][k] = POOLED ? nodePool.create(tid, nullptr) : new Node(nullptr);
                 }
             }
         }
@@ -30,8 +30,10 @@
 #define _TURN_QUEUE_HP_H_
 
 #include <atomic>
+#include <cstdint>
 #include <stdexcept>
 #include "common/HazardPointers.hpp"
+#include "common/NodePool.hpp"
 
 
 /**
@@ -46,11 +48,26 @@
  * Enqueue algorithm: CR Turn enqueue
  * Dequeue algorithm: CR Turn dequeue
  * Consistency: Linearizable
- * enqueue() progress: wait-free bounded O(N_threads)
+ * enqueue() progress: wait-free bounded O(N_threads*MAX_BATCH)
  * dequeue() progress: wait-free bounded O(N_threads)
  * Memory Reclamation: Hazard Pointers (wait-free)
  *
  * <p>
+ * enqueueBatch() builds a chain with up to MAX_BATCH nodes and publishes its last
+ * node in enqueuers[], tagged with the lowest bit. The helpers link the whole chain
+ * with a single CAS on tail.next and then advance the tail over the nodes of the
+ * chain, one CAS each, which is why the bound on enqueue() is O(N_threads*MAX_BATCH)
+ * instead of O(N_threads). The request is done when the tail reaches the last node
+ * of the chain. Each item of the batch is linearizable as one enqueue, in order,
+ * and no other enqueue gets in between them.
+ * dequeueBatch() does one dequeue request for each item, but keeps the hazard
+ * pointers in place until the end of the batch.
+ *
+ * <p>
+ * With POOLED=true the nodes that pass the Hazard Pointers scan go to a NodePool
+ * and the enqueues take their nodes from it, instead of new/delete.
+ *
+ * <p>
  * The paper on Hazard Pointers is named "Hazard Pointers: Safe Memory
  * Reclamation for Lock-Free objects" and it is available here:
  * http://web.cecs.pdx.edu/~walpole/class/cs510/papers/11.pdf
@@ -58,7 +75,7 @@
  * @author Andreia Correia
  * @author Pedro Ramalhete
  */
-template<typename T>
+template<typename T, bool POOLED=false>
 class TurnQueue {
 
 private:
@@ -67,8 +84,9 @@ private:
         const int enqTid;
         std::atomic<int> deqTid;
         std::atomic<Node*> next;
+        Node* first;                 // First node of the chain, used only on the last node of a chain
 
-        Node(T* item, int tid) : item{item}, enqTid{tid}, deqTid{IDX_NONE}, next{nullptr} { }
+        Node(T* item, int tid) : item{item}, enqTid{tid}, deqTid{IDX_NONE}, next{nullptr}, first{this} { }
 
         bool casDeqTid(int cmp, int val) {
      	    return deqTid.compare_exchange_strong(cmp, val);
@@ -77,6 +95,7 @@ private:
 
     static const int IDX_NONE = -1;
     static const int MAX_THREADS = 128;
+    static const int MAX_BATCH = 128;
     const int maxThreads;
 
     // Pointers to head and tail of the list
@@ -89,15 +108,70 @@ private:
     alignas(128) std::atomic<Node*> deqhelp[MAX_THREADS];
 
 
+    NodePool<Node> nodePool {};
     HazardPointers<Node> hp {3, maxThreads}; // We need three hazard pointers
     const int kHpTail = 0;
     const int kHpHead = 0;
     const int kHpNext = 1;
     const int kHpDeq = 2;
+    const int kHpEnq = 2;
 
     Node* sentinelNode = new Node(nullptr, 0);
 
 
+    inline Node* createNode(T* item, const int tid) {
+        if (POOLED) return nodePool.create(tid, item, tid);
+        return new Node(item, tid);
+    }
+
+
+    // The request of an enqueueBatch() in enqueuers[] is the last node of the chain, with the lowest bit set
+    static inline Node* tagChain(Node* last) { return (Node*)((uintptr_t)last | 1); }
+    static inline Node* untag(Node* req) { return (Node*)((uintptr_t)req & ~(uintptr_t)1); }
+    static inline bool isChain(Node* req) { return ((uintptr_t)req & 1) != 0; }
+
+
+    /**
+     * Called only from enqueue() and enqueueBatch()
+     *
+     * The tail advances at least once in each iteration, and before our chain is
+     * linked it may have to go over the chains of all the other threads.
+     */
+    inline void enqueueRequest(Node* myReq, const int tid) {
+        enqueuers[tid].store(myReq);
+        for (int i = 0; i < (maxThreads+1)*MAX_BATCH; i++) {
+            if (enqueuers[tid].load() == nullptr) {
+                hp.clear(tid);
+                return; // Some thread did all the steps
+            }
+            Node* ltail = hp.protectPtr(kHpTail, tail.load(), tid);
+            if (ltail != tail.load()) continue; // If the tail advanced (maxThreads+1)*MAX_BATCH times, then my node has been enqueued
+            Node* lreq = enqueuers[ltail->enqTid].load();
+            if (untag(lreq) == ltail) {                      // Help a thread do step 4
+                enqueuers[ltail->enqTid].compare_exchange_strong(lreq, nullptr);
+            }
+            for (int j = 1; j < maxThreads+1; j++) {         // Help a thread do step 2
+                const int idEnq = (j + ltail->enqTid) % maxThreads;
+                Node* nodeToHelp = enqueuers[idEnq].load();
+                if (nodeToHelp == nullptr) continue;
+                if (isChain(nodeToHelp)) {
+                    // The last node can't be retired while it is still in enqueuers[], so protect it and re-check
+                    Node* llast = hp.protectPtr(kHpEnq, untag(nodeToHelp), tid);
+                    if (enqueuers[idEnq].load() != nodeToHelp) continue;
+                    nodeToHelp = llast->first;
+                }
+                Node* nodenull = nullptr;
+                ltail->next.compare_exchange_strong(nodenull, nodeToHelp);
+                break;
+            }
+            Node* lnext = ltail->next.load();
+     	    if (lnext != nullptr) tail.compare_exchange_strong(ltail, lnext); // Help a thread do step 3
+        }
+        enqueuers[tid].store(nullptr, std::memory_order_release); // Do step 4, just in case it's not done
+        hp.clear(tid);
+    }
+
+
     /**
      * Called only from dequeue()
      *
@@ -154,6 +228,7 @@ private:
 
 public:
     TurnQueue(int maxThreads=MAX_THREADS) : maxThreads(maxThreads) {
+        if (POOLED) hp.setPool(&nodePool);
         head.store(sentinelNode, std::memory_order_relaxed);
         tail.store(sentinelNode, std::memory_order_relaxed);
         for (int i = 0; i < maxThreads; i++) {
@@ -173,7 +248,7 @@ public:
     }
 
 
-    std::string className() { return "TurnQueue"; }
+    std::string className() { return POOLED ? "TurnQueue-Pool" : "TurnQueue"; }
 
 
     /**
@@ -187,31 +262,37 @@ public:
      */
     void enqueue(T* item, const int tid) {
         if (item == nullptr) throw std::invalid_argument("item can not be nullptr");
-        Node* myNode = new Node(item,tid);
-        enqueuers[tid].store(myNode);
-        for (int i = 0; i < maxThreads; i++) {
-            if (enqueuers[tid].load() == nullptr) {
-                hp.clear(tid);
-                return; // Some thread did all the steps
-            }
-            Node* ltail = hp.protectPtr(kHpTail, tail.load(), tid);
-            if (ltail != tail.load()) continue; // If the tail advanced maxThreads times, then my node has been enqueued
-            if (enqueuers[ltail->enqTid].load() == ltail) {  // Help a thread do step 4
-                Node* tmp = ltail;
-                enqueuers[ltail->enqTid].compare_exchange_strong(tmp, nullptr);
+        enqueueRequest(createNode(item,tid), tid);
+    }
+
+
+    /**
+     * Enqueues numItems items, in order. Each group of up to MAX_BATCH items is
+     * pre-linked in a chain of nodes and announced as a single request, which the
+     * helpers insert with a single CAS.
+     *
+     * @param tid The tid must be a UNIQUE index for each thread, in the range 0 to maxThreads-1
+     */
+    void enqueueBatch(T** items, const int numItems, const int tid) {
+        for (int i = 0; i < numItems; i++) {
+            if (items[i] == nullptr) throw std::invalid_argument("item can not be nullptr");
+        }
+        for (int ibegin = 0; ibegin < numItems; ibegin += MAX_BATCH) {
+            const int iend = (ibegin + MAX_BATCH < numItems) ? ibegin + MAX_BATCH : numItems;
+            Node* lfirst = createNode(items[ibegin], tid);
+            if (iend - ibegin == 1) {
+                enqueueRequest(lfirst, tid);
+                continue;
             }
-            for (int j = 1; j < maxThreads+1; j++) {         // Help a thread do step 2
-                Node* nodeToHelp = enqueuers[(j + ltail->enqTid) % maxThreads].load();
-                if (nodeToHelp == nullptr) continue;
-                Node* nodenull = nullptr;
-                ltail->next.compare_exchange_strong(nodenull, nodeToHelp);
-                break;
+            Node* llast = lfirst;
+            for (int i = ibegin+1; i < iend; i++) {
+                Node* node = createNode(items[i], tid);
+                llast->next.store(node, std::memory_order_relaxed);
+                llast = node;
             }
-            Node* lnext = ltail->next.load();
-     	    if (lnext != nullptr) tail.compare_exchange_strong(ltail, lnext); // Help a thread do step 3
+            llast->first = lfirst;
+            enqueueRequest(tagChain(llast), tid);
         }
-        enqueuers[tid].store(nullptr, std::memory_order_release); // Do step 4, just in case it's not done
-        hp.clear(tid);
     }
 
 
@@ -228,6 +309,32 @@ public:
      * @param tid: The tid must be a UNIQUE index for each thread, in the range 0 to maxThreads-1
      */
     T* dequeue(const int tid) {
+        T* item = dequeueRequest(tid);
+        hp.clear(tid);
+        return item;
+    }
+
+
+    /**
+     * Dequeues up to maxItems items into items[] and returns how many it dequeued,
+     * which is less than maxItems only if the queue became empty.
+     *
+     * @param tid: The tid must be a UNIQUE index for each thread, in the range 0 to maxThreads-1
+     */
+    int dequeueBatch(T** items, const int maxItems, const int tid) {
+        int numItems = 0;
+        while (numItems < maxItems) {
+            T* item = dequeueRequest(tid);
+            if (item == nullptr) break;
+            items[numItems++] = item;
+        }
+        hp.clear(tid);
+        return numItems;
+    }
+
+private:
+    // Called only from dequeue() and dequeueBatch(), which are the ones to clear the hazard pointers
+    T* dequeueRequest(const int tid) {
         Node* prReq = deqself[tid].load();     // Previous request
         Node* myReq = deqhelp[tid].load();
         deqself[tid].store(myReq);             // Step 1
@@ -242,7 +349,6 @@ public:
                     deqself[tid].store(myReq, std::memory_order_relaxed);
                     break;
                 }
-                hp.clear(tid);
                 return nullptr;
             }
             Node* lnext = hp.protectPtr(kHpNext, lhead->next.load(), tid);
@@ -252,7 +358,6 @@ public:
         Node* myNode = deqhelp[tid].load();
         Node* lhead = hp.protectPtr(kHpHead, head.load(), tid);     // Do step 4 if needed
         if (lhead == head.load() && myNode == lhead->next.load()) head.compare_exchange_strong(lhead, myNode);
-        hp.clear(tid);
         hp.retire(prReq, tid);
         return myNode->item;
     }
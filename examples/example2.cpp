@@ -0,0 +1,38 @@
+#include <iostream>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "ucs/CXMutationWF.hpp"
+#include "datastructures/sequential/TreeSet.hpp"
+
+// All the nodes of the set are allocated in the shared memory segment
+using SharedSet = TreeSet<int,SharedAllocator<int>>;
+using SharedCX = CXMutationWF<SharedSet,bool,HazardPointersCX,NoStats,CopyAlways,SharedReplicas>;
+
+int main(void) {
+    const int maxThreads = 4;
+    SharedSegment::unlink("/cx-example2");
+    SharedSegment* segment = SharedSegment::create("/cx-example2", 64*1024*1024);
+    if (segment == nullptr) {
+        std::cout << "error: could not map the segment\n";
+        return 1;
+    }
+    // The CX, its Combined instances and the replicas are in the segment
+    SharedCX* cx = segment->construct<SharedCX>(new SharedSet(), maxThreads);
+    segment->setRoot(cx);
+    cx->applyUpdate([] (SharedSet* set) { return set->add(33); }, 0);
+
+    // A process that is not forked would call SharedSegment::attach("/cx-example2") and segment->getRoot<SharedCX>()
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Each process uses its own tids
+        bool foundit = cx->applyReadAttached([] (SharedSet* set) { return set->contains(33); }, 1);
+        std::cout << (foundit ? "Found the key in the other process" : "error") << std::endl;
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+
+    segment->destroy(cx);
+    delete segment;
+    SharedSegment::unlink("/cx-example2");
+    return 0;
+}
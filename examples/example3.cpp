@@ -0,0 +1,40 @@
+#include <ucs/CXMutationWF.hpp>
+#include <map>
+#include <optional>
+#include <string>
+
+// The result of each mutation is the previous value of the key, which is stored out of line in the nodes
+using NameMap = std::map<int,std::string>;
+using OptName = std::optional<std::string>;
+
+int main(void) {
+    const int tid = 0;
+    CXMutationWF<NameMap,OptName> cx {new NameMap()};
+
+    // Enqueue two updates without waiting for them to be applied (wait-free progress)
+    auto first = cx.applyUpdateAsync([] (NameMap* map) -> OptName {
+        auto it = map->find(33);
+        OptName prev = (it == map->end()) ? OptName{} : OptName{it->second};
+        (*map)[33] = "thirty-three";
+        return prev;
+    }, tid);
+    auto second = cx.applyUpdateAsync([] (NameMap* map) -> OptName {
+        auto it = map->find(33);
+        OptName prev = (it == map->end()) ? OptName{} : OptName{it->second};
+        (*map)[33] = "thirty three";
+        return prev;
+    }, tid);
+
+    // get() applies the pending updates if no one else has, and returns the result of each one
+    OptName prev1 = first.get(tid);
+    OptName prev2 = second.get(tid);
+
+    // Will never print out "error"
+    if (!prev1 && prev2 && *prev2 == "thirty-three") {
+        std::cout << "The second update replaced the name of the first one\n";
+    } else {
+        std::cout << "error\n";
+    }
+
+    return 0;
+}
@@ -1,19 +1,22 @@
 
 /*
- * Executes the following non-blocking (array based) queues in a single-enqueue-single-dequeue benchmark:
- * - LCRQ (lock-free)
- * - FAAArrayQueue (lock-free)
- * - MWC-LF (lock-free)
- * - MWC-WF (wait-free bounded)
+ * Executes the following array based queues in a single-enqueue-single-dequeue benchmark:
+ * - CX + ArrayQueue (wait-free bounded)
+ * - PSimOpt + ArrayQueue (wait-free bounded)
+ * and, for comparison, the linked list based:
+ * - Turn Queue (wait-free bounded)
+ * - CX + LinkedListQueue (wait-free bounded)
  */
 #include <iostream>
 #include <fstream>
 #include <cstring>
 
-#include "datastructures/queues/LCRQueue.hpp"
-#include "datastructures/queues/FAAArrayQueue.hpp"
-#include "datastructures/queues/OFLFArrayLinkedListQueue.hpp"
-#include "datastructures/queues/OFWFArrayLinkedListQueue.hpp"
+#include "datastructures/waitfree/TurnQueue.hpp"
+#include "common/UCQueue.hpp"
+#include "datastructures/sequential/ArrayQueue.hpp"
+#include "datastructures/sequential/LinkedListQueue.hpp"
+#include "ucs/PSimOpt.hpp"
+#include "ucs/CXMutationWF.hpp"
 #include "benchmarks/BenchmarkQueues.hpp"
 
 #define MILLION  1000000LL
@@ -24,7 +27,7 @@ int main(void) {
     //vector<int> threadList = { 1, 2, 4, 8, 16, 32, 48, 64 }; // For Cervino
     const int numRuns = 1;                                   // Number of runs
     const long numPairs = 10*MILLION;                        // 10M is fast enough on the laptop, but on cervino we can use 100M
-    const int EMAX_CLASS = 5;
+    const int EMAX_CLASS = 4;
     uint64_t results[EMAX_CLASS][threadList.size()];
     std::string cNames[EMAX_CLASS];
     // Reset results
@@ -36,11 +39,10 @@ int main(void) {
         int iclass = 0;
         BenchmarkQueues bench(nThreads);
         std::cout << "\n----- q-array-enq-deq   threads=" << nThreads << "   pairs=" << numPairs/MILLION << "M   runs=" << numRuns << "-----\n";
-        results[iclass++][ithread] = bench.enqDeq<FAAArrayQueue<UserData>>            (cNames[iclass], numPairs, numRuns);
-        results[iclass++][ithread] = bench.enqDeq<LCRQueue<UserData>>                 (cNames[iclass], numPairs, numRuns);
-        results[iclass++][ithread] = bench.enqDeq<OFLFArrayLinkedListQueue<UserData>> (cNames[iclass], numPairs, numRuns);
-        results[iclass++][ithread] = bench.enqDeq<OFWFArrayLinkedListQueue<UserData>> (cNames[iclass], numPairs, numRuns);
-        //results[iclass++][ithread] = bench.enqDeq<TinySTMLinkedListQueue<UserData>>(classNames[iclass], numPairs, numRuns);
+        results[iclass++][ithread] = bench.enqDeq<UCQueue<CXMutationWF<ArrayQueue<UserData>,UserData*>,ArrayQueue<UserData>,UserData>>           (cNames[iclass], numPairs, numRuns);
+        results[iclass++][ithread] = bench.enqDeq<UCQueue<PSimOpt<ArrayQueue<UserData>,UserData*>,ArrayQueue<UserData>,UserData>>               (cNames[iclass], numPairs, numRuns);
+        results[iclass++][ithread] = bench.enqDeq<TurnQueue<UserData>>                                                                          (cNames[iclass], numPairs, numRuns);
+        results[iclass++][ithread] = bench.enqDeq<UCQueue<CXMutationWF<LinkedListQueue<UserData>,UserData*>,LinkedListQueue<UserData>,UserData>> (cNames[iclass], numPairs, numRuns);
     }
 
     // Export tab-separated values to a file to be imported in gnuplot or excel
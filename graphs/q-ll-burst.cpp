@@ -0,0 +1,64 @@
+/*
+ * Executes the following linked list based queues in a burst benchmark, where all
+ * the threads enqueue a burst of items and then dequeue them:
+ * - Turn Queue (wait-free bounded), one item at a time
+ * - Turn Queue (wait-free bounded), with enqueueBatch()/dequeueBatch() of 32 items
+ * - Turn Queue (wait-free bounded), with enqueueBatch()/dequeueBatch() of 128 items
+ * - Michael-Scott (lock-free)
+ */
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include "datastructures/lockfree/MichaelScottQueue.hpp"
+#include "datastructures/waitfree/TurnQueue.hpp"
+#include "benchmarks/BenchmarkQueues.hpp"
+
+#define MILLION  1000000LL
+
+int main(void) {
+    const std::string dataFilename {"data/q-ll-burst.txt"};
+    vector<int> threadList = { 1, 2, 4, 8 };                 // For the laptop
+    //vector<int> threadList = { 1, 2, 4, 8, 16, 32, 48, 64 }; // For Cervino
+    const int numRuns = 1;                                   // Number of runs
+    const long long burstSize = 1*MILLION;                   // Items enqueued (and then dequeued) by all threads in each iteration
+    const int numIters = 10;                                 // Number of bursts in each run
+    const int EMAX_CLASS = 4;
+    uint64_t resultsEnq[EMAX_CLASS][threadList.size()];
+    uint64_t resultsDeq[EMAX_CLASS][threadList.size()];
+    std::string cNames[EMAX_CLASS];
+    // Reset results
+    std::memset(resultsEnq, 0, sizeof(uint64_t)*EMAX_CLASS*threadList.size());
+    std::memset(resultsDeq, 0, sizeof(uint64_t)*EMAX_CLASS*threadList.size());
+
+    // Burst benchmarks
+    for (int ithread = 0; ithread < threadList.size(); ithread++) {
+        int nThreads = threadList[ithread];
+        int iclass = 0;
+        BenchmarkQueues bench(nThreads);
+        std::cout << "\n----- q-ll-burst   threads=" << nThreads << "   burst=" << burstSize/MILLION << "M   iters=" << numIters << "   runs=" << numRuns << "-----\n";
+        bench.burst<TurnQueue<UserData>>        (cNames[iclass], resultsEnq[iclass][ithread], resultsDeq[iclass][ithread], burstSize, numIters, numRuns); iclass++;
+        bench.burst<TurnQueue<UserData>,32>     (cNames[iclass], resultsEnq[iclass][ithread], resultsDeq[iclass][ithread], burstSize, numIters, numRuns); iclass++;
+        bench.burst<TurnQueue<UserData>,128>    (cNames[iclass], resultsEnq[iclass][ithread], resultsDeq[iclass][ithread], burstSize, numIters, numRuns); iclass++;
+        bench.burst<MichaelScottQueue<UserData>>(cNames[iclass], resultsEnq[iclass][ithread], resultsDeq[iclass][ithread], burstSize, numIters, numRuns); iclass++;
+    }
+
+    // Export tab-separated values to a file to be imported in gnuplot or excel
+    ofstream dataFile;
+    dataFile.open(dataFilename);
+    dataFile << "Threads\t";
+    // Printf class names for each column, enqueues first and then dequeues
+    for (int iclass = 0; iclass < EMAX_CLASS; iclass++) dataFile << cNames[iclass] << "-Enq\t";
+    for (int iclass = 0; iclass < EMAX_CLASS; iclass++) dataFile << cNames[iclass] << "-Deq\t";
+    dataFile << "\n";
+    for (int ithread = 0; ithread < threadList.size(); ithread++) {
+        dataFile << threadList[ithread] << "\t";
+        for (int iclass = 0; iclass < EMAX_CLASS; iclass++) dataFile << resultsEnq[iclass][ithread] << "\t";
+        for (int iclass = 0; iclass < EMAX_CLASS; iclass++) dataFile << resultsDeq[iclass][ithread] << "\t";
+        dataFile << "\n";
+    }
+    dataFile.close();
+    std::cout << "\nSuccessfuly saved results in " << dataFilename << "\n";
+
+    return 0;
+}
@@ -4,6 +4,7 @@
  * - Michael-Scott (lock-free)
  * - SimQueue (wait-free bounded)
  * - Turn Queue (wait-free bounded)
+ * - the same three, with their nodes recycled through a NodePool
  * - MWC-LF (lock-free)
  * - MWC-WF (wait-free bounded)
  */
@@ -29,7 +30,7 @@ int main(void) {
     //vector<int> threadList = { 1, 2, 4, 8, 16, 32, 48, 64, 72, 80, 88, 96 }; // For Cervino
     const int numRuns = 1;                                   // Number of runs
     const long numPairs = 10*MILLION;                        // 10M is fast enough on the laptop, but on cervino we can use 100M
-    const int EMAX_CLASS = 6;
+    const int EMAX_CLASS = 7;
     uint64_t results[EMAX_CLASS][threadList.size()];
     std::string cNames[EMAX_CLASS];
     // Reset results
@@ -44,7 +45,10 @@ int main(void) {
         results[iclass++][ithread] = bench.enqDeq<MichaelScottQueue<UserData>>                                                                  (cNames[iclass], numPairs, numRuns);
         results[iclass++][ithread] = bench.enqDeq<SimQueue<UserData>>                                                                           (cNames[iclass], numPairs, numRuns);
         results[iclass++][ithread] = bench.enqDeq<TurnQueue<UserData>>                                                                          (cNames[iclass], numPairs, numRuns);
-        results[iclass++][ithread] = bench.enqDeq<UCQueue<CXMutationWF<LinkedListQueue<UserData>>,LinkedListQueue<UserData>,UserData>>          (cNames[iclass], numPairs, numRuns);
+        results[iclass++][ithread] = bench.enqDeq<MichaelScottQueue<UserData,true>>                                                             (cNames[iclass], numPairs, numRuns);
+        results[iclass++][ithread] = bench.enqDeq<SimQueue<UserData,true>>                                                                      (cNames[iclass], numPairs, numRuns);
+        results[iclass++][ithread] = bench.enqDeq<TurnQueue<UserData,true>>                                                                     (cNames[iclass], numPairs, numRuns);
+        results[iclass++][ithread] = bench.enqDeq<UCQueue<CXMutationWF<LinkedListQueue<UserData>,UserData*>,LinkedListQueue<UserData>,UserData>> (cNames[iclass], numPairs, numRuns);
         // PSim+LinkedListQueue is just too slow to measure
     }
 
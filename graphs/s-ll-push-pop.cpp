@@ -0,0 +1,61 @@
+
+/*
+ * Executes CX-WF with a LinkedListStack in a push-pop pairs benchmark (the same as q-ll-enq-deq):
+ * - without the elimination array of UCStack
+ * - with the elimination array, and a push waiting 64, 256 and 1024 iterations for a pop
+ */
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include "common/UCStack.hpp"
+#include "datastructures/sequential/LinkedListStack.hpp"
+#include "ucs/CXMutationWF.hpp"
+#include "benchmarks/BenchmarkQueues.hpp"
+
+
+#define MILLION  1000000LL
+
+template<int ELIM_SPINS> using CXStack = UCStack<CXMutationWF<LinkedListStack<UserData>,UserData*>,LinkedListStack<UserData>,UserData,ELIM_SPINS>;
+
+int main(void) {
+    const std::string dataFilename {"data/s-ll-push-pop.txt"};
+    vector<int> threadList = { 1, 2, 4, 8 };                 // For the laptop
+    //vector<int> threadList = { 1, 2, 4, 8, 16, 32, 48, 64, 72, 80, 88, 96 }; // For Cervino
+    const int numRuns = 1;                                   // Number of runs
+    const long numPairs = 10*MILLION;                        // 10M is fast enough on the laptop, but on cervino we can use 100M
+    const int EMAX_CLASS = 4;
+    uint64_t results[EMAX_CLASS][threadList.size()];
+    std::string cNames[EMAX_CLASS];
+    // Reset results
+    std::memset(results, 0, sizeof(uint64_t)*EMAX_CLASS*threadList.size());
+
+    // Push-Pop Throughput benchmarks
+    for (int ithread = 0; ithread < threadList.size(); ithread++) {
+        int nThreads = threadList[ithread];
+        int iclass = 0;
+        BenchmarkQueues bench(nThreads);
+        std::cout << "\n----- s-ll-push-pop   threads=" << nThreads << "   pairs=" << numPairs/MILLION << "M   runs=" << numRuns << "-----\n";
+        results[iclass++][ithread] = bench.pushPop<CXStack<0>>   (cNames[iclass], numPairs, numRuns);
+        results[iclass++][ithread] = bench.pushPop<CXStack<64>>  (cNames[iclass], numPairs, numRuns);
+        results[iclass++][ithread] = bench.pushPop<CXStack<256>> (cNames[iclass], numPairs, numRuns);
+        results[iclass++][ithread] = bench.pushPop<CXStack<1024>>(cNames[iclass], numPairs, numRuns);
+    }
+
+    // Export tab-separated values to a file to be imported in gnuplot or excel
+    ofstream dataFile;
+    dataFile.open(dataFilename);
+    dataFile << "Threads\t";
+    // Printf class names for each column
+    for (int iclass = 0; iclass < EMAX_CLASS; iclass++) dataFile << cNames[iclass] << "\t";
+    dataFile << "\n";
+    for (int ithread = 0; ithread < threadList.size(); ithread++) {
+        dataFile << threadList[ithread] << "\t";
+        for (int iclass = 0; iclass < EMAX_CLASS; iclass++) dataFile << results[iclass][ithread] << "\t";
+        dataFile << "\n";
+    }
+    dataFile.close();
+    std::cout << "\nSuccessfuly saved results in " << dataFilename << "\n";
+
+    return 0;
+}
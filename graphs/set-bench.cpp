@@ -0,0 +1,116 @@
+#include <iostream>
+#include <fstream>
+#include <cstring>
+
+#include "common/UCSet.hpp"
+#include "common/ShardedUC.hpp"
+#include "datastructures/lockfree/MagedHarrisLinkedListSetHP.hpp"
+#include "datastructures/lockfree/NatarajanTreeHE.hpp"
+#include "datastructures/lockfree/SplitOrderedHashSetHP.hpp"
+#include "datastructures/sequential/LinkedListSet.hpp"
+#include "datastructures/sequential/TreeSet.hpp"
+#include "datastructures/sequential/HashSet.hpp"
+#include "datastructures/sequential/SortedVectorValueSet.hpp"
+#include "ucs/COW.hpp"
+#include "ucs/PSim.hpp"
+#include "ucs/PSimOpt.hpp"
+#include "ucs/CXMutationWF.hpp"
+#include "ucs/CXMutationWFTimed.hpp"
+#include "ucs/CXMutationRCU.hpp"
+#include "ucs/HerlihyUniversal.hpp"
+#include "benchmarks/BenchmarkSets.hpp"
+#include "benchmarks/BenchmarkConfig.hpp"
+
+/*
+ * A single benchmark for all the sets, where the workload comes from the command line
+ * or from a JSON file (see BenchmarkConfig.hpp), for example:
+ *   bin/set-bench --sets cx-tree,natarajan-he --threads 1,2,4 --ratios 100 --elements 10000 --duration 5 --output data/tree.csv
+ */
+
+using SetBenchmark = long long (*)(BenchmarkSets&, std::string&, const int, const seconds, const int, const int, const int);
+
+template<typename S>
+long long runSet(BenchmarkSets& bench, std::string& className, const int ratio, const seconds testLength, const int numRuns, const int numElements, const int numObjs) {
+    return bench.benchmark<S,UserData>(className, ratio, testLength, numRuns, numElements, false, numObjs);
+}
+
+static const std::vector<std::pair<std::string,SetBenchmark>> allSets = {
+    {"psim-list",         runSet<UCSet<PSim<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>>},
+    {"psim-tree",         runSet<UCSet<PSim<TreeSet<UserData>>,TreeSet<UserData>,UserData>>},
+    {"psim-hash",         runSet<UCSet<PSim<HashSet<UserData>>,HashSet<UserData>,UserData>>},
+    {"psimopt-list",      runSet<UCSet<PSimOpt<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>>},
+    {"psimopt-tree",      runSet<UCSet<PSimOpt<TreeSet<UserData>>,TreeSet<UserData>,UserData>>},
+    {"psimopt-hash",      runSet<UCSet<PSimOpt<HashSet<UserData>>,HashSet<UserData>,UserData>>},
+    {"cx-list",           runSet<UCSet<CXMutationWF<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>>},
+    {"cx-tree",           runSet<UCSet<CXMutationWF<TreeSet<UserData>>,TreeSet<UserData>,UserData>>},
+    {"cx-hash",           runSet<UCSet<CXMutationWF<HashSet<UserData>>,HashSet<UserData>,UserData>>},
+    {"cxtimed-list",      runSet<UCSet<CXMutationWFTimed<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>>},
+    {"cxtimed-tree",      runSet<UCSet<CXMutationWFTimed<TreeSet<UserData>>,TreeSet<UserData>,UserData>>},
+    {"cxtimed-hash",      runSet<UCSet<CXMutationWFTimed<HashSet<UserData>>,HashSet<UserData>,UserData>>},
+    {"cx-vector",         runSet<UCSet<CXMutationWF<SortedVectorValueSet<UserData>>,SortedVectorValueSet<UserData>,UserData>>},
+    {"cow-vector",        runSet<UCSet<COW<SortedVectorValueSet<UserData>,bool,false>,SortedVectorValueSet<UserData>,UserData>>},
+    {"cowcomb-vector",    runSet<UCSet<COW<SortedVectorValueSet<UserData>>,SortedVectorValueSet<UserData>,UserData>>},
+    {"cxrcu-tree",        runSet<UCSet<CXMutationRCU<TreeSet<UserData>>,TreeSet<UserData>,UserData>>},
+    {"cx-tree-stats",     runSet<UCSet<CXMutationWF<TreeSet<UserData>,bool,HazardPointersCX,UCStats>,TreeSet<UserData>,UserData>>},
+    {"cxtimed-tree-stats",runSet<UCSet<CXMutationWFTimed<TreeSet<UserData>,bool,UCStats>,TreeSet<UserData>,UserData>>},
+    {"psimopt-tree-stats",runSet<UCSet<PSimOpt<TreeSet<UserData>,bool,UCStats>,TreeSet<UserData>,UserData>>},
+    {"herlihy-list",      runSet<UCSet<HerlihyUniversal<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>>},
+    {"sharded-cx-tree",   runSet<ShardedUC<CXMutationWF<TreeSet<UserData>>,TreeSet<UserData>,UserData>>},
+    {"maged-harris-hp",   runSet<MagedHarrisLinkedListSetHP<UserData>>},
+    {"natarajan-he",      runSet<NatarajanTreeHE<UserData,UserData>>},
+    {"split-ordered-hp",  runSet<SplitOrderedHashSetHP<UserData>>},
+};
+
+
+int main(int argc, char* argv[]) {
+    BenchmarkConfig config;
+    if (!config.parse(argc, argv)) return 1;
+    if (config.list || config.sets.empty()) {
+        std::cout << "Usage: " << argv[0] << " --sets <names> [options], with the sets:\n";
+        for (auto& entry : allSets) std::cout << "  " << entry.first << "\n";
+        return config.list ? 0 : 1;
+    }
+    KeyDistribution keyDist;
+    if (!KeyDistribution::parse(config.dist, keyDist)) {
+        BenchmarkConfig::error("unknown key distribution '" + config.dist + "'");
+        return 1;
+    }
+    ThreadPinning pinning;
+    if (!config.pin.empty() && !ThreadPinning::parse(config.pin, pinning)) {
+        BenchmarkConfig::error("unknown thread pinning '" + config.pin + "'");
+        return 1;
+    }
+    std::vector<SetBenchmark> benchs;
+    for (auto& name : config.sets) {
+        auto it = std::find_if(allSets.begin(), allSets.end(), [&name] (auto& entry) { return entry.first == name; });
+        if (it == allSets.end()) {
+            BenchmarkConfig::error("unknown set '" + name + "', see --list");
+            return 1;
+        }
+        benchs.push_back(it->second);
+    }
+
+    const seconds testLength {config.duration};
+    double totalHours = (double)benchs.size()*config.ratios.size()*config.threads.size()*testLength.count()*config.runs/(60.*60.);
+    std::cout << "This benchmark is going to take about " << totalHours << " hours to complete\n";
+
+    std::vector<BenchmarkRecord> records;
+    for (auto ratio : config.ratios) {
+        for (auto nThreads : config.threads) {
+            BenchmarkSets bench(nThreads);
+            bench.setKeyDistribution(keyDist);
+            bench.setPinning(pinning);
+            if (config.perf != 0) bench.setPerfCounters(true);
+            std::cout << "\n----- Sets   numElements=" << config.elements << "   ratio=" << ratio/10. << "%   threads=" << nThreads << "   runs=" << config.runs << "   length=" << testLength.count() << "s -----\n";
+            for (auto runBench : benchs) {
+                std::string className;
+                long long ops = runBench(bench, className, ratio, testLength, config.runs, config.elements, config.shards);
+                records.emplace_back(className, nThreads, ratio, config.elements, keyDist.name(), pinning.describe(nThreads), ops, bench.latency(), bench.memory());
+            }
+        }
+    }
+
+    if (!writeBenchmarkRecords(config.output, records)) return 1;
+    if (!config.output.empty()) std::cout << "\nSuccessfuly saved results in " << config.output << "\n";
+    return 0;
+}
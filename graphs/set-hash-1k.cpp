@@ -9,8 +9,9 @@
 #include <cstring>
 
 #include "common/UCSet.hpp"
-#include "datastructures/lockfree/MagedHarrisHashSetHP.hpp"
+#include "datastructures/lockfree/SplitOrderedHashSetHP.hpp"
 #include "datastructures/sequential/HashSet.hpp"
+#include "datastructures/sequential/FlatHashSet.hpp"
 #include "ucs/PSim.hpp"
 #include "ucs/PSimOpt.hpp"
 #include "ucs/CXMutationWF.hpp"
@@ -47,7 +48,8 @@ int main(void) {
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<PSimOpt<HashSet<UserData>>,HashSet<UserData>,UserData>,UserData>               (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<HashSet<UserData>>,HashSet<UserData>,UserData>,UserData>          (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWFTimed<HashSet<UserData>>,HashSet<UserData>,UserData>,UserData>     (cNames[iclass], ratio, testLength, numRuns, numElements, false);
-            results[iclass++][ithread][iratio] = bench.benchmark<MagedHarrisHashSetHP<UserData>,UserData>                                             (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<FlatHashSet<UserData>>,FlatHashSet<UserData>,UserData>,UserData>  (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<SplitOrderedHashSetHP<UserData>,UserData>                                            (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             maxClass = iclass;
         }
     }
@@ -12,6 +12,7 @@
 #include "datastructures/lockfree/MagedHarrisLinkedListSetHP.hpp"
 #include "datastructures/lockfree/MagedHarrisLinkedListSetHE.hpp"
 #include "datastructures/sequential/LinkedListSet.hpp"
+#include "datastructures/sequential/UnrolledLinkedListSet.hpp"
 #include "ucs/PSim.hpp"
 #include "ucs/PSimOpt.hpp"
 #include "ucs/CXMutationWF.hpp"
@@ -48,6 +49,7 @@ int main(void) {
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<PSimOpt<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>,UserData>               (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>,UserData>          (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWFTimed<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>,UserData>     (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<UnrolledLinkedListSet<UserData>>,UnrolledLinkedListSet<UserData>,UserData>,UserData>(cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<MagedHarrisLinkedListSetHP<UserData>,UserData>                                                   (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<MagedHarrisLinkedListSetHE<UserData>,UserData>                                                   (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             maxClass = iclass;
@@ -12,8 +12,10 @@
 #include "datastructures/lockfree/MagedHarrisLinkedListSetHP.hpp"
 #include "datastructures/lockfree/MagedHarrisLinkedListSetHE.hpp"
 #include "datastructures/sequential/LinkedListSet.hpp"
+#include "datastructures/sequential/UnrolledLinkedListSet.hpp"
 #include "ucs/PSimOpt.hpp"
 #include "ucs/PSim.hpp"
+#include "ucs/HerlihyUniversal.hpp"
 #include "ucs/CXMutationWF.hpp"
 #include "ucs/CXMutationWFTimed.hpp"
 #include "benchmarks/BenchmarkSets.hpp"
@@ -46,8 +48,10 @@ int main(void) {
             std::cout << "\n----- Sets (Linked-Lists)   numElements=" << numElements << "   ratio=" << ratio/10. << "%   threads=" << nThreads << "   runs=" << numRuns << "   length=" << testLength.count() << "s -----\n";
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<PSim<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>,UserData>                  (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<PSimOpt<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>,UserData>               (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSet<HerlihyUniversal<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>,UserData>     (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>,UserData>          (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWFTimed<LinkedListSet<UserData>>,LinkedListSet<UserData>,UserData>,UserData>     (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<UnrolledLinkedListSet<UserData>>,UnrolledLinkedListSet<UserData>,UserData>,UserData>(cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<MagedHarrisLinkedListSetHP<UserData>,UserData>                                                   (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<MagedHarrisLinkedListSetHE<UserData>,UserData>                                                   (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             maxClass = iclass;
@@ -9,6 +9,7 @@
 #include <cstring>
 
 #include "common/UCSet.hpp"
+#include "datastructures/lockfree/NatarajanTreeHE.hpp"
 #include "datastructures/sequential/TreeSet.hpp"
 #include "ucs/PSim.hpp"
 #include "ucs/PSimOpt.hpp"
@@ -43,6 +44,7 @@ int main(void) {
         results[iclass++][ithread] = bench.benchmark<UCSet<PSimOpt<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>               (cNames[iclass], testLength, numRuns, numElements);
         results[iclass++][ithread] = bench.benchmark<UCSet<CXMutationWF<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>          (cNames[iclass], testLength, numRuns, numElements);
         results[iclass++][ithread] = bench.benchmark<UCSet<CXMutationWFTimed<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>          (cNames[iclass], testLength, numRuns, numElements);
+        results[iclass++][ithread] = bench.benchmark<NatarajanTreeHE<UserData,UserData>,UserData>                                          (cNames[iclass], testLength, numRuns, numElements);
         maxClass = iclass;
     }
 
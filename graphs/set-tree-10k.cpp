@@ -4,10 +4,12 @@
 
 #include "common/UCSet.hpp"
 #include "datastructures/lockfree/NatarajanTreeHE.hpp"
+#include "datastructures/lockfree/HerlihyShavitSkipListSetEBR.hpp"
 #include "datastructures/sequential/TreeSet.hpp"
 #include "ucs/PSim.hpp"
 #include "ucs/PSimOpt.hpp"
 #include "ucs/CXMutationWF.hpp"
+#include "ucs/CXMutationRCU.hpp"
 #include "ucs/CXMutationWFTimed.hpp"
 #include "benchmarks/BenchmarkSets.hpp"
 
@@ -40,8 +42,10 @@ int main(void) {
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<PSim<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>                  (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<PSimOpt<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>               (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>          (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationRCU<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>         (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWFTimed<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>     (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<NatarajanTreeHE<UserData,UserData>,UserData>                                         (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<HerlihyShavitSkipListSetEBR<UserData>,UserData>                                      (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             maxClass = iclass;
         }
     }
@@ -5,11 +5,14 @@
 #include "common/UCSet.hpp"
 //#include "datastructures/lockfree/NatarajanTreeHP.hpp"
 #include "datastructures/lockfree/NatarajanTreeHE.hpp"
+#include "datastructures/lockfree/HerlihyShavitSkipListSetEBR.hpp"
 #include "datastructures/sequential/TreeSet.hpp"
+#include "datastructures/sequential/SortedVectorValueSet.hpp"
 #include "ucs/PSim.hpp"
 #include "ucs/PSimOpt.hpp"
 #include "ucs/CXMutationWF.hpp"
 #include "ucs/CXMutationWFTimed.hpp"
+#include "ucs/COW.hpp"
 #include "benchmarks/BenchmarkSets.hpp"
 
 
@@ -42,7 +45,11 @@ int main(void) {
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<PSimOpt<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>               (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>          (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWFTimed<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>     (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<SortedVectorValueSet<UserData>>,SortedVectorValueSet<UserData>,UserData>,UserData>(cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSet<COW<SortedVectorValueSet<UserData>,bool,false>,SortedVectorValueSet<UserData>,UserData>,UserData>(cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSet<COW<SortedVectorValueSet<UserData>>,SortedVectorValueSet<UserData>,UserData>,UserData>  (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<NatarajanTreeHE<UserData,UserData>,UserData>                                         (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<HerlihyShavitSkipListSetEBR<UserData>,UserData>                                      (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             maxClass = iclass;
         }
     }
@@ -3,14 +3,20 @@
 #include <cstring>
 
 #include "common/UCSet.hpp"
+#include "common/ShardedUC.hpp"
 #include "datastructures/lockfree/NatarajanTreeHE.hpp"
+#include "datastructures/lockfree/HerlihyShavitSkipListSetEBR.hpp"
 #include "datastructures/sequential/TreeSet.hpp"
+#include "datastructures/sequential/BPlusTree.hpp"
+#include "datastructures/sequential/PersistentTreeSet.hpp"
 #include "ucs/PSim.hpp"
 #include "ucs/PSimOpt.hpp"
 #include "ucs/CXMutationWF.hpp"
 #include "ucs/CXMutationWFTimed.hpp"
 #include "benchmarks/BenchmarkSets.hpp"
 
+using ArenaTreeSet = TreeSet<UserData,ArenaAllocator<UserData>>;
+
 
 int main(void) {
     const std::string dataFilename {"data/set-tree-1m.txt"};
@@ -40,9 +46,14 @@ int main(void) {
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<PSim<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>                  (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<PSimOpt<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>               (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>          (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<ArenaTreeSet,bool,HazardPointersCX,NoStats,CopyAlways,ArenaReplicas>,ArenaTreeSet,UserData>,UserData>(cNames[iclass], ratio, testLength, numRuns, numElements, false);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWFTimed<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>     (cNames[iclass], ratio, testLength, numRuns, numElements, false);
-            // Natarajan's tree is just too slow (takes more than 2h to fill up the 1M keys): 10:07 -> 12:20
-            //results[iclass++][ithread][iratio] = bench.benchmark<NatarajanTreeHE<UserData,UserData>,UserData>                                         (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<PersistentTreeSet<UserData>>,PersistentTreeSet<UserData>,UserData>,UserData>(cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSet<CXMutationWF<BPlusTreeSet<UserData>>,BPlusTreeSet<UserData>,UserData>,UserData>    (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<ShardedUC<CXMutationWF<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>      (cNames[iclass], ratio, testLength, numRuns, numElements, false, 16);
+            // Natarajan's tree used to take hours to fill up the 1M keys, addAll() now bulk-loads it
+            results[iclass++][ithread][iratio] = bench.benchmark<NatarajanTreeHE<UserData,UserData>,UserData>                                         (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            results[iclass++][ithread][iratio] = bench.benchmark<HerlihyShavitSkipListSetEBR<UserData>,UserData>                                      (cNames[iclass], ratio, testLength, numRuns, numElements, false);
             maxClass = iclass;
         }
     }
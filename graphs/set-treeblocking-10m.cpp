@@ -4,6 +4,7 @@
 
 #include "common/UCSetBlocking.hpp"
 #include "datastructures/lockfree/NatarajanTreeHE.hpp"
+#include "datastructures/sequential/BPlusTree.hpp"
 #include "datastructures/sequential/TreeSet.hpp"
 #include "ucs/PSim.hpp"
 #include "ucs/PSimOpt.hpp"
@@ -44,6 +45,8 @@ int main(void) {
             results[iclass++][ithread][iratio] = bench.benchmark<UCSetBlocking<CXMutationBlocking<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>          (cNames[iclass], ratio, testLength, numRuns, numElements, false, 8);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSetBlocking<CXMutationBlocking<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>          (cNames[iclass], ratio, testLength, numRuns, numElements, false, 16);
             results[iclass++][ithread][iratio] = bench.benchmark<UCSetBlocking<CXMutationBlocking<TreeSet<UserData>>,TreeSet<UserData>,UserData>,UserData>          (cNames[iclass], ratio, testLength, numRuns, numElements, false, 32);                                     (cNames[iclass], ratio, testLength, numRuns, numElements, false);
+            // BPlusTreeSet has parallelCopy(), so the updaters waiting for a Combined help with the copies
+            results[iclass++][ithread][iratio] = bench.benchmark<UCSetBlocking<CXMutationBlocking<BPlusTreeSet<UserData>>,BPlusTreeSet<UserData>,UserData>,UserData>  (cNames[iclass], ratio, testLength, numRuns, numElements, false, 4);
             maxClass = iclass;
         }
     }
@@ -0,0 +1,196 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _COW_UNIVERSAL_H_
+#define _COW_UNIVERSAL_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "../common/InlineFunction.hpp"
+#include "../common/ThreadRegistry.hpp"
+#include "../common/URCUReadersVersion.hpp"
+
+/**
+ * <h1> Copy-On-Write universal construct </h1>
+ *
+ * The baseline of the "copy the whole object" universal constructs: the current
+ * object is behind a pointer, readers apply their function on it inside an RCU
+ * read-side critical section, and an updater copies the object, applies its mutation
+ * on the copy and publishes the copy with a CAS on the pointer. The old object is
+ * retired to URCUGraceVersion. This is what COWSortedVectorSet does for one type.
+ *
+ * With COMBINING false, each updater applies only its own mutation, and an updater
+ * that loses the CAS throws away its copy and starts again, which under contention
+ * means copying the object many times for a single mutation.
+ *
+ * With COMBINING true, an updater first announces its mutation in announce[tid], and
+ * whoever copies the object applies all the announced mutations that are not yet in
+ * it, before the CAS. The object carries, for each thread, the sequence number of its
+ * last applied mutation and its result, so a successful CAS publishes the mutations
+ * of all the threads at once, and an updater whose mutation was published by another
+ * thread takes the result and returns without copying anything. A mutation may be
+ * applied on several copies, but it's in the published object only once.
+ * Once a mutation is announced, every copy that starts after that includes it, and
+ * each of the other threads can win at most one CAS with a copy that started before
+ * the announcement, so an updater is done after at most maxThreads failed CAS.
+ *
+ * The mutations are applied on copies that may be discarded, so they must only
+ * modify the object they are given, like with the other universal constructs.
+ *
+ * Consistency: Linearizable
+ * applyUpdate() progress: lock-free, wait-free bounded O(N_threads) with COMBINING
+ * applyRead() progress: wait-free population oblivious
+ * Memory Reclamation: RCU (URCUGraceVersion) for the objects and the announced mutations
+ */
+template<typename C, typename R = bool, bool COMBINING = true>  // R must be default constructible and copyable
+class COW {
+
+private:
+    static const int MAX_THREADS = 128;
+    static const int MAX_MUTATION_SIZE = 64;  // Size in bytes of the largest callable that can be passed to applyUpdate()
+    static const int CLPAD = 128/sizeof(uint64_t);
+
+    // An announced mutation, retired to the urcu once it has been published
+    struct Op {
+        InlineFunction<R(C*),MAX_MUTATION_SIZE> mutation;
+        const uint64_t                          seq;
+
+        template<typename F> Op(F&& func, uint64_t seq) : mutation{std::forward<F>(func)}, seq{seq} { }
+    };
+
+    // The object, and with COMBINING the last applied mutation of each thread and its result
+    struct State {
+        C*                          obj;
+        std::unique_ptr<uint64_t[]> applied;
+        std::unique_ptr<R[]>        results;
+
+        State(C* obj, const int maxThreads) : obj{obj} {
+            if (!COMBINING) return;
+            applied.reset(new uint64_t[maxThreads]());
+            results.reset(new R[maxThreads]());
+        }
+
+        State(const State& from, const int maxThreads) : State(new C(*from.obj), maxThreads) {
+            if (!COMBINING) return;
+            for (int i = 0; i < maxThreads; i++) {
+                applied[i] = from.applied[i];
+                results[i] = from.results[i];
+            }
+        }
+
+        ~State() { delete obj; }
+    };
+
+    const int maxThreads;
+    URCUGraceVersion urcu {maxThreads};
+
+    alignas(128) std::atomic<State*> curState;
+
+    // Used only with COMBINING
+    alignas(128) std::atomic<Op*>* announce;  // maxThreads entries, padded
+    alignas(128) uint64_t*         opSeqs;    // Sequence number of the last mutation of each thread, padded
+
+    // Applies the mutations announced by all the threads that are not in lstate yet
+    void applyAnnounced(State* lstate) {
+        for (int it = 0; it < maxThreads; it++) {
+            Op* op = announce[it*CLPAD].load();
+            if (op == nullptr || lstate->applied[it] >= op->seq) continue;
+            lstate->results[it] = op->mutation(lstate->obj);
+            lstate->applied[it] = op->seq;
+        }
+    }
+
+public:
+    COW(C* inst, const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+        curState.store(new State(inst, maxThreads));
+        if (!COMBINING) return;
+        announce = new std::atomic<Op*>[maxThreads*CLPAD];
+        opSeqs = new uint64_t[maxThreads*CLPAD];
+        for (int it = 0; it < maxThreads; it++) {
+            announce[it*CLPAD].store(nullptr, std::memory_order_relaxed);
+            opSeqs[it*CLPAD] = 0;
+        }
+    }
+
+    ~COW() {
+        delete curState.load();
+        if (!COMBINING) return;
+        delete[] announce;
+        delete[] opSeqs;
+    }
+
+    static std::string className() { return COMBINING ? "COWComb-" : "COW-"; }
+
+    /*
+     * Progress Condition: lock-free, wait-free bounded O(N_threads) with COMBINING
+     */
+    template<typename F> R applyUpdate(F&& mutativeFunc, const int tid) {
+        if (!COMBINING) {
+            while (true) {
+                urcu.read_lock(tid);
+                State* lstate = curState.load();
+                State* newState = new State(*lstate, maxThreads);
+                R ret = mutativeFunc(newState->obj);
+                if (curState.compare_exchange_strong(lstate, newState)) {
+                    urcu.read_unlock(tid);
+                    urcu.retire(lstate, tid);
+                    return ret;
+                }
+                urcu.read_unlock(tid);
+                delete newState;
+            }
+        }
+        const uint64_t mySeq = ++opSeqs[tid*CLPAD];
+        Op* myOp = new Op(std::forward<F>(mutativeFunc), mySeq);
+        announce[tid*CLPAD].store(myOp);
+        R ret;
+        while (true) {
+            urcu.read_lock(tid);
+            State* lstate = curState.load();
+            if (lstate->applied[tid] >= mySeq) {
+                // Another thread published our mutation
+                ret = lstate->results[tid];
+                urcu.read_unlock(tid);
+                break;
+            }
+            State* newState = new State(*lstate, maxThreads);
+            applyAnnounced(newState);
+            if (curState.compare_exchange_strong(lstate, newState)) {
+                ret = newState->results[tid];
+                urcu.read_unlock(tid);
+                urcu.retire(lstate, tid);
+                break;
+            }
+            urcu.read_unlock(tid);
+            delete newState;
+        }
+        // Other threads may still be applying myOp on their copies
+        announce[tid*CLPAD].store(nullptr, std::memory_order_release);
+        urcu.retire(myOp, tid);
+        return ret;
+    }
+
+    /*
+     * Progress Condition: wait-free population oblivious
+     */
+    template<typename F> R applyRead(F&& readFunc, const int tid) {
+        urcu.read_lock(tid);
+        R ret = readFunc(curState.load()->obj);
+        urcu.read_unlock(tid);
+        return ret;
+    }
+
+    // Same as above, with the tid that the ThreadRegistry assigned to the calling thread
+    template<typename F> R applyUpdate(F&& mutativeFunc) { return applyUpdate(std::forward<F>(mutativeFunc), ThreadRegistry::getTID()); }
+    template<typename F> R applyRead(F&& readFunc)       { return applyRead(std::forward<F>(readFunc), ThreadRegistry::getTID()); }
+};
+
+#endif /* _COW_UNIVERSAL_H_ */
@@ -9,16 +9,29 @@
 #ifndef _CXMUTATIONBlocking_H_
 #define _CXMUTATIONBlocking_H_
 
+#include <algorithm>
 #include <atomic>
 #include <stdexcept>
 #include <cstdint>
 #include <functional>
 #include <cassert>
 #include <chrono>
+#include <memory>
+#include <new>
+#include <type_traits>
 
+#include "../common/Arena.hpp"
 #include "../common/CircularArray.hpp"
+#include "../common/CopyPolicy.hpp"
+#include "../common/EpochBasedCX.hpp"
+#include "../common/HazardErasCX.hpp"
 #include "../common/HazardPointersCX.hpp"
+#include "../common/ParallelCopy.hpp"
+#include "../common/ParkingSpot.hpp"
+#include "../common/SharedMemory.hpp"
 #include "../common/StrongTryRIRWLock.hpp"
+#include "../common/ThreadRegistry.hpp"
+#include "../common/UCStats.hpp"
 
 using namespace std;
 using namespace chrono;
@@ -34,12 +47,35 @@ using namespace chrono;
  * Consistency: Linearizable
  * applyMutation() progress: blocking starvation-free
  * applyRead() progress: wait-free bounded
- * Memory Reclamation: Hazard Pointers + ORCs
+ * Memory Reclamation: Hazard Pointers + ORCs (or any other RECL, see CXMutationWF)
+ *
+ * Copy policy:
+ * COPY is the same as in CXMutationWF. With CopyCostModel, a Combined that is more
+ * than replayLimit() mutations behind is refreshed with a copy, and an updater that
+ * would have to copy a large object keeps looking, for up to waitNs(), for one of
+ * the numObjs Combined instances that can be caught up, or for its mutation to be
+ * done by a later updater.
+ *
+ * Replica allocation:
+ * ALLOC is the same as in CXMutationWF (see Arena.hpp).
+ *
+ * Waiting:
+ * An updater that can't lock any of the numObjs Combined instances spins for a few
+ * passes and then parks on a futex (see ParkingSpot.hpp), so that with more threads
+ * than cores the waiters don't take the CPU away from the updater that holds a
+ * Combined. Updaters call wake() when they release a Combined or mark nodes as done,
+ * which is one load when no thread is parked. stats().parks is the number of parks.
+ * The constructor throws std::invalid_argument if numObjs is lower than 2, because
+ * then an updater could wait forever, and uses at most 2*maxThreads of them.
+ *
+ * Cooperative copies:
+ * If C has parallelCopy() (and ALLOC is HeapReplicas), the copy of a replica is split
+ * in work units, and the updaters that spin in getNewComb() waiting for a Combined run
+ * units of that copy instead of just spinning. See ParallelCopy.hpp.
  *
  * Things to improve:
  * - Get rid of CircularArray or make it more flexible;
  * - Activate HPGuard to clear the hazard pointers when leaving;
- * - Use maxThreads in the rwlock of Combined;
  * - Can we change the protectPtr() to protectPtrRelease() ?
  *
  * <h2> Papers </h2>
@@ -50,7 +86,7 @@ using namespace chrono;
  * Hazard Pointers paper:
  * http://web.cecs.pdx.edu/~walpole/class/cs510/papers/11.pdf
  */
-template<typename C, typename R = bool>  // R must fit in an a std::atomic<R>
+template<typename C, typename R = bool, template<typename> class RECL = HazardPointersCX, typename STATS = NoStats, typename COPY = CopyAlways, typename ALLOC = HeapReplicas>  // R must fit in an a std::atomic<R>
 class CXMutationBlocking {
 
 private:
@@ -67,6 +103,8 @@ private:
         std::atomic<uint64_t>      ticket {0};
         std::atomic<int>           refcnt {0};
         const int                  enqTid;
+        uint64_t                   newEra {0};   // Used only by HazardErasCX
+        uint64_t                   delEra {0};
 
         template<typename F> Node(F&& mut, int tid) : mutation{mut}, enqTid{tid} { }
 
@@ -79,7 +117,7 @@ private:
     struct Combined {
         Node*                      head {nullptr};
         C*                         obj {nullptr};
-        StrongTryRIRWLock          rwLock {MAX_THREADS};
+        StrongTryRIRWLock<>        rwLock;
 
         // Helper function to update newComb->head while keepting track of ORCs.
         void updateHead(Node* mn) {
@@ -87,6 +125,17 @@ private:
             if (head != nullptr) head->refcnt.fetch_add(-1);
             head = mn;
         }
+
+        // The read indicator of rwLock has one entry per thread
+        Combined(const int maxThreads) : rwLock{maxThreads} { }
+    };
+
+    // Calls beginOp() and endOp() of the reclamation policy, on all return paths
+    struct OpGuard {
+        RECL<Node>& hp;
+        const int   tid;
+        OpGuard(RECL<Node>& hp, const int tid) : hp{hp}, tid{tid} { hp.beginOp(tid); }
+        ~OpGuard() { hp.endOp(tid); }
     };
 
     alignas(128) std::atomic<Combined*> curComb { nullptr };
@@ -101,21 +150,33 @@ private:
     alignas(128) Combined* combs;
 
     // Enqueue requests
-    alignas(128) std::atomic<Node*> enqueuers[MAX_THREADS];
+    alignas(128) std::atomic<Node*>* enqueuers;   // maxThreads entries
 
     // Latest measurements of copy time
     alignas(128) std::atomic<microseconds> copyTime {0us};
 
     // We need two hazard pointers for the enqueue() (ltail and lnext), one for myNode, and two to traverse the list/queue
-    HazardPointersCX<Node> hp {5, maxThreads};
+    RECL<Node> hp {5, maxThreads};
     const int kHpTail     = 0;
     const int kHpTailNext = 1;
     const int kHpHead     = 2;
     const int kHpNext     = 3;
     const int kHpMyNode   = 4;
 
-    CircularArray<Node>* preRetired[MAX_THREADS];
+    CircularArray<Node,RECL<Node>>** preRetired; // maxThreads entries
+
+    STATS ucStats {maxThreads};
+    COPY  copyPolicy {};
     int numObjs = 0;
+    CooperativeCopy coopCopy {};
+    ParkingSpot combSpot {std::is_same<ALLOC,SharedReplicas>::value};   // Updaters waiting in getNewComb(), maybe in other processes
+
+    // Refreshes old with a copy of from, split in units if C has parallelCopy()
+    C* refreshReplica(const C& from, const uint64_t fromTicket, C* old, const uint64_t oldTicket) {
+        auto refresh = [&] () { return ALLOC::refresh(from, fromTicket, old, oldTicket); };
+        if (ALLOC::enabled) return refresh();
+        return coopCopy.copy(from, old, refresh);
+    }
 
     Combined* getCombined(uint64_t myTicket, const int tid) {
         for (int i = 0; i < maxThreads; i++) {
@@ -132,25 +193,74 @@ private:
     }
 
 
-    Combined* getNewComb(Node* myNode, const int tid) {
-    	while(true){
+    // Returns true if the mutations from 'mn' up to myTicket can be re-applied instead of doing a copy
+    inline bool isReplayable(Node* mn, uint64_t myTicket, uint64_t replayLimit) {
+        if (mn == nullptr || mn == mn->next.load()) return false;
+        const uint64_t lticket = mn->ticket.load();
+        return replayLimit == 0 || lticket >= myTicket || myTicket - lticket <= replayLimit;
+    }
+
+    /*
+     * While the copy policy gives us time to wait (only if a node was enqueued after ours), a
+     * Combined that would need a copy is skipped in favour of one that can be caught up.
+     */
+    Combined* getNewComb(Node* myNode, uint64_t myTicket, uint64_t replayLimit, const int tid) {
+        const uint64_t waitNs = (myNode->next.load() == nullptr) ? 0 : copyPolicy.waitNs();
+        const uint64_t startNs = (waitNs == 0) ? 0 : copyPolicy.now();
+        for (int ipass = 0; ; ipass++) {
+            // After SPIN_TRIES passes, register as parked before the pass, so that a wake() during the pass isn't lost
+            const bool mayPark = ipass >= ParkingSpot::SPIN_TRIES;
+            const uint32_t word = combSpot.prepare();
+            if (mayPark) combSpot.registerParked();
+            bool sawUnlocked = false;
+            Combined* newComb = nullptr;
 			for (int i = 0; i < numObjs; i++) {
-				if (myNode->done.load()) return nullptr;
-				if (combs[i].rwLock.exclusiveTryLock(tid)) return &combs[i];
+				if (myNode->done.load()) break;
+				if (!combs[i].rwLock.exclusiveTryLock(tid)) continue;
+				if (waitNs == 0 || isReplayable(combs[i].head, myTicket, replayLimit) || copyPolicy.now() - startNs >= waitNs) {
+				    newComb = &combs[i];
+				    break;
+				}
+				combs[i].rwLock.exclusiveUnlock();
+				sawUnlocked = true;
 			}
+            if (newComb != nullptr || myNode->done.load()) {
+                if (mayPark) combSpot.unregisterParked();
+                return newComb;
+            }
+			coopCopy.help();
+            if (!mayPark) {
+                std::this_thread::yield();
+                continue;
+            }
+            if (!sawUnlocked) combSpot.parkOnce(word);   // Nothing to do until an updater releases a Combined
+            combSpot.unregisterParked();
     	}
     }
 
+    // The tid of the calling thread, for the methods without a tid argument
+    inline int registeredTID() const {
+        const int tid = ThreadRegistry::getTID();
+        assert(tid < maxThreads);
+        return tid;
+    }
 
 public:
-    CXMutationBlocking(C* inst, int maxThreads=MAX_THREADS, int numObjs=0) : maxThreads{maxThreads}, numObjs{numObjs}{
-    	if (numObjs < 2) printf("ERROR : numCopies must be superior than 1\n");
-        combs = new Combined[2*maxThreads];
+    CXMutationBlocking(C* inst, int maxThreads=MAX_THREADS, int numObjs=0) : maxThreads{maxThreads}, numObjs{std::min(numObjs, 2*maxThreads)} {
+        if (numObjs < 2) {
+            delete sentinel;
+            delete inst;
+            throw std::invalid_argument("CXMutationBlocking needs at least 2 Combined instances (numObjs)");
+        }
+        combs = std::allocator<Combined>().allocate(2*maxThreads);
+        for (int i = 0; i < 2*maxThreads; i++) new (&combs[i]) Combined(maxThreads);
+        enqueuers = new std::atomic<Node*>[maxThreads];
         for (int i = 0; i < maxThreads; i++) enqueuers[i].store(nullptr, std::memory_order_relaxed);
-        for (int i = 0; i < maxThreads; i++) preRetired[i] = new CircularArray<Node>(hp,i);
+        preRetired = new CircularArray<Node,RECL<Node>>*[maxThreads];
+        for (int i = 0; i < maxThreads; i++) preRetired[i] = new CircularArray<Node,RECL<Node>>(hp,i);
         // Start with two or four valid combined instances.
         combs[0].head = sentinel;
-        combs[0].obj = inst;
+        combs[0].obj = ALLOC::adopt(inst);
         sentinel->refcnt.store(1, std::memory_order_relaxed);
         combs[0].rwLock.setReadLock();
         curComb.store(&combs[0], std::memory_order_release);
@@ -160,15 +270,26 @@ public:
     ~CXMutationBlocking() {
         for (int i = 0; i < 2*maxThreads; i++) {
             if (combs[i].obj == nullptr || combs[i].head == nullptr) continue;
-            delete combs[i].obj;
+            ALLOC::destroy(combs[i].obj);
         }
         for (int i = 0; i < maxThreads; i++) delete preRetired[i];
-        delete[] combs;
+        delete[] preRetired;
+        delete[] enqueuers;
+        for (int i = 0; i < 2*maxThreads; i++) combs[i].~Combined();
+        std::allocator<Combined>().deallocate(combs, 2*maxThreads);
         delete sentinel;
         //std::cout << "numCopies = " << numCopies.load() << "\n";
     }
 
-    static std::string className() { return "CXBlock-"; }
+    static std::string className() { return ALLOC::enabled ? "CXBlock-Arena-" : "CXBlock-"; }
+
+    // Sum of the statistics of all threads, only hpScans and parks unless STATS is UCStats
+    UCStatsSnapshot stats() const {
+        UCStatsSnapshot snap = ucStats.snapshot();
+        snap.hpScans = hp.getNumScans();
+        snap.parks = combSpot.getNumParks();
+        return snap;
+    }
 
     /*
      * Adds the mutativeFunc to the queue and applies all mutations up to it, returning the result.
@@ -177,13 +298,16 @@ public:
      *
      */
     template<typename F> R applyUpdate(F&& mutativeFunc, const int tid) {
+        OpGuard guard {hp, tid};
         // Insert our node in the queue
         Node* myNode = new Node(mutativeFunc, tid);
+        hp.onNew(myNode);
         hp.protectPtrRelease(kHpMyNode, myNode, tid);
         enqueue(myNode, tid);
         const uint64_t myTicket = myNode->ticket.load();
         // Get one of the Combined instances on which to apply mutation(s)
-        Combined* newComb = getNewComb(myNode, tid);
+        const uint64_t replayLimit = copyPolicy.replayLimit();
+        Combined* newComb = getNewComb(myNode, myTicket, replayLimit, tid);
         if (newComb == nullptr) {
             if (myNode->done.load()) return myNode->result.load();
             std::cout << "ERROR: not enough Combined instances\n";
@@ -192,32 +316,45 @@ public:
         Node* mn = newComb->head;
         if (mn != nullptr && mn->ticket.load() >= myTicket) {
             newComb->rwLock.exclusiveUnlock();
+            combSpot.wake();
             return myNode->result.load();
         }
+        // A Combined that is too far behind is refreshed with a copy of curComb
+        if (replayLimit != 0 && !isReplayable(mn, myTicket, replayLimit)) mn = nullptr;
         Combined* lcomb = nullptr;
+        uint64_t numApplied = 0;
+        const uint64_t applyStartNs = copyPolicy.now();
+        uint64_t copyNs = 0;
+        ucStats.add(STATS_LOCK_HOLDS, tid);
         // Apply all mutations starting from 'head' up to our node or the end of the list
         while (mn != myNode) {
             if (mn == nullptr || mn == mn->next.load()) {
                 if (lcomb != nullptr || myNode->done.load() || (lcomb = getCombined(myTicket,tid)) == nullptr) {
                     if (mn != nullptr) newComb->updateHead(mn);
                     newComb->rwLock.exclusiveUnlock();
+                    combSpot.wake();
                     return myNode->result.load();
                 }
                 numCopies.fetch_add(1);
                 mn = lcomb->head;
+                const uint64_t oldTicket = (newComb->head == nullptr) ? UINT64_MAX : newComb->head->ticket.load();
                 // Neither the 'instance' nor the 'head' will change now that we hold the shared lock
                 newComb->updateHead(mn);
-                delete newComb->obj;
-                newComb->obj = new C(*lcomb->obj);
+                const uint64_t copyStartNs = copyPolicy.now();
+                newComb->obj = ucStats.copy(*lcomb->obj, [&] () { return refreshReplica(*lcomb->obj, mn->ticket.load(), newComb->obj, oldTicket); }, tid);
+                copyNs += copyPolicy.onCopy(copyStartNs);
                 lcomb->rwLock.sharedUnlock(tid);
                 continue;
             }
             Node* lnext = hp.protectPtr(kHpHead, mn->next.load(), tid);
             if(mn == mn->next.load()) continue;
-            lnext->result.store(lnext->mutation(newComb->obj), std::memory_order_relaxed);
+            lnext->result.store(ALLOC::apply(newComb->obj, lnext->mutation), std::memory_order_relaxed);
+            ucStats.add(STATS_MUTATIONS, tid);
             hp.protectPtrRelease(kHpNext, lnext, tid);
             mn = lnext;
+            numApplied++;
         }
+        if (COPY::enabled) copyPolicy.onApply(numApplied, copyPolicy.now() - applyStartNs - copyNs);
         newComb->updateHead(mn);
         newComb->rwLock.downgrade();
         // Make the mutation visible to other threads by advancing curComb
@@ -241,11 +378,13 @@ public:
                     preRetired[tid]->add(node);
                     node = lnext;
                 }
+                combSpot.wake();   // lcomb can be locked again, and the nodes are done
                 return myNode->result.load();
             }
             lcomb->rwLock.sharedUnlock(tid);
         }
         newComb->rwLock.setReadUnlock();
+        combSpot.wake();
         return myNode->result.load();
     }
 
@@ -254,11 +393,14 @@ public:
      * Progress Condition: wait-free (bounded by the number of threads)
      */
     template<typename F> R applyRead(F&& readFunc, const int tid) {
+        OpGuard guard {hp, tid};
         Node* myNode = nullptr;
         for (int i=0; i < MAX_READ_TRIES + maxThreads; i++) {
             Combined* lcomb = curComb.load();
             if (i == MAX_READ_TRIES) { // enqueue read-only operation as if it was a mutation
+                ucStats.add(STATS_READ_FALLBACKS, tid);
                 myNode = new Node(readFunc, tid);
+                hp.onNew(myNode);
                 hp.protectPtr(kHpMyNode, myNode, tid);
                 enqueue(myNode, tid);
             }
@@ -293,13 +435,13 @@ public:
             if (ltail != tail.load()) continue; // If the tail advanced maxThreads times, then my node has been enqueued
             if (enqueuers[ltail->enqTid].load() == ltail) {  // Help a thread do step 4
                 Node* tmp = ltail;
-                enqueuers[ltail->enqTid].compare_exchange_strong(tmp, nullptr);
+                if (enqueuers[ltail->enqTid].compare_exchange_strong(tmp, nullptr) && ltail->enqTid != tid) ucStats.add(STATS_ENQUEUE_HELPS, tid);
             }
             for (int j = 1; j < maxThreads+1; j++) {         // Help a thread do step 2
                 Node* nodeToHelp = enqueuers[(j + ltail->enqTid) % maxThreads].load();
                 if (nodeToHelp == nullptr) continue;
                 Node* nodenull = nullptr;
-                ltail->next.compare_exchange_strong(nodenull, nodeToHelp);
+                if (ltail->next.compare_exchange_strong(nodenull, nodeToHelp) && nodeToHelp != myNode) ucStats.add(STATS_ENQUEUE_HELPS, tid);
                 break;
             }
             Node* lnext = ltail->next.load();
@@ -307,11 +449,23 @@ public:
                 hp.protectPtr(kHpTailNext, lnext, tid);
                 if (ltail != tail.load()) continue;
                 lnext->ticket.store(ltail->ticket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
-                tail.compare_exchange_strong(ltail, lnext); // Help a thread do step 3:
+                if (tail.compare_exchange_strong(ltail, lnext) && lnext != myNode) ucStats.add(STATS_ENQUEUE_HELPS, tid); // Help a thread do step 3:
             }
         }
         enqueuers[tid].store(nullptr, std::memory_order_release); // Do step 4, just in case it's not done
     }
+
+    /*
+     * Same as the methods above, but the tid is the one the ThreadRegistry assigned to the calling thread.
+     * It must be lower than the maxThreads passed to the constructor.
+     */
+    template<typename F> R applyUpdate(F&& mutativeFunc) {
+        return applyUpdate(std::forward<F>(mutativeFunc), registeredTID());
+    }
+
+    template<typename F> R applyRead(F&& readFunc) {
+        return applyRead(std::forward<F>(readFunc), registeredTID());
+    }
 };
 
 #endif /* _CXMUTATIONBlocking_H_ */
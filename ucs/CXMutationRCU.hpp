@@ -0,0 +1,42 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _CXMUTATION_RCU_H_
+#define _CXMUTATION_RCU_H_
+
+#include "CXMutationWF.hpp"
+
+/**
+ * <h1> CXMutation with RCU readers </h1>
+ *
+ * CXMutationWF in the rcuReaders mode, so that it can be used in UCSet, UCMap
+ * and UCQueue, which only pass the object and maxThreads to the constructor.
+ * applyRead() is a read_lock() of URCUGraceVersion, a load of curComb and a
+ * read_unlock(), without touching the rwLocks. The updaters skip the Combined
+ * instances that were curComb and may still have readers, instead of waiting for
+ * a grace period. This is meant for workloads that are almost only reads.
+ *
+ * Consistency: Linearizable
+ * applyUpdate() progress: wait-free bounded O(N_threads), blocking only if all the free Combined instances have readers
+ * applyRead() progress: wait-free population oblivious
+ * Memory Reclamation: Hazard Pointers + ORCs for the nodes, RCU for the replicas
+ */
+template<typename C, typename R = bool, template<typename,int> class RECL = HazardPointersCX, typename STATS = NoStats, typename COPY = CopyAlways, typename ALLOC = HeapReplicas>
+class CXMutationRCU : public CXMutationWF<C,R,RECL,STATS,COPY,ALLOC> {
+
+private:
+    static const int MAX_THREADS = 128;
+
+public:
+    CXMutationRCU(C* inst, const int maxThreads=MAX_THREADS) :
+            CXMutationWF<C,R,RECL,STATS,COPY,ALLOC>(inst, maxThreads, 0, 0, 0, false, false, 0, true) { }
+
+    static std::string className() { return ALLOC::enabled ? "CXRCU-Arena-" : "CXRCU-"; }
+};
+
+#endif /* _CXMUTATION_RCU_H_ */
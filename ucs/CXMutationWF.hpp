@@ -13,13 +13,34 @@
 #include <stdexcept>
 #include <cstdint>
 #include <functional>
+#include <algorithm>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
 #include <cassert>
 #include <chrono>
 #include <thread>
+#include <type_traits>
 
+#include "../common/Arena.hpp"
+#include "../common/ChangeStream.hpp"
 #include "../common/CircularArray.hpp"
+#include "../common/CopyPolicy.hpp"
+#include "../common/EpochBasedCX.hpp"
+#include "../common/HazardErasCX.hpp"
 #include "../common/HazardPointersCX.hpp"
+#include "../common/HTM.hpp"
+#include "../common/InlineFunction.hpp"
+#include "../common/MutationLog.hpp"
+#include "../common/NumaTopology.hpp"
+#include "../common/ResultSlot.hpp"
+#include "../common/SharedMemory.hpp"
 #include "../common/StrongTryRIRWLock.hpp"
+#include "../common/ThreadCount.hpp"
+#include "../common/ThreadRegistry.hpp"
+#include "../common/UCStats.hpp"
+#include "../common/URCUReadersVersion.hpp"
 
 using namespace std;
 using namespace chrono;
@@ -33,12 +54,218 @@ using namespace chrono;
  * Consistency: Linearizable
  * applyUpdate() progress: wait-free bounded O(N_threads)
  * applyRead() progress: wait-free bounded
- * Memory Reclamation: Hazard Pointers + ORCs
+ * Memory Reclamation: Hazard Pointers + ORCs (by default, see RECL)
+ *
+ * Reclamation policy:
+ * RECL is the class used to reclaim the nodes of the queue, along with the ORCs.
+ * It can be HazardPointersCX (the default), HazardErasCX or EpochBasedCX. With
+ * EpochBasedCX there are no stores when traversing the queue, only one when
+ * the operation starts and one when it ends, but a thread that stalls in
+ * the middle of an operation prevents the other threads from reclaiming nodes,
+ * therefore applyUpdate() and applyRead() become blocking.
+ *
+ * Replay mode:
+ * When maxReplay is non-zero, an updater prefers a Combined whose head is still
+ * linked in the queue and at most maxReplay mutations behind its own node,
+ * and catches it up by re-applying the queued mutations instead of copying.
+ * A full copy of curComb is done only when no such Combined is available,
+ * i.e. when the gap is larger than maxReplay or the nodes were already retired.
+ * This is meant for large objects, where a copy costs much more than a few
+ * hundred mutations.
+ *
+ * Adaptive replicas:
+ * When maxReplicas is non-zero, at most maxReplicas Combined instances hold a
+ * copy of the object at any given time (it must be at least 2). We start with
+ * one replica and an updater takes an empty Combined (making a new copy) only
+ * when it fails to lock all the live ones. Live replicas whose head has been
+ * retired will need a full copy on their next use anyway, so they are freed,
+ * one Combined checked per update. If all the replicas are in use and the
+ * cap has been reached, the updater waits until it can lock one of them or
+ * until its mutation has been applied by another updater, which makes applyUpdate()
+ * lock-free instead of wait-free in this mode.
+ * getLiveReplicas() and getPeakReplicas() return the number of copies in use.
+ *
+ * Combining:
+ * When maxCombineSpins is non-zero, one updater at a time becomes the combiner
+ * and applies, on its Combined, all the mutations that are in the queue when it
+ * starts, not just the ones up to its own node. The other updaters spin for up
+ * to maxCombineSpins iterations waiting for their mutation to be published in
+ * curComb, and then fall back to the regular wait-free algorithm. With a few
+ * threads contending, this means fewer Combined instances in use and fewer
+ * copies. Progress is still wait-free because the spin is bounded.
+ *
+ * NUMA mode:
+ * When numaAware is true, the Combined instances are split into one pool per
+ * NUMA node and updaters try the pool of their own node first, which means the
+ * copies of the object are usually allocated (first-touch) on the local node.
+ * Readers first try the most recently published replica of their own node, but
+ * use it only if its head has the same ticket as the head of curComb, i.e. if
+ * it is in the same state as curComb, otherwise the read wouldn't be linearizable.
+ * A reader that finds its local replica behind will try to catch it up by
+ * re-applying the mutations in the queue (never by making a copy) before
+ * falling back to curComb.
+ *
+ * Writer-preference:
+ * When maxReaderCancels is non-zero, the rwLocks of the Combined instances are in
+ * writer-preference mode: after maxReaderCancels consecutive cancellations of an
+ * updater that is trying to lock a Combined, readers stop cancelling it. Under
+ * heavy read loads this keeps updaters from going through all the Combined
+ * instances (and making copies) because readers keep cancelling them.
+ * getReaderCancels() returns the number of cancellations so far.
+ *
+ * Adaptive retirement:
+ * When adaptiveRetire is true, the nodes are retired a few at a time in each
+ * update, as soon as all the Combined instances have moved past them (or they
+ * are more than CircularArray::MIN_SIZE tickets behind), instead of in bursts
+ * of up to a thousand nodes when the array of each thread fills up.
+ *
+ * Results:
+ * The result of each mutation is stored in a ResultSlot in its node. Small
+ * trivially copyable types are kept in a std::atomic<R>, and any other R (for
+ * example a value returned by a lookup) is written once into a cache-aligned
+ * slot, so there is no need to box results on the heap.
+ *
+ * Mutation nodes:
+ * The mutation is stored inside the node as an InlineFunction of MAX_MUTATION_SIZE
+ * bytes, and a callable that doesn't fit is a compilation error. Reclaimed nodes
+ * are kept by each thread in the pool of the hazard pointers and reused by the
+ * next operation, which means that applyUpdate() does no calls to malloc/free
+ * in the common case.
+ *
+ * Statistics:
+ * STATS is NoStats by default, which compiles to nothing. With UCStats, each
+ * thread counts the copies (and their size and duration), the mutations applied
+ * per exclusive lock of a Combined, the steps of enqueue() done for other threads
+ * and the reads that fell back to enqueueing, which stats() returns along with
+ * the number of scans of the reclamation policy.
+ *
+ * Copy policy:
+ * COPY decides, when the Combined we locked is behind curComb, whether to replay,
+ * copy or wait. With CopyAlways (the default) the behaviour is the one described
+ * above. With CopyCostModel, the replay limit (when maxReplay is zero) is the
+ * number of mutations that take as long as a copy, and an updater that would
+ * have to copy a large object first waits, for up to the duration of a copy, for
+ * a Combined that can be caught up or for a later updater to apply its mutation.
+ * It waits only if there is a node after its own in the queue, otherwise no one
+ * else would apply its mutation. The wait is bounded in time, like the one in
+ * CXMutationWFTimed, so applyUpdate() is still wait-free.
+ *
+ * Replica allocation:
+ * ALLOC makes, refreshes and frees the replicas (see Arena.hpp). HeapReplicas
+ * (the default) uses new and delete. With ArenaReplicas each replica and its
+ * nodes are in their own arena, so freeing a replica doesn't go through the
+ * global allocator node by node, and refreshing a replica reuses the chunks of
+ * its arena. All the mutations on a replica run with its arena as the current
+ * arena of the thread.
+ *
+ * Shared memory:
+ * With SharedReplicas (see SharedMemory.hpp), the replicas, the Combined instances
+ * and the read indicators of their rwLocks are allocated in a shared memory segment.
+ * The process that created the segment constructs the CXMutationWF in it and does
+ * the updates and the applyRead() calls, and the other processes that mapped the
+ * segment call applyReadAttached(), which reads curComb->obj in place. It touches
+ * only curComb and the rwLocks, and it never enqueues the read as a mutation (the
+ * callable would run in the process of the updaters), so it's lock-free instead of
+ * wait-free: a reader retries only when an updater published a new curComb.
+ * The readers of all the processes need distinct tids and rcuReaders must be false.
+ *
+ * Snapshots:
+ * snapshot() returns a handle to the replica in curComb, which is pinned with a
+ * reference count instead of the shared lock, so that long scans (range queries,
+ * iterations) don't keep the Combined locked. An updater that locks a Combined
+ * whose replica is pinned gives the object to the snapshots (the last one to be
+ * released deletes it) and then treats the Combined as empty, i.e. it makes a new
+ * copy. A pinned object must only be read. If snapshot() can't get the shared lock
+ * it enqueues a mutation that copies the object instead, so it's wait-free.
+ *
+ * RCU readers:
+ * When rcuReaders is true, applyRead() doesn't touch the rwLocks: it does a
+ * read_lock() of URCUGraceVersion, applies readFunc on curComb->obj and does a
+ * read_unlock(), with no CAS, no re-check of curComb and no retries. The updater
+ * that takes curComb out of publication starts a grace period for that Combined
+ * (without waiting for it), and the updaters don't use that Combined until the
+ * grace period is over, they take the next one. Only when all the Combined
+ * instances that are not locked still have readers does an updater wait, with
+ * synchronize(). applyRead() is wait-free population oblivious and applyUpdate()
+ * is blocking in that corner case only. CXMutationRCU uses this mode.
+ *
+ * Asynchronous updates:
+ * applyUpdateAsync() enqueues the mutation and returns an AsyncUpdate handle
+ * right away, without locking a Combined. The ticket given by the Turn queue
+ * already fixes the order of the mutation, and its result is kept in the handle.
+ * The mutation is applied and published by the next updater, by a thread that
+ * calls flushAsync(), by the helper thread of startAsyncHelper(), or by get() on
+ * the handle, which applies the pending mutations itself if no one else did.
+ * Until then readers don't see it, and so a thread that needs to read its own
+ * writes must call get() first. applyUpdateAsync() is wait-free and so is get().
+ *
+ * Mutation log:
+ * With LOG=MutationLog<D>, openLog() opens a write-ahead log of descriptors and
+ * writes a checkpoint of the object. applyUpdateLogged() puts a descriptor in the
+ * node, and the thread that publishes the node in curComb writes it in the log
+ * after the CAS, while it walks the nodes to retire, so the log is written in
+ * batches of published mutations with no extra synchronization. Once the log is
+ * half full since the last checkpoint, the publisher makes a new checkpoint from
+ * a pinned replica, the same way as snapshot(). After a crash, MutationLog::recover()
+ * loads the checkpoint and replays the descriptors. Mutations from applyUpdate()
+ * are not durable, they are logged as no-ops. See MutationLog.hpp.
+ *
+ * Change stream:
+ * enableChangeStream() adds an in-memory ring where the publisher also puts the
+ * descriptors (the LOG::Entry of each node), in the same walk. Followers take a
+ * snapshot with subscribe(), which sets their cursor to the ticket of the snapshot,
+ * and then pollChanges() gives them the descriptors that come after it, in order.
+ * Followers don't pin nodes or replicas, a follower that is lapped by the ring gets
+ * SNAPSHOT_NEEDED and subscribes again. See ChangeStream.hpp.
+ *
+ * HTM fast path:
+ * After enableHTM(), applyUpdate() first tries to apply its mutation in place on
+ * curComb->obj inside a hardware transaction (see HTM.hpp). The transaction only
+ * goes ahead when every node in the queue is already in curComb (its head is the
+ * tail), no thread is in the middle of an enqueue, and curComb has no readers and
+ * no snapshots. It then links the node after the tail, applies the mutation and
+ * advances the head of curComb, with no lock, no copy and no CAS on curComb. A
+ * reader or an updater that arrives in the meantime writes to the read indicator
+ * or to enqueuers[], which aborts the transaction. After a few aborts the node goes
+ * through the wait-free algorithm, so the progress condition doesn't change, and
+ * checking enqueuers[] means the fast path never overtakes an enqueue that is
+ * waiting for help. The fast path is not used while there is a mutation log or a
+ * change stream (the descriptors are written by the publisher) and not with
+ * rcuReaders (the readers leave no trace that the transaction could check).
+ *
+ * Optimistic reads:
+ * For small replicas, the arrive/depart on the read indicator can cost more than
+ * the read itself. A type opts in with OptimisticReads<C> (Arena.hpp) and applyRead()
+ * first reads curComb->obj like a seqlock: it samples the seq of the rwLock of
+ * curComb (see StrongTryRIRWLock::optimisticBegin()) and its ticket, applies
+ * readFunc, and keeps the result if neither of them changed, which means no
+ * updater locked that Combined nor applied a mutation in place with HTM. There are
+ * no stores on that path. After a few failed tries it takes the shared lock as
+ * usual. readFunc may run on an object that an updater is modifying (its result
+ * is then thrown away), so it must have no side effects and it must be safe on
+ * any state of the object, i.e. no pointers to follow and no unchecked indices.
+ * C must be trivially copyable, so that HeapReplicas refreshes the replicas in
+ * place and they are never freed while the Universal Construct is alive. For the
+ * same reason the optimistic reads are disabled with maxReplicas (which frees idle
+ * replicas), and snapshot() and the mutation log (which give replicas away) can't
+ * be used with such a type.
+ *
+ * Thread registration:
+ * Every method has an overload without the tid argument, which takes the tid
+ * that the ThreadRegistry assigned to the calling thread (a thread_local load
+ * after the first call). All the per-thread arrays are allocated with maxThreads
+ * entries, and MAX_THREADS is only the default value of maxThreads.
+ *
+ * Fixed number of threads:
+ * With MAX_T non-zero, maxThreads is the constant MAX_T (see ThreadCount.hpp), in
+ * CXMutationWF and in the hazard pointers (RECL), the rwLocks and their read indicators
+ * that it uses. The loops over the threads, like the helping in enqueue() and the scans
+ * of the read indicators, then have a constant bound, and all the per-thread arrays and
+ * the pool of 2*MAX_T Combined instances are sized for MAX_T threads instead of 128.
+ * The maxThreads given to the constructor must not be larger than MAX_T.
  *
  * Things to improve:
- * - Get rid of CircularArray or make it more flexible;
  * - Activate HPGuard to clear the hazard pointers when leaving;
- * - Use maxThreads in the rwlock of Combined;
  *
  * <h2> Papers </h2>
  * CX paper:
@@ -51,42 +278,117 @@ using namespace chrono;
  * Strong TryRWLocks paper:
  * https://dl.acm.org/citation.cfm?id=3178519
  */
-template<typename C, typename R = bool>  // R must fit in an a std::atomic<R>
+template<typename C, typename R = bool, template<typename,int> class RECL = HazardPointersCX, typename STATS = NoStats, typename COPY = CopyAlways, typename ALLOC = HeapReplicas,
+         typename LOG = NoLog, int MAX_T = 0>  // R must be default constructible and copyable
 class CXMutationWF {
+    static_assert(!OptimisticReads<C>::value || std::is_trivially_copyable<C>::value, "The optimistic reads need a trivially copyable C");
 
 private:
     static const int MAX_READ_TRIES = 10; // Maximum number of times a reader will fail to acquire the shared lock before adding its operation as a mutation
-    static const int MAX_THREADS = 128;
-    const int maxThreads;
+    static const int MAX_THREADS = (MAX_T != 0) ? MAX_T : 128;
+    static const int MAX_NUMA_NODES = 64;
+    static const int RI_GROUP_THRESHOLD = 64;   // Above this number of threads, the read indicators of the rwLocks are grouped
+    static const int RI_THREADS_PER_GROUP = 8;
+    static const uint64_t NO_TICKET = UINT64_MAX;  // Ticket of a Combined without a head
+    static const int MAX_MUTATION_SIZE = 64;  // Size in bytes of the largest callable that can be passed to applyUpdate()/applyRead()
+    static const int MAX_RECYCLED_NODES = 4096; // Maximum number of nodes kept by each thread for reuse
+    static const int HTM_MAX_ATTEMPTS = 3;      // Default number of hardware transactions before applyUpdate() takes the wait-free path
+    static const int OPTIMISTIC_READ_TRIES = 3; // Optimistic reads before applyRead() takes the shared lock, with OptimisticReads<C>
+    const ThreadCount<MAX_T> maxThreads;
+    const uint64_t maxReplay;   // Zero means replay mode is disabled
+    const int maxReplicas;      // Zero means a fixed pool of 2*maxThreads Combined instances
+    const int maxCombineSpins;  // Zero means combining is disabled
+    const bool adaptiveRetire;  // Retire nodes incrementally, based on the oldest head of the Combined instances
+    const bool rcuReaders;      // Readers use URCUGraceVersion instead of the rwLocks
+    const bool optimisticReads; // With OptimisticReads<C>, unless maxReplicas frees the idle replicas
+    NumaTopology numa {};
+    const int numNodes;         // One means NUMA mode is disabled
+    const int combsPerNode;
 
     struct Node {
-        std::function<R(C*)>       mutation;
-        std::atomic<R>             result;   // This needs to be (relaxed) atomic because there are write-races on it.
+        InlineFunction<R(C*),MAX_MUTATION_SIZE> mutation;
+        ResultSlot<R>              result;   // There are write-races on it, see ResultSlot.hpp
         std::atomic<Node*>         next {nullptr};
         std::atomic<uint64_t>      ticket {0};
         std::atomic<int>           refcnt {0};
         const int                  enqTid;
+        uint64_t                   newEra {0};   // Used only by HazardErasCX
+        uint64_t                   delEra {0};
+        typename LOG::Entry        logEntry {};  // Descriptor of applyUpdateLogged()
+
+        template<typename F> Node(F&& mut, int tid) : mutation{std::forward<F>(mut)}, enqTid{tid} { }
+    };
+
+    // Calls beginOp() and endOp() of the reclamation policy, on all return paths
+    struct OpGuard {
+        RECL<Node,MAX_T>& hp;
+        const int         tid;
+        OpGuard(RECL<Node,MAX_T>& hp, const int tid) : hp{hp}, tid{tid} { hp.beginOp(tid); }
+        ~OpGuard() { hp.endOp(tid); }
+    };
+
+    // Mutations and results of applyUpdateBatch(), owned by the callable of the node
+    template<typename F> struct Batch {
+        std::vector<F>                    funcs;
+        std::unique_ptr<ResultSlot<R>[]>  results;
 
-        template<typename F> Node(F&& mut, int tid) : mutation{mut}, enqTid{tid} { }
+        Batch(const F* mutativeFuncs, const int numFuncs) : funcs{mutativeFuncs, mutativeFuncs+numFuncs}, results{new ResultSlot<R>[numFuncs]} { }
+
+        // Called once for each Combined instance where the node is applied
+        R apply(C* obj) {
+            for (unsigned i = 0; i < funcs.size(); i++) results[i].store(funcs[i](obj));
+            return R{};
+        }
+    };
+
+    // Result of applyUpdateAsync(), shared by the handle and the callable in the node
+    struct AsyncState {
+        ResultSlot<R>              result;
+    };
+
+    // A replica held by snapshots. refs is the number of snapshots, plus one while it's still the obj of a Combined.
+    struct Pin {
+        C*                         obj;
+        std::atomic<int>           refs;
+
+        Pin(C* obj, int refs) : obj{obj}, refs{refs} { }
+    };
+
+    // Used by snapshot() when it falls back to a mutation, the first replica where the node is applied makes the copy
+    struct SnapshotCopy {
+        std::atomic<C*>            obj {nullptr};
+        std::atomic<bool>          taken {false};
+
+        ~SnapshotCopy() { if (!taken.load()) ALLOC::destroy(obj.load()); }
     };
 
     // Class to combine head and the instance
     struct Combined {
         Node*                      head {nullptr};
         C*                         obj {nullptr};
-        StrongTryRIRWLock          rwLock {MAX_THREADS};
+        std::atomic<uint64_t>      ticket {NO_TICKET};   // Ticket of head, for readers that don't hold the lock
+        StrongTryRIRWLock<MAX_T, ALLOC::template Allocator> rwLock;
+        std::atomic<Pin*>          pin {nullptr};        // Set while there are snapshots of obj
+        uint64_t                   rcuVersion {0};       // Grace period started when it stopped being curComb, with rcuReaders
         uint64_t                   numLocks {0};
         uint64_t                   numCopies {0};
         uint64_t                   pad[16];              // Avoid false sharing
 
+        // With many threads, the read indicator is split in groups to make the scans of the writers shorter
+        Combined(const int maxThreads, const uint64_t maxReaderCancels) :
+                rwLock{maxThreads, maxThreads > RI_GROUP_THRESHOLD ? RI_THREADS_PER_GROUP : 0, maxReaderCancels} { }
+
         // Helper function to update newComb->head while keeping track of ORCs.
         void updateHead(Node* mn) {
             mn->refcnt.fetch_add(1); // mn is assumed to be protected by an HP
             if (head != nullptr) head->refcnt.fetch_add(-1);
             head = mn;
+            ticket.store(mn->ticket.load(std::memory_order_relaxed));
         }
     };
 
+    using CombinedAlloc = typename ALLOC::template Allocator<Combined>;
+
     alignas(128) std::atomic<Combined*> curComb { nullptr };
 
     std::function<R(C*)> sentinelMutation = [](C* c){ return R{}; };
@@ -99,18 +401,57 @@ private:
 
     alignas(128) std::atomic<uint64_t> numCopies {0};
 
+    // Number of Combined instances with a copy of the object, and the highest it has been
+    alignas(128) std::atomic<int> liveReplicas {0};
+    std::atomic<int>              peakReplicas {0};
+
+    // Used only in NUMA mode, the last Combined of each node that was published in curComb
+    alignas(128) std::atomic<Combined*> localComb[MAX_NUMA_NODES];
+
+    // Used only in combining mode
+    alignas(128) std::atomic<bool>     isCombining {false};
+    alignas(128) std::atomic<uint64_t> publishedTicket {0};  // Highest ticket of a head that was set in curComb
+
     // Enqueue requests
-    alignas(128) std::atomic<Node*> enqueuers[MAX_THREADS];
+    alignas(128) std::atomic<Node*>* enqueuers;   // maxThreads entries
 
     // We need two hazard pointers for the enqueue() (ltail and lnext), one for myNode, and two to traverse the list/queue
-    HazardPointersCX<Node> hp {5, maxThreads};
+    RECL<Node,MAX_T> hp {5, maxThreads, MAX_RECYCLED_NODES, 5*maxThreads};   // Scan once every R=H retires
     const int kHpTail     = 0;
     const int kHpTailNext = 1;
     const int kHpHead     = 2;
     const int kHpNext     = 3;
     const int kHpMyNode   = 4;
 
-    CircularArray<Node>* preRetired[MAX_THREADS];
+    CircularArray<Node,RECL<Node,MAX_T>>** preRetired; // maxThreads entries
+
+    STATS ucStats {maxThreads};
+    COPY  copyPolicy {};
+
+    // Used only with rcuReaders
+    URCUGraceVersion urcu {maxThreads};
+
+    // Used only by startAsyncHelper()
+    std::thread                asyncHelper;
+    std::atomic<bool>          asyncHelperQuit {false};
+
+    // Used only with a MutationLog, after openLog()
+    LOG                        mutationLog {};
+    std::function<void(const C&, std::ostream&)> saveFunc;
+
+    // Used only after enableChangeStream()
+    std::unique_ptr<ChangeStream<typename LOG::Entry>> changeStream;
+
+    // Used only after enableHTM(), zero means the HTM fast path is disabled
+    int                        htmAttempts {0};
+
+    // Reuses a node from this thread's pool if there is one
+    template<typename F> inline Node* newNode(F&& func, const int tid) {
+        void* mem = hp.getRecycled(tid);
+        Node* node = (mem == nullptr) ? new Node(std::forward<F>(func), tid) : new (mem) Node(std::forward<F>(func), tid);
+        hp.onNew(node);
+        return node;
+    }
 
     Combined* getCombined(uint64_t myTicket, const int tid) {
         for (int i = 0; i < maxThreads; i++) {
@@ -126,6 +467,286 @@ private:
         return nullptr;
     }
 
+    // Maximum number of mutations to replay instead of doing a copy, zero if replay is disabled
+    inline uint64_t getReplayLimit() const {
+        return maxReplay != 0 ? maxReplay : copyPolicy.replayLimit();
+    }
+
+    // Returns true if the mutations from 'mn' up to myTicket can be re-applied instead of doing a copy
+    inline bool isReplayable(Node* mn, uint64_t myTicket, uint64_t replayLimit) {
+        if (mn == nullptr || mn == mn->next.load()) return false;
+        const uint64_t lticket = mn->ticket.load();
+        return lticket >= myTicket || myTicket - lticket <= replayLimit;
+    }
+
+    /*
+     * Used only in replay mode.
+     * Looks for a Combined that can catch up by replaying mutations, returning it locked in exclusive mode.
+     * Returns nullptr if there is no such Combined available.
+     */
+    Combined* getReplayableCombined(uint64_t myTicket, uint64_t replayLimit, const int tid) {
+        const int start = getLocalStart();
+        for (int j = 0; j < 2*maxThreads; j++) {
+            Combined* comb = &combs[(start+j) % (2*maxThreads)];
+            if (!comb->rwLock.exclusiveTryLock(tid)) continue;
+            if (isRCUBusy(comb)) {
+                comb->rwLock.exclusiveUnlock();
+                continue;
+            }
+            detachPin(comb);
+            if (isReplayable(comb->head, myTicket, replayLimit)) return comb;
+            comb->rwLock.exclusiveUnlock();
+        }
+        return nullptr;
+    }
+
+    /*
+     * Used only when the copy policy says a copy is expensive.
+     * Waits for up to waitNs for a Combined that can catch up by replaying mutations, returning it
+     * locked in exclusive mode, or for our mutation to be published in curComb, returning nullptr.
+     * Also returns nullptr when the time is up, or right away if no node was enqueued after ours.
+     */
+    Combined* waitReplayableCombined(Node* myNode, uint64_t myTicket, uint64_t replayLimit, uint64_t waitNs, const int tid) {
+        if (myNode->next.load() == nullptr) return nullptr;
+        const uint64_t startNs = copyPolicy.now();
+        do {
+            if (getCurTicket() >= myTicket) return nullptr;
+            if (replayLimit != 0) {
+                Combined* comb = getReplayableCombined(myTicket, replayLimit, tid);
+                if (comb != nullptr) return comb;
+            }
+            std::this_thread::yield();
+        } while (copyPolicy.now() - startNs < waitNs);
+        return nullptr;
+    }
+
+    // Index of the first Combined in the pool of the NUMA node where we're running (zero if NUMA mode is disabled)
+    inline int getLocalStart() {
+        if (numNodes == 1) return 0;
+        return (numa.getNode() % numNodes) * combsPerNode;
+    }
+
+    // Ticket of the head of curComb. If curComb keeps changing, returns the highest ticket that was seen.
+    uint64_t getCurTicket() {
+        uint64_t lticket = 0;
+        for (int i = 0; i < maxThreads; i++) {
+            Combined* lcomb = curComb.load();
+            const uint64_t ticket = lcomb->ticket.load();
+            if (lcomb == curComb.load()) return ticket;
+            lticket = std::max(lticket, ticket);
+        }
+        return lticket;
+    }
+
+    // Used only with adaptiveRetire. Lowest ticket of the heads of the Combined instances.
+    uint64_t getOldestTicket() {
+        uint64_t lticket = NO_TICKET;
+        for (int i = 0; i < 2*maxThreads; i++) lticket = std::min(lticket, combs[i].ticket.load());
+        return lticket;
+    }
+
+    // Re-applies the mutations in the queue on comb until its head reaches targetTicket, or a retired node is found
+    void catchUp(Combined* comb, uint64_t targetTicket, const int tid) {
+        Node* mn = comb->head;
+        if (mn == nullptr) return;
+        while (mn->ticket.load() < targetTicket) {
+            Node* lnext = hp.protectPtr(kHpHead, mn->next.load(), tid);
+            if (lnext == nullptr || mn == mn->next.load()) break;
+            lnext->result.store(ALLOC::apply(comb->obj, lnext->mutation));
+            hp.protectPtrRelease(kHpNext, lnext, tid);
+            mn = lnext;
+            ucStats.add(STATS_MUTATIONS, tid);
+        }
+        comb->updateHead(mn);
+    }
+
+    /*
+     * Used only in NUMA mode.
+     * Applies readFunc on the replica of our NUMA node if it is in the same state as curComb.
+     * If curComb doesn't change between the two loads and the ticket of the local replica is the
+     * same as the ticket of curComb, then reading the local replica is equivalent to reading curComb.
+     * Returns false if the read was not done.
+     */
+    template<typename F> bool applyReadLocal(F& readFunc, R& ret, const int tid) {
+        Combined* lcomb = curComb.load();
+        Combined* local = localComb[numa.getNode() % numNodes].load();
+        if (local == nullptr || local == lcomb) return false;
+        const uint64_t lticket = lcomb->ticket.load();
+        for (int i = 0; i < 2; i++) {
+            if (!local->rwLock.sharedTryLock(tid)) return false;
+            if (local->ticket.load() == lticket) {
+                if (curComb.load() == lcomb && lcomb->ticket.load() == lticket) {
+                    ret = readFunc(local->obj);
+                    local->rwLock.sharedUnlock(tid);
+                    return true;
+                }
+                local->rwLock.sharedUnlock(tid);
+                return false;
+            }
+            local->rwLock.sharedUnlock(tid);
+            if (i == 1 || !local->rwLock.exclusiveTryLock(tid)) return false;
+            detachPin(local);
+            if (local->obj != nullptr) catchUp(local, lticket, tid);
+            local->rwLock.exclusiveUnlock();
+        }
+        return false;
+    }
+
+    /*
+     * Used only with OptimisticReads<C>.
+     * Applies readFunc on curComb->obj without the shared lock, and keeps the result only if no
+     * updater locked curComb or applied a mutation on it in the meantime (see "Optimistic reads").
+     * Returns false if the read was not done.
+     */
+    template<typename F> bool applyReadOptimistic(F& readFunc, R& ret) {
+        for (int i = 0; i < OPTIMISTIC_READ_TRIES; i++) {
+            Combined* lcomb = curComb.load();
+            const uint64_t seq = lcomb->rwLock.optimisticBegin();
+            if (seq == lcomb->rwLock.NO_SEQ) continue;
+            const uint64_t lticket = lcomb->ticket.load();
+            if (lcomb != curComb.load()) continue;
+            R lret = readFunc(lcomb->obj);
+            if (!lcomb->rwLock.optimisticValidate(seq) || lcomb->ticket.load(std::memory_order_relaxed) != lticket) continue;
+            ret = lret;
+            return true;
+        }
+        return false;
+    }
+
+    // Returns false if there are already maxReplicas live replicas
+    bool addReplica() {
+        int n = liveReplicas.load();
+        do {
+            if (maxReplicas != 0 && n >= maxReplicas) return false;
+        } while (!liveReplicas.compare_exchange_weak(n, n+1));
+        int peak = peakReplicas.load();
+        while (peak < n+1 && !peakReplicas.compare_exchange_weak(peak, n+1));
+        return true;
+    }
+
+    /*
+     * Returns a Combined locked in exclusive mode, or nullptr if the mutation with myTicket has
+     * already been applied while we were waiting for a Combined (only in adaptive replicas mode).
+     * In adaptive mode, the live replicas are preferred and a new replica is added only when
+     * all of the live ones are locked.
+     */
+    Combined* getExclusiveCombined(uint64_t myTicket, const int tid) {
+        const int start = getLocalStart();
+        if (maxReplicas == 0) {
+            // With rcuReaders, the first pass skips the Combined instances that may still have readers
+            for (int k = rcuReaders ? 0 : 1; k < 2; k++) {
+                for (int j = 0; j < 2*maxThreads; j++) {
+                    Combined* comb = &combs[(start+j) % (2*maxThreads)];
+                    if (!comb->rwLock.exclusiveTryLock(tid)) continue;
+                    if (k == 0 && isRCUBusy(comb)) {
+                        comb->rwLock.exclusiveUnlock();
+                        continue;
+                    }
+                    detachPin(comb);
+                    return comb;
+                }
+            }
+            std::cout << "ERROR: not enough Combined instances\n";
+            assert(false);
+            return nullptr;
+        }
+        while (true) {
+            for (int j = 0; j < 2*maxThreads; j++) {
+                Combined* comb = &combs[(start+j) % (2*maxThreads)];
+                if (!comb->rwLock.exclusiveTryLock(tid)) continue;
+                if (isRCUBusy(comb)) {
+                    comb->rwLock.exclusiveUnlock();
+                    continue;
+                }
+                detachPin(comb);
+                if (comb->obj != nullptr) return comb;
+                comb->rwLock.exclusiveUnlock();
+            }
+            for (int j = 0; j < 2*maxThreads; j++) {
+                Combined* comb = &combs[(start+j) % (2*maxThreads)];
+                if (!comb->rwLock.exclusiveTryLock(tid)) continue;
+                if (isRCUBusy(comb)) {
+                    comb->rwLock.exclusiveUnlock();
+                    continue;
+                }
+                detachPin(comb);
+                if (comb->obj == nullptr && addReplica()) return comb;
+                comb->rwLock.exclusiveUnlock();
+            }
+            // All replicas are in use, check if one of them has already applied our mutation
+            Combined* lcomb = curComb.load();
+            if (lcomb->rwLock.sharedTryLock(tid)) {
+                const bool isApplied = lcomb->head->ticket.load() >= myTicket;
+                lcomb->rwLock.sharedUnlock(tid);
+                if (isApplied) return nullptr;
+            }
+            std::this_thread::yield();
+        }
+    }
+
+    /*
+     * Used only in adaptive replicas mode.
+     * Frees the copy of one Combined if its head has been retired, which means it is idle and
+     * its next user would have to do a full copy anyway.
+     */
+    void trimReplica(uint64_t myTicket, const int tid) {
+        if (liveReplicas.load() <= 2) return;
+        Combined* comb = &combs[myTicket % (2*maxThreads)];
+        if (!comb->rwLock.exclusiveTryLock(tid)) return;
+        if (isRCUBusy(comb)) {
+            comb->rwLock.exclusiveUnlock();
+            return;
+        }
+        detachPin(comb);
+        Node* lhead = comb->head;
+        if (comb->obj != nullptr && lhead != nullptr && lhead == lhead->next.load()) {
+            ALLOC::destroy(comb->obj);
+            comb->obj = nullptr;
+            comb->head = nullptr;
+            comb->ticket.store(NO_TICKET);
+            lhead->refcnt.fetch_add(-1);
+            liveReplicas.fetch_add(-1);
+        }
+        comb->rwLock.exclusiveUnlock();
+    }
+
+    /*
+     * Used only with rcuReaders, must be called with the exclusive lock of comb.
+     * Returns true if there may still be readers on comb->obj from when comb was curComb,
+     * in which case the updaters look for another Combined instead of waiting for them.
+     */
+    inline bool isRCUBusy(Combined* comb) {
+        if (comb->rcuVersion == 0) return false;
+        if (!urcu.isGraceOver(comb->rcuVersion)) return true;
+        comb->rcuVersion = 0;
+        return false;
+    }
+
+    /*
+     * Must be called with the exclusive lock of comb, before modifying comb->obj.
+     * With rcuReaders, waits for the readers that loaded comb when it was curComb (see isRCUBusy()).
+     * If there are snapshots of comb->obj, they keep it and comb becomes empty, like in trimReplica().
+     */
+    inline void detachPin(Combined* comb) {
+        if (comb->rcuVersion != 0) {
+            comb->rcuVersion = 0;
+            urcu.synchronize();
+        }
+        Pin* lpin = comb->pin.load();
+        if (lpin == nullptr) return;
+        comb->pin.store(nullptr, std::memory_order_relaxed);
+        if (lpin->refs.fetch_add(-1) == 1) {
+            delete lpin;
+            return;
+        }
+        Node* lhead = comb->head;
+        comb->obj = nullptr;
+        comb->head = nullptr;
+        comb->ticket.store(NO_TICKET);
+        if (lhead != nullptr) lhead->refcnt.fetch_add(-1);
+        liveReplicas.fetch_add(-1);
+    }
+
     /**
      * Enqueue algorithm from the Turn queue, adding a monotonically incrementing ticket
      * Steps when uncontended:
@@ -144,13 +765,13 @@ private:
             if (ltail != tail.load()) continue; // If the tail advanced maxThreads times, then my node has been enqueued
             if (enqueuers[ltail->enqTid].load() == ltail) {  // Help a thread do step 4
                 Node* tmp = ltail;
-                enqueuers[ltail->enqTid].compare_exchange_strong(tmp, nullptr);
+                if (enqueuers[ltail->enqTid].compare_exchange_strong(tmp, nullptr) && ltail->enqTid != tid) ucStats.add(STATS_ENQUEUE_HELPS, tid);
             }
             for (int j = 1; j < maxThreads+1; j++) {         // Help a thread do step 2
                 Node* nodeToHelp = enqueuers[(j + ltail->enqTid) % maxThreads].load();
                 if (nodeToHelp == nullptr) continue;
                 Node* nodenull = nullptr;
-                ltail->next.compare_exchange_strong(nodenull, nodeToHelp);
+                if (ltail->next.compare_exchange_strong(nodenull, nodeToHelp) && nodeToHelp != myNode) ucStats.add(STATS_ENQUEUE_HELPS, tid);
                 break;
             }
             Node* lnext = ltail->next.load();
@@ -158,137 +779,190 @@ private:
                 hp.protectPtr(kHpTailNext, lnext, tid);
                 if (ltail != tail.load()) continue;
                 lnext->ticket.store(ltail->ticket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
-                tail.compare_exchange_strong(ltail, lnext); // Help a thread do step 3:
+                if (tail.compare_exchange_strong(ltail, lnext) && lnext != myNode) ucStats.add(STATS_ENQUEUE_HELPS, tid); // Help a thread do step 3:
             }
         }
         enqueuers[tid].store(nullptr, std::memory_order_release); // Do step 4, just in case it's not done
     }
 
-public:
-    CXMutationWF(C* inst, const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
-        combs = new Combined[2*maxThreads];
-        for (int i = 0; i < maxThreads; i++) enqueuers[i].store(nullptr, std::memory_order_relaxed);
-        for (int i = 0; i < maxThreads; i++) preRetired[i] = new CircularArray<Node>(hp,i);
-        // Start with two or 4 valid combined instances.
-        combs[0].head = sentinel;
-        combs[0].obj = inst;
-        combs[1].head = sentinel;
-        combs[1].obj = new C(*inst);
-        if (maxThreads >= 2) {
-            for (int i = 2; i < 4; i++) {
-                combs[i].head = sentinel;
-                combs[i].obj = new C(*inst);
+    /*
+     * Inserts myNode in the queue and applies all mutations up to it, returning its result.
+     * myNode stays protected by the hazard pointer kHpMyNode until this thread's next operation,
+     * or until the end of the current one (OpGuard) with EpochBasedCX.
+     */
+    R applyNode(Node* myNode, const int tid) {
+        // Insert our node in the queue
+        hp.protectPtrRelease(kHpMyNode, myNode, tid);
+        enqueue(myNode, tid);
+        const uint64_t myTicket = myNode->ticket.load();
+        if (maxCombineSpins == 0) return applyMutations(myNode, myTicket, myTicket, tid);
+        if (isCombining.load() || isCombining.exchange(true)) {
+            // There is a combiner, give it a chance to apply and publish our mutation
+            for (int i = 0; i < maxCombineSpins; i++) {
+                if (publishedTicket.load() >= myTicket) return myNode->result.load();
+                std::this_thread::yield();
             }
-            sentinel->refcnt.store(4, std::memory_order_relaxed);
-        } else {
-            sentinel->refcnt.store(2, std::memory_order_relaxed);
+            return applyMutations(myNode, myTicket, myTicket, tid);
         }
-        combs[0].rwLock.setReadLock();
-        curComb.store(&combs[0]);
+        // We're the combiner: apply every mutation that is already in the queue
+        uint64_t targetTicket = myTicket;
+        Node* ltail = hp.protectPtr(kHpTail, tail.load(), tid);
+        if (ltail == tail.load()) targetTicket = std::max(myTicket, ltail->ticket.load());
+        R ret = applyMutations(myNode, myTicket, targetTicket, tid);
+        isCombining.store(false, std::memory_order_release);
+        return ret;
     }
 
-    ~CXMutationWF() {
-    	//printf("numCopies");
-    	for (int i = 0; i < 2*maxThreads; i++) {
-    		if (combs[i].obj == nullptr || combs[i].head == nullptr) continue;
-    		//printf(" %ld",combs[i].numCopies);
-    	}
-    	int count = 0;
-    	//printf("\n");
-    	//printf("numLocks");
-        for (int i = 0; i < 2*maxThreads; i++) {
-        	if(combs[i].obj == nullptr) count++;
-            if (combs[i].obj == nullptr || combs[i].head == nullptr) continue;
-            //printf(" %ld",combs[i].numLocks);
-            delete combs[i].obj;
+    /*
+     * HTM fast path of applyUpdate(): appends myNode to the queue and applies it in place on curComb, in a
+     * hardware transaction. Returns false if the transactions aborted, and then myNode wasn't enqueued.
+     */
+    bool tryApplyHTM(Node* myNode, R& ret, const int tid) {
+        if (LOG::enabled && (mutationLog.isOpen() || changeStream != nullptr)) return false;
+        hp.protectPtrRelease(kHpMyNode, myNode, tid);
+        Node* ltail = nullptr;
+        Pin* lpin = nullptr;
+        for (int i = 0; i < htmAttempts; i++) {
+            const unsigned status = HTM::begin();
+            if (status == HTM::STARTED) {
+                Combined* lcomb = curComb.load(std::memory_order_relaxed);
+                ltail = tail.load(std::memory_order_relaxed);
+                if (lcomb->head != ltail || ltail->next.load(std::memory_order_relaxed) != nullptr) HTM::abort();
+                if (lcomb->rwLock.hasReaders()) HTM::abort();
+                // A pin whose only reference is the one of the Combined has no snapshots left, we drop it
+                lpin = lcomb->pin.load(std::memory_order_relaxed);
+                if (lpin != nullptr) {
+                    if (lpin->refs.load(std::memory_order_relaxed) != 1) HTM::abort();
+                    lcomb->pin.store(nullptr, std::memory_order_relaxed);
+                }
+                for (int it = 0; it < maxThreads; it++) {
+                    if (enqueuers[it].load(std::memory_order_relaxed) != nullptr) HTM::abort();
+                }
+                const uint64_t myTicket = ltail->ticket.load(std::memory_order_relaxed) + 1;
+                myNode->ticket.store(myTicket, std::memory_order_relaxed);
+                ltail->next.store(myNode, std::memory_order_relaxed);
+                tail.store(myNode, std::memory_order_relaxed);
+                ret = ALLOC::apply(lcomb->obj, myNode->mutation);
+                lcomb->updateHead(myNode);
+                if (maxCombineSpins != 0) publishedTicket.store(myTicket, std::memory_order_relaxed);
+                HTM::end();
+                break;
+            }
+            ucStats.add(STATS_HTM_ABORTS, tid);
+            if (!HTM::mayRetry(status)) return false;
         }
-        //printf("\n");
-        //std::cout<<"count "<<count<<"\n";
-        //std::cout << "numCopies = " << numCopies.load() << "\n";
-        for (int i = 0; i < maxThreads; i++) delete preRetired[i];
-        delete[] combs;
-        delete sentinel;
+        if (ltail == nullptr) return false;
+        delete lpin;
+        ucStats.add(STATS_HTM_COMMITS, tid);
+        ucStats.add(STATS_MUTATIONS, tid);
+        // The old head of curComb is retired here, a publisher only retires the nodes from the head of the Combined it replaces
+        preRetired[tid]->add(ltail, adaptiveRetire ? getOldestTicket() : 0);
+        return true;
     }
 
-    static std::string className() { return "CXWF-"; }
-
     /*
-     * Adds the mutativeFunc to the queue and applies all mutations up to it, returning the result.
-     *
-     * Progress Condition: wait-free (bounded by the number of threads)
-     *
+     * Applies on a Combined all mutations up to myNode (and up to targetTicket, if possible) and publishes it on curComb.
      */
-    template<typename F> R applyUpdate(F&& mutativeFunc, const int tid) {
-        // Insert our node in the queue
-        Node* myNode = new Node(mutativeFunc, tid);
-        hp.protectPtrRelease(kHpMyNode, myNode, tid);
-        enqueue(myNode, tid);
-        const uint64_t myTicket = myNode->ticket.load();
+    R applyMutations(Node* myNode, const uint64_t myTicket, const uint64_t targetTicket, const int tid) {
         // Get one of the Combined instances on which to apply mutation(s)
         Combined* newComb = nullptr;
-        for (int i = 0; i < 2*maxThreads; i++) {
-            if (combs[i].rwLock.exclusiveTryLock(tid)) {
-                newComb = &combs[i];
-                //newComb->numLocks++;
-                break;
-            }
-        }
-        if (newComb == nullptr) {
-            std::cout << "ERROR: not enough Combined instances\n";
-            assert(false);
+        const uint64_t replayLimit = getReplayLimit();
+        if (replayLimit != 0) newComb = getReplayableCombined(myTicket, replayLimit, tid);
+        const uint64_t waitNs = copyPolicy.waitNs();
+        if (newComb == nullptr && waitNs != 0) {
+            newComb = waitReplayableCombined(myNode, myTicket, replayLimit, waitNs, tid);
+            if (newComb == nullptr && getCurTicket() >= myTicket) return myNode->result.load();
         }
+        if (newComb == nullptr) newComb = getExclusiveCombined(myTicket, tid);
+        if (newComb == nullptr) return myNode->result.load();
         Node* mn = newComb->head;
         if (mn != nullptr && mn->ticket.load() >= myTicket) {
             newComb->rwLock.exclusiveUnlock();
             return myNode->result.load();
         }
+        // In replay mode, a Combined that is too far behind is refreshed with a copy of curComb
+        if (replayLimit != 0 && !isReplayable(mn, myTicket, replayLimit)) mn = nullptr;
         Combined* lcomb = nullptr;
+        uint64_t numApplied = 0;
+        const uint64_t applyStartNs = copyPolicy.now();
+        uint64_t copyNs = 0;
+        ucStats.add(STATS_LOCK_HOLDS, tid);
         // Apply all mutations starting from 'head' up to our node or the end of the list
         while (mn != myNode) {
             if (mn == nullptr || mn == mn->next.load()) {
                 if (lcomb != nullptr || (lcomb = getCombined(myTicket,tid)) == nullptr) {
+                    ucStats.add(STATS_MUTATIONS, tid, numApplied);
                     if (mn != nullptr) newComb->updateHead(mn);
+                    // Give back the replica that was reserved for an empty Combined
+                    if (maxReplicas != 0 && newComb->obj == nullptr) liveReplicas.fetch_add(-1);
                     newComb->rwLock.exclusiveUnlock();
                     return myNode->result.load();
                 }
-                //numCopies.fetch_add(1);
                 mn = lcomb->head;
+                const uint64_t oldTicket = newComb->ticket.load();
                 // Neither the 'instance' nor the 'head' will change now that we hold the shared lock
                 newComb->updateHead(mn);
-                delete newComb->obj;
-                //newComb->numCopies++;
-                newComb->obj = new C(*lcomb->obj);
+                if (maxReplicas == 0 && newComb->obj == nullptr) addReplica(); // In adaptive mode it was reserved in getExclusiveCombined()
+                const uint64_t copyStartNs = copyPolicy.now();
+                newComb->obj = ucStats.copy(*lcomb->obj, [&] () { return ALLOC::refresh(*lcomb->obj, mn->ticket.load(), newComb->obj, oldTicket); }, tid);
+                copyNs += copyPolicy.onCopy(copyStartNs);
                 lcomb->rwLock.sharedUnlock(tid);
                 continue;
             }
             Node* lnext = hp.protectPtr(kHpHead, mn->next.load(), tid);
             if (mn == mn->next.load()) continue;
-            lnext->result.store(lnext->mutation(newComb->obj), std::memory_order_relaxed);
+            lnext->result.store(ALLOC::apply(newComb->obj, lnext->mutation));
+            hp.protectPtrRelease(kHpNext, lnext, tid);
+            mn = lnext;
+            numApplied++;
+        }
+        // Combining: keep going with the mutations that were enqueued after ours, up to targetTicket
+        while (mn->ticket.load() < targetTicket) {
+            Node* lnext = hp.protectPtr(kHpHead, mn->next.load(), tid);
+            if (lnext == nullptr || mn == mn->next.load()) break;
+            lnext->result.store(ALLOC::apply(newComb->obj, lnext->mutation));
             hp.protectPtrRelease(kHpNext, lnext, tid);
             mn = lnext;
+            numApplied++;
         }
+        ucStats.add(STATS_MUTATIONS, tid, numApplied);
+        if (COPY::enabled) copyPolicy.onApply(numApplied, copyPolicy.now() - applyStartNs - copyNs);
+        const uint64_t lastTicket = mn->ticket.load();
         newComb->updateHead(mn);
         newComb->rwLock.downgrade();
         // Make the mutation visible to other threads by advancing curComb
         for (int i = 0; i < maxThreads; i++) {
             lcomb = curComb.load();
             if (!lcomb->rwLock.sharedTryLock(tid)) continue;
-            if (lcomb->head->ticket.load() >= myTicket) {
+            if (lcomb->head->ticket.load() >= lastTicket) {
                 lcomb->rwLock.sharedUnlock(tid);
                 if (lcomb != curComb.load()) continue;
                 break;
             }
             Combined* tmp = lcomb;
             if (curComb.compare_exchange_strong(tmp, newComb)){
+                if (rcuReaders) lcomb->rcuVersion = urcu.beginGrace();
                 lcomb->rwLock.setReadUnlock();
                 // Retire nodes from oldComb->head to newComb->head
                 Node* node = lcomb->head;
                 lcomb->rwLock.sharedUnlock(tid);
+                const bool isLogged = LOG::enabled && mutationLog.isOpen();
+                if (isLogged) makeRoomInLog(lastTicket, tid);
+                ChangeStream<typename LOG::Entry>* lstream = LOG::enabled ? changeStream.get() : nullptr;
+                const uint64_t oldestTicket = adaptiveRetire ? getOldestTicket() : 0;
                 while (node != mn) {
                     Node* lnext = node->next.load();
-                    preRetired[tid]->add(node);
+                    if (isLogged) mutationLog.write(lnext->ticket.load(), lnext->logEntry);
+                    if (lstream != nullptr) lstream->publish(lnext->ticket.load(), lnext->logEntry);
+                    preRetired[tid]->add(node, oldestTicket);
                     node = lnext;
                 }
+                if (maxReplicas != 0) trimReplica(myTicket, tid);
+                if (numNodes > 1) localComb[std::min<int>((newComb - combs) / combsPerNode, numNodes-1)].store(newComb);
+                if (maxCombineSpins != 0) {
+                    uint64_t lticket = publishedTicket.load();
+                    while (lticket < lastTicket && !publishedTicket.compare_exchange_weak(lticket, lastTicket));
+                }
                 return myNode->result.load();
             }
             lcomb->rwLock.sharedUnlock(tid);
@@ -298,14 +972,433 @@ public:
     }
 
     /*
+     * Applies and publishes the mutations up to node, if its ticket is not yet in curComb.
+     * While curComb is behind the ticket the node can't have been retired, so it's safe to
+     * protect it and check again.
+     */
+    void completeAsync(Node* node, const uint64_t ticket, const int tid) {
+        if (getCurTicket() >= ticket) return;
+        OpGuard guard {hp, tid};
+        hp.protectPtrRelease(kHpMyNode, node, tid);
+        if (getCurTicket() >= ticket) return;
+        applyMutations(node, ticket, ticket, tid);
+    }
+
+    /*
+     * Pins the replica in curComb, like a snapshot, and returns it with the ticket of its head.
+     * Returns nullptr if it couldn't get the shared lock of curComb after a few tries.
+     */
+    Pin* pinCurComb(uint64_t& ticket, const int tid) {
+        for (int i = 0; i < MAX_READ_TRIES + maxThreads; i++) {
+            Combined* lcomb = curComb.load();
+            if (!lcomb->rwLock.sharedTryLock(tid)) continue;
+            if (lcomb != curComb.load()) {
+                lcomb->rwLock.sharedUnlock(tid);
+                continue;
+            }
+            ticket = lcomb->ticket.load();
+            // Only updaters with the exclusive lock drop the reference of the Combined, so refs can't be zero here
+            Pin* lpin = lcomb->pin.load();
+            if (lpin == nullptr) {
+                Pin* newPin = new Pin(lcomb->obj, 2);
+                if (lcomb->pin.compare_exchange_strong(lpin, newPin)) {
+                    lcomb->rwLock.sharedUnlock(tid);
+                    return newPin;
+                }
+                delete newPin;
+            }
+            lpin->refs.fetch_add(1);
+            lcomb->rwLock.sharedUnlock(tid);
+            return lpin;
+        }
+        return nullptr;
+    }
+
+    /*
+     * Called by the publisher before it writes the slots up to lastTicket: makes a checkpoint
+     * when the log is half full, and waits for one if the slots are still needed.
+     */
+    void makeRoomInLog(const uint64_t lastTicket, const int tid) {
+        if (!mutationLog.needsCheckpoint(lastTicket)) return;
+        checkpoint(tid);
+        while (mutationLog.isFull(lastTicket)) {
+            if (!checkpoint(tid)) std::this_thread::yield();
+        }
+    }
+
+    // The tid of the calling thread, for the methods without a tid argument
+    inline int registeredTID() const {
+        const int tid = ThreadRegistry::getTID();
+        assert(tid < maxThreads);
+        return tid;
+    }
+
+public:
+    /*
+     * Handle to a replica returned by snapshot(), the replica is released when the handle is destroyed.
+     * The object must only be read, and it stays valid even if the Universal Construct is destroyed first.
+     */
+    class Snapshot {
+        Pin*     pin;
+        uint64_t ticket;
+
+    public:
+        Snapshot(Pin* pin, uint64_t ticket) : pin{pin}, ticket{ticket} { }
+        Snapshot(Snapshot&& other) : pin{other.pin}, ticket{other.ticket} { other.pin = nullptr; }
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        ~Snapshot() {
+            if (pin == nullptr) return;
+            if (pin->refs.fetch_add(-1) == 1) {
+                ALLOC::destroy(pin->obj);
+                delete pin;
+            }
+        }
+
+        C* get() const { return pin->obj; }
+        C* operator->() const { return pin->obj; }
+
+        // Ticket of the last mutation applied on the object
+        uint64_t getTicket() const { return ticket; }
+    };
+
+    typedef typename ChangeStream<typename LOG::Entry>::Cursor ChangeCursor;
+    typedef typename ChangeStream<typename LOG::Entry>::Status ChangeStatus;
+
+    /*
+     * Handle returned by applyUpdateAsync(). The mutation is already ordered in the queue;
+     * get() makes sure it's published in curComb and returns its result.
+     */
+    class AsyncUpdate {
+        CXMutationWF*               uc;
+        Node*                       node;     // Only dereferenced by completeAsync(), while it's not retired
+        uint64_t                    ticket;
+        std::shared_ptr<AsyncState> state;
+
+    public:
+        AsyncUpdate(CXMutationWF* uc, Node* node, uint64_t ticket, std::shared_ptr<AsyncState> state)
+            : uc{uc}, node{node}, ticket{ticket}, state{std::move(state)} { }
+
+        // Position of the mutation in the queue
+        uint64_t getTicket() const { return ticket; }
+
+        // True if the mutation is visible to readers
+        bool isDone() const { return uc->getCurTicket() >= ticket; }
+
+        // Applies the mutations up to this one if no other thread has, and returns the result
+        R get(const int tid) {
+            uc->completeAsync(node, ticket, tid);
+            return state->result.load();
+        }
+
+        R get() { return get(uc->registeredTID()); }
+    };
+
+    CXMutationWF(C* inst, const int numThreads=MAX_THREADS, const uint64_t maxReplay=0, const int maxReplicas=0, const int maxCombineSpins=0,
+                 const bool numaAware=false, const bool adaptiveRetire=false, const uint64_t maxReaderCancels=0, const bool rcuReaders=false) :
+            maxThreads{numThreads}, maxReplay{maxReplay}, maxReplicas{maxReplicas}, maxCombineSpins{maxCombineSpins}, adaptiveRetire{adaptiveRetire},
+            rcuReaders{rcuReaders}, optimisticReads{OptimisticReads<C>::value && maxReplicas == 0},
+            numNodes{numaAware ? std::max(1, std::min({numa.getNumNodes(), (int)maxThreads, MAX_NUMA_NODES})) : 1},
+            combsPerNode{2*maxThreads/numNodes} {
+        for (int i = 0; i < MAX_NUMA_NODES; i++) localComb[i].store(nullptr, std::memory_order_relaxed);
+        assert(maxReplicas == 0 || maxReplicas >= 2);
+        combs = CombinedAlloc().allocate(2*maxThreads);
+        for (int i = 0; i < 2*maxThreads; i++) new (&combs[i]) Combined(maxThreads, maxReaderCancels);
+        enqueuers = new std::atomic<Node*>[maxThreads];
+        for (int i = 0; i < maxThreads; i++) enqueuers[i].store(nullptr, std::memory_order_relaxed);
+        preRetired = new CircularArray<Node,RECL<Node,MAX_T>>*[maxThreads];
+        for (int i = 0; i < maxThreads; i++) preRetired[i] = new CircularArray<Node,RECL<Node,MAX_T>>(hp,i,adaptiveRetire);
+        // Only combs[0] holds the object, the other Combined instances are empty and get their
+        // copy (or their first assignFrom()) when an updater locks them for the first time.
+        combs[0].head = sentinel;
+        combs[0].obj = ALLOC::adopt(inst);
+        combs[0].ticket.store(0, std::memory_order_relaxed);
+        sentinel->refcnt.store(1, std::memory_order_relaxed);
+        liveReplicas.store(1, std::memory_order_relaxed);
+        peakReplicas.store(liveReplicas.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        combs[0].rwLock.setReadLock();
+        curComb.store(&combs[0]);
+    }
+
+    ~CXMutationWF() {
+        stopAsyncHelper();
+        // Snapshots that are still alive keep their object
+        for (int i = 0; i < 2*maxThreads; i++) detachPin(&combs[i]);
+    	//printf("numCopies");
+    	for (int i = 0; i < 2*maxThreads; i++) {
+    		if (combs[i].obj == nullptr || combs[i].head == nullptr) continue;
+    		//printf(" %ld",combs[i].numCopies);
+    	}
+    	int count = 0;
+    	//printf("\n");
+    	//printf("numLocks");
+        for (int i = 0; i < 2*maxThreads; i++) {
+        	if(combs[i].obj == nullptr) count++;
+            if (combs[i].obj == nullptr || combs[i].head == nullptr) continue;
+            //printf(" %ld",combs[i].numLocks);
+            ALLOC::destroy(combs[i].obj);
+        }
+        //printf("\n");
+        //std::cout<<"count "<<count<<"\n";
+        //std::cout << "numCopies = " << numCopies.load() << "\n";
+        for (int i = 0; i < maxThreads; i++) delete preRetired[i];
+        delete[] preRetired;
+        delete[] enqueuers;
+        for (int i = 0; i < 2*maxThreads; i++) combs[i].~Combined();
+        CombinedAlloc().deallocate(combs, 2*maxThreads);
+        delete sentinel;
+    }
+
+    static std::string className() { return ALLOC::enabled ? "CXWF-Arena-" : "CXWF-"; }
+
+    // Number of Combined instances that currently have a copy of the object
+    int getLiveReplicas() const { return liveReplicas.load(); }
+
+    // Highest number of copies of the object alive at the same time
+    int getPeakReplicas() const { return peakReplicas.load(); }
+
+    // Sum of the statistics of all threads, only hpScans unless STATS is UCStats
+    UCStatsSnapshot stats() const {
+        UCStatsSnapshot snap = ucStats.snapshot();
+        snap.hpScans = hp.getNumScans();
+        return snap;
+    }
+
+    // Number of times that a reader cancelled an updater trying to lock a Combined, see StrongTryRIRWLock
+    uint64_t getReaderCancels() const {
+        uint64_t sum = 0;
+        for (int i = 0; i < 2*maxThreads; i++) sum += combs[i].rwLock.getNumCancels();
+        return sum;
+    }
+
+    /*
+     * Adds the mutativeFunc to the queue and applies all mutations up to it, returning the result.
+     *
+     * Progress Condition: wait-free (bounded by the number of threads)
+     *
+     */
+    template<typename F> R applyUpdate(F&& mutativeFunc, const int tid) {
+        OpGuard guard {hp, tid};
+        Node* myNode = newNode(std::forward<F>(mutativeFunc), tid);
+        if (htmAttempts != 0) {
+            R ret {};
+            if (tryApplyHTM(myNode, ret, tid)) return ret;
+        }
+        return applyNode(myNode, tid);
+    }
+
+    /*
+     * Applies numFuncs mutations with a single node in the queue, i.e. a single
+     * enqueue(), exclusive lock and curComb transition for the whole batch.
+     * The mutations are applied back to back in the order of the array, each one
+     * linearizing on its own, and the result of mutativeFuncs[i] is stored in
+     * results[i] (results can be nullptr if they're not needed).
+     * The callables are copied into the node because other threads may replay
+     * them after this method returns.
+     *
+     * Progress Condition: wait-free (bounded by the number of threads and numFuncs)
+     */
+    template<typename F> void applyUpdateBatch(const F* mutativeFuncs, const int numFuncs, R* results, const int tid) {
+        if (numFuncs <= 0) return;
+        OpGuard guard {hp, tid};
+        std::unique_ptr<Batch<F>> batch {new Batch<F>(mutativeFuncs, numFuncs)};
+        Batch<F>* lbatch = batch.get();
+        applyNode(newNode([b = std::move(batch)] (C* obj) { return b->apply(obj); }, tid), tid);
+        // The batch is owned by our node which is still protected by kHpMyNode
+        if (results != nullptr) {
+            for (int i = 0; i < numFuncs; i++) results[i] = lbatch->results[i].load();
+        }
+    }
+
+    /*
+     * Adds the mutativeFunc to the queue and returns without applying it, see AsyncUpdate.
+     * The result is stored in the handle, because the node may be reclaimed before get() is called.
+     *
+     * Progress Condition: wait-free (bounded by the number of threads)
+     */
+    template<typename F> AsyncUpdate applyUpdateAsync(F&& mutativeFunc, const int tid) {
+        OpGuard guard {hp, tid};
+        auto state = std::make_shared<AsyncState>();
+        Node* myNode = newNode([state, func = std::forward<F>(mutativeFunc)] (C* obj) {
+            R ret = func(obj);
+            state->result.store(ret);
+            return ret;
+        }, tid);
+        hp.protectPtrRelease(kHpMyNode, myNode, tid);
+        enqueue(myNode, tid);
+        return AsyncUpdate(this, myNode, myNode->ticket.load(), std::move(state));
+    }
+
+    /*
+     * Applies and publishes all the mutations that are in the queue, for the asynchronous updates
+     * that no one else applied. Returns false if curComb was already up to date with the tail.
+     *
      * Progress Condition: wait-free (bounded by the number of threads)
      */
+    bool flushAsync(const int tid) {
+        OpGuard guard {hp, tid};
+        Node* ltail = hp.protectPtrRelease(kHpMyNode, tail.load(), tid);
+        if (ltail != tail.load()) return true;   // Someone else is enqueueing, and will apply it
+        const uint64_t lticket = ltail->ticket.load();
+        if (getCurTicket() >= lticket) return false;
+        applyMutations(ltail, lticket, lticket, tid);
+        return true;
+    }
+
+    /*
+     * Starts a thread that calls flushAsync() with tid, sleeping for period whenever there is
+     * nothing to apply. No other thread may use tid until stopAsyncHelper() is called.
+     */
+    void startAsyncHelper(const int tid, const std::chrono::microseconds period=std::chrono::microseconds(50)) {
+        if (asyncHelper.joinable()) return;
+        asyncHelperQuit.store(false);
+        asyncHelper = std::thread([this,tid,period] () {
+            while (!asyncHelperQuit.load()) {
+                if (!flushAsync(tid)) std::this_thread::sleep_for(period);
+            }
+            flushAsync(tid);
+        });
+    }
+
+    void stopAsyncHelper() {
+        if (!asyncHelper.joinable()) return;
+        asyncHelperQuit.store(true);
+        asyncHelper.join();
+    }
+
+    /*
+     * Opens the log at path (path.log and path.ckpt) with capacity slots and writes a
+     * checkpoint of the object with save(const C&, std::ostream&). Must be called before
+     * the updates that are to be logged, with no other thread updating the object.
+     * With syncCommit, applyUpdateLogged() returns only when its slot is synced to the file.
+     */
+    bool openLog(const std::string& path, const uint64_t capacity, std::function<void(const C&, std::ostream&)> save, const bool syncCommit, const int tid) {
+        static_assert(LOG::enabled, "openLog() needs a MutationLog as the LOG policy");
+        static_assert(!OptimisticReads<C>::value, "The replicas of the checkpoints are freed while optimistic readers may still read them");
+        saveFunc = std::move(save);
+        if (!mutationLog.open(path, capacity, syncCommit)) return false;
+        for (int i = 0; i < MAX_READ_TRIES + maxThreads; i++) {
+            if (checkpoint(tid)) return true;
+        }
+        return false;
+    }
+
+    /*
+     * Writes a checkpoint of the replica in curComb, which is pinned while it's saved so
+     * that updaters are not blocked. Returns false if there is already a checkpoint in progress
+     * or curComb couldn't be pinned.
+     *
+     * Progress Condition: blocking (file I/O)
+     */
+    bool checkpoint(const int tid) {
+        if (!mutationLog.isOpen() || !mutationLog.tryBeginCheckpoint()) return false;
+        uint64_t lticket;
+        Pin* lpin = pinCurComb(lticket, tid);
+        if (lpin == nullptr) {
+            mutationLog.endCheckpoint();
+            return false;
+        }
+        Snapshot snap {lpin, lticket};
+        const bool ok = mutationLog.writeCheckpoint(lticket, [&] (std::ostream& os) { saveFunc(*snap.get(), os); });
+        mutationLog.endCheckpoint();
+        return ok;
+    }
+
+    LOG& getLog() { return mutationLog; }
+
+    /*
+     * Starts putting the descriptors of the published mutations in a ring of capacity entries,
+     * for subscribe() and pollChanges(). Must be called before there are updates, like openLog().
+     */
+    void enableChangeStream(const uint64_t capacity) {
+        static_assert(LOG::enabled, "The change stream needs a MutationLog as the LOG policy, for the descriptors");
+        changeStream.reset(new ChangeStream<typename LOG::Entry>(capacity));
+    }
+
+    /*
+     * Enables the HTM fast path of applyUpdate(), with up to maxAttempts hardware transactions
+     * before the wait-free algorithm. Returns false, and leaves it disabled, if the processor
+     * doesn't have HTM or with rcuReaders. Must be called before there are updates.
+     */
+    bool enableHTM(const int maxAttempts=HTM_MAX_ATTEMPTS) {
+        if (rcuReaders || maxAttempts <= 0 || !HTM::isSupported()) return false;
+        htmAttempts = maxAttempts;
+        return true;
+    }
+
+    /*
+     * Returns a snapshot of the object and sets cursor to its ticket, so that pollChanges()
+     * gives the mutations that came after it. Also used after SNAPSHOT_NEEDED.
+     *
+     * Progress Condition: wait-free (bounded by the number of threads)
+     */
+    Snapshot subscribe(ChangeCursor& cursor, const int tid) {
+        Snapshot snap = snapshot(tid);
+        cursor.ticket = snap.getTicket();
+        return snap;
+    }
+
+    /*
+     * Calls func(ticket, desc) for up to maxEntries mutations after cursor, in ticket order,
+     * skipping the ones without a descriptor. Doesn't need a tid, it reads only the ring.
+     *
+     * Progress Condition: wait-free (bounded by maxEntries)
+     */
+    template<typename F> ChangeStatus pollChanges(ChangeCursor& cursor, F&& func, const uint64_t maxEntries=UINT64_MAX) {
+        return changeStream->poll(cursor, [&func] (const uint64_t ticket, const typename LOG::Entry& entry) {
+            if (entry.hasDesc) func(ticket, entry.desc);
+        }, maxEntries);
+    }
+
+    /*
+     * Same as applyUpdate(), with the descriptor desc of the mutation written in the log.
+     * The replay function given to MutationLog::recover() must do the same as mutativeFunc.
+     * With syncCommit, waits until the log is synced up to this mutation.
+     *
+     * Progress Condition: wait-free (bounded by the number of threads), blocking with syncCommit
+     * or when the log is full and a checkpoint is in progress
+     */
+    template<typename D, typename F> R applyUpdateLogged(const D& desc, F&& mutativeFunc, const int tid) {
+        static_assert(LOG::enabled, "applyUpdateLogged() needs a MutationLog as the LOG policy");
+        OpGuard guard {hp, tid};
+        Node* myNode = newNode(std::forward<F>(mutativeFunc), tid);
+        myNode->logEntry.desc = desc;
+        myNode->logEntry.hasDesc = true;
+        R ret = applyNode(myNode, tid);
+        // myNode is still protected by kHpMyNode
+        mutationLog.waitDurable(myNode->ticket.load());
+        return ret;
+    }
+
+    /*
+     * Progress Condition: wait-free (bounded by the number of threads), wait-free population oblivious with rcuReaders
+     */
     template<typename F> R applyRead(F&& readFunc, const int tid) {
+        if (rcuReaders) {
+            urcu.read_lock(tid);
+            R ret = readFunc(curComb.load()->obj);
+            urcu.read_unlock(tid);
+            return ret;
+        }
+        if constexpr (OptimisticReads<C>::value) {
+            R ret;
+            if (optimisticReads) {
+                if (applyReadOptimistic(readFunc, ret)) return ret;
+                ucStats.add(STATS_OPTIMISTIC_FAILS, tid);
+            }
+        }
+        OpGuard guard {hp, tid};
+        if (numNodes > 1) {
+            R ret;
+            if (applyReadLocal(readFunc, ret, tid)) return ret;
+        }
         Node* myNode = nullptr;
         for (int i=0; i < MAX_READ_TRIES + maxThreads; i++) {
             Combined* lcomb = curComb.load();
             if (i == MAX_READ_TRIES) { // enqueue read-only operation as if it was a mutation
-                myNode = new Node(readFunc, tid);
+                ucStats.add(STATS_READ_FALLBACKS, tid);
+                myNode = newNode(readFunc, tid);
                 hp.protectPtr(kHpMyNode, myNode, tid);
                 enqueue(myNode, tid);
             }
@@ -320,6 +1413,131 @@ public:
         }
         return myNode->result.load();
     }
+
+    /*
+     * applyRead() for the processes that mapped the shared memory segment where this instance
+     * was constructed (see SharedMemory.hpp). It doesn't touch the hazard pointers, the nodes
+     * or the stats, which are in the heap of the process of the updaters. There is no overload
+     * without tid, the ThreadRegistry of each process would give the same tids.
+     *
+     * Progress Condition: lock-free
+     */
+    template<typename F> R applyReadAttached(F&& readFunc, const int tid) {
+        assert(!rcuReaders);
+        while (true) {
+            Combined* lcomb = curComb.load();
+            if (!lcomb->rwLock.sharedTryLock(tid)) continue;
+            if (lcomb == curComb.load()) {
+                R ret = readFunc(lcomb->obj);
+                lcomb->rwLock.sharedUnlock(tid);
+                return ret;
+            }
+            lcomb->rwLock.sharedUnlock(tid);
+        }
+    }
+
+    /*
+     * Returns a handle to the replica in curComb, without holding its shared lock.
+     * The snapshot is linearizable, at the moment the replica was pinned.
+     * Updaters that need that Combined while the snapshot is alive will make a new copy.
+     *
+     * Progress Condition: wait-free (bounded by the number of threads)
+     */
+    Snapshot snapshot(const int tid) {
+        static_assert(!OptimisticReads<C>::value, "The replicas of the snapshots are freed while optimistic readers may still read them");
+        uint64_t lticket;
+        Pin* lpin = pinCurComb(lticket, tid);
+        if (lpin != nullptr) return Snapshot(lpin, lticket);
+        // Make a copy of the object in the state just before our node, like the read of applyRead() when it uses a node
+        ucStats.add(STATS_READ_FALLBACKS, tid);
+        auto scopy = std::make_shared<SnapshotCopy>();
+        OpGuard guard {hp, tid};
+        Node* myNode = newNode([scopy] (C* obj) {
+            if (scopy->obj.load() == nullptr) {
+                C* newObj = ALLOC::copy(*obj, (C*)nullptr);
+                C* tmp = nullptr;
+                if (!scopy->obj.compare_exchange_strong(tmp, newObj)) ALLOC::destroy(newObj);
+            }
+            return R{};
+        }, tid);
+        applyNode(myNode, tid);
+        scopy->taken.store(true);
+        // The node doesn't modify the object, so the copy is also the state at its ticket
+        return Snapshot(new Pin(scopy->obj.load(), 1), myNode->ticket.load());
+    }
+
+    /*
+     * Applies readFunc on any Combined whose head is at most maxLagTickets mutations behind
+     * the head of curComb (as seen at the start of the call). The replica may also be ahead of
+     * curComb, with mutations that are not yet published. Either way, readFunc sees the state
+     * of the object after a prefix of the queue of mutations, but the read is not linearizable.
+     * This lets readers spread over the replicas instead of all of them hitting curComb, and
+     * they don't have to re-check curComb after acquiring the shared lock.
+     * If no such replica can be locked, it falls back to applyRead().
+     *
+     * Progress Condition: wait-free (bounded by the number of threads)
+     */
+    template<typename F> R applyReadStale(F&& readFunc, const uint64_t maxLagTickets, const int tid) {
+        const uint64_t minTicket = getCurTicket();
+        const uint64_t lagTicket = (minTicket > maxLagTickets) ? minTicket - maxLagTickets : 0;
+        const int start = getLocalStart() + tid % combsPerNode;
+        for (int j = 0; j < 2*maxThreads; j++) {
+            Combined* comb = &combs[(start+j) % (2*maxThreads)];
+            if (comb->ticket.load() < lagTicket) continue;
+            if (!comb->rwLock.sharedTryLock(tid)) continue;
+            if (comb->obj != nullptr && comb->head != nullptr && comb->ticket.load() >= lagTicket) {
+                auto ret = readFunc(comb->obj);
+                comb->rwLock.sharedUnlock(tid);
+                return ret;
+            }
+            comb->rwLock.sharedUnlock(tid);
+        }
+        return applyRead(readFunc, tid);
+    }
+
+    /*
+     * Same as the methods above, but the tid is the one the ThreadRegistry assigned to the calling thread.
+     * It must be lower than the maxThreads passed to the constructor.
+     */
+    template<typename F> R applyUpdate(F&& mutativeFunc) {
+        return applyUpdate(std::forward<F>(mutativeFunc), registeredTID());
+    }
+
+    template<typename F> R applyRead(F&& readFunc) {
+        return applyRead(std::forward<F>(readFunc), registeredTID());
+    }
+
+    template<typename F> AsyncUpdate applyUpdateAsync(F&& mutativeFunc) {
+        return applyUpdateAsync(std::forward<F>(mutativeFunc), registeredTID());
+    }
+
+    bool flushAsync() {
+        return flushAsync(registeredTID());
+    }
+
+    template<typename D, typename F> R applyUpdateLogged(const D& desc, F&& mutativeFunc) {
+        return applyUpdateLogged(desc, std::forward<F>(mutativeFunc), registeredTID());
+    }
+
+    bool checkpoint() {
+        return checkpoint(registeredTID());
+    }
+
+    Snapshot subscribe(ChangeCursor& cursor) {
+        return subscribe(cursor, registeredTID());
+    }
+
+    template<typename F> void applyUpdateBatch(const F* mutativeFuncs, const int numFuncs, R* results) {
+        applyUpdateBatch(mutativeFuncs, numFuncs, results, registeredTID());
+    }
+
+    template<typename F> R applyReadStale(F&& readFunc, const uint64_t maxLagTickets) {
+        return applyReadStale(std::forward<F>(readFunc), maxLagTickets, registeredTID());
+    }
+
+    Snapshot snapshot() {
+        return snapshot(registeredTID());
+    }
 };
 
 #endif /* _CXMUTATION_WF_H_ */
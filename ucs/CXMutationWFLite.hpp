@@ -0,0 +1,394 @@
+/*
+ * Copyright 2014-2020
+ *   Andreia Correia <andreia.veiga@unine.ch>
+ *   Pedro Ramalhete <pramalhe@gmail.com>
+ *   Pascal Felber <pascal.felber@unine.ch>
+ *
+ * This work is published under the MIT license. See LICENSE.TXT
+ */
+#ifndef _CXMUTATIONWF_LITE_H_
+#define _CXMUTATIONWF_LITE_H_
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include "../common/Arena.hpp"
+#include "../common/HazardPointersCX.hpp"
+#include "../common/InlineFunction.hpp"
+#include "../common/ResultSlot.hpp"
+#include "../common/StrongTryCounterRWLock.hpp"
+#include "../common/ThreadRegistry.hpp"
+
+/**
+ * <h1> CXMutation Wait-Free, lightweight instances </h1>
+ *
+ * The same algorithm as CXMutationWF, for when there are many (millions of) small
+ * objects, each one with its own Universal Construct. A CXMutationWF has 2*maxThreads
+ * Combined instances with a per-thread read indicator each, an enqueuers array, a
+ * CircularArray per thread and its own hazard pointers, which is megabytes per instance.
+ * Here, all the per-thread state lives in a Domain that is shared by the instances:
+ * - The hazard pointers, the retired lists and the pools of recycled nodes;
+ * - The enqueuers array of the Turn queue. A thread enqueues in one queue at a time, so
+ *   a single array works for all the queues, as long as the helpers of a queue only
+ *   help the nodes of that queue (Node::owner). The helper protects the node with a
+ *   hazard pointer before it reads the owner: while a node is in enqueuers[] it is also
+ *   protected by the kHpMyNode of its thread, so it can't have been reclaimed.
+ *
+ * What is left in each instance is curComb, the tail, the sentinel node and a list of
+ * Combined instances of a few words each (StrongTryCounterRWLock instead of the RI lock).
+ * The Combined instances are allocated when they are needed: there is one at the start,
+ * and an updater that can't lock any of them adds one to the list. Without contention
+ * there are two of them, the one in curComb and the one that the next update catches up.
+ *
+ * Retirement:
+ * There are no CircularArrays, the publisher retires the nodes right away, but one
+ * publication behind: when it replaces lcomb in curComb, it retires the nodes from the
+ * head of the Combined that lcomb replaced (Combined::prevHead) up to the head of lcomb.
+ * The nodes after the head of lcomb are kept, so the Combined that was just replaced
+ * can still be caught up by re-applying mutations instead of a copy. The ranges retired
+ * by consecutive publishers are disjoint, like in CXMutationWF.
+ *
+ * The Domain must outlive its instances, and the tids passed to the instances must be
+ * lower than the maxThreads of the Domain. Replicas are made with HeapReplicas (see
+ * Arena.hpp), so a C with assignFrom() is refreshed in place.
+ *
+ * Consistency: Linearizable
+ * applyUpdate() progress: wait-free bounded O(N_threads), lock-free when a Combined is added
+ * applyRead() progress: wait-free bounded
+ * Memory Reclamation: Hazard Pointers + ORCs
+ */
+template<typename C, typename R = bool>  // R must be default constructible and copyable
+class CXMutationWFLite {
+
+private:
+    static const int MAX_READ_TRIES = 10;      // Maximum number of times a reader will fail to acquire the shared lock before adding its operation as a mutation
+    static const int MAX_THREADS = 128;
+    static const int MAX_MUTATION_SIZE = 64;   // Size in bytes of the largest callable that can be passed to applyUpdate()/applyRead()
+    static const int MAX_RECYCLED_NODES = 4096;
+    static const int kHpTail     = 0;
+    static const int kHpTailNext = 1;          // Also protects the node of another thread while its owner is checked
+    static const int kHpHead     = 2;
+    static const int kHpNext     = 3;
+    static const int kHpMyNode   = 4;
+
+    struct Node {
+        InlineFunction<R(C*),MAX_MUTATION_SIZE> mutation;
+        ResultSlot<R>              result;
+        std::atomic<Node*>         next {nullptr};
+        std::atomic<uint64_t>      ticket {0};
+        std::atomic<int>           refcnt {0};
+        const int                  enqTid;
+        const CXMutationWFLite*    owner;    // Instance whose queue the node goes in
+
+        template<typename F> Node(F&& mut, int tid, const CXMutationWFLite* owner) : mutation{std::forward<F>(mut)}, enqTid{tid}, owner{owner} { }
+    };
+
+public:
+    /*
+     * Per-thread state shared by all the instances of CXMutationWFLite<C,R> that are created with it.
+     */
+    class Domain {
+        friend class CXMutationWFLite;
+
+        const int                  maxThreads;
+        HazardPointersCX<Node>     hp {5, maxThreads, MAX_RECYCLED_NODES, 5*maxThreads};
+        std::atomic<Node*>*        enqueuers;   // maxThreads entries
+
+    public:
+        Domain(const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+            enqueuers = new std::atomic<Node*>[maxThreads];
+            for (int i = 0; i < maxThreads; i++) enqueuers[i].store(nullptr, std::memory_order_relaxed);
+        }
+
+        ~Domain() { delete[] enqueuers; }
+
+        Domain(const Domain&) = delete;
+        Domain& operator=(const Domain&) = delete;
+
+        int getMaxThreads() const { return maxThreads; }
+
+        uint64_t getNumScans() const { return hp.getNumScans(); }
+    };
+
+private:
+    struct Combined {
+        Node*                      head {nullptr};
+        C*                         obj {nullptr};
+        Node*                      prevHead {nullptr};   // Head of the Combined that this one replaced in curComb
+        Combined*                  nextComb {nullptr};   // List of the Combined instances of the object
+        StrongTryCounterRWLock     rwLock {};
+
+        // Helper function to update newComb->head while keeping track of ORCs.
+        void updateHead(Node* mn) {
+            mn->refcnt.fetch_add(1); // mn is assumed to be protected by an HP
+            if (head != nullptr) head->refcnt.fetch_add(-1);
+            head = mn;
+        }
+    };
+
+    Domain&                        domain;
+    HazardPointersCX<Node>&        hp;
+    std::atomic<Combined*>         curComb {nullptr};
+    std::atomic<Node*>             tail {nullptr};
+    std::atomic<Combined*>         combs {nullptr};
+    Node*                          sentinel;
+
+    // Reuses a node from this thread's pool if there is one
+    template<typename F> inline Node* newNode(F&& func, const int tid) {
+        void* mem = hp.getRecycled(tid);
+        Node* node = (mem == nullptr) ? new Node(std::forward<F>(func), tid, this) : new (mem) Node(std::forward<F>(func), tid, this);
+        hp.onNew(node);
+        return node;
+    }
+
+    Combined* getCombined(uint64_t myTicket, const int tid) {
+        for (int i = 0; i < domain.maxThreads; i++) {
+            Combined* lcomb = curComb.load();
+            if (!lcomb->rwLock.sharedTryLock(tid)) continue;
+            Node* lhead = lcomb->head;
+            uint64_t lticket = lhead->ticket.load();
+            if (lticket < myTicket && lhead != lhead->next.load()) return lcomb;
+            lcomb->rwLock.sharedUnlock(tid);
+            // in case lhead->ticket.load() has been made visible
+            if (lticket >= myTicket && lcomb == curComb.load()) return nullptr;
+        }
+        return nullptr;
+    }
+
+    // Returns a Combined locked in exclusive mode, adding a new (empty) one if all of them are locked
+    Combined* getExclusiveCombined(const int tid) {
+        for (Combined* comb = combs.load(); comb != nullptr; comb = comb->nextComb) {
+            if (comb->rwLock.exclusiveTryLock(tid)) return comb;
+        }
+        Combined* comb = new Combined();
+        comb->rwLock.exclusiveTryLock(tid);
+        Combined* lcombs = combs.load();
+        do {
+            comb->nextComb = lcombs;
+        } while (!combs.compare_exchange_weak(lcombs, comb));
+        return comb;
+    }
+
+    // Self-links the nodes from first up to last (exclusive) and retires the node after each one
+    inline void retireNodes(Node* first, Node* last, const int tid) {
+        Node* node = first;
+        while (node != last) {
+            Node* lnext = node->next.load();
+            node->next.store(node, std::memory_order_release);
+            hp.retire(lnext, tid);
+            node = lnext;
+        }
+    }
+
+    /**
+     * Enqueue algorithm from the Turn queue, see CXMutationWF::enqueue().
+     * The enqueuers array is shared with the other instances of the Domain, and only the
+     * nodes whose owner is this instance are helped.
+     */
+    void enqueue(Node* myNode, const int tid) {
+        std::atomic<Node*>* enqueuers = domain.enqueuers;
+        const int maxThreads = domain.maxThreads;
+        enqueuers[tid].store(myNode);
+        for (int i = 0; i < maxThreads; i++) {
+            if (enqueuers[tid].load() == nullptr) {
+                return; // Some thread did all the steps
+            }
+            Node* ltail = hp.protectPtr(kHpTail, tail.load(), tid);
+            if (ltail != tail.load()) continue; // If the tail advanced maxThreads times, then my node has been enqueued
+            if (enqueuers[ltail->enqTid].load() == ltail) {  // Help a thread do step 4
+                Node* tmp = ltail;
+                enqueuers[ltail->enqTid].compare_exchange_strong(tmp, nullptr);
+            }
+            for (int j = 1; j < maxThreads+1; j++) {         // Help a thread do step 2
+                std::atomic<Node*>& enq = enqueuers[(j + ltail->enqTid) % maxThreads];
+                Node* nodeToHelp = enq.load();
+                if (nodeToHelp == nullptr) continue;
+                if (nodeToHelp != myNode) {
+                    hp.protectPtr(kHpTailNext, nodeToHelp, tid);
+                    if (enq.load() != nodeToHelp || nodeToHelp->owner != this) continue;
+                }
+                Node* nodenull = nullptr;
+                ltail->next.compare_exchange_strong(nodenull, nodeToHelp);
+                break;
+            }
+            Node* lnext = ltail->next.load();
+            if (lnext != nullptr) {
+                hp.protectPtr(kHpTailNext, lnext, tid);
+                if (ltail != tail.load()) continue;
+                lnext->ticket.store(ltail->ticket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                tail.compare_exchange_strong(ltail, lnext);  // Help a thread do step 3
+            }
+        }
+        enqueuers[tid].store(nullptr, std::memory_order_release); // Do step 4, just in case it's not done
+    }
+
+    // The tid of the calling thread, for the methods without a tid argument
+    inline int registeredTID() const {
+        const int tid = ThreadRegistry::getTID();
+        assert(tid < domain.maxThreads);
+        return tid;
+    }
+
+public:
+    CXMutationWFLite(C* inst, Domain& domain) : domain{domain}, hp{domain.hp} {
+        sentinel = new Node([] (C* c) { return R{}; }, 0, this);
+        tail.store(sentinel, std::memory_order_relaxed);
+        Combined* comb = new Combined();
+        comb->head = sentinel;
+        comb->obj = HeapReplicas::adopt(inst);
+        sentinel->refcnt.store(1, std::memory_order_relaxed);
+        comb->rwLock.setReadLock();
+        combs.store(comb, std::memory_order_relaxed);
+        curComb.store(comb);
+    }
+
+    /*
+     * No other thread may be using the instance. The nodes that were already given to the
+     * hazard pointers stay there, the others are deleted here.
+     */
+    ~CXMutationWFLite() {
+        // The nodes from prevHead of curComb onwards are not self-linked, and only prevHead was retired
+        Node* lprev = curComb.load()->prevHead;
+        Combined* comb = combs.load();
+        while (comb != nullptr) {
+            Combined* lnext = comb->nextComb;
+            if (comb->head != nullptr) comb->head->refcnt.fetch_add(-1);
+            HeapReplicas::destroy(comb->obj);
+            delete comb;
+            comb = lnext;
+        }
+        Node* node = (lprev != nullptr) ? lprev : sentinel;
+        if (node != sentinel) {
+            Node* lnext = node->next.load();
+            node->next.store(node);
+            node = lnext;
+        }
+        while (node != nullptr) {
+            Node* lnext = node->next.load();
+            if (node != sentinel) delete node;
+            node = lnext;
+        }
+        delete sentinel;
+    }
+
+    static std::string className() { return "CXWF-Lite-"; }
+
+    // Number of Combined instances allocated so far, which grows with the number of threads that used the object at the same time
+    int getNumCombined() const {
+        int n = 0;
+        for (Combined* comb = combs.load(); comb != nullptr; comb = comb->nextComb) n++;
+        return n;
+    }
+
+    /*
+     * Adds the mutativeFunc to the queue and applies all mutations up to it, returning the result.
+     *
+     * Progress Condition: wait-free (bounded by the number of threads)
+     */
+    template<typename F> R applyUpdate(F&& mutativeFunc, const int tid) {
+        // Insert our node in the queue
+        Node* myNode = newNode(std::forward<F>(mutativeFunc), tid);
+        hp.protectPtrRelease(kHpMyNode, myNode, tid);
+        enqueue(myNode, tid);
+        const uint64_t myTicket = myNode->ticket.load();
+        // Get one of the Combined instances on which to apply mutation(s)
+        Combined* newComb = getExclusiveCombined(tid);
+        Node* mn = newComb->head;
+        if (mn != nullptr && mn->ticket.load() >= myTicket) {
+            newComb->rwLock.exclusiveUnlock();
+            return myNode->result.load();
+        }
+        Combined* lcomb = nullptr;
+        // Apply all mutations starting from 'head' up to our node or the end of the list
+        while (mn != myNode) {
+            if (mn == nullptr || mn == mn->next.load()) {
+                if (lcomb != nullptr || (lcomb = getCombined(myTicket,tid)) == nullptr) {
+                    if (mn != nullptr) newComb->updateHead(mn);
+                    newComb->rwLock.exclusiveUnlock();
+                    return myNode->result.load();
+                }
+                mn = lcomb->head;
+                const uint64_t oldTicket = (newComb->head == nullptr) ? UINT64_MAX : newComb->head->ticket.load();
+                // Neither the 'instance' nor the 'head' will change now that we hold the shared lock
+                newComb->updateHead(mn);
+                newComb->obj = HeapReplicas::refresh(*lcomb->obj, mn->ticket.load(), newComb->obj, oldTicket);
+                lcomb->rwLock.sharedUnlock(tid);
+                continue;
+            }
+            Node* lnext = hp.protectPtr(kHpHead, mn->next.load(), tid);
+            if (mn == mn->next.load()) continue;
+            lnext->result.store(lnext->mutation(newComb->obj));
+            hp.protectPtrRelease(kHpNext, lnext, tid);
+            mn = lnext;
+        }
+        newComb->updateHead(mn);
+        newComb->rwLock.downgrade();
+        // Make the mutation visible to other threads by advancing curComb
+        for (int i = 0; i < domain.maxThreads; i++) {
+            lcomb = curComb.load();
+            if (!lcomb->rwLock.sharedTryLock(tid)) continue;
+            if (lcomb->head->ticket.load() >= myTicket) {
+                lcomb->rwLock.sharedUnlock(tid);
+                if (lcomb != curComb.load()) continue;
+                break;
+            }
+            // The head of lcomb can't change while we hold its shared lock
+            newComb->prevHead = lcomb->head;
+            Combined* tmp = lcomb;
+            if (curComb.compare_exchange_strong(tmp, newComb)) {
+                lcomb->rwLock.setReadUnlock();
+                Node* first = lcomb->prevHead;
+                Node* last = lcomb->head;
+                lcomb->rwLock.sharedUnlock(tid);
+                // Retire the nodes up to the head of lcomb, one publication behind (first is nullptr at the start)
+                if (first != nullptr) retireNodes(first, last, tid);
+                return myNode->result.load();
+            }
+            lcomb->rwLock.sharedUnlock(tid);
+        }
+        newComb->rwLock.setReadUnlock();
+        return myNode->result.load();
+    }
+
+    /*
+     * Progress Condition: wait-free (bounded by the number of threads)
+     */
+    template<typename F> R applyRead(F&& readFunc, const int tid) {
+        Node* myNode = nullptr;
+        for (int i = 0; i < MAX_READ_TRIES + domain.maxThreads; i++) {
+            Combined* lcomb = curComb.load();
+            if (i == MAX_READ_TRIES) { // enqueue read-only operation as if it was a mutation
+                myNode = newNode(readFunc, tid);
+                hp.protectPtr(kHpMyNode, myNode, tid);
+                enqueue(myNode, tid);
+            }
+            if (lcomb->rwLock.sharedTryLock(tid)) {
+                if (lcomb == curComb.load()) {
+                    auto ret = readFunc(lcomb->obj);
+                    lcomb->rwLock.sharedUnlock(tid);
+                    return ret;
+                }
+                lcomb->rwLock.sharedUnlock(tid);
+            }
+        }
+        return myNode->result.load();
+    }
+
+    /*
+     * Same as the methods above, but the tid is the one the ThreadRegistry assigned to the calling thread.
+     * It must be lower than the maxThreads of the Domain.
+     */
+    template<typename F> R applyUpdate(F&& mutativeFunc) {
+        return applyUpdate(std::forward<F>(mutativeFunc), registeredTID());
+    }
+
+    template<typename F> R applyRead(F&& readFunc) {
+        return applyRead(std::forward<F>(readFunc), registeredTID());
+    }
+};
+
+#endif /* _CXMUTATIONWF_LITE_H_ */
@@ -15,11 +15,15 @@
 #include <functional>
 #include <cassert>
 #include <chrono>
+#include <memory>
+#include <new>
 #include <thread>
 
 #include "../common/CircularArray.hpp"
 #include "../common/HazardPointersCX.hpp"
 #include "../common/StrongTryRIRWLock.hpp"
+#include "../common/ThreadRegistry.hpp"
+#include "../common/UCStats.hpp"
 
 using namespace std;
 using namespace chrono;
@@ -46,7 +50,7 @@ using namespace chrono;
  * Hazard Pointers paper:
  * http://web.cecs.pdx.edu/~walpole/class/cs510/papers/11.pdf
  */
-template<typename C, typename R = bool>  // R must fit in an a std::atomic<R>
+template<typename C, typename R = bool, typename STATS = NoStats>  // R must fit in an a std::atomic<R>
 class CXMutationWFTimed {
 
 private:
@@ -75,7 +79,7 @@ private:
     struct Combined {
         Node*                      head {nullptr};
         C*                         obj {nullptr};
-        StrongTryRIRWLock          rwLock {MAX_THREADS};
+        StrongTryRIRWLock<>        rwLock;
         uint64_t                   numLocks {0};
         uint64_t                   numCopies {0};
         uint64_t                   pad[16];              // Avoid false sharing
@@ -86,6 +90,9 @@ private:
             if (head != nullptr) head->refcnt.fetch_add(-1);
             head = mn;
         }
+
+        // The read indicator of rwLock has one entry per thread
+        Combined(const int maxThreads) : rwLock{maxThreads} { }
     };
 
     alignas(128) std::atomic<Combined*> curComb { nullptr };
@@ -99,7 +106,7 @@ private:
     alignas(128) Combined* combs;
 
     // Enqueue requests
-    alignas(128) std::atomic<Node*> enqueuers[MAX_THREADS];
+    alignas(128) std::atomic<Node*>* enqueuers;   // maxThreads entries
 
     // Latest measurement of copy time
     alignas(128) std::atomic<microseconds> copyTime {1000us};
@@ -113,7 +120,9 @@ private:
     const int kHpNext     = 3;
     const int kHpMyNode   = 4;
 
-    CircularArray<Node>* preRetired[MAX_THREADS];
+    CircularArray<Node>** preRetired; // maxThreads entries
+
+    STATS ucStats {maxThreads};
 
     Combined* getCombined(uint64_t myTicket, const int tid) {
         for (int i = 0; i < maxThreads; i++) {
@@ -173,19 +182,28 @@ private:
     }
 
     // Copies a full data structure and saves the time duration in copyTimes
-    void copyDS(C*& to, C* from) {
+    void copyDS(C*& to, C* from, const int tid) {
         auto startTime = steady_clock::now();
-        to = new C(*from);                       // Run Copy Constructor
+        to = ucStats.copy(*from, tid);             // Run Copy Constructor
         auto endTime = steady_clock::now();
         microseconds timeus = duration_cast<microseconds>(endTime-startTime);
         copyTime.store(timeus, std::memory_order_release);
     }
 
+    // The tid of the calling thread, for the methods without a tid argument
+    inline int registeredTID() const {
+        const int tid = ThreadRegistry::getTID();
+        assert(tid < maxThreads);
+        return tid;
+    }
 
 public:
     CXMutationWFTimed(C* inst, const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
-        combs = new Combined[2*maxThreads];
+        combs = std::allocator<Combined>().allocate(2*maxThreads);
+        for (int i = 0; i < 2*maxThreads; i++) new (&combs[i]) Combined(maxThreads);
+        enqueuers = new std::atomic<Node*>[maxThreads];
         for (int i = 0; i < maxThreads; i++) enqueuers[i].store(nullptr, std::memory_order_relaxed);
+        preRetired = new CircularArray<Node>*[maxThreads];
         for (int i = 0; i < maxThreads; i++) preRetired[i] = new CircularArray<Node>(hp,i);
         // Start with two or 4 valid combined instances
         combs[0].head = sentinel;
@@ -224,13 +242,23 @@ public:
         //printf("\n");
         //std::cout<<"count "<<count<<"\n";
         for (int i = 0; i < maxThreads; i++) delete preRetired[i];
-        delete[] combs;
+        delete[] preRetired;
+        delete[] enqueuers;
+        for (int i = 0; i < 2*maxThreads; i++) combs[i].~Combined();
+        std::allocator<Combined>().deallocate(combs, 2*maxThreads);
         delete sentinel;
         //std::cout << "numCopies = " << numCopies.load() << "\n";
     }
 
     static std::string className() { return "CXWFTimed-"; }
 
+    // Sum of the statistics of all threads, only hpScans unless STATS is UCStats
+    UCStatsSnapshot stats() const {
+        UCStatsSnapshot snap = ucStats.snapshot();
+        snap.hpScans = hp.getNumScans();
+        return snap;
+    }
+
     /*
      * Adds the mutativeFunc to the queue and applies all mutations up to it, returning the result.
      *
@@ -256,6 +284,7 @@ public:
             return myNode->result.load();
         }
         Combined* lcomb = nullptr;
+        ucStats.add(STATS_LOCK_HOLDS, tid);
         // Apply all mutations starting from 'head' up to our node or the end of the list
         while (mn != myNode) {
             if (mn == nullptr || mn == mn->next.load()) {
@@ -270,13 +299,14 @@ public:
                 // Neither the 'instance' nor the 'head' will change now that we hold the shared lock
                 newComb->updateHead(mn);
                 delete newComb->obj;
-                copyDS(newComb->obj, lcomb->obj);
+                copyDS(newComb->obj, lcomb->obj, tid);
                 lcomb->rwLock.sharedUnlock(tid);
                 continue;
             }
             Node* lnext = hp.protectPtr(kHpHead, mn->next.load(), tid);
             if(mn == mn->next.load()) continue;
             lnext->result.store(lnext->mutation(newComb->obj), std::memory_order_relaxed);
+            ucStats.add(STATS_MUTATIONS, tid);
             hp.protectPtrRelease(kHpNext, lnext, tid);
             mn = lnext;
         }
@@ -320,6 +350,7 @@ public:
         for (int i=0; i < MAX_READ_TRIES + maxThreads; i++) {
             Combined* lcomb = curComb.load();
             if (i == MAX_READ_TRIES) { // enqueue read-only operation as if it was a mutation
+                ucStats.add(STATS_READ_FALLBACKS, tid);
                 myNode = new Node(readFunc, tid);
                 hp.protectPtr(kHpMyNode, myNode, tid);
                 enqueue(myNode, tid);
@@ -355,13 +386,13 @@ public:
             if (ltail != tail.load()) continue; // If the tail advanced maxThreads times, then my node has been enqueued
             if (enqueuers[ltail->enqTid].load() == ltail) {  // Help a thread do step 4
                 Node* tmp = ltail;
-                enqueuers[ltail->enqTid].compare_exchange_strong(tmp, nullptr);
+                if (enqueuers[ltail->enqTid].compare_exchange_strong(tmp, nullptr) && ltail->enqTid != tid) ucStats.add(STATS_ENQUEUE_HELPS, tid);
             }
             for (int j = 1; j < maxThreads+1; j++) {         // Help a thread do step 2
                 Node* nodeToHelp = enqueuers[(j + ltail->enqTid) % maxThreads].load();
                 if (nodeToHelp == nullptr) continue;
                 Node* nodenull = nullptr;
-                ltail->next.compare_exchange_strong(nodenull, nodeToHelp);
+                if (ltail->next.compare_exchange_strong(nodenull, nodeToHelp) && nodeToHelp != myNode) ucStats.add(STATS_ENQUEUE_HELPS, tid);
                 break;
             }
             Node* lnext = ltail->next.load();
@@ -369,11 +400,23 @@ public:
                 hp.protectPtr(kHpTailNext, lnext, tid);
                 if (ltail != tail.load()) continue;
                 lnext->ticket.store(ltail->ticket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
-                tail.compare_exchange_strong(ltail, lnext); // Help a thread do step 3:
+                if (tail.compare_exchange_strong(ltail, lnext) && lnext != myNode) ucStats.add(STATS_ENQUEUE_HELPS, tid); // Help a thread do step 3:
             }
         }
         enqueuers[tid].store(nullptr, std::memory_order_release); // Do step 4, just in case it's not done
     }
+
+    /*
+     * Same as the methods above, but the tid is the one the ThreadRegistry assigned to the calling thread.
+     * It must be lower than the maxThreads passed to the constructor.
+     */
+    template<typename F> R applyUpdate(F&& mutativeFunc) {
+        return applyUpdate(std::forward<F>(mutativeFunc), registeredTID());
+    }
+
+    template<typename F> R applyRead(F&& readFunc) {
+        return applyRead(std::forward<F>(readFunc), registeredTID());
+    }
 };
 
 #endif /* _CXMUTATION_WF_TIMED_H_ */
@@ -15,6 +15,9 @@
 #include <functional>
 #include <cassert>
 
+#include "../common/UCStats.hpp"
+#include "../common/URCUReadersVersion.hpp"
+
 
 /**
  * <h1> Herlihy's Universal wait-free construct </h1>
@@ -23,15 +26,37 @@
  *
  * Consistency: Linearizable
  * applyUpdate() progress: wait-free
- * applyRead() progress: wait-free (not specific to reads)
- * Memory Reclamation: none, it leaks memory like crazy
+ * applyRead() progress: wait-free (on a copy, without adding a node to the log)
+ * Memory Reclamation: URCUGraceVersion, blocking (a thread that stalls in apply() stops the reclamation)
+ *
+ * Checkpoints:
+ * Instead of replaying the whole log on a copy of the initial object, apply()
+ * replays it on a copy of the latest checkpoint, which is an object with all
+ * the mutations up to one of the nodes of the log. A thread whose node is at
+ * least CHECKPOINT_INTERVAL nodes after the checkpoint publishes its copy as
+ * the new checkpoint (with a CAS), which means the replay goes through at most
+ * CHECKPOINT_INTERVAL nodes plus the ones of the concurrent threads. Each replay
+ * stores the result in the node, so a thread whose node is already behind the
+ * checkpoint takes its result from there.
+ *
+ * Reclamation:
+ * The nodes before the checkpoint and the old checkpoints are retired to
+ * URCUGraceVersion, and every apply() is a read-side critical section. A node is
+ * also referenced by the announce[] of its thread, so it has two references, one
+ * dropped when the checkpoint moves past it and the other when its thread clears
+ * its announce[] entry, and it's retired by the last of the two. Herlihy's head[]
+ * array is replaced by 'last', the most recent node known to be in the log, which
+ * is never behind the checkpoint and therefore never retired while it's in 'last'.
  *
+ * STATS counts the copies, the mutations that are replayed on each copy and the
+ * nodes of other threads that were threaded in the list (as enqueueHelps).
  */
-template<typename C>
+template<typename C, typename STATS = NoStats>
 class HerlihyUniversal {
 
 private:
     static const int MAX_THREADS = 128; // Increase this for the stress tests
+    static const uint64_t CHECKPOINT_INTERVAL = 64;
 
     template<typename T>
     class Consensus {
@@ -72,96 +97,172 @@ private:
 
     struct Node {
         std::function<bool(C*)>    mutation; // TODO: change bool to void*
-        Consensus<Node>            decideNext{MAX_THREADS}; // decide next Node in list
+        Consensus<Node>            decideNext; // decide next Node in list
         std::atomic<bool>          result {false};   // This needs to be (relaxed) atomic because there are write-races on it. TODO: change to void*
         std::atomic<Node*>         next {nullptr};
         std::atomic<uint64_t>      seq {0}; // sequence number
+        std::atomic<int>           refs {2}; // One for the log, until it's behind the checkpoint, and one for announce[]
 
         // TODO: change bool to void*
-        Node(std::function<bool(C*)>& mutFunc, int tid) : mutation{mutFunc} { }
-
-        bool casNext(Node* cmp, Node* val) {
-            return next.compare_exchange_strong(cmp, val);
-        }
+        Node(std::function<bool(C*)>& mutFunc, int maxThreads) : mutation{mutFunc}, decideNext{maxThreads} { }
+    };
 
-        Node* max(std::atomic<Node*>* array) {
-            Node* lmax = array[0].load();
-            for (int i = 1; i < MAX_THREADS; i++) {
-                Node* node = array[i].load();
-                if (node == nullptr) continue;
-                if (lmax->seq < node->seq) lmax = node;
-            }
-            return lmax;
-        }
+    // The object with all the mutations up to (and including) node
+    struct Checkpoint {
+        C*    obj;
+        Node* node;
+        Checkpoint(C* obj, Node* node) : obj{obj}, node{node} { }
+        ~Checkpoint() { delete obj; }
     };
 
+    const int maxThreads;
 
-    alignas(128) std::atomic<Node*>* announce;
-    alignas(128) std::atomic<Node*>* heads;
-    alignas(128) C* initialInst;
+    alignas(128) std::atomic<Node*>* announce;    // nullptr when the thread is not in apply()
+    alignas(128) std::atomic<Node*> last;
+    alignas(128) std::atomic<Checkpoint*> checkpoint;
 
     std::function<bool(C*)> sentinelMutation = [](C* c){ return false; };
-    Node* sentinel = new Node(sentinelMutation, 0);
-    // The tail of the queue/list of mutations.
-    // Starts by pointing to a sentinel/dummy node
-    Node* tail {sentinel};
+    Node* sentinel;
+
+    URCUGraceVersion urcu {maxThreads};
+
+    STATS ucStats {maxThreads};
+
+    // Drops one reference of node, the last one retires it
+    inline void release(Node* node, const int tid) {
+        if (node->refs.fetch_add(-1) == 1) urcu.retire(node, tid);
+    }
+
+    // Moves 'last' forward to node, if it's behind
+    inline void advanceLast(Node* node) {
+        Node* llast = last.load();
+        while (llast->seq.load() < node->seq.load() && !last.compare_exchange_weak(llast, node)) { }
+    }
+
+    /*
+     * Publishes myObject, which has all the mutations up to myNode, as the new checkpoint if
+     * lcp is still the current one, and retires the nodes from lcp->node up to myNode.
+     * Returns false if myObject wasn't used.
+     */
+    bool publishCheckpoint(Checkpoint* lcp, C* myObject, Node* myNode, const int tid) {
+        Checkpoint* newcp = new Checkpoint(myObject, myNode);
+        if (!checkpoint.compare_exchange_strong(lcp, newcp)) {
+            newcp->obj = nullptr;
+            delete newcp;
+            return false;
+        }
+        Node* node = lcp->node;
+        while (node != myNode) {
+            Node* lnext = node->next.load();
+            release(node, tid);
+            node = lnext;
+        }
+        urcu.retire(lcp, tid);
+        return true;
+    }
 
 
 public:
 
-    HerlihyUniversal(C* inst) {
-        initialInst = inst;
+    HerlihyUniversal(C* inst, const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+        sentinel = new Node(sentinelMutation, maxThreads);
         sentinel->seq = 1;
-        announce = new std::atomic<Node*>[MAX_THREADS];
-        heads = new std::atomic<Node*>[MAX_THREADS];
-        for (int i = 0; i < MAX_THREADS; i++) {
-            announce[i].store(sentinel, std::memory_order_relaxed);
-            heads[i].store(sentinel, std::memory_order_relaxed);
-        }
+        sentinel->refs.store(1, std::memory_order_relaxed);   // It's never in announce[]
+        announce = new std::atomic<Node*>[maxThreads];
+        for (int i = 0; i < maxThreads; i++) announce[i].store(nullptr, std::memory_order_relaxed);
+        last.store(sentinel, std::memory_order_relaxed);
+        checkpoint.store(new Checkpoint(inst, sentinel));
     }
 
 
     ~HerlihyUniversal() {
         delete[] announce;
-        delete[] heads;
-        Node* node = tail;
+        // The nodes before the checkpoint were retired and are freed by urcu
+        Checkpoint* lcp = checkpoint.load();
+        Node* node = lcp->node;
         while (node != nullptr) {
             Node* prev = node;
             node = node->next.load();
             delete prev;
         }
-        delete initialInst;
+        delete lcp;
     }
 
 
     static std::string className() { return "HerlihyUniversal-"; }
 
 
+    // Sum of the statistics of all threads, empty unless STATS is UCStats
+    UCStatsSnapshot stats() const { return ucStats.snapshot(); }
+
+
     //template<typename R>
     bool apply(std::function<bool(C*)>& mutativeFunc, const int tid) { // TODO: change bool to void*/R
-        Node* myNode = new Node(mutativeFunc, tid);
+        Node* myNode = new Node(mutativeFunc, maxThreads);
+        urcu.read_lock(tid);
         announce[tid].store(myNode);
-        heads[tid].store(myNode->max(heads));
-
-        while (announce[tid].load()->seq == 0) {
-            Node* before = heads[tid].load();
-            Node* help = announce[(int)((before->seq+1) % MAX_THREADS)].load();
+        Node* before = last.load();
+        while (myNode->seq.load() == 0) {
+            Node* help = announce[(int)((before->seq+1) % maxThreads)].load();
             Node* prefer = nullptr;
-            if (help->seq == 0) prefer = help;
-            else prefer = announce[tid].load();
+            if (help != nullptr && help->seq == 0) prefer = help;
+            else prefer = myNode;
             Node* after = before->decideNext.decide(prefer, tid);
+            if (after != myNode) ucStats.add(STATS_ENQUEUE_HELPS, tid);
             before->next.store(after);
             after->seq = before->seq + 1;
-            heads[tid].store(after);
+            before = after;
         }
-        C* myObject = new C(*initialInst);
-        Node* current = tail->next.load();
-        while (current != announce[tid].load()){
-            current->mutation(myObject);
+        advanceLast(myNode);   // 'last' is never behind a completed operation, nor behind the checkpoint
+        bool retval;
+        Checkpoint* lcp = checkpoint.load();
+        if (lcp->node->seq.load() >= myNode->seq.load()) {
+            // Our mutation is already in the checkpoint, and its result in our node
+            retval = myNode->result.load();
+        } else {
+            C* myObject = ucStats.copy(*lcp->obj, tid);
+            Node* current = lcp->node->next.load();
+            while (current != myNode){
+                current->result.store(current->mutation(myObject), std::memory_order_relaxed);
+                ucStats.add(STATS_MUTATIONS, tid);
+                current = current->next.load();
+            }
+            retval = mutativeFunc(myObject);
+            myNode->result.store(retval);
+            if (myNode->seq.load() - lcp->node->seq.load() < CHECKPOINT_INTERVAL || !publishCheckpoint(lcp, myObject, myNode, tid)) {
+                delete myObject;
+            }
+        }
+        urcu.read_unlock(tid);
+        announce[tid].store(nullptr);
+        release(myNode, tid);
+        return retval;
+    }
+
+
+    // Same as apply(), for UCSet and the other wrappers
+    template<typename F> bool applyUpdate(F&& mutativeFunc, const int tid) {
+        std::function<bool(C*)> func = std::forward<F>(mutativeFunc);
+        return apply(func, tid);
+    }
+
+    /*
+     * Applies readFunc on a copy of the checkpoint with the mutations up to 'last', which
+     * includes all the operations that completed before this one, without adding a node to the log.
+     */
+    template<typename F> bool applyRead(F&& readFunc, const int tid) {
+        urcu.read_lock(tid);
+        Checkpoint* lcp = checkpoint.load();
+        Node* llast = last.load();
+        C* myObject = ucStats.copy(*lcp->obj, tid);
+        Node* current = lcp->node;
+        while (current != llast) {
             current = current->next.load();
+            current->mutation(myObject);
+            ucStats.add(STATS_MUTATIONS, tid);
         }
-        heads[tid].store(announce[tid].load());
-        auto retval = mutativeFunc(myObject);
+        urcu.read_unlock(tid);
+        bool retval = readFunc(myObject);
         delete myObject;
         return retval;
     }
@@ -136,10 +136,10 @@ public:
     static std::string className() { return "PSim-"; }
 
 
-    R applyUpdate(std::function<R(C*)>& mutativeFunc, const int tid) {
+    template<typename F> R applyUpdate(F&& mutativeFunc, const int tid) {
         // Publish mutation and retire previous mutation
         auto oldmut = mutations[tid].load(std::memory_order_relaxed);
-        std::function<bool(C*)>* newmut = new std::function<bool(C*)>(mutativeFunc);
+        std::function<R(C*)>* newmut = new std::function<R(C*)>(std::forward<F>(mutativeFunc));
         mutations[tid].store(newmut, std::memory_order_relaxed);
         if (oldmut != nullptr) hpMut.retire(oldmut, tid);
         const bool newrequest = !announce[tid].load();
@@ -188,8 +188,8 @@ public:
     }
 
 
-    inline R applyRead(std::function<R(C*)>& mutativeFunc, const int tid) {
-        return applyUpdate(mutativeFunc,tid);
+    template<typename F> inline R applyRead(F&& mutativeFunc, const int tid) {
+        return applyUpdate(std::forward<F>(mutativeFunc),tid);
     }
 };
 
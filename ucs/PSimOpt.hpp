@@ -13,11 +13,13 @@
 #include <stdexcept>
 #include <cstdint>
 #include <functional>
+#include <memory>
 #include <cassert>
 #include <thread>
 #include <chrono>
 
 #include "../common/HazardPointers.hpp"
+#include "../common/UCStats.hpp"
 
 using namespace std;
 using namespace std::chrono;
@@ -62,9 +64,14 @@ using namespace std::chrono;
  *   original had 16;
  * - We don't use an HalfObjectState (no need for it);
  * - We don't have a backoff mechanism;
+ * - The arrays of ObjectState are sized for maxThreads (not MAX_THREADS) and
+ *   the applied bits are packed in 64 bit words, like in the original, so
+ *   copyFrom() copies maxThreads/64 words and maxThreads results. The bits are
+ *   toggled with a load, XOR and store, because only the owner of an
+ *   ObjectState writes on it;
  *
  */
-template<typename C, typename R = bool>  // R must fit in an a std::atomic<R>
+template<typename C, typename R = bool, typename STATS = NoStats>  // R must fit in an a std::atomic<R>
 class PSimOpt {
 
 private:
@@ -73,23 +80,37 @@ private:
 
     class ObjectState {
     public:
-        std::atomic<bool>  applied[MAX_THREADS];
-        std::atomic<R>     results[MAX_THREADS];
-        std::atomic<C*>    instance;
-        ObjectState(C* firstInstance=nullptr) { // Used only by the first objState instance
-            for (int i = 0; i < MAX_THREADS; i++) applied[i].store(false, std::memory_order_relaxed);
-            for (int i = 0; i < MAX_THREADS; i++) results[i].store(R{}, std::memory_order_relaxed);
-            instance.store(firstInstance, std::memory_order_relaxed);
+        const int               numThreads;
+        const int               numWords;
+        std::atomic<uint64_t>*  applied;     // One bit per thread
+        std::atomic<R>*         results;
+        std::atomic<C*>         instance;
+        ObjectState(const int numThreads) : numThreads{numThreads}, numWords{(numThreads+63)/64} {
+            applied = new std::atomic<uint64_t>[numWords];
+            results = new std::atomic<R>[numThreads];
+            for (int i = 0; i < numWords; i++) applied[i].store(0, std::memory_order_relaxed);
+            for (int i = 0; i < numThreads; i++) results[i].store(R{}, std::memory_order_relaxed);
+            instance.store(nullptr, std::memory_order_relaxed);
         }
         ~ObjectState() {
             delete instance.load();
+            delete[] applied;
+            delete[] results;
+        }
+        inline bool isApplied(const int tid) const {
+            return (applied[tid/64].load(std::memory_order_relaxed) >> (tid%64)) & 1;
+        }
+        // Only the thread that owns this ObjectState writes on it, so there is no need for a fetch_xor()
+        inline void toggleApplied(const int tid) {
+            applied[tid/64].store(applied[tid/64].load(std::memory_order_relaxed) ^ (1ULL << (tid%64)), std::memory_order_relaxed);
         }
         // We can't use the "copy assignment operator" because we need to make sure that the instance
-        // we're copying is the one we have protected with the hazard pointer
-        void copyFrom(const ObjectState& from, C* inst) {
-            for (int i = 0; i < MAX_THREADS; i++) applied[i].store(from.applied[i].load(), std::memory_order_relaxed);
-            for (int i = 0; i < MAX_THREADS; i++) results[i].store(from.results[i].load(), std::memory_order_relaxed);
-            instance.store(new C(*inst), std::memory_order_release);
+        // we're copying is the one we have protected with the hazard pointer.
+        // newInst is the copy of that instance.
+        void copyFrom(const ObjectState& from, C* newInst) {
+            for (int i = 0; i < numWords; i++) applied[i].store(from.applied[i].load(), std::memory_order_relaxed);
+            for (int i = 0; i < numThreads; i++) results[i].store(from.results[i].load(), std::memory_order_relaxed);
+            instance.store(newInst, std::memory_order_release);
         }
     };
 
@@ -106,7 +127,7 @@ private:
     // The array of mutations must be atomic due to read-write races, but it's all relaxed
     alignas(128) std::atomic<std::function<R(C*)>*>  mutations[MAX_THREADS]; // Array of mutations
     alignas(128) std::atomic<bool>                   announce[MAX_THREADS];
-    alignas(128) ObjectState                         objStates[MAX_THREADS*2]; // We need two ObjecStates per thread
+    alignas(128) ObjectState*                        objStates;  // We need two ObjecStates per thread
     alignas(128) std::atomic<SeqPointer>             objPointer; // Points to an ObjectState in objStates array
 
     // Hazard Pointers
@@ -115,10 +136,15 @@ private:
     HazardPointers<C> hpInst {1, maxThreads};
     const int kHpInst = 0;
 
+    STATS ucStats {maxThreads};
+
 
 public:
 
     PSimOpt(C* inst, const int maxThreads=MAX_THREADS) : maxThreads{maxThreads} {
+        assert(maxThreads <= MAX_THREADS);
+        objStates = std::allocator<ObjectState>().allocate(2*maxThreads);
+        for (int i = 0; i < 2*maxThreads; i++) new (&objStates[i]) ObjectState(maxThreads);
         SeqPointer first;
         first.u.index = 0; // Point to objStates[0]
         first.u.seq = 0;
@@ -135,16 +161,22 @@ public:
         for (int i = 0; i < maxThreads; i++) {
             if (mutations[i].load() != nullptr) delete mutations[i];
         }
+        for (int i = 0; i < 2*maxThreads; i++) objStates[i].~ObjectState();
+        std::allocator<ObjectState>().deallocate(objStates, 2*maxThreads);
     }
 
 
     static std::string className() { return "PSimOpt-"; }
 
 
-    R applyUpdate(std::function<R(C*)>& mutativeFunc, const int tid) {
+    // Sum of the statistics of all threads, empty unless STATS is UCStats
+    UCStatsSnapshot stats() const { return ucStats.snapshot(); }
+
+
+    template<typename F> R applyUpdate(F&& mutativeFunc, const int tid) {
         // Publish mutation and retire previous mutation
         auto oldmut = mutations[tid].load(std::memory_order_relaxed);
-        std::function<bool(C*)>* newmut = new std::function<bool(C*)>(mutativeFunc);
+        std::function<R(C*)>* newmut = new std::function<R(C*)>(std::forward<F>(mutativeFunc));
         mutations[tid].store(newmut, std::memory_order_relaxed);
         if (oldmut != nullptr) hpMut.retire(oldmut, tid);
         const bool newrequest = !announce[tid].load();
@@ -162,21 +194,24 @@ public:
             C* delInst = newState.instance.load();
             if (delInst != nullptr) hpInst.retire(delInst, tid);
             // Copy the contents of the current ObjectState into the new ObjectState, except for inst
-            newState.copyFrom(objStates[lptr.u.index], inst);
+            newState.copyFrom(objStates[lptr.u.index], ucStats.copy(*inst, tid));
             // Save a pointer to the copy of the instance because that's where we're applying the mutations
             C* newInst = newState.instance.load();
             if (lptr.raw != objPointer.load().raw) continue;
             // Check if my mutation has been applied
-            if (newState.applied[tid] == newrequest) break;
+            if (newState.isApplied(tid) == newrequest) break;
+            ucStats.add(STATS_LOCK_HOLDS, tid);
             // Help other requests, starting from zero
             for (int i = 0; i < maxThreads; i++) {
                 // Check if it is an open request
-                if (announce[i].load() == newState.applied[i]) continue;
-                newState.applied[i] = !newState.applied[i];
+                if (announce[i].load() == newState.isApplied(i)) continue;
+                newState.toggleApplied(i);
                 // Apply the mutation and save the result
                 auto mutation = hpMut.protectPtr(kHpMut, mutations[i].load(), tid);
                 if (mutation != mutations[i].load()) continue;
                 newState.results[i].store((*mutation)(newInst), std::memory_order_relaxed);
+                ucStats.add(STATS_MUTATIONS, tid);
+                if (i != tid) ucStats.add(STATS_ENQUEUE_HELPS, tid);
                 if (lptr.raw != objPointer.load().raw) break;
             }
             if (lptr.raw != objPointer.load().raw) continue;
@@ -196,7 +231,7 @@ public:
     /*
      * Progress condition: wait-free
      */
-    R applyRead(std::function<R(C*)>& readOnlyFunc, const int tid) {
+    template<typename F> R applyRead(F&& readOnlyFunc, const int tid) {
         for (int i = 0; i < MAX_READ_TRIES; i++) {
             SeqPointer lptr = objPointer.load();
             C* inst = hpInst.protectPtr(kHpInst, objStates[lptr.u.index].instance.load(), tid);
@@ -207,6 +242,7 @@ public:
             return retVal;
         }
         // We can't get the hp on inst, so we have to go with a mutative operation instead
+        ucStats.add(STATS_READ_FALLBACKS, tid);
         return applyUpdate(readOnlyFunc, tid);
     }
 };